@@ -0,0 +1,7 @@
+/* this file is autogenerated by make core/autover.h
+ * DO NOT EDIT IT
+ */
+
+#define REPO_VER ""
+#define REPO_HASH "unknown"
+#define REPO_STATE ""
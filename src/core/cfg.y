@@ -262,6 +262,10 @@ extern char *default_routename;
 %token UDP4_RAW
 %token UDP4_RAW_MTU
 %token UDP4_RAW_TTL
+%token UDP_RCV_BATCH
+%token UDP_SND_BATCH
+%token UDP_REUSEPORT
+%token UDP_CPU_AFFINITY
 %token IF
 %token ELSE
 %token SET_ADV_ADDRESS
@@ -352,6 +356,7 @@ extern char *default_routename;
 %token DNS_CACHE_MAX_TTL
 %token DNS_CACHE_MEM
 %token DNS_CACHE_GC_INT
+%token DNS_CACHE_PREFETCH
 %token DNS_CACHE_DEL_NONEXP
 %token DNS_CACHE_REC_PREF
 
@@ -404,6 +409,7 @@ extern char *default_routename;
 %token DISABLE_TCP
 %token TCP_ACCEPT_ALIASES
 %token TCP_CHILDREN
+%token TCP_MAIN_PROCS
 %token TCP_CONNECT_TIMEOUT
 %token TCP_SEND_TIMEOUT
 %token TCP_CON_LIFETIME
@@ -834,6 +840,8 @@ assign_stm:
 	| DNS_CACHE_MEM error { yyerror("boolean value expected"); }
 	| DNS_CACHE_GC_INT EQUAL NUMBER   { IF_DNS_CACHE(dns_timer_interval=$3); }
 	| DNS_CACHE_GC_INT error { yyerror("boolean value expected"); }
+	| DNS_CACHE_PREFETCH EQUAL NUMBER   { IF_DNS_CACHE(dns_cache_prefetch=$3); }
+	| DNS_CACHE_PREFETCH error { yyerror("number expected"); }
 	| DNS_CACHE_DEL_NONEXP EQUAL NUMBER   { IF_DNS_CACHE(default_core_cfg.dns_cache_del_nonexp=$3); }
 	| DNS_CACHE_DEL_NONEXP error { yyerror("boolean value expected"); }
 	| DNS_CACHE_REC_PREF EQUAL NUMBER   { IF_DNS_CACHE(default_core_cfg.dns_cache_rec_pref=$3); }
@@ -968,6 +976,17 @@ assign_stm:
 		#endif
 	}
 	| TCP_CHILDREN EQUAL error { yyerror("number expected"); }
+	| TCP_MAIN_PROCS EQUAL NUMBER {
+		#ifdef USE_TCP
+			if ($3<1 || $3>TCP_MAIN_PROCS_MAX)
+				yyerror("tcp_main_processes out of range");
+			else
+				tcp_main_procs=$3;
+		#else
+			warn("tcp support not compiled in");
+		#endif
+	}
+	| TCP_MAIN_PROCS EQUAL error { yyerror("number expected"); }
 	| TCP_CONNECT_TIMEOUT EQUAL intno {
 		#ifdef USE_TCP
 			tcp_default_cfg.connect_timeout_s=$3;
@@ -1564,6 +1583,14 @@ assign_stm:
 		IF_RAW_SOCKS(default_core_cfg.udp4_raw_ttl=$3);
 	}
 	| UDP4_RAW_TTL EQUAL error { yyerror("number expected"); }
+	| UDP_RCV_BATCH EQUAL NUMBER { udp_rcv_batch=$3; }
+	| UDP_RCV_BATCH EQUAL error { yyerror("number expected"); }
+	| UDP_SND_BATCH EQUAL NUMBER { udp_snd_batch=$3; }
+	| UDP_SND_BATCH EQUAL error { yyerror("number expected"); }
+	| UDP_REUSEPORT EQUAL NUMBER { udp_reuseport=$3; }
+	| UDP_REUSEPORT EQUAL error { yyerror("number expected"); }
+	| UDP_CPU_AFFINITY EQUAL NUMBER { udp_cpu_affinity=$3; }
+	| UDP_CPU_AFFINITY EQUAL error { yyerror("number expected"); }
 	| cfg_var
 	| error EQUAL { yyerror("unknown config variable"); }
 	;
@@ -675,19 +675,35 @@ static void core_tcpinfo(rpc_t* rpc, void* c)
 {
 #ifdef USE_TCP
 	void *handle;
+	void *ah;
+	void *ph;
 	struct tcp_gen_info ti;
+	int i;
 
 	if (!tcp_disable){
 		tcp_get_info(&ti);
 		rpc->add(c, "{", &handle);
-		rpc->struct_add(handle, "dddddd",
+		rpc->struct_add(handle, "ddddddd",
 			"readers", ti.tcp_readers,
+			"main_processes", ti.tcp_main_procs,
 			"max_connections", ti.tcp_max_connections,
 			"max_tls_connections", ti.tls_max_connections,
 			"opened_connections", ti.tcp_connections_no,
 			"opened_tls_connections", ti.tls_connections_no,
 			"write_queued_bytes", ti.tcp_write_queued
 		);
+		/* connection hashes partitions lock contention */
+		if (tcpconn_parts &&
+				rpc->struct_add(handle, "[", "partitions", &ah) >= 0) {
+			for (i = 0; i < TCP_CONN_PARTS; i++) {
+				if (rpc->array_add(ah, "{", &ph) < 0)
+					break;
+				rpc->struct_add(ph, "ddd",
+					"id", i,
+					"locks", tcpconn_parts[i].p.locks,
+					"contended", tcpconn_parts[i].p.contended);
+			}
+		}
 	}else{
 		rpc->fault(c, 500, "tcp support disabled");
 	}
@@ -751,7 +767,6 @@ static const char* core_tcp_list_doc[] = {
 	0                               /* Method signature(s) */
 };
 
-extern gen_lock_t* tcpconn_lock;
 extern struct tcp_connection** tcpconn_id_hash;
 
 static void core_tcp_list(rpc_t* rpc, void* c)
@@ -770,8 +785,8 @@ static void core_tcp_list(rpc_t* rpc, void* c)
 		return;
 	}
 
-	TCPCONN_LOCK;
 	for(i = 0; i < TCP_ID_HASH_SIZE; i++) {
+		TCPCONN_LOCK(tcp_id_part(i));
 		for (con = tcpconn_id_hash[i]; con; con = con->id_next) {
 			rpc->add(c, "{", &handle);
 			/* tcp data */
@@ -833,8 +848,8 @@ static void core_tcp_list(rpc_t* rpc, void* c)
 					"dst_ip", dst_ip,
 					"dst_port", con->rcv.dst_port);
 		}
+		TCPCONN_UNLOCK(tcp_id_part(i));
 	}
-	TCPCONN_UNLOCK;
 #else
 	rpc->fault(c, 500, "tcp support not compiled");
 #endif
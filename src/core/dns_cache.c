@@ -51,6 +51,7 @@
 #include "error.h"
 #include "rpc.h"
 #include "rand/fastrand.h"
+#include "timer_proc.h"
 #ifdef USE_DNS_CACHE_STATS
 #include "pt.h"
 #endif
@@ -68,6 +69,9 @@
 							   dns answer*/
 
 #define DNS_HASH_SIZE	1024 /* must be <= 65535 */
+#define DNS_HASH_LOCKS	64 /* lock stripes, must divide DNS_HASH_SIZE */
+#define DNS_CLEAN_BATCH	32 /* entries removed per last used list pass */
+#define DNS_PREFETCH_BATCH	16 /* entries refreshed per bucket pass */
 #define DEFAULT_DNS_TIMER_INTERVAL 120  /* 2 min. */
 #define DNS_HE_MAX_ADDR 10  /* maxium addresses returne in a hostent struct */
 #define MAX_CNAME_CHAIN  10
@@ -76,9 +80,13 @@
 										selecting a 0-weight record */
 
 int dns_cache_init=1;	/* if 0, the DNS cache is not initialized at startup */
-static gen_lock_t* dns_hash_lock=0;
+static gen_lock_set_t* dns_hash_locks=0; /* bucket h uses lock
+											h%DNS_HASH_LOCKS */
+static gen_lock_t* dns_lu_lock=0; /* last used list & mem. use */
 static volatile unsigned int *dns_cache_mem_used=0; /* current mem. use */
 unsigned int dns_timer_interval=DEFAULT_DNS_TIMER_INTERVAL; /* in s */
+unsigned int dns_cache_prefetch=0; /* refresh used entries that expire in
+									  less than dns_cache_prefetch s */
 int dns_flags=0; /* default flags used for the  dns_*resolvehost
                     (compatibility wrappers) */
 
@@ -86,8 +94,13 @@ int dns_flags=0; /* default flags used for the  dns_*resolvehost
 struct t_dns_cache_stats* dns_cache_stats=0;
 #endif
 
-#define LOCK_DNS_HASH()		lock_get(dns_hash_lock)
-#define UNLOCK_DNS_HASH()	lock_release(dns_hash_lock)
+/* bucket lock, protects the bucket list */
+#define LOCK_DNS_HASH(h)	lock_set_get(dns_hash_locks, (h)%DNS_HASH_LOCKS)
+#define UNLOCK_DNS_HASH(h)	lock_set_release(dns_hash_locks, (h)%DNS_HASH_LOCKS)
+/* protects the last used list and the used mem. counter, it can be taken
+ * while holding a bucket lock, but not the other way around */
+#define LOCK_DNS_LU()		lock_get(dns_lu_lock)
+#define UNLOCK_DNS_LU()		lock_release(dns_lu_lock)
 
 #define FIX_TTL(t) \
 	(((t)<cfg_get(core, core_cfg, dns_cache_min_ttl))? \
@@ -224,10 +237,15 @@ void destroy_dns_cache()
 		dns_servers_up=0;
 	}
 #endif
-	if (dns_hash_lock){
-		lock_destroy(dns_hash_lock);
-		lock_dealloc(dns_hash_lock);
-		dns_hash_lock=0;
+	if (dns_hash_locks){
+		lock_set_destroy(dns_hash_locks);
+		lock_set_dealloc(dns_hash_locks);
+		dns_hash_locks=0;
+	}
+	if (dns_lu_lock){
+		lock_destroy(dns_lu_lock);
+		lock_dealloc(dns_lu_lock);
+		dns_lu_lock=0;
 	}
 	if (dns_hash){
 		shm_free(dns_hash);
@@ -363,14 +381,25 @@ int init_dns_cache()
 	for (r=0; r<DNS_HASH_SIZE; r++)
 		clist_init(&dns_hash[r], next, prev);
 
-	dns_hash_lock=lock_alloc();
-	if (dns_hash_lock==0){
+	dns_hash_locks=lock_set_alloc(DNS_HASH_LOCKS);
+	if (dns_hash_locks==0){
 		ret=E_OUT_OF_MEM;
 		goto error;
 	}
-	if (lock_init(dns_hash_lock)==0){
-		lock_dealloc(dns_hash_lock);
-		dns_hash_lock=0;
+	if (lock_set_init(dns_hash_locks)==0){
+		lock_set_dealloc(dns_hash_locks);
+		dns_hash_locks=0;
+		ret=-1;
+		goto error;
+	}
+	dns_lu_lock=lock_alloc();
+	if (dns_lu_lock==0){
+		ret=E_OUT_OF_MEM;
+		goto error;
+	}
+	if (lock_init(dns_lu_lock)==0){
+		lock_dealloc(dns_lu_lock);
+		dns_lu_lock=0;
 		ret=-1;
 		goto error;
 	}
@@ -405,6 +434,8 @@ int init_dns_cache()
 			goto error;
 		}
 	}
+	if (dns_cache_prefetch)
+		register_sync_timers(1);
 
 	return 0;
 error:
@@ -477,15 +508,14 @@ int init_dns_cache_stats(int iproc_num)
 #endif /* DNS_CACHE_DEBUG */
 
 
-/* must be called with the DNS_LOCK hold
+/* must be called with the bucket lock held
  * remove and entry from the hash, dec. its refcnt and if not referenced
  * anymore deletes it */
 inline static void _dns_hash_remove(struct dns_hash_entry* e)
 {
 	clist_rm(e, next, prev);
-#ifdef DNS_CACHE_DEBUG
-	e->next=e->prev=0;
-#endif
+	e->next=e->prev=0; /* mark it as removed, see dns_hash_remove_refd() */
+	LOCK_DNS_LU();
 #ifdef DNS_LU_LST
 #ifdef DEBUG_LU_LST
 	debug_lu_lst("_dns_hash_remove: pre rm:", &e->last_used_lst);
@@ -499,44 +529,61 @@ inline static void _dns_hash_remove(struct dns_hash_entry* e)
 #endif
 #endif
 	*dns_cache_mem_used-=e->total_size;
+	UNLOCK_DNS_LU();
 	dns_hash_put(e);
 }
 
 
 
-/* non locking  version (the dns hash must _be_ locked externally)
+/* marks the entry as used (must be called with the bucket lock held)
+ * the entry is moved at the end of the last used list at most once per
+ * tick, to keep the last used list lock out of the common lookup path */
+inline static void _dns_hash_touch(struct dns_hash_entry* e, ticks_t now)
+{
+	if (e->last_used==now)
+		return;
+	e->last_used=now;
+#ifdef DNS_LU_LST
+	LOCK_DNS_LU();
+	/* add it at the end */
+#ifdef DEBUG_LU_LST
+	debug_lu_lst("_dns_hash_touch: pre rm:", &e->last_used_lst);
+#endif
+	clist_rm(&e->last_used_lst, next, prev);
+	clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
+#ifdef DEBUG_LU_LST
+	debug_lu_lst("_dns_hash_touch: post append:", &e->last_used_lst);
+#endif
+	UNLOCK_DNS_LU();
+#endif
+}
+
+
+
+/* non locking version (the bucket h must _be_ locked externally)
+ * looks only in bucket h (the cnames are not followed, see dns_hash_get())
  * returns 0 when not found, or the entry on success (an entry with a
  * similar name but with a CNAME type will always match).
  * it doesn't increase the internal refcnt
- * returns the entry when found, 0 when not found and sets *err to !=0
- *  on error (e.g. recursive cnames)
  * WARNING: - internal use only
  *          - always check if the returned entry type is CNAME */
 inline static struct dns_hash_entry* _dns_hash_find(str* name, int type,
-														int* h, int* err)
+														int h)
 {
 	struct dns_hash_entry* e;
 	struct dns_hash_entry* tmp;
-	struct dns_hash_entry* ret;
 	ticks_t now;
-	int cname_chain;
-	str cname;
 #ifdef DNS_WATCHDOG_SUPPORT
 	int servers_up;
 
 	servers_up = atomic_get(dns_servers_up);
 #endif
 
-	cname_chain=0;
-	ret=0;
 	now=get_ticks_raw();
-	*err=0;
-again:
-	*h=dns_hash_no(name->s, name->len, type);
 #ifdef DNS_CACHE_DEBUG
-	LM_DBG("(%.*s(%d), %d), h=%d\n", name->len, name->s, name->len, type, *h);
+	LM_DBG("(%.*s(%d), %d), h=%d\n", name->len, name->s, name->len, type, h);
 #endif
-	clist_foreach_safe(&dns_hash[*h], e, tmp, next){
+	clist_foreach_safe(&dns_hash[h], e, tmp, next){
 		if (
 #ifdef DNS_WATCHDOG_SUPPORT
 			/* remove expired elements only when the dns servers are up */
@@ -549,18 +596,7 @@ again:
 				_dns_hash_remove(e);
 		}else if ((e->type==type) && (e->name_len==name->len) &&
 			(strncasecmp(e->name, name->s, e->name_len)==0)){
-			e->last_used=now;
-#ifdef DNS_LU_LST
-			/* add it at the end */
-#ifdef DEBUG_LU_LST
-			debug_lu_lst("_dns_hash_find: pre rm:", &e->last_used_lst);
-#endif
-			clist_rm(&e->last_used_lst, next, prev);
-			clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
-#ifdef DEBUG_LU_LST
-			debug_lu_lst("_dns_hash_find: post append:", &e->last_used_lst);
-#endif
-#endif
+			_dns_hash_touch(e, now);
 			return e;
 		}else if ((e->type==T_CNAME) &&
 					!((e->rr_lst==0) || (e->ent_flags & DNS_FLAG_BAD_NAME)) &&
@@ -568,37 +604,37 @@ again:
 					(strncasecmp(e->name, name->s, e->name_len)==0)){
 			/*if CNAME matches and CNAME is entry is not a neg. cache entry
 			  (could be produced by a specific CNAME lookup)*/
-			e->last_used=now;
-#ifdef DNS_LU_LST
-			/* add it at the end */
-#ifdef DEBUG_LU_LST
-			debug_lu_lst("_dns_hash_find: cname: pre rm:", &e->last_used_lst);
-#endif
-			clist_rm(&e->last_used_lst, next, prev);
-			clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
-#ifdef DEBUG_LU_LST
-			debug_lu_lst("_dns_hash_find: cname: post append:",
-							&e->last_used_lst);
-#endif
-#endif
-			ret=e; /* if this is an unfinished cname chain, we try to
-					  return the last cname */
-			/* this is a cname => retry using its value */
-			if (cname_chain> MAX_CNAME_CHAIN){
-				LM_ERR("cname chain too long or recursive (\"%.*s\")\n",
-						name->len, name->s);
-				ret=0; /* error*/
-				*err=-1;
-				break;
-			}
-			cname_chain++;
-			cname.s=((struct cname_rdata*)e->rr_lst->rdata)->name;
-			cname.len= ((struct cname_rdata*)e->rr_lst->rdata)->name_len;
-			name=&cname;
-			goto again;
+			_dns_hash_touch(e, now);
+			return e;
 		}
 	}
-	return ret;
+	return 0;
+}
+
+
+
+/* removes the entries from the hash (if still there), the entries must
+ * be referenced by the caller and the references are released
+ * (must be called without any dns lock held)
+ * returns the number of removed entries */
+static int dns_hash_remove_refd(struct dns_hash_entry** e, int n)
+{
+	int i;
+	int h;
+	int deleted;
+
+	deleted=0;
+	for (i=0; i<n; i++){
+		h=dns_hash_no(e[i]->name, e[i]->name_len, e[i]->type);
+		LOCK_DNS_HASH(h);
+		if (e[i]->next){ /* not removed in the meantime */
+			_dns_hash_remove(e[i]);
+			deleted++;
+		}
+		UNLOCK_DNS_HASH(h);
+		dns_hash_put(e[i]);
+	}
+	return deleted;
 }
 
 
@@ -617,6 +653,8 @@ inline static int dns_cache_clean(unsigned int no, int expired_only)
 #ifdef DNS_LU_LST
 	struct dns_lu_lst* l;
 	struct dns_lu_lst* tmp;
+	struct dns_hash_entry* batch[DNS_CLEAN_BATCH];
+	int cnt;
 #else
 	struct dns_hash_entry* t;
 	unsigned int h;
@@ -626,22 +664,30 @@ inline static int dns_cache_clean(unsigned int no, int expired_only)
 	n=0;
 	deleted=0;
 	now=get_ticks_raw();
-	LOCK_DNS_HASH();
 #ifdef DNS_LU_LST
-	clist_foreach_safe(dns_last_used_lst, l, tmp, next){
-		e=(struct dns_hash_entry*)(((char*)l)-
-				(char*)&((struct dns_hash_entry*)(0))->last_used_lst);
-		if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
-			&& (!expired_only || ((s_ticks_t)(now-e->expire)>=0))
-		) {
-				_dns_hash_remove(e);
-				deleted++;
+	/* the bucket locks cannot be taken while holding the last used list
+	 * lock => reference a batch of entries and remove them afterwards */
+	do{
+		cnt=0;
+		LOCK_DNS_LU();
+		clist_foreach_safe(dns_last_used_lst, l, tmp, next){
+			e=(struct dns_hash_entry*)(((char*)l)-
+					(char*)&((struct dns_hash_entry*)(0))->last_used_lst);
+			if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
+				&& (!expired_only || ((s_ticks_t)(now-e->expire)>=0))
+			) {
+					atomic_inc(&e->refcnt);
+					batch[cnt++]=e;
+			}
+			n++;
+			if ((n>=no) || (cnt==DNS_CLEAN_BATCH)) break;
 		}
-		n++;
-		if (n>=no) break;
-	}
+		UNLOCK_DNS_LU();
+		deleted+=dns_hash_remove_refd(batch, cnt);
+	}while((cnt==DNS_CLEAN_BATCH) && (n<no));
 #else
 	for(h=start; h!=(start+DNS_HASH_SIZE); h++){
+		LOCK_DNS_HASH(h%DNS_HASH_SIZE);
 		clist_foreach_safe(&dns_hash[h%DNS_HASH_SIZE], e, t, next){
 			if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
 				&& ((s_ticks_t)(now-e->expire)>=0)
@@ -650,26 +696,34 @@ inline static int dns_cache_clean(unsigned int no, int expired_only)
 				deleted++;
 			}
 			n++;
-			if (n>=no) goto skip;
+			if (n>=no){
+				UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
+				goto skip;
+			}
 		}
+		UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
 	}
 	/* not fair, but faster then random() */
 	if (!expired_only){
 		for(h=start; h!=(start+DNS_HASH_SIZE); h++){
+			LOCK_DNS_HASH(h%DNS_HASH_SIZE);
 			clist_foreach_safe(&dns_hash[h%DNS_HASH_SIZE], e, t, next){
 				if ((e->ent_flags & DNS_FLAG_PERMANENT) == 0) {
 					_dns_hash_remove(e);
 					deleted++;
 				}
 				n++;
-				if (n>=no) goto skip;
+				if (n>=no){
+					UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
+					goto skip;
+				}
 			}
+			UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
 		}
 	}
 skip:
 	start=h;
 #endif
-	UNLOCK_DNS_HASH();
 	return deleted;
 }
 
@@ -688,6 +742,9 @@ inline static int dns_cache_free_mem(unsigned int target, int expired_only)
 #ifdef DNS_LU_LST
 	struct dns_lu_lst* l;
 	struct dns_lu_lst* tmp;
+	struct dns_hash_entry* batch[DNS_CLEAN_BATCH];
+	unsigned int batch_size;
+	int cnt;
 #else
 	struct dns_hash_entry* t;
 	unsigned int h;
@@ -696,24 +753,35 @@ inline static int dns_cache_free_mem(unsigned int target, int expired_only)
 
 	deleted=0;
 	now=get_ticks_raw();
-	LOCK_DNS_HASH();
 #ifdef DNS_LU_LST
-	clist_foreach_safe(dns_last_used_lst, l, tmp, next){
-		if (*dns_cache_mem_used<=target) break;
-		e=(struct dns_hash_entry*)(((char*)l)-
-				(char*)&((struct dns_hash_entry*)(0))->last_used_lst);
-		if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
-			&& (!expired_only || ((s_ticks_t)(now-e->expire)>=0))
-		) {
-				_dns_hash_remove(e);
-				deleted++;
+	do{
+		cnt=0;
+		batch_size=0;
+		LOCK_DNS_LU();
+		clist_foreach_safe(dns_last_used_lst, l, tmp, next){
+			if (*dns_cache_mem_used<=target+batch_size) break;
+			e=(struct dns_hash_entry*)(((char*)l)-
+					(char*)&((struct dns_hash_entry*)(0))->last_used_lst);
+			if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
+				&& (!expired_only || ((s_ticks_t)(now-e->expire)>=0))
+			) {
+					atomic_inc(&e->refcnt);
+					batch[cnt++]=e;
+					batch_size+=e->total_size;
+					if (cnt==DNS_CLEAN_BATCH) break;
+			}
 		}
-	}
+		UNLOCK_DNS_LU();
+		deleted+=dns_hash_remove_refd(batch, cnt);
+	}while((cnt==DNS_CLEAN_BATCH) && (*dns_cache_mem_used>target));
 #else
 	for(h=start; h!=(start+DNS_HASH_SIZE); h++){
+		LOCK_DNS_HASH(h%DNS_HASH_SIZE);
 		clist_foreach_safe(&dns_hash[h%DNS_HASH_SIZE], e, t, next){
-			if (*dns_cache_mem_used<=target)
+			if (*dns_cache_mem_used<=target){
+				UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
 				goto skip;
+			}
 			if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
 				&& ((s_ticks_t)(now-e->expire)>=0)
 			) {
@@ -721,13 +789,17 @@ inline static int dns_cache_free_mem(unsigned int target, int expired_only)
 				deleted++;
 			}
 		}
+		UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
 	}
 	/* not fair, but faster then random() */
 	if (!expired_only){
 		for(h=start; h!=(start+DNS_HASH_SIZE); h++){
+			LOCK_DNS_HASH(h%DNS_HASH_SIZE);
 			clist_foreach_safe(&dns_hash[h%DNS_HASH_SIZE], e, t, next){
-				if (*dns_cache_mem_used<=target)
+				if (*dns_cache_mem_used<=target){
+					UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
 					goto skip;
+				}
 				if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
 					&& ((s_ticks_t)(now-e->expire)>=0)
 				) {
@@ -735,12 +807,12 @@ inline static int dns_cache_free_mem(unsigned int target, int expired_only)
 					deleted++;
 				}
 			}
+			UNLOCK_DNS_HASH(h%DNS_HASH_SIZE);
 		}
 	}
 skip:
 	start=h;
 #endif
-	UNLOCK_DNS_HASH();
 	return deleted;
 }
 
@@ -752,19 +824,49 @@ skip:
  *  if the search matches a CNAME. On error sets *err (e.g. recursive CNAMEs).
  * it increases the internal refcnt => when finished dns_hash_put() must
  *  be called on the returned entry
+ * Each step of a CNAME chain locks only the bucket of the current name,
+ *  the previous CNAME entry is kept referenced while its value is used.
  *  WARNING: - the return might be a CNAME even if type!=CNAME, see above */
 inline static struct dns_hash_entry* dns_hash_get(str* name, int type, int* h,
 													int* err)
 {
 	struct dns_hash_entry* e;
+	struct dns_hash_entry* ret;
+	int cname_chain;
+	str cname;
 
-	LOCK_DNS_HASH();
-	e=_dns_hash_find(name, type, h, err);
-	if (e){
-		atomic_inc(&e->refcnt);
+	ret=0;
+	*err=0;
+	for (cname_chain=0; ; cname_chain++){
+		*h=dns_hash_no(name->s, name->len, type);
+		LOCK_DNS_HASH(*h);
+		e=_dns_hash_find(name, type, *h);
+		if (e){
+			atomic_inc(&e->refcnt);
+		}
+		UNLOCK_DNS_HASH(*h);
+		if (e==0)
+			break; /* if this is an unfinished cname chain, we return the
+					  last cname */
+		if (ret)
+			dns_hash_put(ret);
+		ret=e;
+		if (e->type==type)
+			break;
+		/* this is a cname => retry using its value */
+		if (cname_chain>MAX_CNAME_CHAIN){
+			LM_ERR("cname chain too long or recursive (\"%.*s\")\n",
+					name->len, name->s);
+			dns_hash_put(ret);
+			ret=0; /* error*/
+			*err=-1;
+			break;
+		}
+		cname.s=((struct cname_rdata*)e->rr_lst->rdata)->name;
+		cname.len= ((struct cname_rdata*)e->rr_lst->rdata)->name_len;
+		name=&cname;
 	}
-	UNLOCK_DNS_HASH();
-	return e;
+	return ret;
 }
 
 
@@ -797,25 +899,29 @@ inline static int dns_cache_add(struct dns_hash_entry* e)
 	LM_DBG("adding %.*s(%d) %d (flags=%0x) at %d\n",
 			e->name_len, e->name, e->name_len, e->type, e->ent_flags, h);
 #endif
-	LOCK_DNS_HASH();
+	LOCK_DNS_HASH(h);
+		clist_append(&dns_hash[h], e, next, prev);
+		LOCK_DNS_LU();
 		*dns_cache_mem_used+=e->total_size; /* no need for atomic ops, written
 										 only from within a lock */
-		clist_append(&dns_hash[h], e, next, prev);
 #ifdef DNS_LU_LST
 		clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
 #endif
-	UNLOCK_DNS_HASH();
+		UNLOCK_DNS_LU();
+	UNLOCK_DNS_HASH(h);
 	return 0;
 }
 
 
 
-/* same as above, but it must be called with the dns hash lock held
+/* same as above, but it must be called with the lock of the entry bucket
+ * held
  * returns 0 on success, -1 on error */
 inline static int dns_cache_add_unsafe(struct dns_hash_entry* e)
 {
 	int h;
 
+	h=dns_hash_no(e->name, e->name_len, e->type);
 	/* check space */
 	/* atomic_add_long(dns_cache_total_used, e->size); */
 	if ((*dns_cache_mem_used+e->total_size)>=cfg_get(core, core_cfg, dns_cache_max_mem)){
@@ -824,27 +930,28 @@ inline static int dns_cache_add_unsafe(struct dns_hash_entry* e)
 #endif
 		LM_WARN("cache full, trying to free...\n");
 		/* free ~ 12% of the cache */
-		UNLOCK_DNS_HASH();
+		UNLOCK_DNS_HASH(h);
 		dns_cache_free_mem(*dns_cache_mem_used/16*14,
 					!cfg_get(core, core_cfg, dns_cache_del_nonexp));
-		LOCK_DNS_HASH();
+		LOCK_DNS_HASH(h);
 		if ((*dns_cache_mem_used+e->total_size)>=cfg_get(core, core_cfg, dns_cache_max_mem)){
 			LM_ERR("max. cache mem size exceeded\n");
 			return -1;
 		}
 	}
 	atomic_inc(&e->refcnt);
-	h=dns_hash_no(e->name, e->name_len, e->type);
 #ifdef DNS_CACHE_DEBUG
 	LM_DBG("adding %.*s(%d) %d (flags=%0x) at %d\n",
 			e->name_len, e->name, e->name_len, e->type, e->ent_flags, h);
 #endif
+	clist_append(&dns_hash[h], e, next, prev);
+	LOCK_DNS_LU();
 	*dns_cache_mem_used+=e->total_size; /* no need for atomic ops, written
 										 only from within a lock */
-	clist_append(&dns_hash[h], e, next, prev);
 #ifdef DNS_LU_LST
 	clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
 #endif
+	UNLOCK_DNS_LU();
 	return 0;
 }
 
@@ -1390,7 +1497,8 @@ inline static struct dns_hash_entry* dns_cache_mk_rd_entry(str* name, int type,
 				;
 	}
 	*tail_rr=0; /* terminate the list */
-	e->expire=now+S_TO_TICKS(max_ttl);
+	e->ttl=S_TO_TICKS(max_ttl);
+	e->expire=now+e->ttl;
 	free_rdata_list(tmp_lst);
 	return e;
 }
@@ -1692,7 +1800,8 @@ found:
 	}
 	for (r=0; r<no_records; r++){
 		*rec[r].tail_rr=0; /* terminate the list */
-		rec[r].e->expire=now+S_TO_TICKS(rec[r].max_ttl);
+		rec[r].e->ttl=S_TO_TICKS(rec[r].max_ttl);
+		rec[r].e->expire=now+rec[r].e->ttl;
 	}
 	return rec[0].e;
 error:
@@ -1824,11 +1933,15 @@ inline static struct dns_hash_entry* dns_get_related(struct dns_hash_entry* e,
 
 
 /* calls the external resolver and populates the cache with the result
+ * if refresh is set, the cached entries with the same name and type are
+ * replaced by the new ones (unless permanent) and no negative entry is
+ * added on failure
  * returns: 0 on error, pointer to hash entry on success
  * WARNING: make sure you use dns_hash_entry_put() when you're
  *  finished with the result)
  * */
-inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
+static struct dns_hash_entry* _dns_cache_do_request(str* name, int type,
+														int refresh)
 {
 	struct rdata* records;
 	struct dns_hash_entry* e;
@@ -1840,7 +1953,7 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 	char name_buf[MAX_DNS_NAME];
 	struct dns_hash_entry* old;
 	str rec_name;
-	int add_record, h, err;
+	int add_record, h;
 
 	e=0;
 	l=0;
@@ -1910,17 +2023,18 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 			/* add all the records to the hash */
 			l->prev->next=0; /* we break the double linked list for easier
 								searching */
-			LOCK_DNS_HASH(); /* optimization */
 			for (r=l; r; r=t){
 				t=r->next;
+				h=dns_hash_no(r->name, r->name_len, r->type);
+				LOCK_DNS_HASH(h);
 				/* add the new record to the cache by default */
 				add_record = 1;
-				if (cfg_get(core, core_cfg, dns_cache_rec_pref) > 0) {
+				if (refresh || cfg_get(core, core_cfg, dns_cache_rec_pref) > 0) {
 					/* check whether there is an old record with the
 					 * same type in the cache */
 					rec_name.s = r->name;
 					rec_name.len = r->name_len;
-					old = _dns_hash_find(&rec_name, r->type, &h, &err);
+					old = _dns_hash_find(&rec_name, r->type, h);
 					if (old) {
 						if (old->type != r->type) {
 							/* probably CNAME found */
@@ -1930,6 +2044,10 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 							/* never overwrite permanent entries */
 							add_record = 0;
 
+						} else if (refresh) {
+							/* replace it, but keep its usage */
+							r->last_used = old->last_used;
+
 						} else if ((old->ent_flags & DNS_FLAG_BAD_NAME) == 0) {
 							/* Non-negative, non-permanent entry found with
 							 * the same type. */
@@ -1964,8 +2082,8 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 					}
 					dns_destroy_entry(r);
 				}
+				UNLOCK_DNS_HASH(h);
 			}
-			UNLOCK_DNS_HASH();
 			/* if only cnames found => try to resolve the last one */
 			if (cname_val.s){
 				LM_DBG("dns_get_entry(cname: %.*s (%d))\n",
@@ -1977,7 +2095,7 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 		l=dns_cache_mk_rd_entry2(records);
 #endif
 		free_rdata_list(records);
-	}else if (cfg_get(core, core_cfg, dns_neg_cache_ttl)){
+	}else if (!refresh && cfg_get(core, core_cfg, dns_neg_cache_ttl)){
 		e=dns_cache_mk_bad_entry(name, type, 
 				cfg_get(core, core_cfg, dns_neg_cache_ttl), DNS_FLAG_BAD_NAME);
 		if (likely(e)) {
@@ -1992,7 +2110,6 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 		 * we are looking for */
 		l->prev->next=0; /* we break the double linked list for easier
 							searching */
-		LOCK_DNS_HASH(); /* optimization */
 		for (r=l; r; r=t){
 			t=r->next;
 			if (e==0){ /* no entry found yet */
@@ -2014,14 +2131,16 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 				}
 			}
 
+			h=dns_hash_no(r->name, r->name_len, r->type);
+			LOCK_DNS_HASH(h);
 			/* add the new record to the cache by default */
 			add_record = 1;
-			if (cfg_get(core, core_cfg, dns_cache_rec_pref) > 0) {
+			if (refresh || cfg_get(core, core_cfg, dns_cache_rec_pref) > 0) {
 				/* check whether there is an old record with the
 				 * same type in the cache */
 				rec_name.s = r->name;
 				rec_name.len = r->name_len;
-				old = _dns_hash_find(&rec_name, r->type, &h, &err);
+				old = _dns_hash_find(&rec_name, r->type, h);
 				if (old) {
 					if (old->type != r->type) {
 						/* probably CNAME found */
@@ -2031,6 +2150,10 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 						/* never overwrite permanent entries */
 						add_record = 0;
 
+					} else if (refresh) {
+						/* replace it, but keep its usage */
+						r->last_used = old->last_used;
+
 					} else if ((old->ent_flags & DNS_FLAG_BAD_NAME) == 0) {
 						/* Non-negative, non-permanent entry found with
 						 * the same type. */
@@ -2065,8 +2188,8 @@ inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
 				}
 				dns_destroy_entry(r);
 			}
+			UNLOCK_DNS_HASH(h);
 		}
-		UNLOCK_DNS_HASH();
 		if ((e==0) && (cname_val.s)){ /* not found, but found a cname */
 			/* only one cname is allowed (rfc2181), so we ignore the
 			 * others (we take only the first one) */
@@ -2080,6 +2203,13 @@ end:
 
 
 
+inline static struct dns_hash_entry* dns_cache_do_request(str* name, int type)
+{
+	return _dns_cache_do_request(name, type, 0);
+}
+
+
+
 /* tries to lookup (name, type) in the hash and if not found tries to make
  *  a dns request
  *  return: 0 on error, pointer to a dns_hash_entry on success
@@ -2141,6 +2271,84 @@ error:
 
 
 
+/* dns_cache_prefetch process: re-resolves the entries that will expire in
+ * less than dns_cache_prefetch seconds and were used since entering this
+ * interval, so that the frequently used entries are refreshed before
+ * expiring instead of being resolved again on the request path
+ * (the refreshed entries inherit the last use time, an entry is refreshed
+ * again only if it is used again). For the entries with a ttl shorter than
+ * dns_cache_prefetch the interval is capped at half of the ttl, so that an
+ * entry is not re-resolved on every run. */
+static void dns_cache_prefetch_timer(unsigned int ticks, void* param)
+{
+	struct {
+		char name[MAX_DNS_NAME];
+		int len;
+		unsigned short type;
+	} pf[DNS_PREFETCH_BATCH];
+	struct dns_hash_entry* e;
+	str name;
+	ticks_t now;
+	ticks_t ahead;
+	ticks_t e_ahead;
+	int h, i, n;
+
+	if (!cfg_get(core, core_cfg, use_dns_cache))
+		return;
+#ifdef DNS_WATCHDOG_SUPPORT
+	if (atomic_get(dns_servers_up)==0)
+		return; /* refreshing would fail */
+#endif
+	ahead=S_TO_TICKS(dns_cache_prefetch);
+	for (h=0; h<DNS_HASH_SIZE; h++){
+		n=0;
+		now=get_ticks_raw();
+		LOCK_DNS_HASH(h);
+		clist_foreach(&dns_hash[h], e, next){
+			e_ahead=(e->ttl && e->ttl/2<ahead)?e->ttl/2:ahead;
+			if ((e->ent_flags & (DNS_FLAG_PERMANENT|DNS_FLAG_BAD_NAME))
+					|| ((s_ticks_t)(e->expire-now)<=0) /* already expired */
+					|| ((s_ticks_t)(e->expire-now)>(s_ticks_t)e_ahead)
+					|| TICKS_LT(e->last_used, e->expire-e_ahead))
+				continue;
+			memcpy(pf[n].name, e->name, e->name_len);
+			pf[n].len=e->name_len;
+			pf[n].type=e->type;
+			if (++n==DNS_PREFETCH_BATCH)
+				break;
+		}
+		UNLOCK_DNS_HASH(h);
+		/* resolve without holding any lock */
+		for (i=0; i<n; i++){
+			name.s=pf[i].name;
+			name.len=pf[i].len;
+			LM_DBG("refreshing %.*s (%d)\n", name.len, name.s, pf[i].type);
+			e=_dns_cache_do_request(&name, pf[i].type, 1);
+			if (e)
+				dns_hash_put(e);
+		}
+	}
+}
+
+
+
+/* forks the dns_cache_prefetch process (if enabled), called from the main
+ * process
+ * returns 0 on success, -1 on error */
+int dns_cache_prefetch_start(void)
+{
+	if ((dns_cache_init==0) || (dns_cache_prefetch==0))
+		return 0;
+	if (fork_sync_timer(-1 /*PROC_TIMER*/, "dns prefetch", 1,
+				dns_cache_prefetch_timer, NULL, 1)<0) {
+		LM_ERR("failed to start the dns prefetch process\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+
 /* gets the first non-expired record starting with record no
  * from the dns_hash_entry struct e
  * params:       e   - dns_hash_entry struct
@@ -3526,8 +3734,8 @@ void dns_cache_debug(rpc_t* rpc, void* ctx)
 		return;
 	}
 	now=get_ticks_raw();
-	LOCK_DNS_HASH();
 		for (h=0; h<DNS_HASH_SIZE; h++){
+			LOCK_DNS_HASH(h);
 			clist_foreach(&dns_hash[h], e, next){
 				rpc->add(ctx, "sdddddd",
 								e->name, e->type, e->total_size, e->refcnt.val,
@@ -3536,8 +3744,8 @@ void dns_cache_debug(rpc_t* rpc, void* ctx)
 								TICKS_TO_S(now-e->last_used),
 								e->ent_flags);
 			}
+			UNLOCK_DNS_HASH(h);
 		}
-	UNLOCK_DNS_HASH();
 }
 
 
@@ -3640,8 +3848,8 @@ void dns_cache_debug_all(rpc_t* rpc, void* ctx)
 		return;
 	}
 	now=get_ticks_raw();
-	LOCK_DNS_HASH();
 		for (h=0; h<DNS_HASH_SIZE; h++){
+			LOCK_DNS_HASH(h);
 			clist_foreach(&dns_hash[h], e, next){
 				for (i=0, rr=e->rr_lst; rr; i++, rr=rr->next){
 					rpc->add(ctx, "sddddddd",
@@ -3694,8 +3902,8 @@ void dns_cache_debug_all(rpc_t* rpc, void* ctx)
 									TICKS_TO_S(rr->expire-now));
 				}
 			}
+			UNLOCK_DNS_HASH(h);
 		}
-	UNLOCK_DNS_HASH();
 }
 
 
@@ -3893,8 +4101,8 @@ void dns_cache_view(rpc_t* rpc, void* ctx)
 		return;
 	}
 	now=get_ticks_raw();
-	LOCK_DNS_HASH();
 	for (h=0; h<DNS_HASH_SIZE; h++){
+		LOCK_DNS_HASH(h);
 		clist_foreach(&dns_hash[h], e, next){
 			if (((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
 				&& TICKS_LT(e->expire, now)
@@ -3905,8 +4113,8 @@ void dns_cache_view(rpc_t* rpc, void* ctx)
 			dns_cache_print_entry(rpc, ctx, e);
 			rpc->rpl_printf(ctx, "}");
 		}
+		UNLOCK_DNS_HASH(h);
 	}
-	UNLOCK_DNS_HASH();
 }
 
 
@@ -3921,14 +4129,14 @@ void dns_cache_flush(int del_permanent)
 	struct dns_hash_entry* tmp;
 
 	LM_DBG("removing elements from the cache\n");
-	LOCK_DNS_HASH();
 		for (h=0; h<DNS_HASH_SIZE; h++){
+			LOCK_DNS_HASH(h);
 			clist_foreach_safe(&dns_hash[h], e, tmp, next){
 				if (del_permanent || ((e->ent_flags & DNS_FLAG_PERMANENT) == 0))
 					_dns_hash_remove(e);
 			}
+			UNLOCK_DNS_HASH(h);
 		}
-	UNLOCK_DNS_HASH();
 }
 
 /* deletes all the non-permanent entries from the cache */
@@ -4355,17 +4563,18 @@ int dns_cache_add_record(unsigned short type,
 		}
 	}
 
-	LOCK_DNS_HASH();
+	h = dns_hash_no(new->name, new->name_len, new->type);
+	LOCK_DNS_HASH(h);
 	if (dns_cache_add_unsafe(new)) {
 		LM_ERR("Failed to add the entry to the cache\n");
-		UNLOCK_DNS_HASH();
+		UNLOCK_DNS_HASH(h);
 		goto error;
 	} else {
 		/* remove the old entry from the list */
 		if (old)
 			_dns_hash_remove(old);
 	}
-	UNLOCK_DNS_HASH();
+	UNLOCK_DNS_HASH(h);
 
 	if (old)
 		dns_hash_put(old);
@@ -4386,7 +4595,7 @@ static void dns_cache_delete_record(rpc_t* rpc, void* ctx, unsigned short type)
 {
 	struct dns_hash_entry *e;
 	str name;
-	int err, h, found=0, permanent=0;
+	int h, found=0, permanent=0;
 
 	if (!cfg_get(core, core_cfg, use_dns_cache)){
 		rpc->fault(ctx, 500, "dns cache support disabled (see use_dns_cache)");
@@ -4396,9 +4605,10 @@ static void dns_cache_delete_record(rpc_t* rpc, void* ctx, unsigned short type)
 	if (rpc->scan(ctx, "S", &name) < 1)
 		return;
 
-	LOCK_DNS_HASH();
+	h=dns_hash_no(name.s, name.len, type);
+	LOCK_DNS_HASH(h);
 
-	e=_dns_hash_find(&name, type, &h, &err);
+	e=_dns_hash_find(&name, type, h);
 	if (e && (e->type==type)) {
 		if ((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
 			_dns_hash_remove(e);
@@ -4407,7 +4617,7 @@ static void dns_cache_delete_record(rpc_t* rpc, void* ctx, unsigned short type)
 		found = 1;
 	}
 
-	UNLOCK_DNS_HASH();
+	UNLOCK_DNS_HASH(h);
 
 	if (permanent)
 		rpc->fault(ctx, 400, "Permanent entries cannot be deleted");
@@ -4530,12 +4740,13 @@ int dns_cache_delete_single_record(unsigned short type,
 	}
 
 delete:
-	LOCK_DNS_HASH();
+	h = dns_hash_no(old->name, old->name_len, old->type);
+	LOCK_DNS_HASH(h);
 	if (new) {
 		/* delete the old entry only if the new one can be added */
 		if (dns_cache_add_unsafe(new)) {
 			LM_ERR("Failed to add the entry to the cache\n");
-			UNLOCK_DNS_HASH();
+			UNLOCK_DNS_HASH(h);
 			if (old)
 				dns_hash_put(old);
 			return -1;
@@ -4547,7 +4758,7 @@ delete:
 	} else if (old) {
 		_dns_hash_remove(old);
 	}
-	UNLOCK_DNS_HASH();
+	UNLOCK_DNS_HASH(h);
 
 	if (old)
 		dns_hash_put(old);
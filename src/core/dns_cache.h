@@ -150,6 +150,7 @@ struct dns_hash_entry{
 	atomic_t refcnt;
 	ticks_t last_used;
 	ticks_t expire; /* when the whole entry will expire */
+	ticks_t ttl; /* lifetime of the resolved entries (0 if unknown) */
 	int total_size;
 	unsigned short type;
 	unsigned char ent_flags; /* entry flags: unresolvable/permanent */
@@ -192,6 +193,7 @@ int init_dns_cache_stats(int iproc_num);
 #define DNS_CACHE_ALL_STATS "dc_all_stats"
 #endif
 void destroy_dns_cache(void);
+int dns_cache_prefetch_start(void);
 
 
 void dns_hash_put(struct dns_hash_entry* e);
@@ -456,6 +456,7 @@ int forward_request(struct sip_msg* msg, str* dst, unsigned short port,
 {
 	unsigned int len;
 	char* buf;
+	msg_iov_t mi;
 	char md5[MD5_LEN];
 	struct socket_info* orig_send_sock; /* initial send_sock */
 	int ret;
@@ -473,6 +474,7 @@ int forward_request(struct sip_msg* msg, str* dst, unsigned short port,
 	
 	
 	buf=0;
+	mi.buf=0;
 	orig_send_sock=send_info->send_sock;
 	proto=send_info->proto;
 	ret=0;
@@ -542,9 +544,29 @@ int forward_request(struct sip_msg* msg, str* dst, unsigned short port,
 			prev_send_sock=send_info->send_sock;
 #endif
 			if (buf) pkg_free(buf);
+			buf=0;
+			msg_iov_free(&mi);
 			send_info->proto=proto;
-			buf = build_req_buf_from_sip_req(msg, &len, send_info, 0);
-			if (!buf){
+			/* the unmodified parts of the message are not copied if
+			 * nothing needs to see the whole outgoing buffer */
+			if (msg_send_iov_enabled(send_info)
+					&& !onsend_route_enabled(SIP_REQUEST)
+					&& likely(_forward_set_send_info==0)){
+				if (build_req_iov_from_sip_req(msg, &mi, send_info, 0)<0){
+					LM_ERR("building failed\n");
+					ret=E_OUT_OF_MEM; /* most probable */
+					goto error;
+				}
+				len=mi.len;
+				if (unlikely(send_info->proto!=PROTO_UDP)){
+					/* switched to another proto (udp mtu exceeded) */
+					buf=msg_iov_join(&mi);
+					msg_iov_free(&mi);
+				}
+			}else{
+				buf = build_req_buf_from_sip_req(msg, &len, send_info, 0);
+			}
+			if (!buf && !mi.buf){
 				LM_ERR("building failed\n");
 				ret=E_OUT_OF_MEM; /* most probable */
 				goto error;
@@ -553,11 +575,15 @@ int forward_request(struct sip_msg* msg, str* dst, unsigned short port,
 		}
 #endif
 		 /* send it! */
-		LM_DBG("Sending:\n%.*s.\n", (int)len, buf);
+		if (buf){
+			LM_DBG("Sending:\n%.*s.\n", (int)len, buf);
+		}else{
+			LM_DBG("Sending %d iovecs\n", mi.cnt);
+		}
 		LM_DBG("orig. len=%d, new_len=%d, proto=%d\n",
 				msg->len, len, send_info->proto );
 	
-		if (run_onsend(msg, send_info, buf, len)==0){
+		if (buf && run_onsend(msg, send_info, buf, len)==0){
 			su2ip_addr(&ip, &send_info->to);
 			LM_INFO("request to %s:%d(%d) dropped (onsend_route)\n",
 				ip_addr2a(&ip), su_getport(&send_info->to), send_info->proto);
@@ -594,7 +620,7 @@ int forward_request(struct sip_msg* msg, str* dst, unsigned short port,
 			p_onsend=&onsnd_info;
 		}
 
-		if (msg_send(send_info, buf, len)<0){
+		if ((buf?msg_send(send_info, buf, len):msg_send_iov(send_info, &mi))<0){
 			p_onsend=0;
 			ret=ser_error=E_SEND;
 #ifdef USE_DST_BLACKLIST
@@ -636,6 +662,7 @@ end:
 	}
 #endif
 	if (buf) pkg_free(buf);
+	msg_iov_free(&mi);
 	/* received_buf & line_buf will be freed in receive_msg by free_lump_list*/
 #if defined STATS_REQ_FWD_OK || defined STATS_REQ_FWD_DROP
 	if(ret==0)
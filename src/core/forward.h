@@ -33,6 +33,7 @@
 #include "route.h"
 #include "proxy.h"
 #include "ip_addr.h"
+#include "msg_translator.h"
 
 #include "stats.h"
 #include "udp_server.h"
@@ -292,4 +293,40 @@ error:
 	return -1;
 }
 
+/* true if a message to dst can be sent with msg_send_iov(), i.e. it goes
+ * over udp and no event handler needs the whole outgoing buffer */
+#define msg_send_iov_enabled(dst) \
+	((dst)->proto==PROTO_UDP && !sr_event_enabled(SREV_NET_DATA_OUT) \
+		&& !sr_event_enabled(SREV_NET_DATA_SEND))
+
+/* sends a message built as iovecs (see build_req_iov_from_sip_req()),
+ * only over udp (check msg_send_iov_enabled() first); the SREV_NET_DATA_*
+ * events are not executed
+ * returns: 0 if ok, -1 on error */
+static inline int msg_send_iov(struct dest_info* dst, msg_iov_t* mi)
+{
+	struct dest_info new_dst;
+
+	if (unlikely(dst->proto!=PROTO_UDP)){
+		LM_BUG("iovec send over proto %d\n", dst->proto);
+		return -1;
+	}
+	if (unlikely((dst->send_sock==0) ||
+				(dst->send_sock->flags & SI_IS_MCAST))){
+		new_dst=*dst;
+		new_dst.send_sock=get_send_socket(0, &dst->to, dst->proto);
+		if (unlikely(new_dst.send_sock==0)){
+			LM_ERR("no sending socket found\n");
+			return -1;
+		}
+		dst=&new_dst;
+	}
+	if (unlikely(udp_sendv(dst, mi->iov, mi->cnt, mi->len)==-1)){
+		STATS_TX_DROPS;
+		LOG(cfg_get(core, core_cfg, corelog), "udp_sendv failed\n");
+		return -1;
+	}
+	return 0;
+}
+
 #endif
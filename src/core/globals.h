@@ -74,7 +74,10 @@ extern int raw_udp4_send_sock;
 extern struct socket_info* sendipv4_tcp; /* ipv4 socket to use when msg.
 										comes from ipv6*/
 extern struct socket_info* sendipv6_tcp; /* same as above for ipv6 */
-extern int unix_tcp_sock; /* socket used for communication with tcp main*/
+/* max. number of tcp main processes (see tcp_main_procs) */
+#define TCP_MAIN_PROCS_MAX 16
+/* sockets used for communication with the tcp main processes */
+extern int unix_tcp_socks[TCP_MAIN_PROCS_MAX];
 #endif
 #ifdef USE_TLS
 extern struct socket_info* sendipv4_tls; /* ipv4 socket to use when msg.
@@ -95,6 +98,7 @@ extern int socket_workers;
 extern int tcp_main_pid;
 extern int tcp_cfg_children_no;
 extern int tcp_children_no;
+extern int tcp_main_procs;
 extern int tcp_disable;
 extern enum poll_types tcp_poll_method;
 extern int tcp_max_connections; /* maximum tcp connections, hard limit */
@@ -143,6 +147,10 @@ extern int auto_bind_ipv6;
 
 extern int tos;
 extern int pmtu_discovery;
+extern int udp_rcv_batch;
+extern int udp_snd_batch;
+extern int udp_reuseport;
+extern int udp_cpu_affinity;
 
 /*
  * debug & log_stderr moved to dprint.h*/
@@ -218,6 +226,8 @@ extern int http_reply_parse;
 #ifdef USE_DNS_CACHE
 extern int dns_cache_init; /* if 0, the DNS cache is not initialized at startup */
 extern unsigned int dns_timer_interval; /* gc timer interval in s */
+extern unsigned int dns_cache_prefetch; /* refresh used entries that expire
+											 in less than it (s) */
 extern int dns_flags; /* default flags used for the  dns_*resolvehost
                     (compatibility wrappers) */
 
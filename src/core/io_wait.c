@@ -35,6 +35,10 @@
 #include <fcntl.h>
 #include <unistd.h> /* close, ioctl */
 #endif
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <unistd.h> /* close() */
+#endif
 
 #include <stdlib.h> /* strtol() */
 #include "io_wait.h"
@@ -66,11 +70,15 @@ char* poll_support="poll"
 #ifdef HAVE_DEVPOLL
 ", /dev/poll"
 #endif
+#ifdef HAVE_IO_URING
+", io_uring"
+#endif
 ;
 
 
 char* poll_method_str[POLL_END]={ "none", "poll", "epoll_lt", "epoll_et", 
-								  "sigio_rt", "select", "kqueue",  "/dev/poll"
+								  "sigio_rt", "select", "kqueue",  "/dev/poll",
+								  "io_uring"
 								};
 
 int _os_ver=0; /* os version number */
@@ -267,6 +275,120 @@ static void destroy_devpoll(io_wait_h* h)
 
 
 
+#ifdef HAVE_IO_URING
+/* max. size of the submission ring, the poll requests are re-armed one
+ * at a time so it doesn't have to hold all the watched fds */
+#define IOU_MAX_SQ_ENTRIES 4096
+/* max. size of the completion ring (kernel limit) */
+#define IOU_MAX_CQ_ENTRIES 65536
+
+static void destroy_io_uring(io_wait_h* h)
+{
+	if (h->sqes){
+		munmap(h->sqes, h->sqes_sz);
+		h->sqes=0;
+	}
+	if (h->cq_ring && h->cq_ring!=h->sq_ring)
+		munmap(h->cq_ring, h->cq_ring_sz);
+	h->cq_ring=0;
+	if (h->sq_ring){
+		munmap(h->sq_ring, h->sq_ring_sz);
+		h->sq_ring=0;
+	}
+	if (h->ring_fd!=-1){
+		close(h->ring_fd);
+		h->ring_fd=-1;
+	}
+}
+
+
+
+/* io_uring specific init (sets up and maps the rings directly, without
+ * liburing)
+ * returns -1 on error, 0 on success */
+static int init_io_uring(io_wait_h* h)
+{
+	struct io_uring_params p;
+	unsigned entries;
+	unsigned cq_entries;
+	unsigned* sq_array;
+	unsigned r;
+
+	for (entries=1; entries<h->max_fd_no && entries<IOU_MAX_SQ_ENTRIES;
+			entries<<=1);
+	/* one pending poll completion per watched fd + the removes */
+	for (cq_entries=entries; cq_entries<2*h->max_fd_no &&
+			cq_entries<IOU_MAX_CQ_ENTRIES; cq_entries<<=1);
+	memset(&p, 0, sizeof(p));
+	p.flags=IORING_SETUP_CQSIZE;
+	p.cq_entries=cq_entries;
+	h->ring_fd=syscall(__NR_io_uring_setup, entries, &p);
+	if (h->ring_fd==-1){
+		LM_WARN("io_uring_setup: %s [%d]\n", strerror(errno), errno);
+		return -1;
+	}
+	/* needed: waiting with timeout in the same call as the submit
+	 * (5.11+) and no completions dropped on cq overflow */
+	if ((p.features & (IORING_FEAT_EXT_ARG|IORING_FEAT_NODROP)) !=
+			(IORING_FEAT_EXT_ARG|IORING_FEAT_NODROP)){
+		LM_WARN("io_uring features 0x%x not supported (0x%x)\n",
+				IORING_FEAT_EXT_ARG|IORING_FEAT_NODROP, p.features);
+		goto error;
+	}
+	h->sq_ring_sz=p.sq_off.array+p.sq_entries*sizeof(unsigned);
+	h->cq_ring_sz=p.cq_off.cqes+p.cq_entries*sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP){
+		if (h->cq_ring_sz>h->sq_ring_sz)
+			h->sq_ring_sz=h->cq_ring_sz;
+		h->cq_ring_sz=h->sq_ring_sz;
+	}
+	h->sq_ring=mmap(0, h->sq_ring_sz, PROT_READ|PROT_WRITE,
+					MAP_SHARED|MAP_POPULATE, h->ring_fd, IORING_OFF_SQ_RING);
+	if (h->sq_ring==MAP_FAILED){
+		h->sq_ring=0;
+		LM_ERR("mmap sq ring: %s [%d]\n", strerror(errno), errno);
+		goto error;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP){
+		h->cq_ring=h->sq_ring;
+	}else{
+		h->cq_ring=mmap(0, h->cq_ring_sz, PROT_READ|PROT_WRITE,
+					MAP_SHARED|MAP_POPULATE, h->ring_fd, IORING_OFF_CQ_RING);
+		if (h->cq_ring==MAP_FAILED){
+			h->cq_ring=0;
+			LM_ERR("mmap cq ring: %s [%d]\n", strerror(errno), errno);
+			goto error;
+		}
+	}
+	h->sqes_sz=p.sq_entries*sizeof(struct io_uring_sqe);
+	h->sqes=mmap(0, h->sqes_sz, PROT_READ|PROT_WRITE,
+					MAP_SHARED|MAP_POPULATE, h->ring_fd, IORING_OFF_SQES);
+	if (h->sqes==MAP_FAILED){
+		h->sqes=0;
+		LM_ERR("mmap sqes: %s [%d]\n", strerror(errno), errno);
+		goto error;
+	}
+	h->sq_head=(unsigned*)((char*)h->sq_ring+p.sq_off.head);
+	h->sq_tail=(unsigned*)((char*)h->sq_ring+p.sq_off.tail);
+	h->sq_mask=*(unsigned*)((char*)h->sq_ring+p.sq_off.ring_mask);
+	h->sq_entries=p.sq_entries;
+	h->cq_head=(unsigned*)((char*)h->cq_ring+p.cq_off.head);
+	h->cq_tail=(unsigned*)((char*)h->cq_ring+p.cq_off.tail);
+	h->cq_mask=*(unsigned*)((char*)h->cq_ring+p.cq_off.ring_mask);
+	h->cqes=(struct io_uring_cqe*)((char*)h->cq_ring+p.cq_off.cqes);
+	/* sqe i is always in sq array slot i */
+	sq_array=(unsigned*)((char*)h->sq_ring+p.sq_off.array);
+	for (r=0; r<p.sq_entries; r++)
+		sq_array[r]=r;
+	return 0;
+error:
+	destroy_io_uring(h);
+	return -1;
+}
+#endif
+
+
+
 #ifdef HAVE_SELECT
 static int init_select(io_wait_h* h)
 {
@@ -349,6 +471,16 @@ char* check_poll_method(enum poll_types poll_method)
 		if (_os_ver<0x0507) /* ver < 5.7 */
 			ret="/dev/poll not supported on Solaris < 7.0 (SunOS 5.7)";
 	#endif
+#endif
+			break;
+		case POLL_IOURING:
+#ifndef HAVE_IO_URING
+			ret="io_uring not supported, try re-compiling with"
+					" -DHAVE_IO_URING";
+#else
+			/* io_uring_enter with timeout needs 5.11 */
+			if (_os_ver<0x050b00) /* if ver < 5.11.0 */
+				ret="io_uring not supported on kernels < 5.11";
 #endif
 			break;
 
@@ -454,6 +586,9 @@ int init_io_wait(io_wait_h* h, int max_fd, enum poll_types poll_method)
 #endif
 #ifdef HAVE_DEVPOLL
 	h->dpoll_fd=-1;
+#endif
+#ifdef HAVE_IO_URING
+	h->ring_fd=-1;
 #endif
 	poll_err=check_poll_method(poll_method);
 	
@@ -468,6 +603,15 @@ int init_io_wait(io_wait_h* h, int max_fd, enum poll_types poll_method)
 					poll_method_str[poll_method]);
 		}
 	}
+#ifdef HAVE_IO_URING
+	/* io_uring can be disabled at runtime (sysctl, seccomp) or miss some
+	 * needed feature => fall back to the auto detected method */
+	if ((poll_method==POLL_IOURING) && (init_io_uring(h)<0)){
+		poll_method=choose_poll_method();
+		LM_WARN("io_uring init failed, using %s instead\n",
+				poll_method_str[poll_method]);
+	}
+#endif
 	
 	h->poll_method=poll_method;
 	
@@ -565,6 +709,11 @@ int init_io_wait(io_wait_h* h, int max_fd, enum poll_types poll_method)
 				goto error;
 			}
 			break;
+#endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			/* already initialized */
+			break;
 #endif
 		default:
 			LM_CRIT("unknown/unsupported poll method %s (%d)\n",
@@ -614,6 +763,11 @@ void destroy_io_wait(io_wait_h* h)
 		case POLL_DEVPOLL:
 			destroy_devpoll(h);
 			break;
+#endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			destroy_io_uring(h);
+			break;
 #endif
 		default: /*do  nothing*/
 			;
@@ -65,6 +65,12 @@
 #ifdef HAVE_DEVPOLL
 #include <sys/devpoll.h>
 #endif
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <endian.h>
+#endif
 #ifdef HAVE_SELECT
 /* needed on openbsd for select*/
 #include <sys/time.h>
@@ -117,6 +123,10 @@ struct fd_map{
 	fd_type type;         /* "data" type */
 	void* data;           /* pointer to the corresponding structure */
 	short events;         /* events we are interested int */
+#ifdef HAVE_IO_URING
+	unsigned int gen;     /* io_uring generation, changed on each
+							 add/chg/del, to ignore stale completions */
+#endif
 };
 
 
@@ -170,6 +180,23 @@ struct io_wait_handler{
 #ifdef HAVE_DEVPOLL
 	int dpoll_fd;
 #endif
+#ifdef HAVE_IO_URING
+	int ring_fd;
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	struct io_uring_sqe* sqes;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe* cqes;
+	void* sq_ring;  /* mmaped rings (cq_ring==sq_ring for single mmap) */
+	void* cq_ring;
+	size_t sq_ring_sz;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+#endif
 #ifdef HAVE_SELECT
 	fd_set master_rset; /* read set */
 	fd_set master_wset; /* write set */
@@ -293,6 +320,93 @@ retry2:
 
 
 
+#ifdef HAVE_IO_URING
+/* user_data of the requests whose completions are ignored (poll removes) */
+#define IOU_UD_IGNORE ((__u64)-1)
+/* user_data of a poll request: generation and fd */
+#define iou_ud(fd, gen) (((__u64)(gen)<<32)|(unsigned int)(fd))
+
+static inline int iou_enter(int ring_fd, unsigned to_submit,
+							unsigned min_complete, unsigned flags,
+							void* arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+					flags, arg, argsz);
+}
+
+/*
+ * io_uring specific function: queue a poll add/remove request
+ * The requests are only queued in the submission ring, they are submitted
+ * all at once with the next wait (io_wait_loop_uring()) or when the ring
+ * is full.
+ * returns: -1 on error, 0 on success
+ */
+static inline int iou_queue(io_wait_h* h, int op, int fd, short events,
+							__u64 addr, __u64 user_data)
+{
+	unsigned tail;
+	unsigned head;
+	unsigned mask;
+	struct io_uring_sqe* sqe;
+	int n;
+
+	tail=*h->sq_tail; /* only written by us */
+	head=__atomic_load_n(h->sq_head, __ATOMIC_ACQUIRE);
+	if (unlikely(tail-head>=h->sq_entries)){
+		/* submission ring full => flush it */
+again:
+		n=iou_enter(h->ring_fd, tail-head, 0, 0, 0, 0);
+		if (unlikely(n==-1)){
+			if (errno==EINTR || errno==EAGAIN) goto again;
+			LM_ERR("io_uring_enter (flush) failed: %s [%d]\n",
+					strerror(errno), errno);
+			return -1;
+		}
+		head=__atomic_load_n(h->sq_head, __ATOMIC_ACQUIRE);
+		if (unlikely(tail-head>=h->sq_entries)){
+			LM_ERR("io_uring submission ring still full (%u)\n", tail-head);
+			return -1;
+		}
+	}
+	sqe=&h->sqes[tail & h->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode=op;
+	sqe->fd=fd;
+	sqe->addr=addr;
+	sqe->user_data=user_data;
+	if (op==IORING_OP_POLL_ADD){
+		mask=
+#ifdef POLLRDHUP
+			/* listen for POLLRDHUP too */
+			((POLLIN|POLLRDHUP) & ((int)!(events & POLLIN)-1) ) |
+#else /* POLLRDHUP */
+			(POLLIN & ((int)!(events & POLLIN)-1) ) |
+#endif /* POLLRDHUP */
+			(POLLOUT & ((int)!(events & POLLOUT)-1) );
+#if __BYTE_ORDER == __BIG_ENDIAN
+		mask=(mask<<16)|(mask>>16); /* poll32_events is word-reversed */
+#endif
+		sqe->poll32_events=mask;
+	}
+	/* the sq array is set up 1:1 at init, only the tail has to be moved */
+	__atomic_store_n(h->sq_tail, tail+1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* the poll requests are one-shot: they are re-armed from the loop after
+ * handle_io() (level triggered, like epoll_lt) */
+#define iou_poll_add(h, e) \
+	iou_queue((h), IORING_OP_POLL_ADD, (e)->fd, (e)->events, 0, \
+				iou_ud((e)->fd, (e)->gen))
+/* the poll request holds a reference to the file => it must be removed
+ * even if the fd is closed */
+#define iou_poll_del(h, e) \
+	iou_queue((h), IORING_OP_POLL_REMOVE, -1, 0, \
+				iou_ud((e)->fd, (e)->gen), IOU_UD_IGNORE)
+#endif
+
+
+
 /* generic io_watch_add function
  * Params:
  *     h      - pointer to initialized io_wait handle
@@ -516,6 +630,13 @@ again_devpoll:
 			}
 			break;
 #endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			e->gen++;
+			if (unlikely(iou_poll_add(h, e)==-1))
+				goto error;
+			break;
+#endif
 			
 		default:
 			LM_CRIT("no support for poll method  %s (%d)\n",
@@ -714,6 +835,13 @@ again_devpoll:
 					goto error;
 				}
 				break;
+#endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			if (unlikely(iou_poll_del(h, e)==-1))
+				goto error;
+			e->gen++; /* ignore completions already queued */
+			break;
 #endif
 		default:
 			LM_CRIT("no support for poll method  %s (%d)\n",
@@ -908,6 +1036,19 @@ again_devpoll2:
 					goto error;
 				}
 				break;
+#endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			/* remove & re-add, both are submitted in the same batch */
+			if (unlikely(iou_poll_del(h, e)==-1))
+				goto error;
+			e->gen++;
+			e->events=events;
+			if (unlikely(iou_poll_add(h, e)==-1)){
+				unhash_fd_map(e);
+				goto error;
+			}
+			break;
 #endif
 		default:
 			LM_CRIT("no support for poll method %s (%d)\n",
@@ -1376,6 +1517,83 @@ error:
 
 
 
+#ifdef HAVE_IO_URING
+/* waits for the poll completions, submitting at the same time all the
+ * queued poll add/remove requests (a single syscall per loop) */
+inline static int io_wait_loop_uring(io_wait_h* h, int t, int repeat)
+{
+	int n, ret;
+	unsigned head, tail;
+	unsigned int gen;
+	__u64 ud;
+	__s32 res;
+	int fd;
+	struct fd_map* fm;
+	int revents;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+
+	ts.tv_sec=t;
+	ts.tv_nsec=0;
+	memset(&arg, 0, sizeof(arg));
+	arg.ts=(__u64)(unsigned long)&ts;
+	ret=0;
+again:
+	n=iou_enter(h->ring_fd, *h->sq_tail -
+					__atomic_load_n(h->sq_head, __ATOMIC_ACQUIRE), 1,
+					IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG,
+					&arg, sizeof(arg));
+	if (unlikely(n==-1)){
+		if (errno==EINTR) goto again; /* signal, ignore it */
+		/* ETIME - timeout, EBUSY/EAGAIN - completions not yet reaped */
+		if (errno!=ETIME && errno!=EBUSY && errno!=EAGAIN){
+			LM_ERR("io_uring_enter: %s [%d]\n", strerror(errno), errno);
+			return -1;
+		}
+	}
+	head=*h->cq_head;
+	tail=__atomic_load_n(h->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head!=tail; head++){
+		ud=h->cqes[head & h->cq_mask].user_data;
+		res=h->cqes[head & h->cq_mask].res;
+		/* free the slot before handle_io(), it can queue new requests */
+		__atomic_store_n(h->cq_head, head+1, __ATOMIC_RELEASE);
+		if (ud==IOU_UD_IGNORE)
+			continue;
+		fd=(int)(ud & 0xffffffff);
+		gen=(unsigned int)(ud>>32);
+		if (unlikely(fd<0 || fd>=h->max_fd_no)){
+			LM_CRIT("bad fd %d in completion (not in the 0 - %d range)\n",
+					fd, h->max_fd_no);
+			continue;
+		}
+		fm=get_fd_map(h, fd);
+		/* the fd was removed or changed since the request was queued */
+		if (fm->type==0 || fm->gen!=gen)
+			continue;
+		ret++;
+		if (unlikely(res<0)){
+			LM_ERR("poll request failed on fd %d: %s [%d]\n",
+					fd, strerror(-res), -res);
+			handle_io(fm, POLLERR, -1);
+			continue; /* not re-armed */
+		}
+		revents=res;
+		/* fix revents==POLLPRI case */
+		revents |= (!(revents & POLLPRI)-1) & POLLIN;
+		while(fm->type && fm->gen==gen &&
+				((fm->events|POLLERR|POLLHUP) & revents) &&
+				(handle_io(fm, revents, -1)>0) && repeat);
+		/* re-arm if still watched and not changed from handle_io() */
+		if (fm->type && fm->gen==gen && iou_poll_add(h, fm)==-1)
+			LM_ERR("failed to re-arm the poll request for fd %d\n", fd);
+	}
+	return ret;
+}
+#endif
+
+
+
 /* init */
 
 
@@ -115,6 +115,8 @@ struct socket_info{
 	struct addr_info* addr_info_lst; /* extra addresses (e.g. SCTP mh) */
 	int workers; /* number of worker processes for this socket */
 	int workers_tcpidx; /* index of workers in tcp children array */
+	int* rp_sockets; /* per worker udp sockets (udp_reuseport), 0 if not used */
+	int rp_sockets_no;
 	struct advertise_info useinfo; /* details to be used in SIP msg */
 #ifdef USE_MCAST
 	str mcast; /* name of interface that should join multicast group*/
@@ -149,6 +151,8 @@ typedef struct sr_net_info {
 #define SND_F_FORCE_CON_REUSE	1 /* reuse an existing connection or fail */
 #define SND_F_CON_CLOSE			2 /* close the connection after sending */
 #define SND_F_FORCE_SOCKET		4 /* send socket in dst is forced */
+#define SND_F_UDP_BATCH			8 /* the result is not needed, the udp datagram
+								 can be queued in a send batch */
 
 struct snd_flags {
 	unsigned char f;          /* snd flags */
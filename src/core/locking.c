@@ -79,6 +79,27 @@ void rec_lock_get(rec_lock_t* rlock)
 	}
 }
 
+/**
+ * tries to get the lock without waiting
+ * returns 0 if the lock was taken (or is already held by this process)
+ * and -1 if it is held by another process
+ */
+int rec_lock_tryget(rec_lock_t* rlock)
+{
+	int mypid;
+
+	mypid = my_pid();
+	if (likely(atomic_get(&rlock->locker_pid) != mypid)) {
+		if (lock_try(&rlock->lock)!=0)
+			return -1;
+		atomic_set(&rlock->locker_pid, mypid);
+	} else {
+		/* locked within the same process that executed us */
+		rlock->rec_lock_level++;
+	}
+	return 0;
+}
+
 /**
  *
  */
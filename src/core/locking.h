@@ -57,6 +57,10 @@ Implements (in lock_ops.h & lock_alloc.h):
 	void    rec_lock_destroy(rec_lock_t* lock);  - removes the lock (e.g sysv rmid)
 	void    rec_lock_dealloc(rec_lock_t* lock);  - deallocates the lock's shared m.
 	void    rec_lock_get(rec_lock_t* lock);      - lock (mutex down)
+	int     rec_lock_tryget(rec_lock_t* lock);   - tries to lock, returns 0
+	                                               on success, -1 if the
+	                                               lock is held by another
+	                                               process
 	void    rec_lock_release(rec_lock_t* lock);  - unlock (mutex up)
 
 WARNING: - lock_set_init may fail for large number of sems (e.g. sysv).
@@ -82,6 +86,7 @@ rec_lock_t* rec_lock_init(rec_lock_t* lock);
 void rec_lock_destroy(rec_lock_t* lock);
 void rec_lock_dealloc(rec_lock_t* lock);
 void rec_lock_get(rec_lock_t* lock);
+int rec_lock_tryget(rec_lock_t* lock);
 void rec_lock_release(rec_lock_t* lock);
 
 #endif
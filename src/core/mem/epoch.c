@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file
+ * @brief Epoch based reclamation of shared memory read without locking
+ * @ingroup mem
+ */
+
+#include <string.h>
+#include <sched.h>
+
+#include "../atomic_ops.h"
+#include "../locking.h"
+#include "../dprint.h"
+#include "../pt.h"
+#include "shm_mem.h"
+#include "epoch.h"
+
+/* reclaim from epoch_retire() once so many items are queued */
+#define EPOCH_RECLAIM_BATCH 32
+
+typedef struct epoch_retired {
+	void *p;
+	epoch_free_f f;
+	unsigned int epoch;          /* epoch of the unlink */
+	struct epoch_retired *next;
+} epoch_retired_t;
+
+struct epoch {
+	atomic_t current;            /* current epoch, never 0 */
+	gen_lock_t lock;             /* protects the retired queue */
+	epoch_retired_t *first;      /* retired items, ordered by epoch */
+	epoch_retired_t *last;
+	int nretired;
+	int nprocs;
+	atomic_t *readers;           /* epoch of each reading process, 0 if none */
+	int *depth;                  /* read sections nesting, per process */
+};
+
+
+epoch_t *epoch_new(void)
+{
+	epoch_t *ep;
+	int nprocs;
+	int size;
+
+	nprocs = get_max_procs();
+	size = sizeof(epoch_t) + nprocs * (sizeof(atomic_t) + sizeof(int));
+	ep = (epoch_t*)shm_malloc(size);
+	if(ep == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(ep, 0, size);
+	if(lock_init(&ep->lock) == 0) {
+		LM_ERR("cannot initialize the epoch lock\n");
+		shm_free(ep);
+		return NULL;
+	}
+	atomic_set(&ep->current, 1);
+	ep->nprocs = nprocs;
+	ep->readers = (atomic_t*)(ep + 1);
+	ep->depth = (int*)(ep->readers + nprocs);
+	return ep;
+}
+
+
+static void epoch_free_list(epoch_retired_t *rp)
+{
+	epoch_retired_t *next;
+
+	for(; rp != NULL; rp = next) {
+		next = rp->next;
+		rp->f(rp->p);
+		shm_free(rp);
+	}
+}
+
+
+void epoch_destroy(epoch_t *ep)
+{
+	if(ep == NULL)
+		return;
+	epoch_free_list(ep->first);
+	lock_destroy(&ep->lock);
+	shm_free(ep);
+}
+
+
+int epoch_enter(epoch_t *ep)
+{
+	if(ep == NULL || process_no < 0 || process_no >= ep->nprocs)
+		return -1;
+	if(ep->depth[process_no]++ == 0) {
+		atomic_set(&ep->readers[process_no], atomic_get(&ep->current));
+		/* the epoch must be visible before the shared data is read */
+		membar();
+	}
+	return 0;
+}
+
+
+void epoch_exit(epoch_t *ep)
+{
+	if(ep == NULL || process_no < 0 || process_no >= ep->nprocs)
+		return;
+	if(--ep->depth[process_no] == 0) {
+		/* the shared data must be read before the epoch is cleared */
+		membar();
+		atomic_set(&ep->readers[process_no], 0);
+	}
+}
+
+
+/* oldest epoch of the active readers, the current epoch if none */
+static unsigned int epoch_oldest(epoch_t *ep, int skip)
+{
+	unsigned int oldest;
+	unsigned int e;
+	int i;
+
+	oldest = (unsigned int)atomic_get(&ep->current);
+	for(i = 0; i < ep->nprocs; i++) {
+		if(i == skip)
+			continue;
+		e = (unsigned int)atomic_get(&ep->readers[i]);
+		if(e != 0 && (int)(e - oldest) < 0)
+			oldest = e;
+	}
+	return oldest;
+}
+
+
+/* unlinks the retired items no reader can see anymore
+ * - the epoch lock must be held */
+static epoch_retired_t *epoch_reclaim_unsafe(epoch_t *ep)
+{
+	epoch_retired_t *list;
+	epoch_retired_t *rp;
+	unsigned int oldest;
+
+	if(ep->first == NULL)
+		return NULL;
+	membar();
+	oldest = epoch_oldest(ep, -1);
+	/* an item retired in epoch E can be seen only by the readers that
+	 * entered in an epoch <= E */
+	list = NULL;
+	for(rp = ep->first; rp != NULL && (int)(oldest - rp->epoch) > 0;
+			rp = rp->next) {
+		list = rp;
+		ep->nretired--;
+	}
+	if(list == NULL)
+		return NULL;
+	list->next = NULL;
+	list = ep->first;
+	ep->first = rp;
+	if(rp == NULL)
+		ep->last = NULL;
+	return list;
+}
+
+
+void epoch_retire(epoch_t *ep, void *p, epoch_free_f f)
+{
+	epoch_retired_t *rp;
+	epoch_retired_t *list;
+	unsigned int e;
+
+	if(ep == NULL) {
+		f(p);
+		return;
+	}
+	rp = (epoch_retired_t*)shm_malloc(sizeof(epoch_retired_t));
+	list = NULL;
+	lock_get(&ep->lock);
+	/* the unlink must be visible before the epoch is taken */
+	membar();
+	e = (unsigned int)atomic_get(&ep->current);
+	atomic_set(&ep->current, (e + 1 == 0) ? 1 : (int)(e + 1));
+	if(rp != NULL) {
+		rp->p = p;
+		rp->f = f;
+		rp->epoch = e;
+		rp->next = NULL;
+		if(ep->last)
+			ep->last->next = rp;
+		else
+			ep->first = rp;
+		ep->last = rp;
+		if(++ep->nretired >= EPOCH_RECLAIM_BATCH)
+			list = epoch_reclaim_unsafe(ep);
+	}
+	lock_release(&ep->lock);
+	if(rp == NULL) {
+		SHM_MEM_ERROR;
+		/* wait for the other readers that might use it, the caller must
+		 * not keep references to it */
+		membar();
+		while((int)(epoch_oldest(ep, process_no) - e) <= 0)
+			sched_yield();
+		f(p);
+		return;
+	}
+	epoch_free_list(list);
+}
+
+
+static void epoch_shm_free(void *p)
+{
+	shm_free(p);
+}
+
+
+void epoch_retire_shm(epoch_t *ep, void *p)
+{
+	epoch_retire(ep, p, epoch_shm_free);
+}
+
+
+void epoch_reclaim(epoch_t *ep)
+{
+	epoch_retired_t *list;
+
+	if(ep == NULL || ep->first == NULL)
+		return;
+	lock_get(&ep->lock);
+	list = epoch_reclaim_unsafe(ep);
+	lock_release(&ep->lock);
+	epoch_free_list(list);
+}
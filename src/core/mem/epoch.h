@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file
+ * @brief Epoch based reclamation of shared memory read without locking
+ *
+ * A reader marks its process slot with the current epoch while it walks
+ * shared structures without taking their lock. A writer unlinks an item
+ * (under its own lock) and retires it: the item is queued with the epoch
+ * of the unlink and freed only when all the readers that could still see
+ * it are gone. Any process can reclaim the queued items (e.g. a timer).
+ *
+ * @ingroup mem
+ */
+
+#ifndef _sr_epoch_h_
+#define _sr_epoch_h_
+
+typedef void (*epoch_free_f)(void *p);
+
+typedef struct epoch epoch_t;
+
+/**
+ * @brief Allocate a new epoch domain
+ *
+ * To be called when the number of processes is known (child_init with
+ * PROC_INIT), before forking.
+ * @return the new domain or NULL on error
+ */
+epoch_t *epoch_new(void);
+
+/**
+ * @brief Free an epoch domain and all the items still retired in it
+ *
+ * There must be no readers left.
+ */
+void epoch_destroy(epoch_t *ep);
+
+/**
+ * @brief Start a read section, the sections can be nested
+ * @return 0 on success, -1 if reading without locking is not possible
+ * (no domain or unknown process), the caller must take the lock then
+ */
+int epoch_enter(epoch_t *ep);
+
+/**
+ * @brief End a read section started with epoch_enter()
+ */
+void epoch_exit(epoch_t *ep);
+
+/**
+ * @brief Free p with f after all the current readers are done
+ *
+ * p must be already unlinked from the shared structures. If ep is NULL
+ * (no lock-free readers yet) p is freed right away.
+ */
+void epoch_retire(epoch_t *ep, void *p, epoch_free_f f);
+
+/**
+ * @brief epoch_retire() for a shm block
+ */
+void epoch_retire_shm(epoch_t *ep, void *p);
+
+/**
+ * @brief Free the retired items no reader can access anymore
+ */
+void epoch_reclaim(epoch_t *ep);
+
+#endif
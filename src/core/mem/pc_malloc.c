@@ -0,0 +1,408 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file
+ * \brief Per process cache in front of the shared memory manager
+ * \ingroup mem
+ */
+
+#include <string.h>
+
+#include "../compiler_opt.h"
+#include "../dprint.h"
+#include "../pt.h"
+#include "../counters.h"
+#include "shm.h"
+#include "pc_malloc.h"
+
+/* every chunk (cached or not) is prefixed by this header */
+struct pcm_hdr {
+	unsigned int cls;  /* size class or PCM_NOCACHE */
+	int owner;         /* process_no of the last allocating process */
+	unsigned long size; /* usable size */
+};
+
+#define PCM_HDR_SIZE \
+	((sizeof(struct pcm_hdr)+PCM_ROUNDTO-1)&(~(PCM_ROUNDTO-1)))
+#define PCM_HDR2P(h)	((void*)((char*)(h)+PCM_HDR_SIZE))
+#define PCM_P2HDR(p)	((struct pcm_hdr*)((char*)(p)-PCM_HDR_SIZE))
+
+#define PCM_SMALL_CLASSES	(PCM_SMALL_MAX/PCM_ROUNDTO)
+#define PCM_CLASSES \
+	(PCM_SMALL_CLASSES + (PCM_MAX_SIZE-PCM_SMALL_MAX)/PCM_LARGE_STEP)
+#define PCM_NOCACHE		((unsigned int)-1)
+
+/* size (>0, <=PCM_MAX_SIZE) to size class */
+#define PCM_SIZE2CLASS(s) \
+	(((s)<=PCM_SMALL_MAX)?((s)-1)/PCM_ROUNDTO: \
+		PCM_SMALL_CLASSES+((s)-PCM_SMALL_MAX-1)/PCM_LARGE_STEP)
+/* size class to chunk size */
+#define PCM_CLASS2SIZE(c) \
+	(((c)<PCM_SMALL_CLASSES)?((c)+1)*PCM_ROUNDTO: \
+		PCM_SMALL_MAX+((c)-PCM_SMALL_CLASSES+1)*PCM_LARGE_STEP)
+
+#ifdef DBG_SR_MEMORY
+#define PCM_DBG_PARAMS , const char* file, const char* func, \
+							unsigned int line, const char* mname
+#define PCM_DBG_ARGS , file, func, line, mname
+#else
+#define PCM_DBG_PARAMS
+#define PCM_DBG_ARGS
+#endif
+
+/* per process magazine for one size class */
+struct pcm_mag {
+	unsigned int n;    /* number of cached chunks */
+	unsigned int max;  /* capacity, depends on the class size */
+	struct pcm_hdr* chunks[PCM_MAG_SIZE];
+};
+
+static struct pcm_mag _pcm_mags[PCM_CLASSES];
+static unsigned long _pcm_cached_bytes = 0;
+
+/* the wrapped shm manager */
+static sr_shm_api_t _pcm_be;
+
+static char *_pcm_mem_name = "pc_malloc";
+
+/* stats */
+struct pcm_counters_h {
+	counter_handle_t hits;
+	counter_handle_t misses;
+	counter_handle_t refills;
+	counter_handle_t returns;
+	counter_handle_t frees;
+	counter_handle_t cross_frees;
+	counter_handle_t nocache;
+};
+
+static struct pcm_counters_h _pcm_cnts_h;
+static int _pcm_cnts_on = 0;
+
+static counter_val_t pcm_hit_rate(counter_handle_t h, void* param);
+
+static counter_def_t pcm_cnt_defs[] =  {
+	{&_pcm_cnts_h.hits, "hits", 0, 0, 0,
+		"allocations served from the process cache."},
+	{&_pcm_cnts_h.misses, "misses", 0, 0, 0,
+		"allocations that had to refill the process cache."},
+	{&_pcm_cnts_h.refills, "refilled_chunks", 0, 0, 0,
+		"chunks moved from the shm manager to the process caches."},
+	{&_pcm_cnts_h.returns, "returned_chunks", 0, 0, 0,
+		"chunks moved from the process caches back to the shm manager."},
+	{&_pcm_cnts_h.frees, "frees", 0, 0, 0,
+		"frees of cacheable chunks."},
+	{&_pcm_cnts_h.cross_frees, "cross_process_frees", 0, 0, 0,
+		"frees of cacheable chunks allocated by another process."},
+	{&_pcm_cnts_h.nocache, "uncached", 0, 0, 0,
+		"allocations too big to be cached."},
+	{0, "hit_rate", 0, pcm_hit_rate, 0,
+		"percentage of the cacheable allocations served from the cache."},
+	{0, 0, 0, 0, 0, 0 }
+};
+
+#define PCM_STAT_INC(name) \
+	do { \
+		if (likely(_pcm_cnts_on)) counter_inc(_pcm_cnts_h.name); \
+	} while(0)
+
+#define PCM_STAT_ADD(name, v) \
+	do { \
+		if (likely(_pcm_cnts_on)) counter_add(_pcm_cnts_h.name, (v)); \
+	} while(0)
+
+
+static counter_val_t pcm_hit_rate(counter_handle_t h, void* param)
+{
+	counter_val_t hits;
+	counter_val_t all;
+
+	hits = counter_get_val(_pcm_cnts_h.hits);
+	all = hits + counter_get_val(_pcm_cnts_h.misses);
+	if (all == 0)
+		return 0;
+	return hits * 100 / all;
+}
+
+
+/**
+ * \brief Moves up to n chunks from the shm manager into a magazine
+ * \return number of chunks added
+ */
+static int pcm_refill(void* mbp, unsigned int cls, unsigned int n,
+		int locked PCM_DBG_PARAMS)
+{
+	struct pcm_mag* m;
+	struct pcm_hdr* h;
+	unsigned long csize;
+	unsigned int i;
+
+	m = &_pcm_mags[cls];
+	csize = PCM_CLASS2SIZE(cls);
+	if (!locked) shm_lock();
+	for (i = 0; i < n && m->n < m->max; i++) {
+		h = _pcm_be.xmalloc_unsafe(mbp, PCM_HDR_SIZE + csize PCM_DBG_ARGS);
+		if (h == 0)
+			break;
+		h->cls = cls;
+		h->size = csize;
+		m->chunks[m->n++] = h;
+	}
+	if (!locked) shm_unlock();
+	_pcm_cached_bytes += i * csize;
+	PCM_STAT_ADD(refills, i);
+	return i;
+}
+
+
+/**
+ * \brief Returns up to n chunks of a magazine to the shm manager
+ */
+static void pcm_return(void* mbp, unsigned int cls, unsigned int n,
+		int locked PCM_DBG_PARAMS)
+{
+	struct pcm_mag* m;
+	unsigned int i;
+
+	m = &_pcm_mags[cls];
+	if (n > m->n)
+		n = m->n;
+	if (n == 0)
+		return;
+	if (!locked) shm_lock();
+	for (i = 0; i < n; i++)
+		_pcm_be.xfree_unsafe(mbp, m->chunks[--m->n] PCM_DBG_ARGS);
+	if (!locked) shm_unlock();
+	_pcm_cached_bytes -= n * PCM_CLASS2SIZE(cls);
+	PCM_STAT_ADD(returns, n);
+}
+
+
+static inline void* pcm_alloc(void* mbp, size_t size, int locked
+		PCM_DBG_PARAMS)
+{
+	struct pcm_mag* m;
+	struct pcm_hdr* h;
+	unsigned int cls;
+
+	if (unlikely(size > PCM_MAX_SIZE)) {
+		if (locked)
+			h = _pcm_be.xmalloc_unsafe(mbp, PCM_HDR_SIZE + size PCM_DBG_ARGS);
+		else
+			h = _pcm_be.xmalloc(mbp, PCM_HDR_SIZE + size PCM_DBG_ARGS);
+		if (h == 0)
+			return 0;
+		h->cls = PCM_NOCACHE;
+		h->owner = process_no;
+		h->size = size;
+		PCM_STAT_INC(nocache);
+		return PCM_HDR2P(h);
+	}
+	cls = PCM_SIZE2CLASS((size)?size:1);
+	m = &_pcm_mags[cls];
+	if (likely(m->n > 0)) {
+		PCM_STAT_INC(hits);
+	} else {
+		PCM_STAT_INC(misses);
+		if (pcm_refill(mbp, cls, (m->max + 1) / 2, locked PCM_DBG_ARGS) == 0)
+			return 0;
+	}
+	h = m->chunks[--m->n];
+	_pcm_cached_bytes -= h->size;
+	h->owner = process_no;
+	return PCM_HDR2P(h);
+}
+
+
+static inline void pcm_release(void* mbp, void* p, int locked
+		PCM_DBG_PARAMS)
+{
+	struct pcm_mag* m;
+	struct pcm_hdr* h;
+
+	if (unlikely(p == 0))
+		return;
+	h = PCM_P2HDR(p);
+	if (unlikely(h->cls == PCM_NOCACHE)) {
+		if (locked)
+			_pcm_be.xfree_unsafe(mbp, h PCM_DBG_ARGS);
+		else
+			_pcm_be.xfree(mbp, h PCM_DBG_ARGS);
+		return;
+	}
+	PCM_STAT_INC(frees);
+	if (h->owner != process_no)
+		PCM_STAT_INC(cross_frees);
+	m = &_pcm_mags[h->cls];
+	if (unlikely(m->n >= m->max
+				|| _pcm_cached_bytes + h->size > PCM_PROC_MAX_BYTES)) {
+		pcm_return(mbp, h->cls, (m->max + 1) / 2, locked PCM_DBG_ARGS);
+		if (_pcm_cached_bytes + h->size > PCM_PROC_MAX_BYTES) {
+			/* other size classes hold the memory, don't cache it */
+			if (locked)
+				_pcm_be.xfree_unsafe(mbp, h PCM_DBG_ARGS);
+			else
+				_pcm_be.xfree(mbp, h PCM_DBG_ARGS);
+			return;
+		}
+	}
+	m->chunks[m->n++] = h;
+	_pcm_cached_bytes += h->size;
+}
+
+
+void* pcm_shm_malloc(void* mbp, size_t size PCM_DBG_PARAMS)
+{
+	return pcm_alloc(mbp, size, 0 PCM_DBG_ARGS);
+}
+
+void* pcm_shm_malloc_unsafe(void* mbp, size_t size PCM_DBG_PARAMS)
+{
+	return pcm_alloc(mbp, size, 1 PCM_DBG_ARGS);
+}
+
+void pcm_shm_free(void* mbp, void* p PCM_DBG_PARAMS)
+{
+	pcm_release(mbp, p, 0 PCM_DBG_ARGS);
+}
+
+void pcm_shm_free_unsafe(void* mbp, void* p PCM_DBG_PARAMS)
+{
+	pcm_release(mbp, p, 1 PCM_DBG_ARGS);
+}
+
+void* pcm_shm_realloc(void* mbp, void* p, size_t size PCM_DBG_PARAMS)
+{
+	struct pcm_hdr* h;
+	void* r;
+
+	if (p == 0)
+		return pcm_alloc(mbp, size, 0 PCM_DBG_ARGS);
+	if (size == 0) {
+		pcm_release(mbp, p, 0 PCM_DBG_ARGS);
+		return 0;
+	}
+	h = PCM_P2HDR(p);
+	if (h->cls == PCM_NOCACHE && size > PCM_MAX_SIZE) {
+		h = _pcm_be.xrealloc(mbp, h, PCM_HDR_SIZE + size PCM_DBG_ARGS);
+		if (h == 0)
+			return 0;
+		h->size = size;
+		return PCM_HDR2P(h);
+	}
+	if (h->cls != PCM_NOCACHE && size <= h->size)
+		return p; /* still fits in the chunk */
+	r = pcm_alloc(mbp, size, 0 PCM_DBG_ARGS);
+	if (r == 0)
+		return 0;
+	memcpy(r, p, (size < h->size) ? size : h->size);
+	pcm_release(mbp, p, 0 PCM_DBG_ARGS);
+	return r;
+}
+
+void* pcm_shm_resize(void* mbp, void* p, size_t size PCM_DBG_PARAMS)
+{
+	pcm_release(mbp, p, 0 PCM_DBG_ARGS);
+	return pcm_alloc(mbp, size, 0 PCM_DBG_ARGS);
+}
+
+
+/**
+ * \brief Drops the cache inherited from the parent process
+ *
+ * The chunks stay owned by the parent's cache, the child starts with empty
+ * magazines. Called in the child after fork().
+ */
+void pcm_shm_on_fork(void)
+{
+	unsigned int i;
+
+	if (_shm_root.xmalloc != pcm_shm_malloc)
+		return;
+	for (i = 0; i < PCM_CLASSES; i++)
+		_pcm_mags[i].n = 0;
+	_pcm_cached_bytes = 0;
+}
+
+
+/**
+ * \brief Destroy memory pool
+ */
+void pcm_malloc_destroy_shm_manager(void)
+{
+	if (_pcm_be.xdestroy)
+		_pcm_be.xdestroy();
+	memset(&_pcm_be, 0, sizeof(sr_shm_api_t));
+}
+
+/**
+ * \brief Init the cache on top of the already initialized shm manager
+ */
+int pcm_malloc_init_shm_manager(void)
+{
+	sr_shm_api_t ma;
+	unsigned int i;
+	unsigned long csize;
+
+	if (_shm_root.xmalloc == 0 || _shm_root.xmalloc_unsafe == 0
+			|| _shm_root.xfree_unsafe == 0) {
+		LM_ERR("no shm manager to use as pc_malloc backend\n");
+		return -1;
+	}
+	memcpy(&_pcm_be, &_shm_root, sizeof(sr_shm_api_t));
+	for (i = 0; i < PCM_CLASSES; i++) {
+		csize = PCM_CLASS2SIZE(i);
+		_pcm_mags[i].n = 0;
+		_pcm_mags[i].max = (csize * PCM_MAG_SIZE <= PCM_MAG_BYTES)?
+								PCM_MAG_SIZE : PCM_MAG_BYTES / csize;
+		if (_pcm_mags[i].max == 0)
+			_pcm_mags[i].max = 1;
+	}
+
+	memset(&ma, 0, sizeof(sr_shm_api_t));
+	ma.mname          = _pcm_mem_name;
+	ma.mem_pool       = _pcm_be.mem_pool;
+	ma.mem_block      = _pcm_be.mem_block;
+	ma.xmalloc        = pcm_shm_malloc;
+	ma.xmalloc_unsafe = pcm_shm_malloc_unsafe;
+	ma.xfree          = pcm_shm_free;
+	ma.xfree_unsafe   = pcm_shm_free_unsafe;
+	ma.xrealloc       = pcm_shm_realloc;
+	ma.xresize        = pcm_shm_resize;
+	ma.xstatus        = _pcm_be.xstatus;
+	ma.xinfo          = _pcm_be.xinfo;
+	ma.xavailable     = _pcm_be.xavailable;
+	ma.xsums          = _pcm_be.xsums;
+	ma.xdestroy       = pcm_malloc_destroy_shm_manager;
+	ma.xmodstats      = _pcm_be.xmodstats;
+	ma.xfmodstats     = _pcm_be.xfmodstats;
+
+	if (shm_init_api(&ma) < 0) {
+		LM_ERR("cannot initialize the core shm api\n");
+		return -1;
+	}
+	if (counter_register_array("shm_pcache", pcm_cnt_defs) < 0) {
+		LM_WARN("failed to register the shm process cache counters\n");
+	} else {
+		_pcm_cnts_on = 1;
+	}
+	LM_DBG("shm process cache on top of %s\n",
+			(_pcm_be.mname)?_pcm_be.mname:"unknown");
+	return 0;
+}
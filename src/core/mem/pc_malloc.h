@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file
+ * \brief Per process cache in front of the shared memory manager
+ *
+ * Small shm chunks (up to PCM_MAX_SIZE) are kept after free in per process,
+ * size classed free lists ("magazines"). An allocation served from the
+ * local magazine does not take the global shm lock. Empty magazines are
+ * refilled and full ones are returned to the shm manager in batches, with
+ * the shm lock taken once per batch.
+ *
+ * Enabled by selecting a "pc" shm manager with -x: pcfm, pcqm or pctlsf.
+ * The per process caches are not thread safe.
+ *
+ * \ingroup mem
+ */
+
+#ifndef _pc_malloc_h_
+#define _pc_malloc_h_
+
+/* allocation size granularity for small chunks */
+#define PCM_ROUNDTO			16
+/* biggest small chunk (PCM_ROUNDTO steps up to it) */
+#define PCM_SMALL_MAX		1024
+/* size step for the chunks bigger than PCM_SMALL_MAX */
+#define PCM_LARGE_STEP		256
+/* biggest cached chunk, bigger ones go directly to the shm manager */
+#define PCM_MAX_SIZE		8192
+/* max. chunks kept in one magazine */
+#define PCM_MAG_SIZE		32
+/* max. bytes kept in one magazine (limits the big size classes) */
+#define PCM_MAG_BYTES		(64*1024)
+/* max. bytes kept in all the magazines of a process */
+#define PCM_PROC_MAX_BYTES	(1024*1024)
+
+int pcm_malloc_init_shm_manager(void);
+void pcm_shm_on_fork(void);
+
+#endif
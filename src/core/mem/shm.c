@@ -34,6 +34,7 @@
 #endif
 
 #include "memcore.h"
+#include "pc_malloc.h"
 
 #define _ROUND2TYPE(s, type) \
 	(((s)+(sizeof(type)-1))&(~(sizeof(type)-1)))
@@ -246,6 +247,21 @@ int shm_init_manager(char *name)
 			|| strcmp(name, "tlsf_malloc")==0) {
 		/*tlsf malloc*/
 		return tlsf_malloc_init_shm_manager();
+	} else if(strcmp(name, "pcfm")==0) {
+		/*fast malloc with per process cache*/
+		if(fm_malloc_init_shm_manager()<0)
+			return -1;
+		return pcm_malloc_init_shm_manager();
+	} else if(strcmp(name, "pcqm")==0) {
+		/*quick malloc with per process cache*/
+		if(qm_malloc_init_shm_manager()<0)
+			return -1;
+		return pcm_malloc_init_shm_manager();
+	} else if(strcmp(name, "pctlsf")==0) {
+		/*tlsf malloc with per process cache*/
+		if(tlsf_malloc_init_shm_manager()<0)
+			return -1;
+		return pcm_malloc_init_shm_manager();
 	} else if(strcmp(name, "sm")==0) {
 		/*system malloc*/
 	} else {
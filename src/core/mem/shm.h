@@ -84,6 +84,7 @@ void shm_destroy_manager(void);
 void shm_print_manager(void);
 
 #define shm_available_safe() shm_available()
-#define shm_malloc_on_fork() do{}while(0)
+void pcm_shm_on_fork(void);
+#define shm_malloc_on_fork() pcm_shm_on_fork()
 
 #endif
@@ -892,13 +892,58 @@ skip_after:
 /* another helper functions, adds/Removes the lump,
 	code moved form build_req_from_req  */
 
-void process_lumps( struct sip_msg* msg,
+/* adds to mi the new parts written in new_buf since the last call */
+static inline void msg_iov_flush(msg_iov_t* mi, char* new_buf,
+									unsigned int offset)
+{
+	struct iovec* v;
+
+	if (offset<=mi->flushed)
+		return;
+	if (mi->cnt){
+		v=&mi->iov[mi->cnt-1];
+		if ((char*)v->iov_base+v->iov_len==new_buf+mi->flushed){
+			v->iov_len+=offset-mi->flushed;
+			mi->flushed=offset;
+			return;
+		}
+	}
+	v=&mi->iov[mi->cnt++];
+	v->iov_base=new_buf+mi->flushed;
+	v->iov_len=offset-mi->flushed;
+	mi->flushed=offset;
+}
+
+/* adds to mi a slice of the original message, without copying it (if
+ * there are no iovecs left, the slice is copied in new_buf);
+ * returns the new offset in new_buf */
+static inline unsigned int msg_iov_add_orig(msg_iov_t* mi, char* new_buf,
+									unsigned int offset, char* s,
+									unsigned int size)
+{
+	/* the slice, the new parts before it and the ones after the last
+	 * slice must fit */
+	if (unlikely(mi->cnt+3>MSG_IOV_MAX)){
+		memcpy(new_buf+offset, s, size);
+		return offset+size;
+	}
+	msg_iov_flush(mi, new_buf, offset);
+	mi->iov[mi->cnt].iov_base=s;
+	mi->iov[mi->cnt].iov_len=size;
+	mi->cnt++;
+	return offset;
+}
+
+/* process_lumps() helper, if mi is set the unmodified parts of the original
+ * message are added to it instead of being copied */
+static void _process_lumps( struct sip_msg* msg,
                     struct lump* lumps,
                     char* new_buf,
                     unsigned int* new_buf_offs,
                     unsigned int* orig_offs,
                     struct dest_info* send_info,
-                    int flag)
+                    int flag,
+                    msg_iov_t* mi)
 {
 	struct lump *t;
 	struct lump *r;
@@ -1360,8 +1405,13 @@ skip_after:
 				}
 				size=t->u.offset-s_offset;
                 if (size > 0 && flag == FLAG_MSG_ALL){
-					memcpy(new_buf+offset, orig+s_offset,size);
-					offset+=size;
+					if (unlikely(mi)){
+						offset=msg_iov_add_orig(mi, new_buf, offset,
+											orig+s_offset, size);
+					}else{
+						memcpy(new_buf+offset, orig+s_offset,size);
+						offset+=size;
+					}
 					s_offset+=size;
                 } else if (flag == FLAG_MSG_LUMPS_ONLY) {
                     /* do not copy the whole message, jump to the lumps offs */
@@ -1453,6 +1503,19 @@ skip_nop_after:
 }
 
 
+void process_lumps( struct sip_msg* msg,
+                    struct lump* lumps,
+                    char* new_buf,
+                    unsigned int* new_buf_offs,
+                    unsigned int* orig_offs,
+                    struct dest_info* send_info,
+                    int flag)
+{
+	_process_lumps(msg, lumps, new_buf, new_buf_offs, orig_offs, send_info,
+			flag, 0);
+}
+
+
 /*
  * Adjust/insert Content-Length if necessary
  */
@@ -1916,10 +1979,14 @@ clean:
   * depending on the presence of the BUILD_IN_SHM flag, needs freeing when
   *   done) and sets returned_len or 0 on error.
   */
-char * build_req_buf_from_sip_req( struct sip_msg* msg,
+/* builds the request to be forwarded; if mi is set, the unmodified parts
+ * of the original message are not copied, but added to mi as iovecs
+ * (and the returned buffer holds only the new parts) */
+static char* build_req_buf(struct sip_msg* msg,
 								unsigned int *returned_len,
 								struct dest_info* send_info,
-								unsigned int mode)
+								unsigned int mode,
+								msg_iov_t* mi)
 {
 	unsigned int len, new_len, received_len, rport_len, uri_len, via_len,
 				 body_delta;
@@ -2165,8 +2232,12 @@ after_update_via1:
 	if (msg->new_uri.s){
 		/* copy message up to uri */
 		size=msg->first_line.u.request.uri.s-buf;
-		memcpy(new_buf, buf, size);
-		offset+=size;
+		if (unlikely(mi)){
+			offset=msg_iov_add_orig(mi, new_buf, offset, buf, size);
+		}else{
+			memcpy(new_buf, buf, size);
+			offset+=size;
+		}
 		s_offset+=size;
 		/* add our uri */
 		memcpy(new_buf+offset, msg->new_uri.s, uri_len);
@@ -2175,10 +2246,21 @@ after_update_via1:
 	}
 	new_buf[new_len]=0;
 	/* copy msg adding/removing lumps */
-	process_lumps(msg, msg->add_rm, new_buf, &offset, &s_offset, send_info, FLAG_MSG_ALL);
-	process_lumps(msg, msg->body_lumps, new_buf, &offset, &s_offset,send_info, FLAG_MSG_ALL);
+	_process_lumps(msg, msg->add_rm, new_buf, &offset, &s_offset, send_info,
+			FLAG_MSG_ALL, mi);
+	_process_lumps(msg, msg->body_lumps, new_buf, &offset, &s_offset,
+			send_info, FLAG_MSG_ALL, mi);
 	/* copy the rest of the message */
-	memcpy(new_buf+offset, buf+s_offset, len-s_offset);
+	if (unlikely(mi)){
+		if (len>s_offset)
+			offset=msg_iov_add_orig(mi, new_buf, offset, buf+s_offset,
+										len-s_offset);
+		msg_iov_flush(mi, new_buf, offset);
+		mi->buf=new_buf;
+		mi->len=new_len;
+	}else{
+		memcpy(new_buf+offset, buf+s_offset, len-s_offset);
+	}
 	new_buf[new_len]=0;
 
 	/* update the send_info if udp_mtu affected */
@@ -2188,7 +2270,7 @@ after_update_via1:
 	}
 
 #ifdef DBG_MSG_QA
-	if (new_buf[new_len-1]==0) {
+	if (mi==0 && new_buf[new_len-1]==0) {
 		LM_ERR("0 in the end\n");
 		abort();
 	}
@@ -2211,6 +2293,72 @@ error00:
 	return 0;
 }
 
+char * build_req_buf_from_sip_req( struct sip_msg* msg,
+								unsigned int *returned_len,
+								struct dest_info* send_info,
+								unsigned int mode)
+{
+	return build_req_buf(msg, returned_len, send_info, mode, 0);
+}
+
+/** builds the request to be forwarded as a list of iovecs.
+ * The unmodified parts of the message are not copied, mi->iov points
+ * directly inside msg->buf, so msg must not change until the request is
+ * sent. Only the new parts (via, lumps, new uri) are copied in mi->buf,
+ * which must be freed with msg_iov_free(). BUILD_IN_SHM is not allowed.
+ * @return 0 on success, -1 on error
+ */
+int build_req_iov_from_sip_req(struct sip_msg* msg, msg_iov_t* mi,
+				struct dest_info* send_info, unsigned int mode)
+{
+	unsigned int len;
+
+	mi->cnt=0;
+	mi->len=0;
+	mi->buf=0;
+	mi->flushed=0;
+	if (unlikely(mode&BUILD_IN_SHM)){
+		LM_BUG("iovec requests cannot be built in shm\n");
+		return -1;
+	}
+	if (build_req_buf(msg, &len, send_info, mode, mi)==0)
+		return -1;
+	return 0;
+}
+
+/** returns the request built in mi as a single pkg buffer (0 terminated)
+ * or 0 on error. mi is not changed (it must still be freed).
+ */
+char* msg_iov_join(msg_iov_t* mi)
+{
+	char* buf;
+	unsigned int offset;
+	int i;
+
+	buf=pkg_malloc(mi->len+1);
+	if (buf==0){
+		ser_error=E_OUT_OF_MEM;
+		LM_ERR("out of memory\n");
+		return 0;
+	}
+	offset=0;
+	for (i=0; i<mi->cnt; i++){
+		memcpy(buf+offset, mi->iov[i].iov_base, mi->iov[i].iov_len);
+		offset+=mi->iov[i].iov_len;
+	}
+	buf[offset]=0;
+	return buf;
+}
+
+void msg_iov_free(msg_iov_t* mi)
+{
+	if (mi->buf)
+		pkg_free(mi->buf);
+	mi->buf=0;
+	mi->cnt=0;
+	mi->len=0;
+}
+
 char * generate_res_buf_from_sip_res( struct sip_msg* msg,
 				unsigned int *returned_len, unsigned int mode)
 {
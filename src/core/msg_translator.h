@@ -51,9 +51,24 @@
 #define BUILD_NO_PATH			(1<<2)
 #define BUILD_IN_SHM			(1<<7)
 
+#include <sys/uio.h>
 #include "parser/msg_parser.h"
 #include "ip_addr.h"
 
+/* max. number of iovecs for a message built by build_req_iov_from_sip_req(),
+ * if more are needed the remaining parts are copied */
+#define MSG_IOV_MAX	32
+
+/* a message built as a list of iovecs: unmodified slices of the original
+ * message buffer and the new parts (lumps, via, new uri) in buf */
+typedef struct msg_iov {
+	struct iovec iov[MSG_IOV_MAX];
+	int cnt;              /* number of used iovecs */
+	unsigned int len;     /* total length */
+	char* buf;            /* new parts, pkg allocated */
+	unsigned int flushed; /* length of buf already in iov */
+} msg_iov_t;
+
 /* point to some remarkable positions in a SIP message */
 struct bookmark {
 	str to_tag_val;
@@ -82,6 +97,13 @@ char * build_req_buf_from_sip_req(struct sip_msg* msg,
 				unsigned int *returned_len, struct dest_info* send_info,
 				unsigned int mode);
 
+int build_req_iov_from_sip_req(struct sip_msg* msg, msg_iov_t* mi,
+				struct dest_info* send_info, unsigned int mode);
+
+char* msg_iov_join(msg_iov_t* mi);
+
+void msg_iov_free(msg_iov_t* mi);
+
 char * build_res_buf_from_sip_res(struct sip_msg* msg,
 				unsigned int *returned_len);
 
@@ -1,48 +0,0 @@
-/* 
- * Route Header Field Name Parsing Macros
- *
- * Copyright (C) 2001-2003 FhG Fokus
- *
- * This file is part of Kamailio, a free SIP server.
- *
- * Kamailio is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation; either version 2 of the License, or
- * (at your option) any later version
- *
- * Kamailio is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License 
- * along with this program; if not, write to the Free Software 
- * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
- */
-
-/*! \file 
- * \brief Parser ::  Route Header Field Name Parsing Macros
- *
- * \ingroup parser
- */
-
-
-
-#ifndef CASE_ROUT_H
-#define CASE_ROUT_H
-
-
-#define rout_CASE                   \
-     p += 4;                        \
-     switch(LOWER_BYTE(*p)) {       \
-     case 'e':                      \
-	     hdr->type = HDR_ROUTE_T; \
-	     p++;                   \
-	     goto dc_end;           \
-                                    \
-     default:                       \
-	     goto other;            \
-     }
-
-
-#endif /* CASE_ROUT_H */
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/** Parser :: Header field line and name scanners
+ * @file
+ * @ingroup parser
+ */
+
+#include "hf_scan.h"
+
+/* the vector versions need per function target attributes */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || \
+	 (defined(__GNUC__) && \
+	  ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define HF_SCAN_X86
+#include <immintrin.h>
+#endif
+
+static int hf_scan_mode = HF_SCAN_SCALAR;
+
+
+static char* hf_scan_name_end_scalar(char* p, char* end)
+{
+	for(; p < end; p++) {
+		if ((*p == ':') || (*p == ' ') || (*p == '\t')) return p;
+	}
+	return 0;
+}
+
+static char* hf_scan_lf_scalar(char* p, char* end)
+{
+	for(; p < end; p++) {
+		if (*p == '\n') return p;
+	}
+	return 0;
+}
+
+
+#ifdef HF_SCAN_X86
+
+/* the vector loads are done only while at least one full vector is left
+ * in the buffer, the rest is scanned with the scalar version */
+
+__attribute__((target("sse4.2")))
+static char* hf_scan_name_end_sse42(char* p, char* end)
+{
+	const __m128i set = _mm_setr_epi8(':', ' ', '\t', 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0);
+	__m128i v;
+	int i;
+
+	for(; end - p >= 16; p += 16) {
+		v = _mm_loadu_si128((const __m128i*)p);
+		i = _mm_cmpestri(set, 3, v, 16,
+				_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY
+				| _SIDD_LEAST_SIGNIFICANT);
+		if (i < 16) return p + i;
+	}
+	return hf_scan_name_end_scalar(p, end);
+}
+
+__attribute__((target("sse4.2")))
+static char* hf_scan_lf_sse42(char* p, char* end)
+{
+	const __m128i lf = _mm_set1_epi8('\n');
+	__m128i v;
+	int m;
+
+	for(; end - p >= 16; p += 16) {
+		v = _mm_loadu_si128((const __m128i*)p);
+		m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+		if (m) return p + __builtin_ctz(m);
+	}
+	return hf_scan_lf_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static char* hf_scan_name_end_avx2(char* p, char* end)
+{
+	const __m256i colon = _mm256_set1_epi8(':');
+	const __m256i sp = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	__m256i v;
+	unsigned int m;
+
+	for(; end - p >= 32; p += 32) {
+		v = _mm256_loadu_si256((const __m256i*)p);
+		m = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(
+					_mm256_or_si256(_mm256_cmpeq_epi8(v, colon),
+						_mm256_cmpeq_epi8(v, sp)),
+					_mm256_cmpeq_epi8(v, tab)));
+		if (m) return p + __builtin_ctz(m);
+	}
+	return hf_scan_name_end_sse42(p, end);
+}
+
+__attribute__((target("avx2")))
+static char* hf_scan_lf_avx2(char* p, char* end)
+{
+	const __m256i lf = _mm256_set1_epi8('\n');
+	__m256i v;
+	unsigned int m;
+
+	for(; end - p >= 32; p += 32) {
+		v = _mm256_loadu_si256((const __m256i*)p);
+		m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf));
+		if (m) return p + __builtin_ctz(m);
+	}
+	return hf_scan_lf_sse42(p, end);
+}
+
+#endif /* HF_SCAN_X86 */
+
+
+hf_scan_f hf_scan_name_end = hf_scan_name_end_scalar;
+hf_scan_f hf_scan_lf = hf_scan_lf_scalar;
+
+
+/** selects the scanners for a given mode (HF_SCAN_*).
+ * @return 0 on success, -1 if the mode is not supported by the build
+ *  or by the cpu
+ */
+int hf_scan_set_mode(int mode)
+{
+	switch(mode) {
+		case HF_SCAN_SCALAR:
+			hf_scan_name_end = hf_scan_name_end_scalar;
+			hf_scan_lf = hf_scan_lf_scalar;
+			break;
+#ifdef HF_SCAN_X86
+		case HF_SCAN_SSE42:
+			if (!__builtin_cpu_supports("sse4.2"))
+				return -1;
+			hf_scan_name_end = hf_scan_name_end_sse42;
+			hf_scan_lf = hf_scan_lf_sse42;
+			break;
+		case HF_SCAN_AVX2:
+			if (!__builtin_cpu_supports("avx2")
+					|| !__builtin_cpu_supports("sse4.2"))
+				return -1;
+			hf_scan_name_end = hf_scan_name_end_avx2;
+			hf_scan_lf = hf_scan_lf_avx2;
+			break;
+#endif /* HF_SCAN_X86 */
+		default:
+			return -1;
+	}
+	hf_scan_mode = mode;
+	return 0;
+}
+
+int hf_scan_get_mode(void)
+{
+	return hf_scan_mode;
+}
+
+const char* hf_scan_mode_name(int mode)
+{
+	switch(mode) {
+		case HF_SCAN_SCALAR:
+			return "scalar";
+		case HF_SCAN_SSE42:
+			return "sse4.2";
+		case HF_SCAN_AVX2:
+			return "avx2";
+	}
+	return "unknown";
+}
+
+/** selects the best scanners supported by the cpu.
+ * @return the selected mode
+ */
+int hf_scan_init(void)
+{
+#ifdef HF_SCAN_X86
+	__builtin_cpu_init();
+	if (hf_scan_set_mode(HF_SCAN_AVX2) == 0)
+		return hf_scan_mode;
+	if (hf_scan_set_mode(HF_SCAN_SSE42) == 0)
+		return hf_scan_mode;
+#endif /* HF_SCAN_X86 */
+	hf_scan_set_mode(HF_SCAN_SCALAR);
+	return hf_scan_mode;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*! \file
+ * \brief Parser :: Header field line and name scanners
+ *
+ * Scanners used by the header parser to find the end of a header name and
+ * the end of a header line. On x86 SSE4.2 or AVX2 versions are selected at
+ * startup (hf_scan_init()) based on the cpu features, otherwise (and until
+ * hf_scan_init() is called) the scalar versions are used.
+ *
+ * \ingroup parser
+ */
+
+#ifndef HF_SCAN_H
+#define HF_SCAN_H
+
+#define HF_SCAN_SCALAR	0
+#define HF_SCAN_SSE42	1
+#define HF_SCAN_AVX2	2
+
+typedef char* (*hf_scan_f)(char* p, char* end);
+
+/** returns the first ':', ' ' or '\\t' in [p, end) or 0 if not found */
+extern hf_scan_f hf_scan_name_end;
+/** returns the first '\\n' in [p, end) or 0 if not found */
+extern hf_scan_f hf_scan_lf;
+
+int hf_scan_init(void);
+int hf_scan_set_mode(int mode);
+int hf_scan_get_mode(void);
+const char* hf_scan_mode_name(int mode);
+
+#endif /* HF_SCAN_H */
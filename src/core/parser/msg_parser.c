@@ -49,6 +49,7 @@
 #include "../core_stats.h"
 #include "../globals.h"
 #include "parse_hname2.h"
+#include "hf_scan.h"
 #include "parse_uri.h"
 #include "parse_content.h"
 #include "parse_to.h"
@@ -247,7 +248,7 @@ char* get_hdr_field(char* const buf, char* const end, struct hdr_field* const hd
 			/* find end of header */
 			/* find lf */
 			do{
-				match=q_memchr(tmp, '\n', end-tmp);
+				match=hf_scan_lf(tmp, end);
 				if (match){
 					match++;
 				}else {
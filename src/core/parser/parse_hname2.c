@@ -21,18 +21,17 @@
  *
  */
 
-/** Parser :: Fast 32-bit Header Field Name Parser.
+/** Parser :: Header Field Name Parser.
  * @file
  * @ingroup parser
  */
 
 #include "../comp_defs.h"
 #include "parse_hname2.h"
-#include "keys.h"
+#include "hf_scan.h"
 #include "../ut.h"  /* q_memchr */
 
 #define LOWER_BYTE(b) ((b) | 0x20)
-#define LOWER_DWORD(d) ((d) | 0x20202020)
 
 /** Skip all white-chars and return position of the first non-white char.
  */
@@ -47,214 +46,190 @@ static inline char* skip_ws(char* p, unsigned int size)
 	return p;
 }
 
-/*! \name 
- * Parser macros
+/*! \name
+ * Header name classifier
+ *
+ * The well known header names are looked up in a perfect hash table:
+ * HNAME_HASH() gives a different slot for each of the names in hname_table,
+ * so a lookup is one hash computation and one case-insensitive compare.
+ * The hash uses the lowercase first, middle and last chars and the length.
+ * When adding a name, check that its slot is still free (or change the
+ * middle char multiplier until all the slots are distinct).
  */
 /*@{ */
-#include "case_via.h"      /* Via */
-#include "case_from.h"     /* From */
-#include "case_to.h"       /* To */
-#include "case_cseq.h"     /* CSeq */
-#include "case_call.h"     /* Call-ID */
-#include "case_cont.h"     /* Contact, Content-Type, Content-Length, Content-Purpose,
-			    * Content-Action, Content-Disposition */
-#include "case_rout.h"     /* Route */
-#include "case_max.h"      /* Max-Forwards */
-#include "case_reco.h"     /* Record-Route */
-#include "case_auth.h"     /* Authorization */
-#include "case_expi.h"     /* Expires */
-#include "case_prox.h"     /* Proxy-Authorization, Proxy-Require */
-#include "case_allo.h"     /* Allow */
-#include "case_unsu.h"     /* Unsupported */
-#include "case_even.h"     /* Event */
-#include "case_sip.h"      /* Sip-If-Match */
-#include "case_acce.h"     /* Accept, Accept-Language */
-#include "case_orga.h"     /* Organization */
-#include "case_prio.h"     /* Priority */
-#include "case_subj.h"     /* Subject */
-#include "case_user.h"     /* User-Agent */
-#include "case_serv.h"     /* Server */
-#include "case_supp.h"     /* Supported */
-#include "case_dive.h"     /* Diversion */
-#include "case_remo.h"     /* Remote-Party-ID */
-#include "case_refe.h"     /* Refer-To */
-#include "case_sess.h"     /* Session-Expires */
-#include "case_reje.h"     /* Reject-Contact */
-#include "case_min.h"      /* Min-SE */
-#include "case_subs.h"     /* Subscription-State */
-#include "case_requ.h"     /* Require */
-#include "case_www.h"      /* WWW-Authenticate */
-#include "case_date.h"     /* Date */
-#include "case_iden.h"     /* Identity, Identity-info */
-#include "case_retr.h"     /* Retry-After */
-#include "case_path.h"     /* Path */
-#include "case_priv.h"
-#include "case_reas.h"     /* Reason */
-#include "case_p_as.h"     /* P-Asserted-Identity */
-#include "case_p_pr.h"     /* P-Preferred-Identity */
-
-/*@} */
 
-#define SAFE_READ(val, len) \
-((len) == 1 ? READ1(val) : ((len) == 2 ? READ2(val) : ((len) == 3 ? READ3(val) : ((len) > 3 ? READ4(val) : READ0(val)))))
+#define HNAME_HASH_SIZE 256
 
-#define READ(val) \
-READ4(val)
+#define HNAME_HASH(s, len) \
+	((LOWER_BYTE((unsigned char)(s)[0]) \
+		+ LOWER_BYTE((unsigned char)(s)[(len) - 1]) \
+		+ 15 * LOWER_BYTE((unsigned char)(s)[(len) >> 1]) \
+		+ (len)) & (HNAME_HASH_SIZE - 1))
 
-#define READ4(val) \
-(*((val) + 0) + (*((val) + 1) << 8) + (*((val) + 2) << 16) + (*((val) + 3) << 24))
+struct hname_entry {
+	str name;			/* lowercase */
+	hdr_types_t type;
+};
 
-#define READ3(val) \
-(*((val) + 0) + (*((val) + 1) << 8) + (*((val) + 2) << 16))
+static const struct hname_entry hname_table[] = {
+	{STR_NULL, HDR_OTHER_T},
+	{str_init("via"), HDR_VIA_T},
+	{str_init("from"), HDR_FROM_T},
+	{str_init("to"), HDR_TO_T},
+	{str_init("cseq"), HDR_CSEQ_T},
+	{str_init("call-id"), HDR_CALLID_T},
+	{str_init("contact"), HDR_CONTACT_T},
+	{str_init("content-type"), HDR_CONTENTTYPE_T},
+	{str_init("content-length"), HDR_CONTENTLENGTH_T},
+	{str_init("content-disposition"), HDR_CONTENTDISPOSITION_T},
+	{str_init("content-encoding"), HDR_CONTENTENCODING_T},
+	{str_init("route"), HDR_ROUTE_T},
+	{str_init("max-forwards"), HDR_MAXFORWARDS_T},
+	{str_init("record-route"), HDR_RECORDROUTE_T},
+	{str_init("authorization"), HDR_AUTHORIZATION_T},
+	{str_init("expires"), HDR_EXPIRES_T},
+	{str_init("min-expires"), HDR_MIN_EXPIRES_T},
+	{str_init("proxy-authorization"), HDR_PROXYAUTH_T},
+	{str_init("proxy-require"), HDR_PROXYREQUIRE_T},
+	{str_init("proxy-authenticate"), HDR_PROXY_AUTHENTICATE_T},
+	{str_init("allow"), HDR_ALLOW_T},
+	{str_init("allow-events"), HDR_ALLOWEVENTS_T},
+	{str_init("unsupported"), HDR_UNSUPPORTED_T},
+	{str_init("event"), HDR_EVENT_T},
+	{str_init("sip-if-match"), HDR_SIPIFMATCH_T},
+	{str_init("accept"), HDR_ACCEPT_T},
+	{str_init("accept-language"), HDR_ACCEPTLANGUAGE_T},
+	{str_init("accept-contact"), HDR_ACCEPTCONTACT_T},
+	{str_init("organization"), HDR_ORGANIZATION_T},
+	{str_init("priority"), HDR_PRIORITY_T},
+	{str_init("subject"), HDR_SUBJECT_T},
+	{str_init("subscription-state"), HDR_SUBSCRIPTION_STATE_T},
+	{str_init("user-agent"), HDR_USERAGENT_T},
+	{str_init("server"), HDR_SERVER_T},
+	{str_init("supported"), HDR_SUPPORTED_T},
+	{str_init("diversion"), HDR_DIVERSION_T},
+	{str_init("remote-party-id"), HDR_RPID_T},
+	{str_init("refer-to"), HDR_REFER_TO_T},
+	{str_init("referred-by"), HDR_REFERREDBY_T},
+	{str_init("session-expires"), HDR_SESSIONEXPIRES_T},
+	{str_init("reject-contact"), HDR_REJECTCONTACT_T},
+	{str_init("min-se"), HDR_MIN_SE_T},
+	{str_init("require"), HDR_REQUIRE_T},
+	{str_init("request-disposition"), HDR_REQUESTDISPOSITION_T},
+	{str_init("www-authenticate"), HDR_WWW_AUTHENTICATE_T},
+	{str_init("date"), HDR_DATE_T},
+	{str_init("identity"), HDR_IDENTITY_T},
+	{str_init("identity-info"), HDR_IDENTITY_INFO_T},
+	{str_init("retry-after"), HDR_RETRY_AFTER_T},
+	{str_init("path"), HDR_PATH_T},
+	{str_init("privacy"), HDR_PRIVACY_T},
+	{str_init("reason"), HDR_REASON_T},
+	{str_init("p-asserted-identity"), HDR_PAI_T},
+	{str_init("p-preferred-identity"), HDR_PPI_T},
+};
 
-#define READ2(val) \
-(*((val) + 0) + (*((val) + 1) << 8))
+static const unsigned char hname_index[HNAME_HASH_SIZE] = {
+	 0,  1,  0, 14,  0,  0, 15,  0,  0, 17,  0,  9,  0,  0,  0, 28,
+	 0, 31,  0,  0,  0,  0,  0,  0,  0,  0, 43,  0,  0,  0,  0,  0,
+	 0,  0,  5,  0, 30,  0,  0,  0,  0, 26,  0,  0,  0,  0,  0,  0,
+	 0, 20,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  2,  0,  0,  0,  0,  0,  0,  0,
+	 0, 34,  0,  0,  0,  0,  3,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0, 22, 36,  0,  0,  0,  0,  0, 41,  8,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0, 13,  0,  0, 35, 24,  0,  0,  0,  0,  0,
+	18,  0, 48,  0,  0,  0,  0, 37, 39, 45, 12,  0,  0,  0,  0, 29,
+	 7,  0, 32, 51, 38,  0,  0,  0, 49,  0,  6,  0,  0,  0,  0,  0,
+	27, 47,  0,  0,  0,  0, 46, 11,  0, 42,  0,  0,  0,  0,  0,  0,
+	 0, 40,  0,  4,  0, 10, 25,  0,  0, 23,  0, 21,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0, 33,  0, 44, 52, 53, 50,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0, 16,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 19,
+};
 
-#define READ1(val) \
-(*((val) + 0))
+/* compact header forms, indexed by the lowercase letter */
+static const hdr_types_t hname_compact['z' - 'a' + 1] = {
+	['a' - 'a'] = HDR_ACCEPTCONTACT_T,
+	['b' - 'a'] = HDR_REFERREDBY_T,
+	['c' - 'a'] = HDR_CONTENTTYPE_T,
+	['d' - 'a'] = HDR_REQUESTDISPOSITION_T,
+	['e' - 'a'] = HDR_CONTENTENCODING_T,
+	['f' - 'a'] = HDR_FROM_T,
+	['i' - 'a'] = HDR_CALLID_T,
+	['j' - 'a'] = HDR_REJECTCONTACT_T,
+	['k' - 'a'] = HDR_SUPPORTED_T,
+	['l' - 'a'] = HDR_CONTENTLENGTH_T,
+	['m' - 'a'] = HDR_CONTACT_T,
+	['n' - 'a'] = HDR_IDENTITY_INFO_T,
+	['o' - 'a'] = HDR_EVENT_T,
+	['r' - 'a'] = HDR_REFER_TO_T,
+	['s' - 'a'] = HDR_SUBJECT_T,
+	['t' - 'a'] = HDR_TO_T,
+	['u' - 'a'] = HDR_ALLOWEVENTS_T,
+	['v' - 'a'] = HDR_VIA_T,
+	['x' - 'a'] = HDR_SESSIONEXPIRES_T,
+	['y' - 'a'] = HDR_IDENTITY_T,
+};
 
-#define READ0(val) \
-(0)
-
-#define FIRST_QUATERNIONS       \
-        case _via1_: via1_CASE; \
-	case _from_: from_CASE; \
-	case _to12_: to12_CASE; \
-	case _cseq_: cseq_CASE; \
-	case _call_: call_CASE; \
-	case _cont_: cont_CASE; \
-	case _rout_: rout_CASE; \
-	case _max__: max_CASE;  \
-	case _reco_: reco_CASE; \
-	case _via2_: via2_CASE; \
-	case _auth_: auth_CASE; \
-	case _supp_: supp_CASE; \
-	case _expi_: expi_CASE; \
-	case _prox_: prox_CASE; \
-	case _allo_: allo_CASE; \
-	case _unsu_: unsu_CASE; \
-        case _even_: even_CASE; \
-        case _sip_ : sip_CASE;  \
-        case _acce_: acce_CASE; \
-        case _orga_: orga_CASE; \
-        case _prio_: prio_CASE; \
-        case _subj_: subj_CASE; \
-        case _subs_: subs_CASE; \
-        case _user_: user_CASE; \
-        case _serv_: serv_CASE; \
-        case _dive_: dive_CASE; \
-        case _remo_: remo_CASE; \
-        case _refe_: refe_CASE; \
-	case _sess_: sess_CASE; \
-	case _reje_: reje_CASE; \
-	case _min__: min_CASE;  \
-	case _requ_: requ_CASE;  \
-	case _www__: www_CASE; \
-	case _date_: date_CASE; \
-	case _iden_: iden_CASE; \
-	case _retr_: retr_CASE; \
-	case _path_: path_CASE; \
-	case _priv_: priv_CASE; \
-	case _reas_: reas_CASE; \
-	case _p_as_: p_as_CASE; \
-	case _p_pr_: p_pr_CASE;
+/** Returns the type of the header with the name [s, s+len).
+ */
+static inline hdr_types_t hname_classify(const char* s, int len)
+{
+	const struct hname_entry* e;
+	unsigned char c;
+	int i;
 
+	if (len < 2) {
+		if (len == 0) return HDR_OTHER_T;
+		c = LOWER_BYTE((unsigned char)*s);
+		if (c < 'a' || c > 'z') return HDR_OTHER_T;
+		return hname_compact[c - 'a'];
+	}
+	e = &hname_table[hname_index[HNAME_HASH(s, len)]];
+	if (e->name.len != len) return HDR_OTHER_T;
+	for (i = 0; i < len; i++) {
+		if (LOWER_BYTE((unsigned char)s[i]) != (unsigned char)e->name.s[i])
+			return HDR_OTHER_T;
+	}
+	return e->type;
+}
 
-#define PARSE_COMPACT(id)          \
-        switch(*(p + 1)) {         \
-        case ' ':                  \
-	        hdr->type = id;    \
-	        p += 2;            \
-	        goto dc_end;       \
-	                           \
-        case ':':                  \
-	        hdr->type = id;    \
-	        hdr->name.len = 1; \
-	        return (p + 2);    \
-        }
+/*@} */
 
 char* parse_hname2(char* const begin, const char* const end, struct hdr_field* const hdr)
 {
-	register char* p;
-	register unsigned int val;
+	char* p;
 
 	if ((end - begin) < 4) {
 		hdr->type = HDR_ERROR_T;
 		return begin;
 	}
 
-	p = begin;
-
-	val = LOWER_DWORD(READ(p));
 	hdr->name.s = begin;
+	/* the name ends at the double colon or at white space */
+	p = hf_scan_name_end(begin, (char*)end);
+	if (!p) goto error;
+	hdr->type = hname_classify(begin, p - begin);
 
-	switch(val) {
-	FIRST_QUATERNIONS;
-
-	default:
-		switch(LOWER_BYTE(*p)) {
-		case 't':
-			switch(LOWER_BYTE(*(p + 1))) {
-			case 'o':
-			case ' ':
-				hdr->type = HDR_TO_T;
-				p += 2;
-				goto dc_end;
-
-			case ':':
-				hdr->type = HDR_TO_T;
-				hdr->name.len = 1;
-				return (p + 2);
-			}
-			break;
-
-		case 'v': PARSE_COMPACT(HDR_VIA_T);           break;
-		case 'f': PARSE_COMPACT(HDR_FROM_T);          break;
-		case 'i': PARSE_COMPACT(HDR_CALLID_T);        break;
-		case 'm': PARSE_COMPACT(HDR_CONTACT_T);       break;
-		case 'l': PARSE_COMPACT(HDR_CONTENTLENGTH_T); break;
-		case 'k': PARSE_COMPACT(HDR_SUPPORTED_T);     break;
-		case 'c': PARSE_COMPACT(HDR_CONTENTTYPE_T);   break;
-		case 'o': PARSE_COMPACT(HDR_EVENT_T);         break;
-		case 'x': PARSE_COMPACT(HDR_SESSIONEXPIRES_T);break;
-		case 'a': PARSE_COMPACT(HDR_ACCEPTCONTACT_T); break;
-		case 'u': PARSE_COMPACT(HDR_ALLOWEVENTS_T);   break;
-		case 'e': PARSE_COMPACT(HDR_CONTENTENCODING_T); break;
-		case 'b': PARSE_COMPACT(HDR_REFERREDBY_T);    break;
-		case 'j': PARSE_COMPACT(HDR_REJECTCONTACT_T); break;
-		case 'd': PARSE_COMPACT(HDR_REQUESTDISPOSITION_T); break;
-		case 's': PARSE_COMPACT(HDR_SUBJECT_T);       break;
-		case 'r': PARSE_COMPACT(HDR_REFER_TO_T);      break;
-		case 'y': PARSE_COMPACT(HDR_IDENTITY_T);      break;
-		case 'n': PARSE_COMPACT(HDR_IDENTITY_INFO_T); break;
-		}
-		goto other;
-        }
-
-	     /* Double colon hasn't been found yet */
- dc_end:
-       	p = skip_ws(p, end - p);
 	if (*p != ':') {
-	        goto other;
-	} else {
-		hdr->name.len = p - hdr->name.s;
-		return (p + 1);
+		/* white space before the double colon */
+		p = skip_ws(p, end - p);
+		if (p >= end || *p != ':') {
+			/* Unknown header type */
+			hdr->type = HDR_OTHER_T;
+			p = q_memchr(p, ':', end - p);
+			if (!p) goto error;
+		}
 	}
+	hdr->name.len = p - hdr->name.s;
+	return (p + 1);
 
-	     /* Unknown header type */
- other:
-	p = q_memchr(p, ':', end - p);
-	if (!p) {        /* No double colon found, error.. */
-		hdr->type = HDR_ERROR_T;
-		hdr->name.s = 0;
-		hdr->name.len = 0;
-		return 0;
-	} else {
-		hdr->type = HDR_OTHER_T;
-		hdr->name.len = p - hdr->name.s;
-		/*hdr_update_type(hdr);*/
-		return (p + 1);
-	}
+error:
+	/* No double colon found, error.. */
+	hdr->type = HDR_ERROR_T;
+	hdr->name.s = 0;
+	hdr->name.len = 0;
+	return 0;
 }
 
 /**
@@ -21,7 +21,7 @@
  */
 
 /*! \file
- * \brief Parser :: Fast 32-bit Header Field Name Parser
+ * \brief Parser :: Header Field Name Parser
  *
  * \ingroup parser
  */
@@ -32,8 +32,9 @@
 #include "hf.h"
 
 
-/** Fast 32-bit header field name parser.
- * @file
+/** Header field name parser.
+ * Sets hdr->type (HDR_OTHER_T for unknown names) and hdr->name.
+ * @return pointer after the double colon, hdr->type is HDR_ERROR_T on error
  */
 char* parse_hname2(char* const begin, const char* const end, struct hdr_field* const hdr);
 char* parse_hname2_short(char* const begin, const char* const end, struct hdr_field* const hdr);
@@ -31,7 +31,7 @@
 
 enum poll_types { POLL_NONE, POLL_POLL, POLL_EPOLL_LT, POLL_EPOLL_ET,
 					POLL_SIGIO_RT, POLL_SELECT, POLL_KQUEUE, POLL_DEVPOLL,
-					POLL_END};
+					POLL_IOURING, POLL_END};
 
 /* all the function and vars are defined in io_wait.c */
 
@@ -86,6 +86,10 @@ static int calc_common_open_fds_no(void)
 				-1 /* timer (no udp)*/ + 3 /* stdin/out/err */ +
 				2*mhomed
 				;
+#ifdef USE_TCP
+	/* + 1 tcp send unix socket/all_proc for each extra tcp main proc. */
+	max_fds_no+=estimated_proc_no*(tcp_main_procs-1);
+#endif
 	return max_fds_no;
 }
 
@@ -96,6 +100,7 @@ int init_pt(int proc_no)
 {
 #ifdef USE_TCP
 	int r;
+	int i;
 #endif
 	
 	estimated_proc_no+=proc_no;
@@ -117,7 +122,8 @@ int init_pt(int proc_no)
 	memset(pt, 0, sizeof(struct process_table)*estimated_proc_no);
 #ifdef USE_TCP
 	for (r=0; r<estimated_proc_no; r++){
-		pt[r].unix_sock=-1;
+		for (i=0; i<TCP_MAIN_PROCS_MAX; i++)
+			pt[r].unix_sock[i]=-1;
 		pt[r].idx=-1;
 	}
 #endif
@@ -197,14 +203,17 @@ int close_extra_socks(int child_id, int proc_no)
 {
 #ifdef USE_TCP
 	int r;
+	int i;
 	struct socket_info* si;
 	
 	if (child_id!=PROC_TCP_MAIN){
 		for (r=0; r<proc_no; r++){
-			if (pt[r].unix_sock>=0){
-				/* we can't change the value in pt[] because it's
-				 * shared so we only close it */
-				close(pt[r].unix_sock);
+			for (i=0; i<tcp_main_procs; i++){
+				if (pt[r].unix_sock[i]>=0){
+					/* we can't change the value in pt[] because it's
+					 * shared so we only close it */
+					close(pt[r].unix_sock[i]);
+				}
 			}
 		}
 		/* close all listen sockets (needed only in tcp_main */
@@ -233,6 +242,54 @@ int close_extra_socks(int child_id, int proc_no)
 
 
 
+#ifdef USE_TCP
+/* creates a socket pair for each tcp main process
+ * returns 0 on success, -1 on error (the already created pairs must be
+ *  closed with tcp_main_socks_close()) */
+static int tcp_main_socks_init(int sockfd[][2])
+{
+	int i;
+
+	for (i=0; i<tcp_main_procs; i++){
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd[i])<0){
+			LM_ERR("socketpair failed: %s\n", strerror(errno));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* keeps the child end (sockfd[i][1]) in unix_tcp_socks[] if in the child
+ * process, else the tcp main end (sockfd[i][0]) in pt[proc] and closes
+ * the other one */
+static void tcp_main_socks_set(int sockfd[][2], int in_child, int proc)
+{
+	int i;
+
+	for (i=0; i<tcp_main_procs; i++){
+		if (in_child){
+			close(sockfd[i][0]);
+			unix_tcp_socks[i]=sockfd[i][1];
+		}else{
+			close(sockfd[i][1]);
+			pt[proc].unix_sock[i]=sockfd[i][0];
+		}
+	}
+}
+
+static void tcp_main_socks_close(int sockfd[][2])
+{
+	int i;
+
+	for (i=0; i<TCP_MAIN_PROCS_MAX; i++){
+		if (sockfd[i][0]!=-1) close(sockfd[i][0]);
+		if (sockfd[i][1]!=-1) close(sockfd[i][1]);
+	}
+}
+#endif /* USE_TCP */
+
+
+
 /**
  * Forks a new process.
  * @param child_id - rank, if equal to PROC_NOCHLDINIT init_child will not be
@@ -248,7 +305,7 @@ int fork_process(int child_id, char *desc, int make_sock)
 	unsigned int new_seed1;
 	unsigned int new_seed2;
 #ifdef USE_TCP
-	int sockfd[2];
+	int sockfd[TCP_MAIN_PROCS_MAX][2];
 #endif
 
 	if(unlikely(fork_delay>0))
@@ -256,7 +313,7 @@ int fork_process(int child_id, char *desc, int make_sock)
 
 	ret=-1;
 	#ifdef USE_TCP
-		sockfd[0]=sockfd[1]=-1;
+		memset(sockfd, -1, sizeof(sockfd));
 		if(make_sock && !tcp_disable){
 			 if (!is_main){
 				 LM_CRIT("called from a non "
@@ -269,11 +326,8 @@ int fork_process(int child_id, char *desc, int make_sock)
 				 LM_CRIT("called, but tcp main is already started\n");
 				 goto error;
 			 }
-			 if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd)<0){
-				LM_ERR("socketpair failed: %s\n",
-							strerror(errno));
+			 if (tcp_main_socks_init(sockfd)<0)
 				goto error;
-			}
 		}
 	#endif
 	lock_get(process_lock);
@@ -320,10 +374,8 @@ int fork_process(int child_id, char *desc, int make_sock)
 		lock_release(process_lock);
 #endif
 		#ifdef USE_TCP
-			if (make_sock && !tcp_disable){
-				close(sockfd[0]);
-				unix_tcp_sock=sockfd[1];
-			}
+			if (make_sock && !tcp_disable)
+				tcp_main_socks_set(sockfd, 1, process_no);
 		#endif		
 		if ((child_id!=PROC_NOCHLDINIT) && (init_child(child_id) < 0)) {
 			LM_ERR("init_child failed for process %d, pid %d, \"%s\"\n",
@@ -344,8 +396,7 @@ int fork_process(int child_id, char *desc, int make_sock)
 		}
 		#ifdef USE_TCP
 			if (make_sock && !tcp_disable){
-				close(sockfd[1]);
-				pt[child_process_no].unix_sock=sockfd[0];
+				tcp_main_socks_set(sockfd, 0, child_process_no);
 				pt[child_process_no].idx=-1; /* this is not a "tcp" process*/
 			}
 		#endif
@@ -358,8 +409,7 @@ int fork_process(int child_id, char *desc, int make_sock)
 	}
 error:
 #ifdef USE_TCP
-	if (sockfd[0]!=-1) close(sockfd[0]);
-	if (sockfd[1]!=-1) close(sockfd[1]);
+	tcp_main_socks_close(sockfd);
 #endif
 end:
 	return ret;
@@ -376,7 +426,7 @@ end:
 int fork_tcp_process(int child_id, char *desc, int r, int *reader_fd_1)
 {
 	int pid, child_process_no;
-	int sockfd[2];
+	int sockfd[TCP_MAIN_PROCS_MAX][2];
 	int reader_fd[2]; /* for comm. with the tcp children read  */
 	int ret;
 	int i;
@@ -384,7 +434,7 @@ int fork_tcp_process(int child_id, char *desc, int r, int *reader_fd_1)
 	unsigned int new_seed2;
 	
 	/* init */
-	sockfd[0]=sockfd[1]=-1;
+	memset(sockfd, -1, sizeof(sockfd));
 	reader_fd[0]=reader_fd[1]=-1;
 	ret=-1;
 	
@@ -396,10 +446,8 @@ int fork_tcp_process(int child_id, char *desc, int r, int *reader_fd_1)
 		 LM_CRIT("called _after_ starting tcp main\n");
 		 goto error;
 	 }
-	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd)<0){
-		LM_ERR("socketpair failed: %s\n", strerror(errno));
+	if (tcp_main_socks_init(sockfd)<0)
 		goto error;
-	}
 	if (socketpair(AF_UNIX, SOCK_STREAM, 0, reader_fd)<0){
 		LM_ERR("socketpair failed: %s\n", strerror(errno));
 		goto error;
@@ -459,8 +507,7 @@ int fork_tcp_process(int child_id, char *desc, int r, int *reader_fd_1)
 		lock_get(process_lock);
 		lock_release(process_lock);
 #endif
-		close(sockfd[0]);
-		unix_tcp_sock=sockfd[1];
+		tcp_main_socks_set(sockfd, 1, process_no);
 		close(reader_fd[0]);
 		if (reader_fd_1) *reader_fd_1=reader_fd[1];
 		if ((child_id!=PROC_NOCHLDINIT) && (init_child(child_id) < 0)) {
@@ -477,7 +524,7 @@ int fork_tcp_process(int child_id, char *desc, int r, int *reader_fd_1)
 #endif
 		/* add the process to the list in shm */
 		pt[child_process_no].pid=pid;
-		pt[child_process_no].unix_sock=sockfd[0];
+		tcp_main_socks_set(sockfd, 0, child_process_no);
 		pt[child_process_no].idx=r;
 		if (desc){
 			snprintf(pt[child_process_no].desc, MAX_PT_DESC, "%s child=%d", 
@@ -488,7 +535,6 @@ int fork_tcp_process(int child_id, char *desc, int r, int *reader_fd_1)
 		lock_release(process_lock);
 #endif
 		
-		close(sockfd[1]);
 		close(reader_fd[1]);
 		
 		tcp_children[r].pid=pid;
@@ -501,8 +547,7 @@ int fork_tcp_process(int child_id, char *desc, int r, int *reader_fd_1)
 		goto end;
 	}
 error:
-	if (sockfd[0]!=-1) close(sockfd[0]);
-	if (sockfd[1]!=-1) close(sockfd[1]);
+	tcp_main_socks_close(sockfd);
 	if (reader_fd[0]!=-1) close(reader_fd[0]);
 	if (reader_fd[1]!=-1) close(reader_fd[1]);
 end:
@@ -37,7 +37,8 @@
 struct process_table {
 	int pid;
 #ifdef USE_TCP
-	int unix_sock; 	/* unix socket on which tcp main listens	*/
+	int unix_sock[TCP_MAIN_PROCS_MAX]; /* unix sockets on which the tcp
+										  main processes listen */
 	int idx; 		/* tcp child index, -1 for other processes 	*/
 #endif
 	char desc[MAX_PT_DESC];
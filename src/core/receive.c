@@ -52,6 +52,7 @@
 
 #include "tcp_server.h" /* for tcpconn_add_alias */
 #include "tcp_options.h" /* for access to tcp_accept_aliases*/
+#include "udp_server.h"
 #include "cfg/cfg.h"
 #include "core_stats.h"
 #include "kemi.h"
@@ -147,6 +148,9 @@ int receive_msg(char* buf, unsigned int len, struct receive_info* rcv_info)
 	sr_event_exec(SREV_NET_DATA_IN, (void*)&inb);
 	len = inb.len;
 
+	/* queue the udp datagrams generated while processing this message */
+	udp_send_batch_start();
+
 	msg=pkg_malloc(sizeof(struct sip_msg));
 	if (msg==0) {
 		LM_ERR("no mem for sip_msg\n");
@@ -373,6 +377,7 @@ end:
 #endif
 	/* reset log prefix */
 	log_prefix_set(NULL);
+	udp_send_batch_end();
 	return 0;
 
 #ifndef NO_ONREPLY_ROUTE_ERROR
@@ -402,6 +407,7 @@ error00:
 	STATS_RX_DROPS;
 	/* reset log prefix */
 	log_prefix_set(NULL);
+	udp_send_batch_end();
 	return -1;
 }
 
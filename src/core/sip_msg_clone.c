@@ -358,22 +358,16 @@ static inline int clone_authorized_hooks(struct sip_msg* new,
 
 
 
-/** Creates a shm clone for a sip_msg.
- * org_msg is cloned along with most of its headers and lumps into one
- * shm memory block (so that a shm_free() on the result will free everything)
- * @return shm malloced sip_msg on success, 0 on error
- * Warning: Cloner does not clone all hdr_field headers (From, To, etc.).
+/** Computes the size of the shm block needed by a sip_msg clone.
+ * @return the number of bytes sip_msg_shm_clone_buf() will use for org_msg
  */
-struct sip_msg*  sip_msg_shm_clone( struct sip_msg *org_msg, int *sip_msg_len,
-									int clone_lumps)
+unsigned int sip_msg_shm_clone_len(struct sip_msg *org_msg, int clone_lumps)
 {
 	unsigned int      len;
-	struct hdr_field  *hdr,*new_hdr,*last_hdr;
+	struct hdr_field  *hdr;
 	struct via_body   *via;
 	struct via_param  *prm;
-	struct to_param   *to_prm,*new_to_prm;
-	struct sip_msg    *new_msg;
-	char              *p;
+	struct to_param   *to_prm;
 
 	/*computing the length of entire sip_msg structure*/
 	len = ROUND4(sizeof( struct sip_msg ));
@@ -491,15 +485,23 @@ struct sip_msg*  sip_msg_shm_clone( struct sip_msg *org_msg, int *sip_msg_len,
 		LUMP_LIST_LEN(len, org_msg->body_lumps);
 		RPL_LUMP_LIST_LEN(len, org_msg->reply_lump);
 	}
-	
-	p=(char *)shm_malloc(len);
-	if (!p)
-	{
-		LM_ERR("cannot allocate memory\n" );
-		return 0;
-	}
-	if (sip_msg_len)
-		*sip_msg_len = len;
+
+	return len;
+}
+
+
+/** Clones a sip_msg into a caller provided shm buffer.
+ * p must point to at least sip_msg_shm_clone_len(org_msg, clone_lumps)
+ * bytes of shm memory, owned by the caller also on error.
+ * @return the clone (placed at p) on success, 0 on error
+ * Warning: Cloner does not clone all hdr_field headers (From, To, etc.).
+ */
+struct sip_msg*  sip_msg_shm_clone_buf(struct sip_msg *org_msg, char *p,
+									int clone_lumps)
+{
+	struct hdr_field  *hdr,*new_hdr,*last_hdr;
+	struct to_param   *to_prm,*new_to_prm;
+	struct sip_msg    *new_msg;
 
 	/* filling up the new structure */
 	new_msg = (struct sip_msg*)p;
@@ -935,7 +937,39 @@ struct sip_msg*  sip_msg_shm_clone( struct sip_msg *org_msg, int *sip_msg_len,
 	}
 	
 	if (clone_authorized_hooks(new_msg, org_msg) < 0) {
-		shm_free(new_msg);
+		return 0;
+	}
+
+	return new_msg;
+}
+
+
+/** Creates a shm clone for a sip_msg.
+ * org_msg is cloned along with most of its headers and lumps into one
+ * shm memory block (so that a shm_free() on the result will free everything)
+ * @return shm malloced sip_msg on success, 0 on error
+ * Warning: Cloner does not clone all hdr_field headers (From, To, etc.).
+ */
+struct sip_msg*  sip_msg_shm_clone( struct sip_msg *org_msg, int *sip_msg_len,
+									int clone_lumps)
+{
+	unsigned int      len;
+	struct sip_msg    *new_msg;
+	char              *p;
+
+	len = sip_msg_shm_clone_len(org_msg, clone_lumps);
+	p=(char *)shm_malloc(len);
+	if (!p)
+	{
+		LM_ERR("cannot allocate memory\n" );
+		return 0;
+	}
+	if (sip_msg_len)
+		*sip_msg_len = len;
+
+	new_msg = sip_msg_shm_clone_buf(org_msg, p, clone_lumps);
+	if (!new_msg) {
+		shm_free(p);
 		return 0;
 	}
 
@@ -195,6 +195,7 @@ struct tcp_connection{
 	int id; /* id (unique!) used to retrieve a specific connection when
 	           reply-ing*/
 	int reader_pid; /* pid of the active reader process */
+	int main_idx; /* tcp main process owning the connection */
 	struct receive_info rcv; /* src & dst ip, ports, proto a.s.o*/
 	struct tcp_req req; /* request data */
 	atomic_t refcnt;
@@ -226,6 +227,9 @@ struct tcp_connection{
 
 #define tcpconn_close_after_send(c)	((c)->send_flags.f & SND_F_CON_CLOSE)
 
+/* unix socket for sending commands about c to its tcp main process */
+#define tcpconn_main_sock(c) (unix_tcp_socks[(c)->main_idx])
+
 #define TCP_RCV_INFO(c) (&(c)->rcv)
 
 #define TCP_RCV_LADDR(r) (&((r).dst_ip))
@@ -288,12 +292,76 @@ struct tcp_connection{
 	}while(0)
 
 
-#define TCPCONN_LOCK lock_get(tcpconn_lock);
-#define TCPCONN_UNLOCK lock_release(tcpconn_lock);
-
 #define TCP_ALIAS_HASH_SIZE 4096
 #define TCP_ID_HASH_SIZE 1024
 
+/* the connection hashes are split in TCP_CONN_PARTS partitions, each one
+ * with its own lock. The partition is chosen by the peer ip, so that all the
+ * aliases of a connection are in the same partition and the connection id
+ * encodes it in its lower bits (id & TCP_CONN_PART_MASK). The id hash
+ * buckets and the alias hash buckets keep the same lower bits => each
+ * bucket belongs to exactly one partition.
+ * Note: TCP_CONN_PARTS must be a power of 2 and <= TCP_ID_HASH_SIZE */
+#define TCP_CONN_PART_BITS 4
+#define TCP_CONN_PARTS (1<<TCP_CONN_PART_BITS)
+#define TCP_CONN_PART_MASK (TCP_CONN_PARTS-1)
+
+/* assumed cache line size, used to keep the partitions apart */
+#define TCP_CONN_PART_ALIGN 64
+
+/* partition lock and its counters (updated with the lock held) */
+struct tcpconn_part_data {
+	gen_lock_t lock;
+	unsigned int locks;     /* lock acquisitions */
+	unsigned int contended; /* acquisitions that had to wait */
+};
+
+/* each partition is padded to a whole number of cache lines, so that
+ * taking a partition lock does not bounce the cache line of the others */
+union tcpconn_part {
+	struct tcpconn_part_data p;
+	char _pad[(sizeof(struct tcpconn_part_data)+TCP_CONN_PART_ALIGN-1)
+				& ~(TCP_CONN_PART_ALIGN-1)];
+};
+
+/* TCP_CONN_PARTS entries, cache line aligned */
+extern union tcpconn_part* tcpconn_parts;
+
+/* partition of an ip address */
+static inline unsigned tcp_ip_part(struct ip_addr* ip)
+{
+	unsigned h;
+
+	if (ip->len==16)
+		h=ip->u.addr32[0]^ip->u.addr32[1]^ip->u.addr32[2]^ip->u.addr32[3];
+	else
+		h=ip->u.addr32[0];
+	h ^= h>>16;
+	h ^= h>>8;
+	h ^= h>>4;
+	return h & TCP_CONN_PART_MASK;
+}
+
+/* partition of a connection id, of an id hash bucket or of an alias
+ * hash bucket */
+#define tcp_id_part(id) ((unsigned)(id) & TCP_CONN_PART_MASK)
+#define tcpconn_part(c) tcp_id_part((c)->id)
+
+static inline void tcpconn_part_lock(unsigned part)
+{
+	struct tcpconn_part_data* p;
+
+	p=&tcpconn_parts[part].p;
+	if (lock_try(&p->lock)!=0){
+		lock_get(&p->lock);
+		p->contended++;
+	}
+	p->locks++;
+}
+
+#define TCPCONN_LOCK(part) tcpconn_part_lock(part)
+#define TCPCONN_UNLOCK(part) lock_release(&tcpconn_parts[(part)].p.lock)
+
 /* hash (dst_ip, dst_port, local_ip, local_port) */
 static inline unsigned tcp_addr_hash(	struct ip_addr* ip, 
 										unsigned short port,
@@ -318,7 +386,9 @@ static inline unsigned tcp_addr_hash(	struct ip_addr* ip,
 	 *  32)*/
 	h ^= h>>17;
 	h ^= h>>7;
-	return h & (TCP_ALIAS_HASH_SIZE-1);
+	/* the lower bits select the peer ip partition */
+	return (h & (TCP_ALIAS_HASH_SIZE-1) & ~TCP_CONN_PART_MASK) |
+				tcp_ip_part(ip);
 }
 
 #define tcp_id_hash(id) (id&(TCP_ID_HASH_SIZE-1))
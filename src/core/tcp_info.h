@@ -26,6 +26,7 @@
 
 struct tcp_gen_info{
 	int tcp_readers;
+	int tcp_main_procs; /* number of tcp main processes */
 	int tcp_max_connections; /* startup connection limit, cannot be exceeded*/
 	int tls_max_connections; /* startup tls limit, cannot exceed tcp limit*/
 	int tcp_connections_no; /* crt. connections number */
@@ -45,6 +45,7 @@ struct tcp_child{
 	int busy;
 	struct socket_info *mysocket; /* listen socket to handle traffic on it */
 	int n_reqs; /* number of requests serviced so far */
+	int main_idx; /* tcp main process the reader belongs to */
 };
 
 #define TCP_ALIAS_FORCE_ADD 1
@@ -55,7 +56,7 @@ int init_tcp(void);
 void destroy_tcp(void);
 int tcp_init(struct socket_info* sock_info);
 int tcp_init_children(void);
-void tcp_main_loop(void);
+void tcp_main_loop(int idx);
 void tcp_receive_loop(int unix_sock);
 int tcp_fix_child_sockets(int* fd);
 
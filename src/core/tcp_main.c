@@ -58,6 +58,7 @@
 
 #include <errno.h>
 #include <string.h>
+#include <limits.h> /* INT_MAX */
 
 #ifdef HAVE_SELECT
 #include <sys/select.h>
@@ -157,6 +158,7 @@ static struct fd_cache_entry fd_cache[TCP_FD_CACHE_SIZE];
 #endif /* TCP_FD_CACHE */
 
 static int is_tcp_main=0;
+static int tcp_main_idx=0; /* index of this tcp main process */
 
 
 enum poll_types tcp_poll_method=0; /* by default choose the best method */
@@ -176,13 +178,15 @@ static int* tls_connections_no=0; /* current tls open connections */
 struct tcp_conn_alias** tcpconn_aliases_hash=0;
 /* connection hash table (after connection id) */
 struct tcp_connection** tcpconn_id_hash=0;
-gen_lock_t* tcpconn_lock=0;
+/* one lock per hashes partition (see TCP_CONN_PARTS) */
+union tcpconn_part* tcpconn_parts=0;
+static void* tcpconn_parts_mem=0; /* tcpconn_parts, before aligning */
 
 struct tcp_child* tcp_children=0;
-static int* connection_id=0; /*  unique for each connection, used for 
+static atomic_t* connection_id=0; /*  unique for each connection, used for 
 								quickly finding the corresponding connection
 								for a reply */
-int unix_tcp_sock;
+int unix_tcp_socks[TCP_MAIN_PROCS_MAX];
 
 static int tcp_proto_no=-1; /* tcp protocol number as returned by
 							   getprotobyname */
@@ -757,6 +761,63 @@ inline static void _wbufq_destroy( struct  tcp_wbuffer_queue* q)
 
 
 
+#ifdef TLS_HOOKS
+/* minimum size of the write buffers used for the tls batched data
+ * (one full tls record + overhead) */
+#define TCP_TLS_FLUSH_BLK_SIZE (16384+512)
+
+/* unsafe version, call while holding the connection write lock and only
+ * on an empty queue.
+ * Adds the data batched by the tls module (see tls_hooks.h flush), the
+ * tls records being written directly in the write buffers. Like
+ * _wbufq_insert() it ignores the max queue size checks (the clear text
+ * was already accepted).
+ * returns -1 on error, bytes queued on success (>=0) */
+inline static int _wbufq_tls_flush(struct tcp_connection* c)
+{
+	struct tcp_wbuffer_queue* q;
+	struct tcp_wbuffer* wb;
+	unsigned int wb_size;
+	int n;
+	int more;
+	int ret;
+
+	q=&c->wbuf_q;
+	ret=0;
+	do{
+		more=0;
+		wb_size=MAX_unsigned(cfg_get(tcp, tcp_cfg, wq_blk_size),
+								TCP_TLS_FLUSH_BLK_SIZE);
+		wb=shm_malloc(sizeof(*wb)+wb_size-1);
+		if (unlikely(wb==0))
+			return -1;
+		n=tls_flush(c, wb->buf, wb_size, &more);
+		if (unlikely(n<=0)){
+			shm_free(wb);
+			return (n<0)?-1:ret;
+		}
+		/* mark the block as full, the next add will use a new one */
+		wb->b_size=n;
+		wb->next=0;
+		if (q->last==0){
+			q->first=wb;
+			q->offset=0;
+			q->wr_timeout=get_ticks_raw()+cfg_get(tcp, tcp_cfg, send_timeout);
+		}else{
+			q->last->next=wb;
+		}
+		q->last=wb;
+		q->last_used=n;
+		q->queued+=n;
+		atomic_add_int((int*)tcp_total_wq, n);
+		ret+=n;
+	}while(more);
+	return ret;
+}
+#endif /* TLS_HOOKS */
+
+
+
 /* tries to empty the queue  (safe version, c->write_lock must not be hold)
  * returns -1 on error, bytes written on success (>=0) 
  * if the whole queue is emptied => sets *empty*/
@@ -773,6 +834,9 @@ inline static int wbufq_run(int fd, struct tcp_connection* c, int* empty)
 	ret=0;
 	lock_get(&c->write_lock);
 	q=&c->wbuf_q;
+#ifdef TLS_HOOKS
+again:
+#endif /* TLS_HOOKS */
 	while(q->first){
 		block_size=((q->first==q->last)?q->last_used:q->first->b_size)-
 						q->offset;
@@ -857,6 +921,17 @@ inline static int wbufq_run(int fd, struct tcp_connection* c, int* empty)
 		q->last=0;
 		q->last_used=0;
 		q->offset=0;
+#ifdef TLS_HOOKS
+		/* tls data batched while the queue was not empty */
+		if (unlikely(ret>=0 && (c->type==PROTO_TLS || c->type==PROTO_WSS))){
+			n=_wbufq_tls_flush(c);
+			if (unlikely(n<0))
+				ret=-1;
+			else if (n>0)
+				goto again;
+		}
+		if (likely(q->first==0))
+#endif /* TLS_HOOKS */
 		*empty=1;
 	}
 	lock_release(&c->write_lock);
@@ -952,6 +1027,7 @@ struct tcp_connection* tcpconn_new(int sock, union sockaddr_union* su,
 {
 	struct tcp_connection *c;
 	int rd_b_size;
+	int id;
 	
 	rd_b_size=cfg_get(tcp, tcp_cfg, rd_buf_size);
 	c=shm_malloc(sizeof(struct tcp_connection) + rd_b_size);
@@ -984,7 +1060,16 @@ struct tcp_connection* tcpconn_new(int sock, union sockaddr_union* su,
 	print_ip("tcpconn_new: new tcp connection: ", &c->rcv.src_ip, "\n");
 	LM_DBG("on port %d, type %d\n", c->rcv.src_port, type);
 	init_tcp_req(&c->req, (char*)c+sizeof(struct tcp_connection), rd_b_size);
-	c->id=(*connection_id)++;
+	/* the lower bits of the id are the hashes partition of the peer ip */
+	/* connections are created in parallel by all the tcp main processes
+	 * and by the workers (async connect), so the counter is atomic */
+	id=(atomic_add(connection_id, 1)-1) & (INT_MAX>>TCP_CONN_PART_BITS);
+	if (unlikely(id==0)) /* wrapped around, 0 is not a valid id */
+		id=(atomic_add(connection_id, 1)-1) & (INT_MAX>>TCP_CONN_PART_BITS);
+	c->id=(id<<TCP_CONN_PART_BITS) | tcp_ip_part(&c->rcv.src_ip);
+	/* accepted connections belong to the tcp main that accepted them,
+	 * the new outgoing ones are spread over all the tcp main processes */
+	c->main_idx=is_tcp_main?tcp_main_idx:(id % tcp_main_procs);
 	c->rcv.proto_reserved1=0; /* this will be filled before receive_message*/
 	c->rcv.proto_reserved2=0;
 	c->state=state;
@@ -1219,15 +1304,15 @@ int tcpconn_finish_connect( struct tcp_connection* c,
 	if (likely(from==0)){
 		new_conn_alias_flags=cfg_get(tcp, tcp_cfg, new_conn_alias_flags);
 		/* add aliases */
-		TCPCONN_LOCK;
+		TCPCONN_LOCK(tcpconn_part(c));
 		_tcpconn_add_alias_unsafe(c, c->rcv.src_port, &c->rcv.dst_ip, 0,
 													new_conn_alias_flags);
 		_tcpconn_add_alias_unsafe(c, c->rcv.src_port, &c->rcv.dst_ip,
 									c->rcv.dst_port, new_conn_alias_flags);
-		TCPCONN_UNLOCK;
+		TCPCONN_UNLOCK(tcpconn_part(c));
 	}else if (su_cmp(from, &local_addr)!=1){
 		new_conn_alias_flags=cfg_get(tcp, tcp_cfg, new_conn_alias_flags);
-		TCPCONN_LOCK;
+		TCPCONN_LOCK(tcpconn_part(c));
 			/* remove all the aliases except the first one and re-add them
 			 * (there shouldn't be more then the 3 default aliases at this 
 			 * stage) */
@@ -1244,7 +1329,7 @@ int tcpconn_finish_connect( struct tcp_connection* c,
 												0, new_conn_alias_flags);
 			_tcpconn_add_alias_unsafe(c, c->rcv.src_port, &c->rcv.dst_ip,
 									c->rcv.dst_port, new_conn_alias_flags);
-		TCPCONN_UNLOCK;
+		TCPCONN_UNLOCK(tcpconn_part(c));
 	}
 	
 	return s;
@@ -1265,7 +1350,7 @@ inline static struct tcp_connection*  tcpconn_add(struct tcp_connection *c)
 		c->id_hash=tcp_id_hash(c->id);
 		c->aliases=0;
 		new_conn_alias_flags=cfg_get(tcp, tcp_cfg, new_conn_alias_flags);
-		TCPCONN_LOCK;
+		TCPCONN_LOCK(tcpconn_part(c));
 		c->flags|=F_CONN_HASHED;
 		/* add it at the begining of the list*/
 		tcpconn_listadd(tcpconn_id_hash[c->id_hash], c, id_next, id_prev);
@@ -1287,7 +1372,7 @@ inline static struct tcp_connection*  tcpconn_add(struct tcp_connection *c)
 		/* ignore add_alias errors, there are some valid cases when one
 		 *  of the add_alias would fail (e.g. first add_alias for 2 connections
 		 *   with the same destination but different src. ip*/
-		TCPCONN_UNLOCK;
+		TCPCONN_UNLOCK(tcpconn_part(c));
 		LM_DBG("hashes: %d:%d:%d, %d\n",
 												c->con_aliases[0].hash,
 												c->con_aliases[1].hash,
@@ -1341,14 +1426,14 @@ void _tcpconn_rm(struct tcp_connection* c)
 void tcpconn_rm(struct tcp_connection* c)
 {
 	int r;
-	TCPCONN_LOCK;
+	TCPCONN_LOCK(tcpconn_part(c));
 	tcpconn_listrm(tcpconn_id_hash[c->id_hash], c, id_next, id_prev);
 	/* remove all the aliases */
 	for (r=0; r<c->aliases; r++)
 		tcpconn_listrm(tcpconn_aliases_hash[c->con_aliases[r].hash], 
 						&c->con_aliases[r], next, prev);
 	c->aliases = 0;
-	TCPCONN_UNLOCK;
+	TCPCONN_UNLOCK(tcpconn_part(c));
 	lock_destroy(&c->write_lock);
 #ifdef USE_TLS
 	if ((c->type==PROTO_TLS || c->type==PROTO_WSS)&&(c->extra_data)) tls_tcpconn_clean(c);
@@ -1421,8 +1506,15 @@ struct tcp_connection* tcpconn_get(int id, struct ip_addr* ip, int port,
 	struct tcp_connection* c;
 	struct ip_addr local_ip;
 	int local_port;
+	unsigned part;
 	
 	local_port=0;
+	part=0;
+	if (likely(id)){
+		part=tcp_id_part(id);
+	}else if (likely(ip)){
+		part=tcp_ip_part(ip);
+	}
 	if (likely(ip)){
 		if (unlikely(local_addr)){
 			su2ip_addr(&local_ip, local_addr);
@@ -1432,7 +1524,7 @@ struct tcp_connection* tcpconn_get(int id, struct ip_addr* ip, int port,
 			local_port=0;
 		}
 	}
-	TCPCONN_LOCK;
+	TCPCONN_LOCK(part);
 	c=_tcpconn_find(id, ip, port, &local_ip, local_port);
 	if (likely(c)){ 
 			atomic_inc(&c->refcnt);
@@ -1444,7 +1536,7 @@ struct tcp_connection* tcpconn_get(int id, struct ip_addr* ip, int port,
 			if (likely(c->reader_pid==0 && timeout != 0))
 				c->timeout=get_ticks_raw()+timeout;
 	}
-	TCPCONN_UNLOCK;
+	TCPCONN_UNLOCK(part);
 	return c;
 }
 
@@ -1456,7 +1548,9 @@ struct tcp_connection* tcpconn_get(int id, struct ip_addr* ip, int port,
  *                                new one
  * returns 0 on success, <0 on failure ( -1  - null c, -2 too many aliases,
  *  -3 alias already present and pointing to another connection)
- * WARNING: must be called with TCPCONN_LOCK held */
+ * WARNING: must be called with the TCPCONN_LOCK of the connection
+ *  partition held (an alias is always in the partition of its parent
+ *  connection peer ip, so the replaced aliases are in the same one) */
 inline static int _tcpconn_add_alias_unsafe(struct tcp_connection* c, int port,
 										struct ip_addr* l_ip, int l_port,
 										int flags)
@@ -1565,7 +1659,7 @@ int tcpconn_add_alias(int id, int port, int proto)
 	
 	/* fix the port */
 	port=port?port:((proto==PROTO_TLS)?SIPS_PORT:SIP_PORT);
-	TCPCONN_LOCK;
+	TCPCONN_LOCK(tcp_id_part(id));
 	/* check if alias already exists */
 	c=_tcpconn_find(id, 0, 0, 0, 0);
 	if (likely(c)){
@@ -1584,14 +1678,14 @@ int tcpconn_add_alias(int id, int port, int proto)
 										alias_flags);
 		if (unlikely(ret<0)) goto error;
 	}else goto error_not_found;
-	TCPCONN_UNLOCK;
+	TCPCONN_UNLOCK(tcp_id_part(id));
 	return 0;
 error_not_found:
-	TCPCONN_UNLOCK;
+	TCPCONN_UNLOCK(tcp_id_part(id));
 	LM_ERR("no connection found for id %d\n",id);
 	return -1;
 error:
-	TCPCONN_UNLOCK;
+	TCPCONN_UNLOCK(tcp_id_part(id));
 	switch(ret){
 		case -2:
 			LM_ERR("too many aliases (%d) for connection %p (id %d) %s:%d <- %d\n",
@@ -1925,7 +2019,7 @@ redo_tls_encode:
 			}
 			/* send to tcp_main */
 			response[0]=(long)c;
-			if (unlikely(send_fd(unix_tcp_sock, response,
+			if (unlikely(send_fd(tcpconn_main_sock(c), response,
 									sizeof(response), fd) <= 0)){
 				LM_ERR("%s: %ld for %p failed:" " %s (%d)\n",
 							su2a(&dst->to, sizeof(dst->to)),
@@ -1953,7 +2047,7 @@ redo_tls_encode:
 		/* send the new tcpconn to "tcp main" */
 		response[0]=(long)c;
 		response[1]=CONN_NEW;
-		n=send_fd(unix_tcp_sock, response, sizeof(response), c->s);
+		n=send_fd(tcpconn_main_sock(c), response, sizeof(response), c->s);
 		if (unlikely(n<=0)){
 			LM_ERR("%s: failed send_fd: %s (%d)\n",
 					su2a(&dst->to, sizeof(dst->to)),
@@ -2003,7 +2097,7 @@ redo_tls_encode:
 									&response[1], 0);
 		if (unlikely(response[1] != CONN_NOP)) {
 			response[0]=(long)c;
-			if (send_all(unix_tcp_sock, response, sizeof(response)) <= 0) {
+			if (send_all(tcpconn_main_sock(c), response, sizeof(response)) <= 0) {
 				BUG("tcp_main command %ld sending failed (write):"
 						"%s (%d)\n", response[1], strerror(errno), errno);
 				/* all commands != CONN_NOP returned by tcpconn_do_send()
@@ -2083,11 +2177,11 @@ conn_wait_close:
 	   remove it because it's marked as PENDing) and the refcnt is at least
 	   2
 	 */
-	TCPCONN_LOCK;
+	TCPCONN_LOCK(tcpconn_part(c));
 		_tcpconn_detach(c);
 		c->flags&=~F_CONN_HASHED;
 		tcpconn_put(c);
-	TCPCONN_UNLOCK;
+	TCPCONN_UNLOCK(tcpconn_part(c));
 	/* dec refcnt -> mark it for destruction */
 	tcpconn_chld_put(c);
 	return n;
@@ -2212,14 +2306,15 @@ static int tcpconn_send_put(struct tcp_connection* c, const char* buf,
 			/* get the fd */
 			response[0]=(long)c;
 			response[1]=CONN_GET_FD;
-			n=send_all(unix_tcp_sock, response, sizeof(response));
+			n=send_all(tcpconn_main_sock(c), response, sizeof(response));
 			if (unlikely(n<=0)){
 				LM_ERR("failed to get fd(write):%s (%d)\n", strerror(errno), errno);
 				n=-1;
 				goto release_c;
 			}
 			LM_DBG("c=%p, n=%d\n", c, n);
-			n=receive_fd(unix_tcp_sock, &tmp, sizeof(tmp), &fd, MSG_WAITALL);
+			n=receive_fd(tcpconn_main_sock(c), &tmp, sizeof(tmp), &fd,
+							MSG_WAITALL);
 			if (unlikely(n<=0)){
 				LM_ERR("failed to get fd(receive_fd): %s (%d)\n",
 						strerror(errno), errno);
@@ -2290,7 +2385,7 @@ static int tcpconn_send_put(struct tcp_connection* c, const char* buf,
 	if (unlikely(response[1] != CONN_NOP)) {
 error:
 		response[0]=(long)c;
-		if (send_all(unix_tcp_sock, response, sizeof(response)) <= 0) {
+		if (send_all(tcpconn_main_sock(c), response, sizeof(response)) <= 0) {
 			BUG("tcp_main command %ld sending failed (write):%s (%d)\n",
 					response[1], strerror(errno), errno);
 			/* all commands != CONN_NOP returned by tcpconn_do_send()
@@ -2376,7 +2471,7 @@ int tcpconn_send_unsafe(int fd, struct tcp_connection *c,
 		 */
 		atomic_inc(&c->refcnt);
 		response[0]=(long)c;
-		if (send_all(unix_tcp_sock, response, sizeof(response)) <= 0) {
+		if (send_all(tcpconn_main_sock(c), response, sizeof(response)) <= 0) {
 			BUG("connection %p command %ld sending failed (write):%s (%d)\n",
 					c, response[1], strerror(errno), errno);
 			/* send failed => deref. it back by hand */
@@ -2893,17 +2988,17 @@ inline static void tcpconn_destroy(struct tcp_connection* tcpconn)
 			/* try to continue */
 			if (likely(tcpconn->flags & F_CONN_MAIN_TIMER))
 				local_timer_del(&tcp_main_ltimer, &tcpconn->timer);
-			TCPCONN_LOCK;
+			TCPCONN_LOCK(tcpconn_part(tcpconn));
 				_tcpconn_detach(tcpconn);
 				tcpconn->flags &= ~(F_CONN_HASHED|F_CONN_MAIN_TIMER);
-			TCPCONN_UNLOCK;
+			TCPCONN_UNLOCK(tcpconn_part(tcpconn));
 		}
 		if (likely(!(tcpconn->flags & F_CONN_FD_CLOSED))){
 			tcpconn_close_main_fd(tcpconn);
 			tcpconn->flags|=F_CONN_FD_CLOSED;
-			(*tcp_connections_no)--;
+			atomic_add_int(tcp_connections_no, -1);
 			if (unlikely(tcpconn->type==PROTO_TLS || tcpconn->type==PROTO_WSS))
-				(*tls_connections_no)--;
+				atomic_add_int(tls_connections_no, -1);
 		}
 		_tcpconn_free(tcpconn); /* destroys also the wbuf_q if still present*/
 }
@@ -2933,10 +3028,10 @@ inline static int tcpconn_put_destroy(struct tcp_connection* tcpconn)
 			/* try to continue */
 			if (likely(tcpconn->flags & F_CONN_MAIN_TIMER))
 				local_timer_del(&tcp_main_ltimer, &tcpconn->timer);
-			TCPCONN_LOCK;
+			TCPCONN_LOCK(tcpconn_part(tcpconn));
 				_tcpconn_detach(tcpconn);
 				tcpconn->flags &= ~(F_CONN_HASHED|F_CONN_MAIN_TIMER);
-			TCPCONN_UNLOCK;
+			TCPCONN_UNLOCK(tcpconn_part(tcpconn));
 		}else{
 			LM_CRIT("%p flags = %0x\n", tcpconn, tcpconn->flags);
 		}
@@ -2948,9 +3043,9 @@ inline static int tcpconn_put_destroy(struct tcp_connection* tcpconn)
 	if (likely(!(tcpconn->flags & F_CONN_FD_CLOSED))){
 		tcpconn_close_main_fd(tcpconn);
 		tcpconn->flags|=F_CONN_FD_CLOSED;
-		(*tcp_connections_no)--;
+		atomic_add_int(tcp_connections_no, -1);
 		if (unlikely(tcpconn->type==PROTO_TLS || tcpconn->type==PROTO_WSS))
-				(*tls_connections_no)--;
+				atomic_add_int(tls_connections_no, -1);
 	}
 	/* all the flags / ops on the tcpconn must be done prior to decrementing
 	 * the refcnt. and at least a membar_write_atomic_op() mem. barrier or
@@ -2982,14 +3077,14 @@ inline static int tcpconn_try_unhash(struct tcp_connection* tcpconn)
 		}else
 			/* in case it's still in a reader timer */
 			tcpconn->timeout=get_ticks_raw();
-		TCPCONN_LOCK;
+		TCPCONN_LOCK(tcpconn_part(tcpconn));
 			if (tcpconn->flags & F_CONN_HASHED){
 				tcpconn->flags&=~F_CONN_HASHED;
 				_tcpconn_detach(tcpconn);
-				TCPCONN_UNLOCK;
+				TCPCONN_UNLOCK(tcpconn_part(tcpconn));
 			}else{
 				/* tcp_send was faster and did unhash it itself */
-				TCPCONN_UNLOCK;
+				TCPCONN_UNLOCK(tcpconn_part(tcpconn));
 				return 0;
 			}
 #ifdef TCP_ASYNC
@@ -3438,15 +3533,16 @@ inline static int handle_ser_child(struct process_table* p, int fd_i)
 #endif /* TCP_ASYNC */
 	
 	ret=-1;
-	if (unlikely(p->unix_sock<=0)){
+	if (unlikely(p->unix_sock[tcp_main_idx]<=0)){
 		/* (we can't have a fd==0, 0 is never closed )*/
-		LM_CRIT("fd %d for %d (pid %d)\n", p->unix_sock, (int)(p-&pt[0]), p->pid);
+		LM_CRIT("fd %d for %d (pid %d)\n", p->unix_sock[tcp_main_idx],
+					(int)(p-&pt[0]), p->pid);
 		goto error;
 	}
 			
 	/* get all bytes and the fd (if transmitted)
 	 * (this is a SOCK_STREAM so read is not atomic) */
-	bytes=receive_fd(p->unix_sock, response, sizeof(response), &fd,
+	bytes=receive_fd(p->unix_sock[tcp_main_idx], response, sizeof(response), &fd,
 						MSG_DONTWAIT);
 	if (unlikely(bytes<(int)sizeof(response))){
 		/* too few bytes read */
@@ -3455,7 +3551,7 @@ inline static int handle_ser_child(struct process_table* p, int fd_i)
 			LM_DBG("dead child %d, pid %d (shutting down?)\n",
 					(int)(p-&pt[0]), p->pid);
 			/* don't listen on it any more */
-			io_watch_del(&io_h, p->unix_sock, fd_i, 0);
+			io_watch_del(&io_h, p->unix_sock[tcp_main_idx], fd_i, 0);
 			goto error; /* child dead => no further io events from it */
 		}else if (bytes<0){
 			/* EAGAIN is ok if we try to empty the buffer
@@ -3530,16 +3626,18 @@ inline static int handle_ser_child(struct process_table* p, int fd_i)
 				   fd => don't try to send the fd (trying to send a
 				   closed fd _will_ fail) */
 				tmp = 0;
-				if (unlikely(send_all(p->unix_sock, &tmp, sizeof(tmp)) <= 0))
+				if (unlikely(send_all(p->unix_sock[tcp_main_idx], &tmp,
+										sizeof(tmp)) <= 0))
 					BUG("handle_ser_child: CONN_GET_FD: send_all failed\n");
 				/* no need to attempt to destroy the connection, it should
 				   be already in the process of being destroyed */
-			} else if (unlikely(send_fd(p->unix_sock, &tcpconn,
+			} else if (unlikely(send_fd(p->unix_sock[tcp_main_idx], &tcpconn,
 										sizeof(tcpconn), tcpconn->s)<=0)){
 				LM_ERR("CONN_GET_FD: send_fd failed\n");
 				/* try sending error (better then not sending anything) */
 				tmp = 0;
-				if (unlikely(send_all(p->unix_sock, &tmp, sizeof(tmp)) <= 0))
+				if (unlikely(send_all(p->unix_sock[tcp_main_idx], &tmp,
+										sizeof(tmp)) <= 0))
 					BUG("handle_ser_child: CONN_GET_FD:"
 							" send_fd send_all fallback failed\n");
 			}
@@ -3554,9 +3652,9 @@ inline static int handle_ser_child(struct process_table* p, int fd_i)
 				tcpconn_put_destroy(tcpconn);
 				break;
 			}
-			(*tcp_connections_no)++;
+			atomic_add_int(tcp_connections_no, 1);
 			if (unlikely(tcpconn->type==PROTO_TLS))
-				(*tls_connections_no)++;
+				atomic_add_int(tls_connections_no, 1);
 			tcpconn->s=fd;
 			/* add tcpconn to the list*/
 			tcpconn_add(tcpconn);
@@ -3679,9 +3777,9 @@ inline static int handle_ser_child(struct process_table* p, int fd_i)
 				tcpconn_put_destroy(tcpconn);
 				break;
 			}
-			(*tcp_connections_no)++;
+			atomic_add_int(tcp_connections_no, 1);
 			if (unlikely(tcpconn->type==PROTO_TLS))
-				(*tls_connections_no)++;
+				atomic_add_int(tls_connections_no, 1);
 			tcpconn->s=fd;
 			/* update the timeout*/
 			t=get_ticks_raw();
@@ -3757,12 +3855,14 @@ inline static int send2child(struct tcp_connection* tcpconn)
 	
 	if(likely(tcp_sockets_gworkers==0)) {
 		/* no child selection based on received socket
-		 * - use least loaded over all */
-		min_busy=tcp_children[0].busy;
-		idx=0;
+		 * - use least loaded over all (belonging to this tcp main) */
+		min_busy=INT_MAX;
+		idx=tcp_main_idx; /* the first reader of this tcp main */
 		last=crt+tcp_children_no;
 		for (; crt<last; crt++){
 			i=crt%tcp_children_no;
+			if (unlikely(tcp_children[i].main_idx!=tcp_main_idx))
+				continue;
 			if (!tcp_children[i].busy){
 				idx=i;
 				min_busy=0;
@@ -3792,9 +3892,13 @@ inline static int send2child(struct tcp_connection* tcpconn)
 					tcp_children[wlast-1].pid, tcp_children[wlast-1].proc_no,
 					(tcpconn->rcv.bind_address)?tcpconn->rcv.bind_address->sock_str.s:"");
 		}
-		idx = wfirst;
-		min_busy = tcp_children[idx].busy;
+		/* the readers of a group are assigned round robin to the tcp
+		 * main processes (see tcp_init_children()) */
+		idx = wfirst + tcp_main_idx;
+		min_busy = INT_MAX;
 		for(i=wfirst; i<wlast; i++) {
+			if (unlikely(tcp_children[i].main_idx!=tcp_main_idx))
+				continue;
 			if (!tcp_children[i].busy){
 				idx=i;
 				min_busy=0;
@@ -3921,9 +4025,9 @@ static inline int handle_new_connect(struct socket_info* si)
 		tcp_safe_close(new_sock);
 		return 1; /* success, because the accept was succesfull */
 	}
-	(*tcp_connections_no)++;
+	atomic_add_int(tcp_connections_no, 1);
 	if (unlikely(si->proto==PROTO_TLS))
-		(*tls_connections_no)++;
+		atomic_add_int(tls_connections_no, 1);
 	/* stats for established connections are incremented after
 	   the first received or sent packet.
 	   Alternatively they could be incremented here for accepted
@@ -3984,9 +4088,9 @@ static inline int handle_new_connect(struct socket_info* si)
 	}else{ /*tcpconn==0 */
 		LM_ERR("tcpconn_new failed, closing socket\n");
 		tcp_safe_close(new_sock);
-		(*tcp_connections_no)--;
+		atomic_add_int(tcp_connections_no, -1);
 		if (unlikely(si->proto==PROTO_TLS))
-			(*tls_connections_no)--;
+			atomic_add_int(tls_connections_no, -1);
 	}
 	return 1; /* accept() was succesfull */
 }
@@ -4283,9 +4387,9 @@ static ticks_t tcpconn_main_timeout(ticks_t t, struct timer_ln* tl, void* data)
 	if (likely(c->flags & F_CONN_HASHED)){
 		c->flags&=~(F_CONN_HASHED|F_CONN_MAIN_TIMER);
 		c->state=S_CONN_BAD;
-		TCPCONN_LOCK;
+		TCPCONN_LOCK(tcpconn_part(c));
 			_tcpconn_detach(c);
-		TCPCONN_UNLOCK;
+		TCPCONN_UNLOCK(tcpconn_part(c));
 	}else{
 		c->flags&=~F_CONN_MAIN_TIMER;
 		LM_CRIT("timer: called with unhashed connection %p\n", c);
@@ -4329,8 +4433,8 @@ static inline void tcpconn_destroy_all(void)
 	int fd;
 	
 	
-	TCPCONN_LOCK; 
 	for(h=0; h<TCP_ID_HASH_SIZE; h++){
+		TCPCONN_LOCK(tcp_id_part(h));
 		c=tcpconn_id_hash[h];
 		while(c){
 			next=c->id_next;
@@ -4353,9 +4457,9 @@ static inline void tcpconn_destroy_all(void)
 				if (fd>0 && (c->type==PROTO_TLS || c->type==PROTO_WSS))
 					tls_close(c, fd);
 				if (unlikely(c->type==PROTO_TLS || c->type==PROTO_WSS))
-					(*tls_connections_no)--;
+					atomic_add_int(tls_connections_no, -1);
 #endif
-				(*tcp_connections_no)--;
+				atomic_add_int(tcp_connections_no, -1);
 				c->flags &= ~F_CONN_HASHED;
 				_tcpconn_rm(c);
 				if (fd>0) {
@@ -4367,20 +4471,40 @@ static inline void tcpconn_destroy_all(void)
 				}
 			c=next;
 		}
+		TCPCONN_UNLOCK(tcp_id_part(h));
 	}
-	TCPCONN_UNLOCK;
 }
 
 
 
 /* tcp main loop */
-void tcp_main_loop()
+/* idx - index of the tcp main process, from 0 to tcp_main_procs-1
+ * Each tcp main process watches all the listen sockets (the accept() is
+ * non-blocking, so they just compete for the new connections), but only
+ * its own unix sockets to the other processes and its own tcp readers and
+ * it handles only the connections it owns (tcp_connection->main_idx) */
+void tcp_main_loop(int idx)
 {
 
 	struct socket_info* si;
 	int r;
+	int i;
 	
 	is_tcp_main=1; /* mark this process as tcp main */
+	tcp_main_idx=idx;
+	/* close the unix sockets used by the other tcp main processes */
+	for (r=1; r<process_no; r++){
+		for (i=0; i<tcp_main_procs; i++){
+			if (i!=idx && pt[r].unix_sock[i]>0)
+				close(pt[r].unix_sock[i]); /* pt[] is shared, only close */
+		}
+	}
+	for (r=0; r<tcp_children_no; r++){
+		if (tcp_children[r].main_idx!=idx && tcp_children[r].unix_sock>0){
+			close(tcp_children[r].unix_sock);
+			tcp_children[r].unix_sock=-1; /* per process copy */
+		}
+	}
 	
 	tcp_main_max_fd_no=get_max_open_fds();
 	/* init send fd queues (here because we want mem. alloc only in the tcp
@@ -4435,14 +4559,17 @@ void tcp_main_loop()
 	/* add all the unix sockets used for communcation with other ser processes
 	 *  (get fd, new connection a.s.o) */
 	for (r=1; r<process_no; r++){
-		if (pt[r].unix_sock>0) /* we can't have 0, we never close it!*/
-			if (io_watch_add(&io_h, pt[r].unix_sock, POLLIN,F_PROC, &pt[r])<0){
+		if (pt[r].unix_sock[idx]>0) /* we can't have 0, we never close it!*/
+			if (io_watch_add(&io_h, pt[r].unix_sock[idx], POLLIN, F_PROC,
+								&pt[r])<0){
 					LM_CRIT("failed to add process %d unix socket to the fd list\n", r);
 					goto error;
 			}
 	}
 	/* add all the unix sokets used for communication with the tcp childs */
 	for (r=0; r<tcp_children_no; r++){
+		if (tcp_children[r].main_idx!=idx)
+			continue;
 		if (tcp_children[r].unix_sock>0)/*we can't have 0, we never close it!*/
 			if (io_watch_add(&io_h, tcp_children[r].unix_sock, POLLIN,
 									F_TCPCHILD, &tcp_children[r]) <0){
@@ -4517,6 +4644,15 @@ void tcp_main_loop()
 				tcp_timer_run();
 			}
 			break;
+#endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			while(1){
+				io_wait_loop_uring(&io_h, TCP_MAIN_SELECT_TIMEOUT, 0);
+				send_fd_queue_run(&send2child_q); /* then new io */
+				tcp_timer_run();
+			}
+			break;
 #endif
 		default:
 			LM_CRIT("no support for poll method %s (%d)\n", 
@@ -4537,12 +4673,15 @@ error:
 /* cleanup before exit */
 void destroy_tcp()
 {
+		int r;
+
 		if (tcpconn_id_hash){
-			if (tcpconn_lock)
-				TCPCONN_UNLOCK; /* hack: force-unlock the tcp lock in case
-								   some process was terminated while holding 
-								   it; this will allow an almost gracious 
-								   shutdown */
+			if (tcpconn_parts)
+				for (r=0; r<TCP_CONN_PARTS; r++)
+					TCPCONN_UNLOCK(r); /* hack: force-unlock the tcp locks in
+									  case some process was terminated while
+									  holding one; this will allow an almost
+									  gracious shutdown */
 			tcpconn_destroy_all(); 
 			shm_free(tcpconn_id_hash);
 			tcpconn_id_hash=0;
@@ -4570,10 +4709,12 @@ void destroy_tcp()
 			shm_free(tcpconn_aliases_hash);
 			tcpconn_aliases_hash=0;
 		}
-		if (tcpconn_lock){
-			lock_destroy(tcpconn_lock);
-			lock_dealloc((void*)tcpconn_lock);
-			tcpconn_lock=0;
+		if (tcpconn_parts){
+			for (r=0; r<TCP_CONN_PARTS; r++)
+				lock_destroy(&tcpconn_parts[r].p.lock);
+			shm_free(tcpconn_parts_mem);
+			tcpconn_parts_mem=0;
+			tcpconn_parts=0;
 		}
 		if (tcp_children){
 			pkg_free(tcp_children);
@@ -4587,23 +4728,35 @@ void destroy_tcp()
 int init_tcp()
 {
 	char* poll_err;
+	int r;
 	
 	tcp_options_check();
 	if (tcp_cfg==0){
 		BUG("tcp_cfg not initialized\n");
 		goto error;
 	}
-	/* init lock */
-	tcpconn_lock=lock_alloc();
-	if (tcpconn_lock==0){
-		LM_CRIT("could not alloc lock\n");
+	/* init the hashes partitions locks (shm_malloc() does not align to
+	 * a cache line, so allocate one more entry and align by hand) */
+	tcpconn_parts_mem=shm_malloc((TCP_CONN_PARTS+1) *
+								sizeof(union tcpconn_part));
+	if (tcpconn_parts_mem==0){
+		LM_CRIT("could not alloc the partitions locks\n");
 		goto error;
 	}
-	if (lock_init(tcpconn_lock)==0){
-		LM_CRIT("could not init lock\n");
-		lock_dealloc((void*)tcpconn_lock);
-		tcpconn_lock=0;
-		goto error;
+	memset(tcpconn_parts_mem, 0,
+			(TCP_CONN_PARTS+1) * sizeof(union tcpconn_part));
+	tcpconn_parts=(union tcpconn_part*)(((unsigned long)tcpconn_parts_mem +
+					TCP_CONN_PART_ALIGN-1) & ~(TCP_CONN_PART_ALIGN-1UL));
+	for (r=0; r<TCP_CONN_PARTS; r++){
+		if (lock_init(&tcpconn_parts[r].p.lock)==0){
+			LM_CRIT("could not init the partitions locks\n");
+			while (--r>=0)
+				lock_destroy(&tcpconn_parts[r].p.lock);
+			shm_free(tcpconn_parts_mem);
+			tcpconn_parts_mem=0;
+			tcpconn_parts=0;
+			goto error;
+		}
 	}
 	/* init globals */
 	tcp_connections_no=shm_malloc(sizeof(int));
@@ -4619,12 +4772,12 @@ int init_tcp()
 	}
 	*tls_connections_no=0;
 	if (INIT_TCP_STATS()!=0) goto error;
-	connection_id=shm_malloc(sizeof(int));
+	connection_id=shm_malloc(sizeof(atomic_t));
 	if (connection_id==0){
 		LM_CRIT("could not alloc globals\n");
 		goto error;
 	}
-	*connection_id=1;
+	atomic_set(connection_id, 1);
 #ifdef TCP_ASYNC
 	tcp_total_wq=shm_malloc(sizeof(*tcp_total_wq));
 	if (tcp_total_wq==0){
@@ -4733,7 +4886,8 @@ int tcp_init_children()
 		for (si=tls_listen; si; si=si->next, r++);
 #endif
 	
-	register_fds(r+tcp_max_connections+get_max_procs()-1 /* tcp main */);
+	register_fds(r+tcp_max_connections+
+			tcp_main_procs*get_max_procs()-1 /* tcp main */);
 #if 0
 	tcp_max_fd_no=get_max_procs()*2 +r-1 /* timer */ +3; /* stdin/out/err*/
 	/* max connections can be temporarily exceeded with estimated_process_count
@@ -4773,6 +4927,12 @@ int tcp_init_children()
 	}
 #endif
 	tcp_sockets_gworkers = (i != tcp_children_no-1)?(1 + i + 1):0;
+	/* split the readers of each group round robin between the tcp main
+	 * processes (calc_proc_no() makes sure each group has enough) */
+	for(r=0; r<tcp_children_no; r++){
+		si=tcp_children[r].mysocket;
+		tcp_children[r].main_idx=(si?(r-si->workers_tcpidx):r)%tcp_main_procs;
+	}
 
 	/* create the tcp sock_info structures */
 	/* copy the sockets --moved to main_loop*/
@@ -4806,6 +4966,7 @@ error:
 void tcp_get_info(struct tcp_gen_info *ti)
 {
 	ti->tcp_readers=tcp_children_no;
+	ti->tcp_main_procs=tcp_main_procs;
 	ti->tcp_max_connections=tcp_max_connections;
 	ti->tls_max_connections=tls_max_connections;
 	ti->tcp_connections_no=*tcp_connections_no;
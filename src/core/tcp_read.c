@@ -1812,6 +1812,14 @@ void tcp_receive_loop(int unix_sock)
 				tcp_reader_timer_run();
 			}
 			break;
+#endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			while(1){
+				io_wait_loop_uring(&io_w, TCP_CHILD_SELECT_TIMEOUT, 0);
+				tcp_reader_timer_run();
+			}
+			break;
 #endif
 		default:
 			LM_CRIT("no support for poll method %s (%d)\n", 
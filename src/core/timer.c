@@ -49,6 +49,7 @@
 #include "locking.h"
 #include "sched_yield.h"
 #include "cfg/cfg_struct.h"
+#include "udp_server.h"
 
 
 /* how often will the timer handler be called (in ticks) */
@@ -975,7 +976,9 @@ void timer_main()
 			/* update the local cfg if needed */
 			cfg_update();
 
+			udp_send_batch_start();
 			timer_handler();
+			udp_send_batch_end();
 		}
 		pause();
 	}
@@ -1115,6 +1118,7 @@ void slow_timer_main()
 		/* update the local cfg if needed */
 		cfg_update();
 
+		udp_send_batch_start();
 		LOCK_SLOW_TIMER_LIST();
 		while(*s_idx!=*t_idx){
 			i= *s_idx%SLOW_LISTS_NO;
@@ -1150,6 +1154,7 @@ void slow_timer_main()
 			(*s_idx)++;
 		}
 		UNLOCK_SLOW_TIMER_LIST();
+		udp_send_batch_end();
 	}
 
 }
@@ -76,6 +76,17 @@ struct tls_hooks{
 	/* generic pre-init function (called at kamailio start, before module
 	 * initialization (after modparams) */
 	int (*pre_init)(void);
+	/* process the data batched by encode() (encode can keep the data
+	   instead of processing it right away when the tcp write queue is not
+	   empty, returning *plen == 0) and write the tls records directly
+	   in buf (size bytes). Called with c->write_lock held, each time the
+	   tcp write queue has been emptied.
+	   Should return the number of bytes written in buf (>=0) and set *more
+	   if there is still batched data left (buf was too small).
+	   If it returns < 0 => error (tcp connection will be closed).
+	*/
+	int (*flush)(struct tcp_connection* c, char* buf, unsigned int size,
+					int* more);
 };
 
 
@@ -105,6 +116,8 @@ extern struct tls_hooks tls_hook;
 	tls_hook_call(encode, -1, (c), (pbuf), (plen), (rbuf), (rlen), (sflags))
 #define tls_close(conn, fd)		tls_hook_call_v(tcpconn_close, (conn), (fd))
 #define tls_read(c, flags)				tls_hook_call(read, -1, (c), (flags))
+#define tls_flush(c, buf, size, more) \
+	tls_hook_call(flush, 0, (c), (buf), (size), (more))
 
 int register_tls_hooks(struct tls_hooks* h);
 
@@ -26,6 +26,12 @@
  * Module: @ref core
  */
 
+#ifdef __OS_linux
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg(), struct mmsghdr, cpu sets */
+#endif
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -38,6 +44,9 @@
 #ifdef __linux__
 	#include <linux/types.h>
 	#include <linux/errqueue.h>
+	#include <linux/filter.h>
+	#include <sched.h>
+	#include <unistd.h>
 #endif
 
 
@@ -52,6 +61,7 @@
 #include "cfg/cfg_struct.h"
 #include "events.h"
 #include "stun.h"
+#include "counters.h"
 #ifdef USE_RAW_SOCKS
 #include "raw_sock.h"
 #endif /* USE_RAW_SOCKS */
@@ -126,6 +136,11 @@ qa_passed:
 #endif
 
 
+/* socket read by this udp worker (differs from bind_address->socket only
+ * with udp_reuseport) */
+static int udp_rcv_sock = -1;
+
+
 int probe_max_receive_buffer( int udp_sock )
 {
 	int optval;
@@ -270,10 +285,14 @@ static int setup_mcast_rcvr(int sock, union sockaddr_union* addr, char* interfac
 #endif /* USE_MCAST */
 
 
-int udp_init(struct socket_info* sock_info)
+/** creates and binds an udp socket for sock_info.
+ * @return socket fd on success, -1 on error.
+ */
+static int udp_sock_init(struct socket_info* sock_info)
 {
 	union sockaddr_union* addr;
 	int optval;
+	int s;
 #ifdef USE_MCAST
 	unsigned char m_ttl, m_loop;
 #endif
@@ -285,34 +304,45 @@ int udp_init(struct socket_info* sock_info)
 		goto error;
 	}
 */
+	s=-1;
 	sock_info->proto=PROTO_UDP;
 	if (init_su(addr, &sock_info->address, sock_info->port_no)<0){
 		LM_ERR("could not init sockaddr_union\n");
 		goto error;
 	}
 
-	sock_info->socket = socket(AF2PF(addr->s.sa_family), SOCK_DGRAM, 0);
-	if (sock_info->socket==-1){
+	s = socket(AF2PF(addr->s.sa_family), SOCK_DGRAM, 0);
+	if (s==-1){
 		LM_ERR("socket: %s\n", strerror(errno));
 		goto error;
 	}
 	/* set sock opts? */
 	optval=1;
-	if (setsockopt(sock_info->socket, SOL_SOCKET, SO_REUSEADDR ,
+	if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR ,
 					(void*)&optval, sizeof(optval)) ==-1){
 		LM_ERR("setsockopt: %s\n", strerror(errno));
 		goto error;
 	}
+#ifdef SO_REUSEPORT
+	if (udp_reuseport && !(sock_info->flags & SI_IS_MCAST)) {
+		optval=1;
+		if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT,
+						(void*)&optval, sizeof(optval)) ==-1){
+			LM_ERR("setsockopt(SO_REUSEPORT): %s\n", strerror(errno));
+			goto error;
+		}
+	}
+#endif /* SO_REUSEPORT */
 	/* tos */
 	optval = tos;
 	if (addr->s.sa_family==AF_INET){
-		if (setsockopt(sock_info->socket, IPPROTO_IP, IP_TOS, (void*)&optval,
+		if (setsockopt(s, IPPROTO_IP, IP_TOS, (void*)&optval,
 				sizeof(optval)) ==-1){
 			LM_WARN("setsockopt tos: %s\n", strerror(errno));
 			/* continue since this is not critical */
 		}
 	} else if (addr->s.sa_family==AF_INET6){
-		if (setsockopt(sock_info->socket, IPPROTO_IPV6, IPV6_TCLASS,
+		if (setsockopt(s, IPPROTO_IPV6, IPV6_TCLASS,
 					(void*)&optval, sizeof(optval)) ==-1) {
 			LM_WARN("setsockopt v6 tos: %s\n", strerror(errno));
 			/* continue since this is not critical */
@@ -322,7 +352,7 @@ int udp_init(struct socket_info* sock_info)
 #if defined (__OS_linux) && defined(UDP_ERRORS)
 	optval=1;
 	/* enable error receiving on unconnected sockets */
-	if(setsockopt(sock_info->socket, SOL_IP, IP_RECVERR,
+	if(setsockopt(s, SOL_IP, IP_RECVERR,
 					(void*)&optval, sizeof(optval)) ==-1){
 		LM_ERR("setsockopt: %s\n", strerror(errno));
 		goto error;
@@ -332,7 +362,7 @@ int udp_init(struct socket_info* sock_info)
 	/* if pmtu_discovery=1 then set DF bit and do Path MTU discovery
 	 * disabled by default */
 	optval= (pmtu_discovery) ? IP_PMTUDISC_DO : IP_PMTUDISC_DONT;
-	if(setsockopt(sock_info->socket, IPPROTO_IP, IP_MTU_DISCOVER,
+	if(setsockopt(s, IPPROTO_IP, IP_MTU_DISCOVER,
 			(void*)&optval, sizeof(optval)) ==-1){
 		LM_ERR("setsockopt: %s\n", strerror(errno));
 		goto error;
@@ -341,13 +371,13 @@ int udp_init(struct socket_info* sock_info)
 
 #ifdef USE_MCAST
 	if ((sock_info->flags & SI_IS_MCAST)
-	    && (setup_mcast_rcvr(sock_info->socket, addr, sock_info->mcast.s)<0)){
+	    && (setup_mcast_rcvr(s, addr, sock_info->mcast.s)<0)){
 			goto error;
 	}
 	/* set the multicast options */
 	if (addr->s.sa_family==AF_INET){
 		m_loop=mcast_loopback;
-		if (setsockopt(sock_info->socket, IPPROTO_IP, IP_MULTICAST_LOOP,
+		if (setsockopt(s, IPPROTO_IP, IP_MULTICAST_LOOP,
 						&m_loop, sizeof(m_loop))==-1){
 			LM_WARN("setsockopt(IP_MULTICAST_LOOP): %s\n", strerror(errno));
 			/* it's only a warning because we might get this error if the
@@ -355,18 +385,18 @@ int udp_init(struct socket_info* sock_info)
 		}
 		if (mcast_ttl>=0){
 			m_ttl=mcast_ttl;
-			if (setsockopt(sock_info->socket, IPPROTO_IP, IP_MULTICAST_TTL,
+			if (setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL,
 						&m_ttl, sizeof(m_ttl))==-1){
 				LM_WARN("setsockopt (IP_MULTICAST_TTL): %s\n", strerror(errno));
 			}
 		}
 	} else if (addr->s.sa_family==AF_INET6){
-		if (setsockopt(sock_info->socket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP,
+		if (setsockopt(s, IPPROTO_IPV6, IPV6_MULTICAST_LOOP,
 						&mcast_loopback, sizeof(mcast_loopback))==-1){
 			LM_WARN("setsockopt (IPV6_MULTICAST_LOOP): %s\n", strerror(errno));
 		}
 		if (mcast_ttl>=0){
-			if (setsockopt(sock_info->socket, IPPROTO_IP, IPV6_MULTICAST_HOPS,
+			if (setsockopt(s, IPPROTO_IP, IPV6_MULTICAST_HOPS,
 							&mcast_ttl, sizeof(mcast_ttl))==-1){
 				LM_WARN("setssckopt (IPV6_MULTICAST_HOPS): %s\n", strerror(errno));
 			}
@@ -377,11 +407,11 @@ int udp_init(struct socket_info* sock_info)
 	}
 #endif /* USE_MCAST */
 
-	if ( probe_max_receive_buffer(sock_info->socket)==-1) goto error;
+	if ( probe_max_receive_buffer(s)==-1) goto error;
 
-	if (bind(sock_info->socket,  &addr->s, sockaddru_len(*addr))==-1){
+	if (bind(s,  &addr->s, sockaddru_len(*addr))==-1){
 		LM_ERR("bind(%x, %p, %d) on %s: %s\n",
-				sock_info->socket, &addr->s,
+				s, &addr->s,
 				(unsigned)sockaddru_len(*addr),
 				sock_info->address_str.s,
 				strerror(errno));
@@ -391,12 +421,384 @@ int udp_init(struct socket_info* sock_info)
 	}
 
 /*	pkg_free(addr);*/
-	return 0;
+	return s;
 
 error:
 /*	if (addr) pkg_free(addr);*/
+	if (s!=-1) close(s);
+	return -1;
+}
+
+
+int udp_init(struct socket_info* sock_info)
+{
+	int s;
+
+	s=udp_sock_init(sock_info);
+	if (s==-1)
+		return -1;
+	sock_info->socket=s;
+	return 0;
+}
+
+
+
+#if defined (__OS_linux) && defined(SO_ATTACH_REUSEPORT_CBPF)
+/** attaches a cbpf program to the reuseport group of sock, delivering the
+ * packets processed by the kernel on cpu c to the socket with index
+ * c % sockets_no (the socket of the worker pinned on that cpu).
+ */
+static int udp_reuseport_attach_cpu_steering(int sock, int sockets_no)
+{
+	struct sock_filter code[] = {
+		/* A = current cpu */
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		/* A = A % sockets_no */
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, sockets_no },
+		/* return A (socket index inside the group) */
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog;
+
+	prog.len=sizeof(code)/sizeof(code[0]);
+	prog.filter=code;
+	if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+					(void*)&prog, sizeof(prog)) ==-1){
+		LM_ERR("setsockopt(SO_ATTACH_REUSEPORT_CBPF): %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+
+
+/** opens one SO_REUSEPORT udp socket per worker for sock_info.
+ * The first one is the socket created by udp_init() (used also for
+ * sending), the others are bound to the same address in the same order as
+ * the workers will be forked, so that the socket index in the kernel
+ * reuseport group matches the worker rank.
+ * Must be called in the main process, after udp_init() and before forking.
+ * @return 0 on success, -1 on error.
+ */
+int udp_reuseport_init(struct socket_info* sock_info, int workers)
+{
+#ifdef SO_REUSEPORT
+	int i;
+#if defined (__OS_linux) && defined(SO_ATTACH_REUSEPORT_CBPF)
+	long cpus;
+#endif
+
+	if (!udp_reuseport || workers<=1 || (sock_info->flags & SI_IS_MCAST))
+		return 0;
+	sock_info->rp_sockets=(int*)pkg_malloc(workers * sizeof(int));
+	if (sock_info->rp_sockets==0){
+		LM_ERR("out of memory\n");
+		return -1;
+	}
+	sock_info->rp_sockets[0]=sock_info->socket;
+	for(i=1; i<workers; i++){
+		sock_info->rp_sockets[i]=udp_sock_init(sock_info);
+		if (sock_info->rp_sockets[i]==-1){
+			LM_ERR("failed to create reuseport socket %d for %s\n",
+					i, sock_info->sock_str.s);
+			goto error;
+		}
+	}
+	sock_info->rp_sockets_no=workers;
+	if (udp_cpu_affinity){
+#if defined (__OS_linux) && defined(SO_ATTACH_REUSEPORT_CBPF)
+		cpus=sysconf(_SC_NPROCESSORS_ONLN);
+		if (cpus>0 && workers>cpus){
+			LM_WARN("more udp workers (%d) than cpus (%ld) for %s -"
+					" using the default reuseport distribution\n",
+					workers, cpus, sock_info->sock_str.s);
+		} else if (udp_reuseport_attach_cpu_steering(sock_info->socket,
+						workers)<0){
+			LM_WARN("cpu steering not available for %s -"
+					" using the default reuseport distribution\n",
+					sock_info->sock_str.s);
+		}
+#endif
+	}
+	return 0;
+error:
+	for(i--; i>0; i--)
+		close(sock_info->rp_sockets[i]);
+	pkg_free(sock_info->rp_sockets);
+	sock_info->rp_sockets=0;
+	return -1;
+#else
+	LM_WARN("SO_REUSEPORT not supported - udp workers of %s will share"
+			" one socket\n", sock_info->sock_str.s);
+	return 0;
+#endif /* SO_REUSEPORT */
+}
+
+
+
+/** selects the receive socket of an udp worker and pins the process to
+ * the cpus c with c % workers == rank (the cpus steered to its socket),
+ * or to cpu rank % cpus if there is none, when udp_cpu_affinity is set.
+ * Must be called in the worker process, before udp_rcv_loop().
+ * @param rank - worker index for bind_address (0 .. workers-1).
+ */
+void udp_reuseport_child_init(struct socket_info* sock_info, int rank)
+{
+#ifdef __OS_linux
+	cpu_set_t cpus;
+	long cpus_no;
+	int workers;
+	int c;
+	int n;
+#endif
+
+	if (sock_info->rp_sockets && rank<sock_info->rp_sockets_no)
+		udp_rcv_sock=sock_info->rp_sockets[rank];
+#ifdef __OS_linux
+	if (udp_cpu_affinity){
+		cpus_no=sysconf(_SC_NPROCESSORS_ONLN);
+		if (cpus_no<=0)
+			return;
+		CPU_ZERO(&cpus);
+		n=0;
+		workers=sock_info->rp_sockets?sock_info->rp_sockets_no:0;
+		if (workers>1 && workers<=cpus_no){
+			/* the same mapping as the steering program */
+			for(c=0; c<cpus_no && c<CPU_SETSIZE; c++){
+				if (c % workers==rank){
+					CPU_SET(c, &cpus);
+					n++;
+				}
+			}
+		}
+		if (n==0)
+			CPU_SET(rank % cpus_no, &cpus);
+		if (sched_setaffinity(0, sizeof(cpus), &cpus)==-1){
+			LM_WARN("failed to set cpu affinity of worker %d: %s\n",
+					rank, strerror(errno));
+		}
+	}
+#endif
+}
+
+
+
+#ifdef HAVE_RECVMMSG
+
+/* udp receive batching counters */
+struct udp_rcv_batch_counters_h {
+	counter_handle_t calls;
+	counter_handle_t msgs;
+};
+
+static struct udp_rcv_batch_counters_h udp_rcv_batch_cnts_h;
+
+static counter_val_t udp_rcv_batch_avg_fill(counter_handle_t h, void* param);
+
+static counter_def_t udp_rcv_batch_cnt_defs[] =  {
+	{&udp_rcv_batch_cnts_h.calls, "rcv_batch_calls", 0, 0, 0,
+		"number of recvmmsg() calls that returned at least one datagram."},
+	{&udp_rcv_batch_cnts_h.msgs, "rcv_batch_msgs", 0, 0, 0,
+		"number of datagrams received through recvmmsg()."},
+	{0, "rcv_batch_avg_fill", 0, udp_rcv_batch_avg_fill, 0,
+		"average number of datagrams received per recvmmsg() call."},
+	{0, 0, 0, 0, 0, 0 }
+};
+
+
+/** computes the average batch fill (received datagrams per recvmmsg()).
+ */
+static counter_val_t udp_rcv_batch_avg_fill(counter_handle_t h, void* param)
+{
+	counter_val_t calls;
+
+	calls = counter_get_val(udp_rcv_batch_cnts_h.calls);
+	if (calls == 0)
+		return 0;
+	return counter_get_val(udp_rcv_batch_cnts_h.msgs) / calls;
+}
+
+#endif /* HAVE_RECVMMSG */
+
+
+/** checks the udp_receive_batch value and registers the batching counters.
+ * Must be called after parsing the config and before forking.
+ * @return 0 on success, -1 on error.
+ */
+int udp_rcv_batch_init(void)
+{
+	if (udp_rcv_batch <= 1) {
+		udp_rcv_batch = 0;
+		return 0;
+	}
+#if !defined HAVE_RECVMMSG || defined DYN_BUF
+	LM_WARN("udp_receive_batch is not supported by this build"
+			" - using one recvfrom() per datagram\n");
+	udp_rcv_batch = 0;
+	return 0;
+#else
+	if (udp_rcv_batch > UDP_RCV_BATCH_MAX) {
+		LM_WARN("udp_receive_batch too big (%d), using %d\n",
+				udp_rcv_batch, UDP_RCV_BATCH_MAX);
+		udp_rcv_batch = UDP_RCV_BATCH_MAX;
+	}
+	if (counter_register_array("udp", udp_rcv_batch_cnt_defs) < 0) {
+		LM_ERR("failed to register the udp receive batch counters\n");
+		return -1;
+	}
+	return 0;
+#endif
+}
+
+
+
+/** processes a received datagram (common part of the receive loops).
+ * buf must have space for one more char (it will be 0-terminated).
+ */
+static inline void udp_rcv_msg(char* buf, unsigned len,
+		union sockaddr_union* from, struct receive_info* ri)
+{
+	char *tmp;
+
+	/* we must 0-term the messages, receive_msg expects it */
+	buf[len]=0; /* no need to save the previous char */
+
+	ri->src_su=*from;
+	su2ip_addr(&ri->src_ip, from);
+	ri->src_port=su_getport(from);
+
+	if(unlikely(sr_event_enabled(SREV_NET_DGRAM_IN)))
+	{
+		void *sredp[3];
+		sredp[0] = (void*)buf;
+		sredp[1] = (void*)(&len);
+		sredp[2] = (void*)ri;
+		if(sr_event_exec(SREV_NET_DGRAM_IN, (void*)sredp)<0) {
+			/* data handled by callback - continue to next packet */
+			return;
+		}
+	}
+#ifndef NO_ZERO_CHECKS
+	if (!unlikely(sr_event_enabled(SREV_STUN_IN)) || (unsigned char)*buf != 0x00) {
+		if (len<MIN_UDP_PACKET) {
+			tmp=ip_addr2a(&ri->src_ip);
+			LM_DBG("probing packet received from %s %d\n", tmp, htons(ri->src_port));
+			return;
+		}
+	}
+/* historically, zero-terminated packets indicated a bug in clients
+ * that calculated wrongly packet length and included string-terminating
+ * zero; today clients exist with legitimate binary payloads and we
+ * shall not check for zero-terminated payloads
+ */
+#ifdef TRASH_ZEROTERMINATED_PACKETS
+	if (buf[len-1]==0) {
+		tmp=ip_addr2a(&ri->src_ip);
+		LM_WARN("upstream bug - 0-terminated packet from %s %d\n",
+				tmp, htons(ri->src_port));
+		len--;
+	}
+#endif
+#endif
+#ifdef DBG_MSG_QA
+	if (!dbg_msg_qa(buf, len)) {
+		LM_WARN("an incoming message didn't pass test,"
+					"  drop it: %.*s\n", len, buf );
+		return;
+	}
+#endif
+	if (ri->src_port==0){
+		tmp=ip_addr2a(&ri->src_ip);
+		LM_INFO("dropping 0 port packet from %s\n", tmp);
+		return;
+	}
+
+	/* update the local config */
+	cfg_update();
+	if (unlikely(sr_event_enabled(SREV_STUN_IN)) && (unsigned char)*buf == 0x00) {
+		/* stun_process_msg releases buf memory if necessary */
+		if ((stun_process_msg(buf, len, ri)) != 0) {
+			return; /* some error occurred */
+		}
+	} else {
+		/* receive_msg must free buf too!*/
+		receive_msg(buf, len, ri);
+	}
+}
+
+
+
+#if defined HAVE_RECVMMSG && !defined DYN_BUF
+/** udp receive loop reading up to udp_rcv_batch datagrams per syscall.
+ * Each datagram gets its own BUF_SIZE+1 buffer and the datagrams are passed
+ * one by one to udp_rcv_msg() after recvmmsg() returns. The buffers take
+ * udp_rcv_batch*(BUF_SIZE+1) bytes (about 4MB for the max. batch) and live
+ * for the whole process, so they are allocated with the system malloc()
+ * and not from the pkg memory pool.
+ */
+static int udp_rcv_batch_loop(struct receive_info* ri)
+{
+	struct mmsghdr* msgs;
+	struct iovec* iov;
+	union sockaddr_union* from;
+	char* bufs;
+	int vlen;
+	int n;
+	int i;
+
+	vlen=udp_rcv_batch;
+	bufs=0;
+	msgs=(struct mmsghdr*)pkg_malloc(vlen * (sizeof(struct mmsghdr) +
+				sizeof(struct iovec) + sizeof(union sockaddr_union)));
+	if (msgs==0){
+		LM_ERR("out of memory\n");
+		goto error;
+	}
+	bufs=(char*)malloc(vlen * (BUF_SIZE+1));
+	if (bufs==0){
+		LM_ERR("could not allocate %d receive buffers\n", vlen);
+		goto error;
+	}
+	iov=(struct iovec*)(msgs+vlen);
+	from=(union sockaddr_union*)(iov+vlen);
+	memset(msgs, 0, vlen * (sizeof(struct mmsghdr) + sizeof(struct iovec) +
+				sizeof(union sockaddr_union)));
+	for(i=0; i<vlen; i++){
+		iov[i].iov_base=bufs + i * (BUF_SIZE+1);
+		iov[i].iov_len=BUF_SIZE;
+		msgs[i].msg_hdr.msg_name=&from[i].s;
+		msgs[i].msg_hdr.msg_iov=&iov[i];
+		msgs[i].msg_hdr.msg_iovlen=1;
+	}
+
+	for(;;){
+		for(i=0; i<vlen; i++)
+			msgs[i].msg_hdr.msg_namelen=sockaddru_len(bind_address->su);
+		/* block only until the first datagram is available */
+		n=recvmmsg(udp_rcv_sock, msgs, vlen, MSG_WAITFORONE, 0);
+		if (n==-1){
+			if (errno==EAGAIN){
+				LM_DBG("packet with bad checksum received\n");
+				continue;
+			}
+			LM_ERR("recvmmsg:[%d] %s\n", errno, strerror(errno));
+			if ((errno==EINTR)||(errno==EWOULDBLOCK)|| (errno==ECONNREFUSED))
+				continue;
+			else goto error;
+		}
+		counter_inc(udp_rcv_batch_cnts_h.calls);
+		counter_add(udp_rcv_batch_cnts_h.msgs, n);
+		for(i=0; i<n; i++)
+			udp_rcv_msg((char*)iov[i].iov_base, msgs[i].msg_len, &from[i], ri);
+	}
+
+error:
+	if (bufs) free(bufs);
+	if (msgs) pkg_free(msgs);
 	return -1;
 }
+#endif /* HAVE_RECVMMSG && !DYN_BUF */
 
 
 
@@ -408,27 +810,36 @@ int udp_rcv_loop()
 #else
 	static char buf [BUF_SIZE+1];
 #endif
-	char *tmp;
 	union sockaddr_union* from;
 	unsigned int fromlen;
 	struct receive_info ri;
 
 
-	from=(union sockaddr_union*) pkg_malloc(sizeof(union sockaddr_union));
-	if (from==0){
-		LM_ERR("out of memory\n");
-		goto error;
-	}
-	memset(from, 0 , sizeof(union sockaddr_union));
+	from=0;
 	ri.bind_address=bind_address; /* this will not change, we do it only once*/
 	ri.dst_port=bind_address->port_no;
 	ri.dst_ip=bind_address->address;
 	ri.proto=PROTO_UDP;
 	ri.proto_reserved1=ri.proto_reserved2=0;
 
+	if (udp_rcv_sock==-1)
+		udp_rcv_sock=bind_address->socket;
+
 	/* initialize the config framework */
 	if (cfg_child_init()) goto error;
 
+#if defined HAVE_RECVMMSG && !defined DYN_BUF
+	if (udp_rcv_batch > 1)
+		return udp_rcv_batch_loop(&ri);
+#endif
+
+	from=(union sockaddr_union*) pkg_malloc(sizeof(union sockaddr_union));
+	if (from==0){
+		LM_ERR("out of memory\n");
+		goto error;
+	}
+	memset(from, 0 , sizeof(union sockaddr_union));
+
 	for(;;){
 #ifdef DYN_BUF
 		buf=pkg_malloc(BUF_SIZE+1);
@@ -438,7 +849,7 @@ int udp_rcv_loop()
 		}
 #endif
 		fromlen=sockaddru_len(bind_address->su);
-		len=recvfrom(bind_address->socket, buf, BUF_SIZE, 0, &from->s,
+		len=recvfrom(udp_rcv_sock, buf, BUF_SIZE, 0, &from->s,
 											&fromlen);
 		if (len==-1){
 			if (errno==EAGAIN){
@@ -450,89 +861,220 @@ int udp_rcv_loop()
 				continue; /* goto skip;*/
 			else goto error;
 		}
-		/* we must 0-term the messages, receive_msg expects it */
-		buf[len]=0; /* no need to save the previous char */
+		udp_rcv_msg(buf, len, from, &ri);
+
+	/* skip: do other stuff */
 
-		ri.src_su=*from;
-		su2ip_addr(&ri.src_ip, from);
-		ri.src_port=su_getport(from);
+	}
+	/*
+	if (from) pkg_free(from);
+	return 0;
+	*/
 
-		if(unlikely(sr_event_enabled(SREV_NET_DGRAM_IN)))
-		{
-			void *sredp[3];
-			sredp[0] = (void*)buf;
-			sredp[1] = (void*)(&len);
-			sredp[2] = (void*)(&ri);
-			if(sr_event_exec(SREV_NET_DGRAM_IN, (void*)sredp)<0) {
-				/* data handled by callback - continue to next packet */
-				continue;
-			}
-		}
-#ifndef NO_ZERO_CHECKS
-		if (!unlikely(sr_event_enabled(SREV_STUN_IN)) || (unsigned char)*buf != 0x00) {
-			if (len<MIN_UDP_PACKET) {
-				tmp=ip_addr2a(&ri.src_ip);
-				LM_DBG("probing packet received from %s %d\n", tmp, htons(ri.src_port));
-				continue;
-			}
-		}
-/* historically, zero-terminated packets indicated a bug in clients
- * that calculated wrongly packet length and included string-terminating
- * zero; today clients exist with legitimate binary payloads and we
- * shall not check for zero-terminated payloads
+error:
+	if (from) pkg_free(from);
+	return -1;
+}
+
+
+
+
+#ifdef HAVE_SENDMMSG
+
+/* per process queue of datagrams waiting for udp_send_batch_end() */
+struct udp_snd_queue {
+	int depth; /* udp_send_batch_start() nesting level */
+	int n;     /* number of queued datagrams */
+	int used;  /* bytes used in buf */
+	int sock[UDP_SND_BATCH_MAX];
+	union sockaddr_union to[UDP_SND_BATCH_MAX];
+	struct iovec iov[UDP_SND_BATCH_MAX];
+	struct mmsghdr msgs[UDP_SND_BATCH_MAX];
+	char buf[UDP_SND_QUEUE_BUF_SIZE];
+};
+
+static struct udp_snd_queue* udp_snd_q = 0;
+
+/* udp send batching counters */
+struct udp_snd_batch_counters_h {
+	counter_handle_t calls;
+	counter_handle_t msgs;
+};
+
+static struct udp_snd_batch_counters_h udp_snd_batch_cnts_h;
+
+static counter_def_t udp_snd_batch_cnt_defs[] =  {
+	{&udp_snd_batch_cnts_h.calls, "snd_batch_calls", 0, 0, 0,
+		"number of sendmmsg() calls."},
+	{&udp_snd_batch_cnts_h.msgs, "snd_batch_msgs", 0, 0, 0,
+		"number of datagrams sent through sendmmsg()."},
+	{0, 0, 0, 0, 0, 0 }
+};
+
+#endif /* HAVE_SENDMMSG */
+
+
+/** checks the udp_send_batch value and registers the batching counters.
+ * Must be called after parsing the config and before forking.
+ * @return 0 on success, -1 on error.
  */
-#ifdef TRASH_ZEROTERMINATED_PACKETS
-		if (buf[len-1]==0) {
-			tmp=ip_addr2a(&ri.src_ip);
-			LM_WARN("upstream bug - 0-terminated packet from %s %d\n",
-					tmp, htons(ri.src_port));
-			len--;
-		}
-#endif
+int udp_snd_batch_init(void)
+{
+	if (udp_snd_batch <= 1) {
+		udp_snd_batch = 0;
+		return 0;
+	}
+#ifndef HAVE_SENDMMSG
+	LM_WARN("udp_send_batch is not supported by this build"
+			" - using one sendto() per datagram\n");
+	udp_snd_batch = 0;
+	return 0;
+#else
+	if (udp_snd_batch > UDP_SND_BATCH_MAX) {
+		LM_WARN("udp_send_batch too big (%d), using %d\n",
+				udp_snd_batch, UDP_SND_BATCH_MAX);
+		udp_snd_batch = UDP_SND_BATCH_MAX;
+	}
+	if (counter_register_array("udp", udp_snd_batch_cnt_defs) < 0) {
+		LM_ERR("failed to register the udp send batch counters\n");
+		return -1;
+	}
+	return 0;
 #endif
-#ifdef DBG_MSG_QA
-		if (!dbg_msg_qa(buf, len)) {
-			LM_WARN("an incoming message didn't pass test,"
-						"  drop it: %.*s\n", len, buf );
+}
+
+
+#ifdef HAVE_SENDMMSG
+/** sends all the queued datagrams, using one sendmmsg() for each run of
+ * datagrams going out through the same socket.
+ * Errors are only logged (the senders were already told the datagrams
+ * were sent).
+ */
+static void udp_snd_queue_flush(struct udp_snd_queue* q)
+{
+	struct ip_addr ip;
+	int i;
+	int run;
+	int n;
+
+	i = 0;
+	while (i < q->n) {
+		for (run = 1; i + run < q->n && q->sock[i + run] == q->sock[i]; run++);
+		n = sendmmsg(q->sock[i], &q->msgs[i], run, 0);
+		if (likely(n > 0)) {
+			counter_inc(udp_snd_batch_cnts_h.calls);
+			counter_add(udp_snd_batch_cnts_h.msgs, n);
+			i += n;
 			continue;
 		}
-#endif
-		if (ri.src_port==0){
-			tmp=ip_addr2a(&ri.src_ip);
-			LM_INFO("dropping 0 port packet from %s\n", tmp);
+		if (n == -1 && errno == EINTR)
 			continue;
+		/* the first datagram of the run could not be sent, skip it */
+		su2ip_addr(&ip, &q->to[i]);
+		LM_ERR("sendmmsg(sock,%p,%u,0,%s:%d,%d): %s(%d)\n",
+				q->iov[i].iov_base, (unsigned)q->iov[i].iov_len,
+				ip_addr2a(&ip), su_getport(&q->to[i]),
+				(int)q->msgs[i].msg_hdr.msg_namelen, strerror(errno), errno);
+		if (errno == EINVAL) {
+			LM_CRIT("invalid sendmmsg parameters\n"
+			"one possible reason is the server is bound to localhost and\n"
+			"attempts to send to the net\n");
 		}
+		i++;
+	}
+	q->n = 0;
+	q->used = 0;
+}
 
-		/* update the local config */
-		cfg_update();
-		if (unlikely(sr_event_enabled(SREV_STUN_IN)) && (unsigned char)*buf == 0x00) {
-			/* stun_process_msg releases buf memory if necessary */
-			if ((stun_process_msg(buf, len, &ri)) != 0) {
-				continue; /* some error occurred */
-			}
-		} else {
-			/* receive_msg must free buf too!*/
-			receive_msg(buf, len, &ri);
-		}
 
-	/* skip: do other stuff */
+/** queues a datagram for sending on the next flush.
+ * @return len on success, -1 if the datagram cannot be queued and must be
+ *  sent directly.
+ */
+static int udp_snd_queue_add(struct udp_snd_queue* q, struct dest_info* dst,
+		struct iovec* v, int cnt, unsigned len)
+{
+	struct mmsghdr* m;
+	unsigned offset;
+	int i;
 
+	if (unlikely(len > UDP_SND_QUEUE_BUF_SIZE))
+		return -1;
+	if (q->n >= udp_snd_batch || q->used + len > UDP_SND_QUEUE_BUF_SIZE)
+		udp_snd_queue_flush(q);
+	for (i = 0, offset = 0; i < cnt; i++) {
+		memcpy(q->buf + q->used + offset, v[i].iov_base, v[i].iov_len);
+		offset += v[i].iov_len;
 	}
-	/*
-	if (from) pkg_free(from);
-	return 0;
-	*/
+	q->sock[q->n] = dst->send_sock->socket;
+	q->to[q->n] = dst->to;
+	q->iov[q->n].iov_base = q->buf + q->used;
+	q->iov[q->n].iov_len = len;
+	m = &q->msgs[q->n];
+	memset(m, 0, sizeof(*m));
+	m->msg_hdr.msg_name = &q->to[q->n].s;
+	m->msg_hdr.msg_namelen = sockaddru_len(dst->to);
+	m->msg_hdr.msg_iov = &q->iov[q->n];
+	m->msg_hdr.msg_iovlen = 1;
+	q->used += len;
+	q->n++;
+	return len;
+}
+#endif /* HAVE_SENDMMSG */
 
-error:
-	if (from) pkg_free(from);
-	return -1;
+
+/** starts an udp send batch.
+ * Until the matching udp_send_batch_end(), datagrams sent with udp_send()
+ * over normal (non raw) sockets are queued in a per process buffer and sent
+ * with sendmmsg(). Calls can be nested, the queue is flushed when the
+ * outermost batch ends. Does nothing if udp_send_batch is not set.
+ * Only datagrams sent with SND_F_UDP_BATCH in dst->send_flags are queued:
+ * a queued send always returns success and the errors of the later
+ * sendmmsg() are only logged, so the senders that act on a failed send
+ * (dns failover, blacklisting, 477/503 replies) are never delayed.
+ */
+void udp_send_batch_start(void)
+{
+#ifdef HAVE_SENDMMSG
+	if (likely(udp_snd_batch <= 1))
+		return;
+	if (unlikely(udp_snd_q == 0)) {
+		udp_snd_q = (struct udp_snd_queue*)pkg_malloc(
+				sizeof(struct udp_snd_queue));
+		if (udp_snd_q == 0) {
+			LM_ERR("could not allocate the udp send queue\n");
+			udp_snd_batch = 0; /* don't try again in this process */
+			return;
+		}
+		memset(udp_snd_q, 0, sizeof(struct udp_snd_queue));
+	}
+	udp_snd_q->depth++;
+#endif
 }
 
 
+/** ends an udp send batch, sending the queued datagrams if this is the
+ * outermost batch.
+ */
+void udp_send_batch_end(void)
+{
+#ifdef HAVE_SENDMMSG
+	if (likely(udp_snd_q == 0 || udp_snd_q->depth == 0))
+		return;
+	udp_snd_q->depth--;
+	if (udp_snd_q->depth == 0 && udp_snd_q->n > 0)
+		udp_snd_queue_flush(udp_snd_q);
+#endif
+}
+
 
 
-/* send buf:len over udp to dst (uses only the to and send_sock dst members)
+/* send buf:len over udp to dst (uses only the to, send_sock and send_flags
+ * dst members)
  * returns the numbers of bytes sent on success (>=0) and -1 on error
+ * (inside an udp send batch a datagram with SND_F_UDP_BATCH set might be
+ * only queued and its send errors are only logged, see
+ * udp_send_batch_start())
  */
 int udp_send(struct dest_info* dst, char *buf, unsigned len)
 {
@@ -540,6 +1082,9 @@ int udp_send(struct dest_info* dst, char *buf, unsigned len)
 	int n;
 	int tolen;
 	struct ip_addr ip; /* used only on error, for debugging */
+#ifdef HAVE_SENDMMSG
+	struct iovec v;
+#endif /* HAVE_SENDMMSG */
 #ifdef USE_RAW_SOCKS
 	int mtu;
 #endif /* USE_RAW_SOCKS */
@@ -557,6 +1102,17 @@ int udp_send(struct dest_info* dst, char *buf, unsigned len)
 					dst->send_sock->address.af == AF_INET) )) {
 #endif /* USE_RAW_SOCKS */
 		/* normal send over udp socket */
+#ifdef HAVE_SENDMMSG
+		if (unlikely(udp_snd_q && udp_snd_q->depth > 0
+						&& (dst->send_flags.f & SND_F_UDP_BATCH))) {
+			v.iov_base=buf;
+			v.iov_len=len;
+			n=udp_snd_queue_add(udp_snd_q, dst, &v, 1, len);
+			if (likely(n>=0))
+				return n;
+			/* too big to be queued, send it directly */
+		}
+#endif /* HAVE_SENDMMSG */
 		tolen=sockaddru_len(dst->to);
 again:
 		n=sendto(dst->send_sock->socket, buf, len, 0, &dst->to.s, tolen);
@@ -595,3 +1151,75 @@ raw_again:
 #endif /* USE_RAW_SOCKS */
 	return n;
 }
+
+
+
+/** sends a datagram given as a list of iovecs (len is the total length),
+ * like udp_send() but without joining the parts first.
+ * If the datagram must be sent over a raw socket, the parts are copied in
+ * a temporary buffer and udp_send() is used.
+ * @return the number of bytes sent or -1 on error
+ */
+int udp_sendv(struct dest_info* dst, struct iovec* v, int cnt, unsigned len)
+{
+	struct msghdr m;
+	struct ip_addr ip; /* used only on error, for debugging */
+	char* buf;
+	unsigned offset;
+	int n;
+	int i;
+	int join;
+
+	join=0;
+#ifdef DBG_MSG_QA
+	join=1; /* dbg_msg_qa() needs the whole message */
+#endif
+#ifdef USE_RAW_SOCKS
+	if (raw_udp4_send_sock >= 0 && cfg_get(core, core_cfg, udp4_raw) &&
+			dst->send_sock->address.af == AF_INET)
+		join=1;
+#endif /* USE_RAW_SOCKS */
+	if (unlikely(join)) {
+		buf=pkg_malloc(len);
+		if (unlikely(buf==0)) {
+			LM_ERR("out of memory\n");
+			return -1;
+		}
+		for (i=0, offset=0; i<cnt; i++) {
+			memcpy(buf+offset, v[i].iov_base, v[i].iov_len);
+			offset+=v[i].iov_len;
+		}
+		n=udp_send(dst, buf, len);
+		pkg_free(buf);
+		return n;
+	}
+#ifdef HAVE_SENDMMSG
+	if (unlikely(udp_snd_q && udp_snd_q->depth > 0
+					&& (dst->send_flags.f & SND_F_UDP_BATCH))) {
+		n=udp_snd_queue_add(udp_snd_q, dst, v, cnt, len);
+		if (likely(n>=0))
+			return n;
+		/* too big to be queued, send it directly */
+	}
+#endif /* HAVE_SENDMMSG */
+	memset(&m, 0, sizeof(m));
+	m.msg_name=&dst->to.s;
+	m.msg_namelen=sockaddru_len(dst->to);
+	m.msg_iov=v;
+	m.msg_iovlen=cnt;
+again:
+	n=sendmsg(dst->send_sock->socket, &m, 0);
+	if (unlikely(n==-1)){
+		su2ip_addr(&ip, &dst->to);
+		LM_ERR("sendmsg(sock,%d iovecs,%u,0,%s:%d,%d): %s(%d)\n",
+				cnt, len, ip_addr2a(&ip), su_getport(&dst->to),
+				(int)m.msg_namelen, strerror(errno), errno);
+		if (errno==EINTR) goto again;
+		if (errno==EINVAL) {
+			LM_CRIT("invalid sendmsg parameters\n"
+			"one possible reason is the server is bound to localhost and\n"
+			"attempts to send to the net\n");
+		}
+	}
+	return n;
+}
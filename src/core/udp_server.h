@@ -29,15 +29,31 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include "ip_addr.h"
+#include "config.h"
 
 #define MAX_RECV_BUFFER_SIZE	256*1024
 #define BUFFER_INCREMENT	2048
 
+/* max. number of datagrams read with one recvmmsg() (udp_receive_batch) */
+#define UDP_RCV_BATCH_MAX	64
+/* max. number of datagrams queued for one sendmmsg() (udp_send_batch) */
+#define UDP_SND_BATCH_MAX	64
+/* size of the per process buffer holding the queued datagrams */
+#define UDP_SND_QUEUE_BUF_SIZE	(2*BUF_SIZE)
+
 
 int udp_init(struct socket_info* si);
+int udp_reuseport_init(struct socket_info* si, int workers);
+void udp_reuseport_child_init(struct socket_info* si, int rank);
 int udp_send(struct dest_info* dst, char *buf, unsigned len);
+int udp_sendv(struct dest_info* dst, struct iovec* v, int cnt, unsigned len);
 int udp_rcv_loop(void);
+int udp_rcv_batch_init(void);
+int udp_snd_batch_init(void);
+void udp_send_batch_start(void);
+void udp_send_batch_end(void);
 
 
 #endif
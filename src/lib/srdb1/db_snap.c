@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \file lib/srdb1/db_snap.c
+ * \brief Binary snapshot files of table rows.
+ * \ingroup db1
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "db_snap.h"
+
+#define DB_SNAP_MAGIC "KSRSNAP"
+#define DB_SNAP_ENDIAN 0x01020304
+/* stdio buffer of the writer */
+#define DB_SNAP_WBUF_SIZE (1024*1024)
+
+/* fnv-1a */
+#define DB_SNAP_CSUM_INIT 14695981039346656037ULL
+
+static inline unsigned long long db_snap_csum(unsigned long long h,
+		const char* p, size_t len)
+{
+	const unsigned char* e;
+
+	for (e = (const unsigned char*)p + len;
+			(const unsigned char*)p < e; p++) {
+		h ^= (unsigned char)*p;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+
+static int db_snap_write(db_snap_w_t* _w, const void* _p, size_t _len)
+{
+	if (_len == 0)
+		return 0;
+	if (fwrite(_p, 1, _len, _w->f) != _len) {
+		LM_ERR("failed to write snapshot %s: %s\n", _w->tmpname,
+				strerror(errno));
+		return -1;
+	}
+	_w->hdr.csum = db_snap_csum(_w->hdr.csum, _p, _len);
+	_w->hdr.dlen += _len;
+	return 0;
+}
+
+
+static void db_snap_wfree(db_snap_w_t* _w)
+{
+	if (_w->f) {
+		fclose(_w->f);
+		_w->f = 0;
+	}
+	if (_w->fname) {
+		pkg_free(_w->fname);
+		_w->fname = 0;
+	}
+	_w->tmpname = 0; /* same block as fname */
+}
+
+
+int db_snap_create(db_snap_w_t* _w, char* _fname, char* _name, int _ncols)
+{
+	int len;
+
+	memset(_w, 0, sizeof(db_snap_w_t));
+	len = strlen(_fname);
+	/* fname and fname.tmp in one block */
+	_w->fname = (char*)pkg_malloc(2 * len + 6);
+	if (_w->fname == 0) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memcpy(_w->fname, _fname, len + 1);
+	_w->tmpname = _w->fname + len + 1;
+	memcpy(_w->tmpname, _fname, len);
+	memcpy(_w->tmpname + len, ".tmp", 5);
+
+	_w->f = fopen(_w->tmpname, "w");
+	if (_w->f == 0) {
+		LM_ERR("cannot create snapshot %s: %s\n", _w->tmpname,
+				strerror(errno));
+		db_snap_wfree(_w);
+		return -1;
+	}
+	setvbuf(_w->f, 0, _IOFBF, DB_SNAP_WBUF_SIZE);
+
+	memcpy(_w->hdr.magic, DB_SNAP_MAGIC, sizeof(DB_SNAP_MAGIC));
+	_w->hdr.endian = DB_SNAP_ENDIAN;
+	_w->hdr.version = DB_SNAP_VERSION;
+	_w->hdr.ncols = _ncols;
+	strncpy(_w->hdr.name, _name, sizeof(_w->hdr.name) - 1);
+	/* the header is written again on commit */
+	if (fwrite(&_w->hdr, 1, sizeof(db_snap_hdr_t), _w->f)
+			!= sizeof(db_snap_hdr_t)) {
+		LM_ERR("failed to write snapshot %s: %s\n", _w->tmpname,
+				strerror(errno));
+		db_snap_abort(_w);
+		return -1;
+	}
+	_w->hdr.csum = DB_SNAP_CSUM_INIT;
+	return 0;
+}
+
+
+int db_snap_add(db_snap_w_t* _w, db_val_t* _vals)
+{
+	unsigned char t[2];
+	unsigned int i, len;
+	long long ll;
+	const char* s;
+	db_val_t* v;
+
+	for (i = 0; i < _w->hdr.ncols; i++) {
+		v = &_vals[i];
+		t[0] = (unsigned char)VAL_TYPE(v);
+		t[1] = VAL_NULL(v) ? 1 : 0;
+		if (db_snap_write(_w, t, 2) < 0)
+			return -1;
+		if (VAL_NULL(v))
+			continue;
+		switch (VAL_TYPE(v)) {
+			case DB1_INT:
+				if (db_snap_write(_w, &VAL_INT(v), sizeof(int)) < 0)
+					return -1;
+				break;
+			case DB1_BITMAP:
+				if (db_snap_write(_w, &VAL_BITMAP(v), sizeof(int)) < 0)
+					return -1;
+				break;
+			case DB1_BIGINT:
+				if (db_snap_write(_w, &VAL_BIGINT(v), sizeof(long long)) < 0)
+					return -1;
+				break;
+			case DB1_DATETIME:
+				ll = (long long)VAL_TIME(v);
+				if (db_snap_write(_w, &ll, sizeof(long long)) < 0)
+					return -1;
+				break;
+			case DB1_DOUBLE:
+				if (db_snap_write(_w, &VAL_DOUBLE(v), sizeof(double)) < 0)
+					return -1;
+				break;
+			case DB1_STRING:
+			case DB1_STR:
+			case DB1_BLOB:
+				if (VAL_TYPE(v) == DB1_STRING) {
+					s = VAL_STRING(v);
+					len = s ? strlen(s) : 0;
+				} else {
+					s = VAL_STR(v).s;
+					len = (s && VAL_STR(v).len > 0) ? VAL_STR(v).len : 0;
+				}
+				if (db_snap_write(_w, &len, sizeof(len)) < 0
+						|| db_snap_write(_w, s, len) < 0
+						|| db_snap_write(_w, "", 1) < 0)
+					return -1;
+				break;
+			default:
+				LM_ERR("unsupported value type %d (column %u)\n",
+						VAL_TYPE(v), i);
+				return -1;
+		}
+	}
+	_w->hdr.rows++;
+	return 0;
+}
+
+
+int db_snap_commit(db_snap_w_t* _w, unsigned int _flags)
+{
+	_w->hdr.flags = _flags;
+	_w->hdr.created = (long long)time(0);
+	if (fseek(_w->f, 0, SEEK_SET) != 0
+			|| fwrite(&_w->hdr, 1, sizeof(db_snap_hdr_t), _w->f)
+				!= sizeof(db_snap_hdr_t)
+			|| fflush(_w->f) != 0 || fsync(fileno(_w->f)) != 0) {
+		LM_ERR("failed to write snapshot %s: %s\n", _w->tmpname,
+				strerror(errno));
+		db_snap_abort(_w);
+		return -1;
+	}
+	fclose(_w->f);
+	_w->f = 0;
+	if (rename(_w->tmpname, _w->fname) < 0) {
+		LM_ERR("cannot rename snapshot %s to %s: %s\n", _w->tmpname,
+				_w->fname, strerror(errno));
+		unlink(_w->tmpname);
+		db_snap_wfree(_w);
+		return -1;
+	}
+	LM_DBG("snapshot %s written (%llu rows, %llu bytes)\n", _w->fname,
+			_w->hdr.rows, _w->hdr.dlen);
+	db_snap_wfree(_w);
+	return 0;
+}
+
+
+void db_snap_abort(db_snap_w_t* _w)
+{
+	if (_w->f) {
+		fclose(_w->f);
+		_w->f = 0;
+	}
+	if (_w->tmpname)
+		unlink(_w->tmpname);
+	db_snap_wfree(_w);
+}
+
+
+int db_snap_open(db_snap_t* _s, char* _fname, char* _name, int _ncols,
+		int _max_age, unsigned int _flags)
+{
+	struct stat st;
+	db_snap_hdr_t* h;
+	long long age;
+
+	memset(_s, 0, sizeof(db_snap_t));
+	_s->fd = open(_fname, O_RDONLY);
+	if (_s->fd < 0) {
+		if (errno == ENOENT) {
+			LM_INFO("no snapshot %s\n", _fname);
+		} else {
+			LM_ERR("cannot open snapshot %s: %s\n", _fname, strerror(errno));
+		}
+		return -1;
+	}
+	if (fstat(_s->fd, &st) < 0 || st.st_size < sizeof(db_snap_hdr_t)) {
+		LM_WARN("invalid snapshot %s\n", _fname);
+		goto error;
+	}
+	_s->len = st.st_size;
+	_s->buf = mmap(0, _s->len, PROT_READ, MAP_PRIVATE, _s->fd, 0);
+	if (_s->buf == MAP_FAILED) {
+		LM_ERR("cannot map snapshot %s: %s\n", _fname, strerror(errno));
+		_s->buf = 0;
+		goto error;
+	}
+	h = (db_snap_hdr_t*)_s->buf;
+	if (memcmp(h->magic, DB_SNAP_MAGIC, sizeof(DB_SNAP_MAGIC)) != 0
+			|| h->endian != DB_SNAP_ENDIAN || h->version != DB_SNAP_VERSION) {
+		LM_WARN("snapshot %s has an unknown format\n", _fname);
+		goto error;
+	}
+	if (h->ncols != _ncols || h->name[sizeof(h->name) - 1] != 0
+			|| strcmp(h->name, _name) != 0) {
+		LM_WARN("snapshot %s is not for %s (%.*s)\n", _fname, _name,
+				(int)sizeof(h->name), h->name);
+		goto error;
+	}
+	if ((h->flags & _flags) != _flags) {
+		LM_INFO("snapshot %s was not written on shutdown - not used\n",
+				_fname);
+		goto error;
+	}
+	age = (long long)time(0) - h->created;
+	if (_max_age > 0 && age > _max_age) {
+		LM_INFO("snapshot %s is too old (%lld s) - not used\n", _fname, age);
+		goto error;
+	}
+	if (h->dlen != _s->len - sizeof(db_snap_hdr_t)
+			|| db_snap_csum(DB_SNAP_CSUM_INIT, _s->buf + sizeof(db_snap_hdr_t),
+					h->dlen) != h->csum) {
+		LM_WARN("snapshot %s is corrupted\n", _fname);
+		goto error;
+	}
+	_s->hdr = h;
+	_s->p = _s->buf + sizeof(db_snap_hdr_t);
+	_s->end = _s->buf + _s->len;
+	return 0;
+
+error:
+	db_snap_close(_s);
+	return -1;
+}
+
+
+#define db_snap_get(_s, _dst, _len) \
+	do { \
+		if ((_s)->end - (_s)->p < (_len)) \
+			goto error; \
+		memcpy((_dst), (_s)->p, (_len)); \
+		(_s)->p += (_len); \
+	} while(0)
+
+int db_snap_next(db_snap_t* _s, db_val_t* _vals)
+{
+	unsigned int i, len;
+	unsigned char t[2];
+	long long ll;
+	db_val_t* v;
+
+	if (_s->row >= _s->hdr->rows)
+		return 0;
+	memset(_vals, 0, _s->hdr->ncols * sizeof(db_val_t));
+	for (i = 0; i < _s->hdr->ncols; i++) {
+		v = &_vals[i];
+		db_snap_get(_s, t, 2);
+		VAL_TYPE(v) = (db_type_t)t[0];
+		VAL_NULL(v) = t[1];
+		if (VAL_NULL(v))
+			continue;
+		switch (VAL_TYPE(v)) {
+			case DB1_INT:
+				db_snap_get(_s, &VAL_INT(v), sizeof(int));
+				break;
+			case DB1_BITMAP:
+				db_snap_get(_s, &VAL_BITMAP(v), sizeof(int));
+				break;
+			case DB1_BIGINT:
+				db_snap_get(_s, &VAL_BIGINT(v), sizeof(long long));
+				break;
+			case DB1_DATETIME:
+				db_snap_get(_s, &ll, sizeof(long long));
+				VAL_TIME(v) = (time_t)ll;
+				break;
+			case DB1_DOUBLE:
+				db_snap_get(_s, &VAL_DOUBLE(v), sizeof(double));
+				break;
+			case DB1_STRING:
+			case DB1_STR:
+			case DB1_BLOB:
+				db_snap_get(_s, &len, sizeof(len));
+				if (_s->end - _s->p < (long)len + 1 || _s->p[len] != 0)
+					goto error;
+				/* str_val.s and string_val are the same pointer */
+				VAL_STR(v).s = _s->p;
+				VAL_STR(v).len = len;
+				_s->p += len + 1;
+				break;
+			default:
+				goto error;
+		}
+	}
+	_s->row++;
+	return 1;
+
+error:
+	LM_ERR("invalid data in snapshot row %llu\n", _s->row);
+	return -1;
+}
+
+
+void db_snap_close(db_snap_t* _s)
+{
+	if (_s->buf) {
+		munmap(_s->buf, _s->len);
+		_s->buf = 0;
+	}
+	if (_s->fd >= 0) {
+		close(_s->fd);
+		_s->fd = -1;
+	}
+	_s->hdr = 0;
+}
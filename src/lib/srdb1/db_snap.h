@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \file lib/srdb1/db_snap.h
+ * \brief Binary snapshot files of table rows.
+ *
+ * A snapshot file holds rows of db values with a fixed number of columns,
+ * written by a module from its memory content and loaded back at startup
+ * instead of querying the database (or when no database is used).
+ *
+ * The file is written in a temporary file that is renamed when complete,
+ * so a snapshot is either the old or the new one. It is loaded with mmap()
+ * and the string values point directly in the mapped file (zero terminated),
+ * so they are valid until db_snap_close(). A checksum of the rows is
+ * verified before the first row is returned. The format is not portable
+ * between architectures (native byte order).
+ * \ingroup db1
+ */
+
+#ifndef DB1_SNAP_H
+#define DB1_SNAP_H
+
+#include <stdio.h>
+#include <time.h>
+#include "db_val.h"
+
+#define DB_SNAP_VERSION 1
+
+/** written on shutdown, the memory content was final */
+#define DB_SNAP_F_FINAL (1<<0)
+
+/** snapshot file header */
+typedef struct db_snap_hdr {
+	char magic[8];            /**< "KSRSNAP" */
+	unsigned int endian;      /**< 0x01020304 in native byte order */
+	unsigned int version;     /**< DB_SNAP_VERSION */
+	unsigned int flags;       /**< DB_SNAP_F_* */
+	unsigned int ncols;       /**< values per row */
+	long long created;        /**< write time */
+	unsigned long long rows;  /**< number of rows */
+	unsigned long long dlen;  /**< size of the rows data */
+	unsigned long long csum;  /**< checksum of the rows data */
+	char name[64];            /**< content name, zero terminated */
+} db_snap_hdr_t;
+
+/** snapshot being written */
+typedef struct db_snap_w {
+	FILE* f;
+	char* fname;
+	char* tmpname;
+	db_snap_hdr_t hdr;
+} db_snap_w_t;
+
+/** snapshot being read */
+typedef struct db_snap {
+	int fd;
+	char* buf;      /**< mapped file */
+	size_t len;     /**< mapped file size */
+	char* p;        /**< next row */
+	char* end;      /**< end of data */
+	unsigned long long row;
+	db_snap_hdr_t* hdr;
+} db_snap_t;
+
+
+/**
+ * \brief Start writing a snapshot file
+ * \param _w writer
+ * \param _fname snapshot file name (replaced on db_snap_commit())
+ * \param _name content name, checked when loading
+ * \param _ncols values per row
+ * \return 0 on success, -1 on error
+ */
+int db_snap_create(db_snap_w_t* _w, char* _fname, char* _name, int _ncols);
+
+/**
+ * \brief Add a row to a snapshot
+ * \param _w writer
+ * \param _vals row values (ncols)
+ * \return 0 on success, -1 on error
+ */
+int db_snap_add(db_snap_w_t* _w, db_val_t* _vals);
+
+/**
+ * \brief Complete a snapshot and replace the old one
+ * \param _w writer
+ * \param _flags DB_SNAP_F_* flags
+ * \return 0 on success, -1 on error (the old snapshot is kept)
+ */
+int db_snap_commit(db_snap_w_t* _w, unsigned int _flags);
+
+/**
+ * \brief Drop a snapshot being written (the old one is kept)
+ * \param _w writer
+ */
+void db_snap_abort(db_snap_w_t* _w);
+
+/**
+ * \brief Open a snapshot file for loading
+ * \param _s reader
+ * \param _fname snapshot file name
+ * \param _name expected content name
+ * \param _ncols expected values per row
+ * \param _max_age maximum age in seconds (0 - no limit)
+ * \param _flags DB_SNAP_F_* flags the snapshot must have
+ * \return 0 on success, -1 if the snapshot is missing, stale, of
+ * another kind or corrupted
+ */
+int db_snap_open(db_snap_t* _s, char* _fname, char* _name, int _ncols,
+		int _max_age, unsigned int _flags);
+
+/**
+ * \brief Read the next row of a snapshot
+ * \param _s reader
+ * \param _vals row values (ncols), the strings point in the snapshot
+ * \return 1 if a row was read, 0 at the end, -1 on error
+ */
+int db_snap_next(db_snap_t* _s, db_val_t* _vals);
+
+/**
+ * \brief Close a snapshot opened with db_snap_open()
+ * \param _s reader
+ */
+void db_snap_close(db_snap_t* _s);
+
+#endif /* DB1_SNAP_H */
@@ -127,6 +127,7 @@
 #include "core/cfg_core.h"
 #include "core/endianness.h" /* init */
 #include "core/basex.h" /* init */
+#include "core/parser/hf_scan.h" /* init */
 #include "core/pvapi.h" /* init PV api */
 #include "core/pv_core.h" /* register core pvars */
 #include "core/ppcfg.h"
@@ -207,7 +208,8 @@ Options:\n\
                   disable with no or off\n\
     -A define    Add config pre-processor define (e.g., -A WITH_AUTH)\n\
     -x name      Specify internal manager for shared memory (shm)\n\
-                  - can be: fm, qm or tlsf\n\
+                  - can be: fm, qm or tlsf; pcfm, pcqm or pctlsf add\n\
+                  per process caches for small chunks\n\
     -X name      Specify internal manager for private memory (pkg)\n\
                   - if omitted, the one for shm is used\n"
 #ifdef STATS
@@ -302,6 +304,7 @@ int children_no = 0;		/* number of children processing requests */
 #ifdef USE_TCP
 int tcp_cfg_children_no = 0; /* set via config or command line option */
 int tcp_children_no = 0; /* based on socket_workers and tcp_cfg_children_no */
+int tcp_main_procs = 1; /* number of tcp main processes */
 int tcp_disable = 0; /* 1 if tcp is disabled */
 #endif
 #ifdef USE_TLS
@@ -418,6 +421,10 @@ char* mcast = 0;
 
 int tos = IPTOS_LOWDELAY;
 int pmtu_discovery = 0;
+int udp_rcv_batch = 0; /* max. datagrams read per recvmmsg(), <=1 disables it */
+int udp_snd_batch = 0; /* max. datagrams sent per sendmmsg(), <=1 disables it */
+int udp_reuseport = 0; /* one SO_REUSEPORT socket per udp worker */
+int udp_cpu_affinity = 0; /* pin udp workers to cpus (and steer by cpu) */
 
 int auto_bind_ipv6 = 0;
 
@@ -1395,6 +1402,12 @@ int main_loop(void)
 			LM_CRIT("Cannot start wtimer\n");
 			goto error;
 		}
+#ifdef USE_DNS_CACHE
+		if (dns_cache_prefetch_start()<0) {
+			LM_CRIT("Cannot start the dns prefetch process\n");
+			goto error;
+		}
+#endif
 		/* main process, receive loop */
 		process_no=0; /*main process number*/
 		pt[process_no].pid=getpid();
@@ -1436,6 +1449,9 @@ int main_loop(void)
 			/* create the listening socket (for each address)*/
 			/* udp */
 			if (udp_init(si)==-1) goto error;
+			if (udp_reuseport_init(si,
+						(si->workers>0)?si->workers:children_no)==-1)
+				goto error;
 			/* get first ipv4/ipv6 socket*/
 			if ((si->address.af==AF_INET)&&
 					((sendipv4==0)||(sendipv4->flags&(SI_IS_LO|SI_IS_MCAST))))
@@ -1516,7 +1532,7 @@ int main_loop(void)
 					sendipv6_tcp=si;
 			}
 			/* the number of sockets does not matter */
-			cfg_register_child(tcp_children_no + 1 /* tcp main */);
+			cfg_register_child(tcp_children_no + tcp_main_procs);
 		}
 #ifdef USE_TLS
 		if (!tls_disable && tls_has_init_si()){
@@ -1608,6 +1624,7 @@ int main_loop(void)
 				}else if (pid==0){
 					/* child */
 					bind_address=si; /* shortcut */
+					udp_reuseport_child_init(si, i);
 #ifdef STATS
 					setstats( i+r*children_no );
 #endif
@@ -1693,6 +1710,12 @@ int main_loop(void)
 			LM_CRIT("Cannot start wtimer\n");
 			goto error;
 		}
+#ifdef USE_DNS_CACHE
+		if (dns_cache_prefetch_start()<0) {
+			LM_CRIT("Cannot start the dns prefetch process\n");
+			goto error;
+		}
+#endif
 
 	/* init childs with rank==MAIN before starting tcp main (in case they want
 	 * to fork  a tcp capable process, the corresponding tcp. comm. fds in
@@ -1706,18 +1729,21 @@ int main_loop(void)
 		if (!tcp_disable){
 				/* start tcp  & tls receivers */
 			if (tcp_init_children()<0) goto error;
-				/* start tcp+tls master proc */
-			pid = fork_process(PROC_TCP_MAIN, "tcp main process", 0);
-			if (pid<0){
-				LM_CRIT("cannot fork tcp main process: %s\n", strerror(errno));
-				goto error;
-			}else if (pid==0){
-				/* child */
-				tcp_main_loop();
-			}else{
-				tcp_main_pid=pid;
-				unix_tcp_sock=-1;
+				/* start tcp+tls master procs */
+			for(i=0; i<tcp_main_procs; i++){
+				pid = fork_process(PROC_TCP_MAIN, "tcp main process", 0);
+				if (pid<0){
+					LM_CRIT("cannot fork tcp main process: %s\n",
+							strerror(errno));
+					goto error;
+				}else if (pid==0){
+					/* child */
+					tcp_main_loop(i);
+				}
 			}
+			tcp_main_pid=pid;
+			for(i=0; i<tcp_main_procs; i++)
+				unix_tcp_socks[i]=-1;
 		}
 #endif
 		/* main */
@@ -1726,7 +1752,8 @@ int main_loop(void)
 		close_extra_socks(PROC_ATTENDANT, get_proc_no());
 		if(!tcp_disable){
 			/* main's tcp sockets are disabled by default from init_pt() */
-			unix_tcp_sock=-1;
+			for(i=0; i<tcp_main_procs; i++)
+				unix_tcp_socks[i]=-1;
 		}
 #endif
 		/* init cfg, but without per child callbacks support */
@@ -1775,6 +1802,7 @@ static int calc_proc_no(void)
 #ifdef USE_TCP
 	int tcp_listeners;
 	int tcp_e_listeners;
+	int tcp_min_group;
 #endif
 #ifdef USE_SCTP
 	int sctp_listeners;
@@ -1803,6 +1831,34 @@ static int calc_proc_no(void)
 	tcp_listeners += tcp_e_listeners;
 #endif
 	tcp_children_no = tcp_listeners;
+	/* the readers of each group (generic and per socket) are split between
+	 * the tcp main processes => each group must have at least one reader
+	 * for each tcp main */
+	tcp_e_listeners = tcp_children_no;
+	tcp_min_group = tcp_children_no;
+	for (si=tcp_listen; si; si=si->next) {
+		if(si->workers>0) {
+			tcp_e_listeners -= si->workers;
+			if(si->workers < tcp_min_group)
+				tcp_min_group = si->workers;
+		}
+	}
+#ifdef USE_TLS
+	for (si=tls_listen; si; si=si->next) {
+		if(si->workers>0) {
+			tcp_e_listeners -= si->workers;
+			if(si->workers < tcp_min_group)
+				tcp_min_group = si->workers;
+		}
+	}
+#endif
+	if (tcp_e_listeners > 0 && tcp_e_listeners < tcp_min_group)
+		tcp_min_group = tcp_e_listeners; /* generic readers */
+	if (tcp_main_procs > tcp_min_group) {
+		tcp_main_procs = (tcp_min_group > 0) ? tcp_min_group : 1;
+		LM_WARN("not enough tcp readers per group, using %d tcp main"
+				" processes\n", tcp_main_procs);
+	}
 #endif
 #ifdef USE_SCTP
 	for (si=sctp_listen, sctp_listeners=0; si; si=si->next)
@@ -1819,7 +1875,7 @@ static int calc_proc_no(void)
 #endif
 		+ 1 /* wtimer process */
 #ifdef USE_TCP
-		+((!tcp_disable)?( 1/* tcp main */ + tcp_listeners ):0)
+		+((!tcp_disable)?( tcp_main_procs + tcp_listeners ):0)
 #endif
 #ifdef USE_SCTP
 		+((!sctp_disable)?sctp_listeners:0)
@@ -1913,6 +1969,12 @@ int main(int argc, char** argv)
 	if(sr_memmng_pkg==NULL) {
 		if(sr_memmng_shm!=NULL) {
 			sr_memmng_pkg = sr_memmng_shm;
+			/* the per process caches are a shm front-end, pkg uses the
+			 * underlying manager (pcfm -> fm, pcqm -> qm, pctlsf -> tlsf) */
+			if(strcmp(sr_memmng_pkg, "pcfm")==0
+					|| strcmp(sr_memmng_pkg, "pcqm")==0
+					|| strcmp(sr_memmng_pkg, "pctlsf")==0)
+				sr_memmng_pkg += 2;
 		} else {
 			sr_memmng_pkg = SR_MEMMNG_DEFAULT;
 		}
@@ -2463,6 +2525,8 @@ try_again:
 		LM_CRIT("could not initialize base* framework\n");
 		goto error;
 	}
+	/* select the sip header scanners for this cpu */
+	LM_DBG("using %s header scanners\n", hf_scan_mode_name(hf_scan_init()));
 	if (sr_cfg_init() < 0) {
 		LM_CRIT("could not initialize configuration framework\n");
 		goto error;
@@ -2537,6 +2601,14 @@ try_again:
 		}
 	}
 #endif /* USE_SCTP */
+	if (udp_rcv_batch_init()<0){
+		LM_CRIT("could not initialize udp receive batching, exiting...\n");
+		goto error;
+	}
+	if (udp_snd_batch_init()<0){
+		LM_CRIT("could not initialize udp send batching, exiting...\n");
+		goto error;
+	}
 	/* init_daemon? */
 	if( !dont_fork && daemonize((log_name==0)?argv[0]:log_name, 1) < 0)
 		goto error;
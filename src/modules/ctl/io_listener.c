@@ -300,6 +300,13 @@ void io_listen_loop(int fd_no, struct ctrl_socket* cs_lst)
 				io_wait_loop_devpoll(&io_h, IO_LISTEN_TIMEOUT, 0);
 			}
 			break;
+#endif
+#ifdef HAVE_IO_URING
+		case POLL_IOURING:
+			while(1){
+				io_wait_loop_uring(&io_h, IO_LISTEN_TIMEOUT, 0);
+			}
+			break;
 #endif
 		default:
 			LOG(L_CRIT, "BUG: io_listen_loop: no support for poll method "
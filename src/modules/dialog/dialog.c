@@ -73,6 +73,7 @@
 #include "dlg_load.h"
 #include "dlg_cb.h"
 #include "dlg_db_handler.h"
+#include "dlg_snap.h"
 #include "dlg_req_within.h"
 #include "dlg_profile.h"
 #include "dlg_var.h"
@@ -299,6 +300,9 @@ static param_export_t mod_params[]={
 	{ "db_skip_load",          INT_PARAM, &db_skip_load             },
 	{ "ka_failed_limit",       INT_PARAM, &dlg_ka_failed_limit      },
 	{ "enable_dmq",            INT_PARAM, &dlg_enable_dmq           },
+	{ "snapshot_dir",          PARAM_STR, &dlg_snapshot_dir         },
+	{ "snapshot_interval",     PARAM_INT, &dlg_snapshot_interval    },
+	{ "snapshot_max_age",      PARAM_INT, &dlg_snapshot_max_age     },
 	{ 0,0,0 }
 };
 
@@ -452,6 +456,7 @@ static int pv_get_dlg_count(struct sip_msg *msg, pv_param_t *param,
 static int mod_init(void)
 {
 	unsigned int n;
+	int ret;
 	sr_cfgenv_t *cenv = NULL;
 
 	if(dlg_ka_interval!=0 && dlg_ka_interval<30) {
@@ -660,10 +665,20 @@ static int mod_init(void)
 		return -1;
 	}
 
+	if (dlg_snap_init()!=0)
+		return -1;
+
 	/* if a database should be used to store the dialogs' information */
 	dlg_db_mode = dlg_db_mode_param;
 	if (dlg_db_mode==DB_MODE_NONE) {
 		db_url.s = 0; db_url.len = 0;
+		ret = dlg_snap_load();
+		if (ret<0) {
+			LM_ERR("failed to load the dialog snapshot\n");
+			return -1;
+		}
+		if (ret==0)
+			run_load_callbacks();
 	} else {
 		if (dlg_db_mode!=DB_MODE_REALTIME &&
 		dlg_db_mode!=DB_MODE_DELAYED && dlg_db_mode!=DB_MODE_SHUTDOWN ) {
@@ -701,6 +716,8 @@ static int mod_init(void)
 		return -1;
 	}
 
+	dlg_snap_set_ready();
+
 	return 0;
 }
 
@@ -733,6 +750,11 @@ static int child_init(int rank)
 		}
 	}
 
+	if (rank==PROC_INIT && dlg_profiles_epoch_init()!=0) {
+		LM_ERR("failed to init the profile counters reclamation\n");
+		return -1;
+	}
+
 	if (rank==1) {
 		if_update_stat(dlg_enable_stats, active_dlgs, active_dlgs_cnt);
 		if_update_stat(dlg_enable_stats, early_dlgs, early_dlgs_cnt);
@@ -766,6 +788,8 @@ static void mod_destroy(void)
 		dialog_update_db(0, 0);
 		destroy_dlg_db();
 	}
+	/* after the db update, so it can replace the load from db */
+	dlg_snap_save(1);
 	dlg_bridge_destroy_hdrs();
 	/* no DB interaction from now on */
 	dlg_db_mode = DB_MODE_NONE;
@@ -1248,6 +1272,7 @@ void dlg_clean_timer_exec(unsigned int ticks, void* param)
 {
 	dlg_clean_run(ticks);
 	remove_expired_remote_profiles(time(NULL));
+	dlg_profiles_epoch_reclaim();
 }
 
 static int fixup_dlg_bye(void** param, int param_no)
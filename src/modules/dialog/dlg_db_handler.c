@@ -42,6 +42,7 @@
 #include "dlg_var.h"
 #include "dlg_profile.h"
 #include "dlg_db_handler.h"
+#include "dlg_snap.h"
 
 
 str call_id_column			=	str_init(CALL_ID_COL);
@@ -123,6 +124,7 @@ extern int early_dlgs_cnt;
 
 static int load_dialog_info_from_db(int dlg_hash_size, int fetch_num_rows);
 static int load_dialog_vars_from_db(int fetch_num_rows);
+static int clear_dialog_tables(void);
 
 int dlg_connect_db(const str *db_url)
 {
@@ -138,6 +140,8 @@ int dlg_connect_db(const str *db_url)
 
 int init_dlg_db(const str *db_url, int dlg_hash_size , int db_update_period, int fetch_num_rows, int db_skip_load)
 {
+	int ret;
+
 	/* Find a database module */
 	if (db_bind_mod(db_url, &dialog_dbf) < 0){
 		LM_ERR("Unable to bind to a database driver\n");
@@ -165,13 +169,24 @@ int init_dlg_db(const str *db_url, int dlg_hash_size , int db_update_period, int
 	}
 
 	if ( db_skip_load == 0 ) {
-		if( (load_dialog_info_from_db(dlg_hash_size, fetch_num_rows) ) !=0 ){
-			LM_ERR("Unable to load the dialog data\n");
+		ret = dlg_snap_load();
+		if (ret < 0) {
+			LM_ERR("Unable to load the dialog snapshot\n");
 			return -1;
 		}
-		if( (load_dialog_vars_from_db(fetch_num_rows) ) !=0 ){
-			LM_ERR("Unable to load the dialog variable data\n");
-			return -1;
+		if (ret == 0) {
+			/* loaded from snapshot, same table state as after a db load */
+			if (dlg_db_mode==DB_MODE_SHUTDOWN && clear_dialog_tables()!=0)
+				return -1;
+		} else {
+			if( (load_dialog_info_from_db(dlg_hash_size, fetch_num_rows) ) !=0 ){
+				LM_ERR("Unable to load the dialog data\n");
+				return -1;
+			}
+			if( (load_dialog_vars_from_db(fetch_num_rows) ) !=0 ){
+				LM_ERR("Unable to load the dialog variable data\n");
+				return -1;
+			}
 		}
 	}
 	dialog_dbf.close(dialog_db_handle);
@@ -225,6 +240,25 @@ static int use_dialog_vars_table(void)
 
 
 
+static int clear_dialog_tables(void)
+{
+	if (use_dialog_table()!=0)
+		return -1;
+	if (dialog_dbf.delete(dialog_db_handle, 0, 0, 0, 0) < 0) {
+		LM_ERR("failed to clear dialog table\n");
+		return -1;
+	}
+	if (use_dialog_vars_table()!=0)
+		return -1;
+	if (dialog_dbf.delete(dialog_db_handle, 0, 0, 0, 0) < 0) {
+		LM_ERR("failed to clear dialog variable table\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+
 static int select_entire_dialog_table(db1_res_t ** res, int fetch_num_rows)
 {
 	db_key_t query_cols[DIALOG_TABLE_COL_NO] = {	&h_entry_column,
@@ -294,12 +328,13 @@ struct socket_info * create_socket_info(db_val_t * vals, int n){
 
 
 
-static int load_dialog_info_from_db(int dlg_hash_size, int fetch_num_rows)
+/*!
+ * \brief Restore a dialog from a row of the dialog table columns
+ * \param values row values, in the order of select_entire_dialog_table()
+ * \return 0 on success or if the row is skipped, -1 on error
+ */
+int dlg_load_dialog_row(db_val_t *values)
 {
-	db1_res_t * res;
-	db_val_t * values;
-	db_row_t * rows;
-	int i, nr_rows;
 	struct dlg_cell *dlg;
 	str callid, from_uri, to_uri, from_tag, to_tag, req_uri;
 	str cseq1, cseq2, contact1, contact2, rroute1, rroute2;
@@ -307,153 +342,168 @@ static int load_dialog_info_from_db(int dlg_hash_size, int fetch_num_rows)
 	str xdata;
 	unsigned int next_id;
 	srjson_doc_t jdoc;
-	
-	res = 0;
-	if((nr_rows = select_entire_dialog_table(&res, fetch_num_rows)) < 0)
-		goto end;
 
-	nr_rows = RES_ROW_N(res);
+	if (VAL_NULL(values) || VAL_NULL(values+1)) {
+		LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
+			h_entry_column.len, h_entry_column.s,
+			h_id_column.len, h_id_column.s);
+		return 0;
+	}
 
-	LM_DBG("the database has information about %i dialogs\n", nr_rows);
+	if (VAL_NULL(values+7) || VAL_NULL(values+8)) {
+		LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
+			start_time_column.len, start_time_column.s,
+			state_column.len, state_column.s);
+		return 0;
+	}
 
-	rows = RES_ROWS(res);
+	/*restore the dialog info*/
+	GET_STR_VALUE(callid, values, 2, 1, 0);
+	GET_STR_VALUE(from_uri, values, 3, 1, 0);
+	GET_STR_VALUE(from_tag, values, 4, 1, 0);
+	GET_STR_VALUE(to_uri, values, 5, 1, 0);
+	GET_STR_VALUE(req_uri, values, 20, 1, 0);
 
-	do {
-		/* for every row---dialog */
-		for(i=0; i<nr_rows; i++){
+	if((dlg=build_new_dlg(&callid, &from_uri, &to_uri, &from_tag,
+					&req_uri))==0){
+		LM_ERR("failed to build new dialog\n");
+		return -1;
+	}
 
-			values = ROW_VALUES(rows + i);
+	if(dlg->h_entry != VAL_INT(values)){
+		LM_ERR("inconsistent hash data in the dialog database: "
+			"you may have restarted Kamailio using a different "
+			"hash_size: please erase %.*s database and restart\n", 
+			dialog_table_name.len, dialog_table_name.s);
+		shm_free(dlg);
+		return -1;
+	}
 
-			if (VAL_NULL(values) || VAL_NULL(values+1)) {
-				LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
-					h_entry_column.len, h_entry_column.s,
-					h_id_column.len, h_id_column.s);
-				continue;
-			}
+	/*link the dialog*/
+	link_dlg(dlg, 0, 0);
 
-			if (VAL_NULL(values+7) || VAL_NULL(values+8)) {
-				LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
-					start_time_column.len, start_time_column.s,
-					state_column.len, state_column.s);
-				continue;
-			}
+	dlg->h_id = VAL_INT(values+1);
+	next_id = d_table->entries[dlg->h_entry].next_id;
 
-			/*restore the dialog info*/
-			GET_STR_VALUE(callid, values, 2, 1, 0);
-			GET_STR_VALUE(from_uri, values, 3, 1, 0);
-			GET_STR_VALUE(from_tag, values, 4, 1, 0);
-			GET_STR_VALUE(to_uri, values, 5, 1, 0);
-			GET_STR_VALUE(req_uri, values, 20, 1, 0);
+	d_table->entries[dlg->h_entry].next_id =
+		(next_id <= dlg->h_id) ? (dlg->h_id+1) : next_id;
 
-			if((dlg=build_new_dlg(&callid, &from_uri, &to_uri, &from_tag,
-							&req_uri))==0){
-				LM_ERR("failed to build new dialog\n");
-				goto error;
-			}
+	GET_STR_VALUE(to_tag, values, 6, 1, 1);
 
-			if(dlg->h_entry != VAL_INT(values)){
-				LM_ERR("inconsistent hash data in the dialog database: "
-					"you may have restarted Kamailio using a different "
-					"hash_size: please erase %.*s database and restart\n", 
-					dialog_table_name.len, dialog_table_name.s);
-				shm_free(dlg);
-				goto error;
-			}
+	dlg->start_ts	= VAL_INT(values+7);
+
+	dlg->state 		= VAL_INT(values+8);
+	if (dlg->state==DLG_STATE_CONFIRMED_NA ||
+	dlg->state==DLG_STATE_CONFIRMED) {
+		active_dlgs_cnt++;
+		if_update_stat(dlg_enable_stats, active_dlgs, 1);
+	} else if (dlg->state==DLG_STATE_EARLY) {
+		early_dlgs_cnt++;
+		if_update_stat(dlg_enable_stats, early_dlgs, 1);
+	}
+
+	dlg->tl.timeout = (unsigned int)(VAL_INT(values+9));
+	LM_DBG("db dialog timeout is %u (%u/%u)\n", dlg->tl.timeout,
+			get_ticks(), (unsigned int)time(0));
+	if (dlg->tl.timeout<=(unsigned int)time(0)) {
+		dlg->tl.timeout = 0;
+		dlg->lifetime = 0;
+	} else {
+		dlg->lifetime = dlg->tl.timeout - dlg->start_ts;
+		dlg->tl.timeout -= (unsigned int)time(0);
+	}
 
-			/*link the dialog*/
-			link_dlg(dlg, 0, 0);
+	GET_STR_VALUE(cseq1, values, 10 , 1, 1);
+	GET_STR_VALUE(cseq2, values, 11 , 1, 1);
+	GET_STR_VALUE(rroute1, values, 12, 0, 0);
+	GET_STR_VALUE(rroute2, values, 13, 0, 0);
+	GET_STR_VALUE(contact1, values, 14, 1, 1);
+	GET_STR_VALUE(contact2, values, 15, 1, 1);
+
+	if ( (dlg_set_leg_info( dlg, &from_tag, &rroute1, &contact1,
+	&cseq1, DLG_CALLER_LEG)!=0) ||
+	(dlg_set_leg_info( dlg, &to_tag, &rroute2, &contact2, &cseq2, DLG_CALLEE_LEG)!=0) ) {
+		LM_ERR("dlg_set_leg_info failed\n");
+		dlg_unref(dlg,1);
+		return 0;
+	}
 
-			dlg->h_id = VAL_INT(values+1);
-			next_id = d_table->entries[dlg->h_entry].next_id;
+	dlg->bind_addr[DLG_CALLER_LEG] = create_socket_info(values, 16);
+	dlg->bind_addr[DLG_CALLEE_LEG] = create_socket_info(values, 17);
 
-			d_table->entries[dlg->h_entry].next_id =
-				(next_id <= dlg->h_id) ? (dlg->h_id+1) : next_id;
+	dlg->sflags = (unsigned int)VAL_INT(values+18);
 
-			GET_STR_VALUE(to_tag, values, 6, 1, 1);
+	GET_STR_VALUE(toroute_name, values, 19, 0, 0);
+	dlg_set_toroute(dlg, &toroute_name);
 
-			dlg->start_ts	= VAL_INT(values+7);
+	GET_STR_VALUE(xdata, values, 21, 0, 0);
+	if(xdata.s!=NULL && dlg->state!=DLG_STATE_DELETED)
+	{
+		srjson_InitDoc(&jdoc, NULL);
+		jdoc.buf = xdata;
+		dlg_json_to_profiles(dlg, &jdoc);
+		srjson_DestroyDoc(&jdoc);
+	}
+	dlg->iflags = (unsigned int)VAL_INT(values+22);
 
-			dlg->state 		= VAL_INT(values+8);
-			if (dlg->state==DLG_STATE_CONFIRMED_NA ||
-			dlg->state==DLG_STATE_CONFIRMED) {
-				active_dlgs_cnt++;
-				if_update_stat(dlg_enable_stats, active_dlgs, 1);
-			} else if (dlg->state==DLG_STATE_EARLY) {
-				early_dlgs_cnt++;
-				if_update_stat(dlg_enable_stats, early_dlgs, 1);
-			}
+	if (!dlg->bind_addr[DLG_CALLER_LEG] || !dlg->bind_addr[DLG_CALLEE_LEG]) {
+		/* non-local socket, probably not our dialog */
+		dlg->iflags &= ~DLG_IFLAG_DMQ_SYNC;
+	}
 
-			dlg->tl.timeout = (unsigned int)(VAL_INT(values+9));
-			LM_DBG("db dialog timeout is %u (%u/%u)\n", dlg->tl.timeout,
-					get_ticks(), (unsigned int)time(0));
-			if (dlg->tl.timeout<=(unsigned int)time(0)) {
-				dlg->tl.timeout = 0;
-				dlg->lifetime = 0;
-			} else {
-				dlg->lifetime = dlg->tl.timeout - dlg->start_ts;
-				dlg->tl.timeout -= (unsigned int)time(0);
-			}
+	if(dlg->state==DLG_STATE_DELETED) {
+		/* end_ts used for force clean up not stored - set it to now */
+		dlg->end_ts = (unsigned int)time(0);
+	}
+	/*restore the timer values */
+	if (0 != insert_dlg_timer( &(dlg->tl), (int)dlg->tl.timeout )) {
+		LM_CRIT("Unable to insert dlg %p [%u:%u] "
+			"with clid '%.*s' and tags '%.*s' '%.*s'\n",
+			dlg, dlg->h_entry, dlg->h_id,
+			dlg->callid.len, dlg->callid.s,
+			dlg->tag[DLG_CALLER_LEG].len, dlg->tag[DLG_CALLER_LEG].s,
+			dlg->tag[DLG_CALLEE_LEG].len, dlg->tag[DLG_CALLEE_LEG].s);
+		dlg_unref(dlg,1);
+		return 0;
+	}
+	dlg_ref(dlg,1);
+	LM_DBG("current dialog timeout is %u (%u)\n", dlg->tl.timeout,
+			get_ticks());
 
-			GET_STR_VALUE(cseq1, values, 10 , 1, 1);
-			GET_STR_VALUE(cseq2, values, 11 , 1, 1);
-			GET_STR_VALUE(rroute1, values, 12, 0, 0);
-			GET_STR_VALUE(rroute2, values, 13, 0, 0);
-			GET_STR_VALUE(contact1, values, 14, 1, 1);
-			GET_STR_VALUE(contact2, values, 15, 1, 1);
-
-			if ( (dlg_set_leg_info( dlg, &from_tag, &rroute1, &contact1,
-			&cseq1, DLG_CALLER_LEG)!=0) ||
-			(dlg_set_leg_info( dlg, &to_tag, &rroute2, &contact2, &cseq2, DLG_CALLEE_LEG)!=0) ) {
-				LM_ERR("dlg_set_leg_info failed\n");
-				dlg_unref(dlg,1);
-				continue;
-			}
+	dlg->dflags = 0;
+	return 0;
 
-			dlg->bind_addr[DLG_CALLER_LEG] = create_socket_info(values, 16);
-			dlg->bind_addr[DLG_CALLEE_LEG] = create_socket_info(values, 17);
+next_dialog:
+	return 0;
+}
 
-			dlg->sflags = (unsigned int)VAL_INT(values+18);
 
-			GET_STR_VALUE(toroute_name, values, 19, 0, 0);
-			dlg_set_toroute(dlg, &toroute_name);
 
-			GET_STR_VALUE(xdata, values, 21, 0, 0);
-			if(xdata.s!=NULL && dlg->state!=DLG_STATE_DELETED)
-			{
-				srjson_InitDoc(&jdoc, NULL);
-				jdoc.buf = xdata;
-				dlg_json_to_profiles(dlg, &jdoc);
-				srjson_DestroyDoc(&jdoc);
-			}
-			dlg->iflags = (unsigned int)VAL_INT(values+22);
+static int load_dialog_info_from_db(int dlg_hash_size, int fetch_num_rows)
+{
+	db1_res_t * res;
+	db_val_t * values;
+	db_row_t * rows;
+	int i, nr_rows;
 
-			if (!dlg->bind_addr[DLG_CALLER_LEG] || !dlg->bind_addr[DLG_CALLEE_LEG]) {
-				/* non-local socket, probably not our dialog */
-				dlg->iflags &= ~DLG_IFLAG_DMQ_SYNC;
-			}
+	res = 0;
+	if((nr_rows = select_entire_dialog_table(&res, fetch_num_rows)) < 0)
+		goto end;
 
-			if(dlg->state==DLG_STATE_DELETED) {
-				/* end_ts used for force clean up not stored - set it to now */
-				dlg->end_ts = (unsigned int)time(0);
-			}
-			/*restore the timer values */
-			if (0 != insert_dlg_timer( &(dlg->tl), (int)dlg->tl.timeout )) {
-				LM_CRIT("Unable to insert dlg %p [%u:%u] "
-					"with clid '%.*s' and tags '%.*s' '%.*s'\n",
-					dlg, dlg->h_entry, dlg->h_id,
-					dlg->callid.len, dlg->callid.s,
-					dlg->tag[DLG_CALLER_LEG].len, dlg->tag[DLG_CALLER_LEG].s,
-					dlg->tag[DLG_CALLEE_LEG].len, dlg->tag[DLG_CALLEE_LEG].s);
-				dlg_unref(dlg,1);
-				continue;
-			}
-			dlg_ref(dlg,1);
-			LM_DBG("current dialog timeout is %u (%u)\n", dlg->tl.timeout,
-					get_ticks());
+	nr_rows = RES_ROW_N(res);
+
+	LM_DBG("the database has information about %i dialogs\n", nr_rows);
+
+	rows = RES_ROWS(res);
+
+	do {
+		/* for every row---dialog */
+		for(i=0; i<nr_rows; i++){
 
-			dlg->dflags = 0;
-			next_dialog:
-			;
+			values = ROW_VALUES(rows + i);
+
+			if (dlg_load_dialog_row(values) < 0)
+				goto error;
 		}
 
 		/* any more data to be fetched ?*/
@@ -519,12 +569,51 @@ static int select_entire_dialog_vars_table(db1_res_t ** res, int fetch_num_rows)
 	return 0;
 }
 
+/*!
+ * \brief Restore a dialog variable from a row of the dialog vars table
+ * \param values h_entry, h_id, key and value
+ */
+void dlg_load_vars_row(db_val_t *values)
+{
+	struct dlg_cell *dlg;
+
+	if (VAL_NULL(values) || VAL_NULL(values+1)) {
+		LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
+			vars_h_entry_column.len, vars_h_entry_column.s,
+			vars_h_id_column.len, vars_h_id_column.s);
+		return;
+	}
+
+	if (VAL_NULL(values+2) || VAL_NULL(values+3)) {
+		LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
+			vars_key_column.len, vars_key_column.s,
+			vars_value_column.len, vars_value_column.s);
+		return;
+	}
+	if (VAL_INT(values) < d_table->size) {
+		dlg = (d_table->entries)[VAL_INT(values)].first;
+		while (dlg) {
+			if (dlg->h_id == VAL_INT(values+1)) {
+				str key = { VAL_STR(values+2).s, strlen(VAL_STRING(values+2)) };
+				str value = { VAL_STR(values+3).s, strlen(VAL_STRING(values+3)) };
+				set_dlg_variable_unsafe(dlg, &key, &value);
+				break;
+			}
+			dlg = dlg->next;
+			if (!dlg) {
+				LM_WARN("insonsistent data: the dialog h_entry/h_id does not exist!\n");
+			}
+		}
+	} else {
+		LM_WARN("insonsistent data: the h_entry in the DB does not exist!\n");
+	}
+}
+
 static int load_dialog_vars_from_db(int fetch_num_rows)
 {
 	db1_res_t * res;
 	db_val_t * values;
 	db_row_t * rows;
-	struct dlg_cell  * dlg; 
 	int i, nr_rows;
 
 	res = 0;
@@ -543,36 +632,7 @@ static int load_dialog_vars_from_db(int fetch_num_rows)
 
 			values = ROW_VALUES(rows + i);
 
-			if (VAL_NULL(values) || VAL_NULL(values+1)) {
-				LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
-					vars_h_entry_column.len, vars_h_entry_column.s,
-					vars_h_id_column.len, vars_h_id_column.s);
-				continue;
-			}
-
-			if (VAL_NULL(values+2) || VAL_NULL(values+3)) {
-				LM_ERR("columns %.*s or/and %.*s cannot be null -> skipping\n",
-					vars_key_column.len, vars_key_column.s,
-					vars_value_column.len, vars_value_column.s);
-				continue;
-			}
-			if (VAL_INT(values) < d_table->size) {
-				dlg = (d_table->entries)[VAL_INT(values)].first;
-				while (dlg) {
-					if (dlg->h_id == VAL_INT(values+1)) {
-						str key = { VAL_STR(values+2).s, strlen(VAL_STRING(values+2)) };
-						str value = { VAL_STR(values+3).s, strlen(VAL_STRING(values+3)) };
-						set_dlg_variable_unsafe(dlg, &key, &value);
-						break;
-					}
-					dlg = dlg->next;
-					if (!dlg) {
-						LM_WARN("insonsistent data: the dialog h_entry/h_id does not exist!\n");
-					}
-				}
-			} else {
-				LM_WARN("insonsistent data: the h_entry in the DB does not exist!\n");
-			}
+			dlg_load_vars_row(values);
 		}
 
 		/* any more data to be fetched ?*/
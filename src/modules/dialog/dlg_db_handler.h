@@ -120,4 +120,7 @@ int remove_dialog_from_db(struct dlg_cell * cell);
 int update_dialog_dbinfo(struct dlg_cell * cell);
 void dialog_update_db(unsigned int ticks, void * param);
 
+int dlg_load_dialog_row(db_val_t *values);
+void dlg_load_vars_row(db_val_t *values);
+
 #endif
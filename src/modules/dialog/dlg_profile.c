@@ -29,6 +29,7 @@
 
 
 #include "../../core/mem/shm_mem.h"
+#include "../../core/mem/epoch.h"
 #include "../../core/hashes.h"
 #include "../../core/trim.h"
 #include "../../core/dprint.h"
@@ -224,15 +225,57 @@ static struct dlg_profile_table* new_dlg_profile( str *name, unsigned int size,
 }
 
 
+/* epoch domain of the value counters, which are read without taking the
+ * profile lock */
+static epoch_t *dlg_profiles_epoch = NULL;
+
+/*!
+ * \brief Init the deferred free of the value counters read without lock
+ * \note to be called in child_init with PROC_INIT
+ * \return 0 on success, -1 on failure
+ */
+int dlg_profiles_epoch_init(void)
+{
+	struct dlg_profile_table *profile;
+
+	for (profile=profiles ; profile ; profile=profile->next)
+		if (profile->has_value)
+			break;
+	if (profile==NULL)
+		return 0;
+	dlg_profiles_epoch = epoch_new();
+	return (dlg_profiles_epoch==NULL)?-1:0;
+}
+
+
+/*!
+ * \brief Free the value counters no reader can access anymore
+ */
+void dlg_profiles_epoch_reclaim(void)
+{
+	epoch_reclaim(dlg_profiles_epoch);
+}
+
+
 /*!
  * \brief Destroy a dialog profile list
  * \param profile dialog profile
  */
 static void destroy_dlg_profile(struct dlg_profile_table *profile)
 {
+	struct dlg_profile_vcount *vc;
+	unsigned int i;
+
 	if (profile==NULL)
 		return;
 
+	for (i=0 ; i<profile->size ; i++) {
+		while (profile->entries[i].vcounts) {
+			vc = profile->entries[i].vcounts;
+			profile->entries[i].vcounts = vc->next;
+			shm_free(vc);
+		}
+	}
 	lock_destroy( &profile->lock );
 	shm_free( profile );
 	return;
@@ -251,10 +294,92 @@ void destroy_dlg_profiles(void)
 		profiles = profiles->next;
 		destroy_dlg_profile( profile );
 	}
+	epoch_destroy(dlg_profiles_epoch);
+	dlg_profiles_epoch = NULL;
 	return;
 }
 
 
+/*!
+ * \brief Update the profile counters for an added item
+ * \note must be called with the profile lock held
+ * \param profile dialog profile table
+ * \param p_entry profile hash entry of the item
+ * \param value item value
+ * \return 0 on success, -1 on failure (nothing counted)
+ */
+static int profile_count_add(dlg_profile_table_t *profile,
+		dlg_profile_entry_t *p_entry, str *value)
+{
+	struct dlg_profile_vcount *vc;
+
+	if (profile->has_value) {
+		for (vc=p_entry->vcounts ; vc ; vc=vc->next) {
+			if (vc->value.len==value->len
+					&& memcmp(vc->value.s, value->s, value->len)==0)
+				break;
+		}
+		if (vc) {
+			atomic_inc(&vc->count);
+		} else {
+			vc = (struct dlg_profile_vcount*)shm_malloc(
+					sizeof(struct dlg_profile_vcount) + value->len + 1);
+			if (vc==NULL) {
+				LM_ERR("no more shm mem for the value counter in profile"
+						" <%.*s>\n", profile->name.len, profile->name.s);
+				return -1;
+			}
+			vc->value.s = (char*)(vc + 1);
+			memcpy(vc->value.s, value->s, value->len);
+			vc->value.s[value->len] = 0;
+			vc->value.len = value->len;
+			atomic_set(&vc->count, 1);
+			vc->next = p_entry->vcounts;
+			/* complete before the lock-free readers can see it */
+			membar_write();
+			p_entry->vcounts = vc;
+		}
+	}
+	p_entry->content++;
+	atomic_inc(&profile->count);
+	return 0;
+}
+
+
+/*!
+ * \brief Update the profile counters for a removed item
+ * \note must be called with the profile lock held
+ * \param profile dialog profile table
+ * \param p_entry profile hash entry of the item
+ * \param value item value
+ */
+static void profile_count_del(dlg_profile_table_t *profile,
+		dlg_profile_entry_t *p_entry, str *value)
+{
+	struct dlg_profile_vcount *vc;
+	struct dlg_profile_vcount *prev;
+
+	p_entry->content--;
+	atomic_dec(&profile->count);
+	if (profile->has_value==0)
+		return;
+	for (prev=NULL,vc=p_entry->vcounts ; vc ; prev=vc,vc=vc->next) {
+		if (vc->value.len==value->len
+				&& memcmp(vc->value.s, value->s, value->len)==0) {
+			if (atomic_dec_and_test(&vc->count)) {
+				if (prev)
+					prev->next = vc->next;
+				else
+					p_entry->vcounts = vc->next;
+				/* it can still be walked by get_profile_size() */
+				epoch_retire_shm(dlg_profiles_epoch, vc);
+			}
+			return;
+		}
+	}
+}
+
+
 /*!
  * \brief Destroy dialog linkers
  * \param linker dialog linker
@@ -283,7 +408,7 @@ void destroy_linkers(struct dlg_profile_link *linker)
 				lh->prev->next = lh->next;
 			}
 			lh->next = lh->prev = NULL;
-			p_entry->content --;
+			profile_count_del(l->profile, p_entry, &lh->value);
 			lock_release( &l->profile->lock );
 		}
 		/* free memory */
@@ -347,8 +472,8 @@ void remove_expired_remote_profiles(time_t te)
 							lh->prev->next = lh->next;
 						}
 						lh->next = lh->prev = NULL;
+						profile_count_del(profile, p_entry, &lh->value);
 						if(lh->linker) shm_free(lh->linker);
-						p_entry->content--;
 						lock_release(&profile->lock);
 						return;
 					}
@@ -392,8 +517,8 @@ int remove_profile(dlg_profile_table_t *profile, str *value, str *puid)
 					lh->prev->next = lh->next;
 				}
 				lh->next = lh->prev = NULL;
+				profile_count_del(profile, p_entry, &lh->value);
 				if(lh->linker) shm_free(lh->linker);
-				p_entry->content--;
 				lock_release(&profile->lock );
 				return 1;
 			}
@@ -462,8 +587,9 @@ int profile_cleanup( struct sip_msg *msg, unsigned int flags, void *param )
  * \brief Link a dialog profile
  * \param linker dialog linker
  * \param vkey key for profile hash table
+ * \return 0 on success, -1 on failure (linker not linked)
  */
-static void link_profile(struct dlg_profile_link *linker, str *vkey)
+static int link_profile(struct dlg_profile_link *linker, str *vkey)
 {
 	unsigned int hash;
 	struct dlg_profile_entry *p_entry;
@@ -475,6 +601,11 @@ static void link_profile(struct dlg_profile_link *linker, str *vkey)
 	/* insert into profile hash table */
 	p_entry = &linker->profile->entries[hash];
 	lock_get( &linker->profile->lock );
+	if (profile_count_add(linker->profile, p_entry,
+				&linker->hash_linker.value)<0) {
+		lock_release( &linker->profile->lock );
+		return -1;
+	}
 	if (p_entry->first) {
 		linker->hash_linker.prev = p_entry->first->prev;
 		linker->hash_linker.next = p_entry->first;
@@ -484,19 +615,27 @@ static void link_profile(struct dlg_profile_link *linker, str *vkey)
 		p_entry->first = linker->hash_linker.next 
 			= linker->hash_linker.prev = &linker->hash_linker;
 	}
-	p_entry->content ++;
 	lock_release( &linker->profile->lock );
+	return 0;
 }
 
 /*!
  * \brief Link a dialog profile
  * \param linker dialog linker
  * \param dlg dialog cell
+ * \return 0 on success, -1 on failure (linker not linked, to be freed
+ * by the caller)
  */
-static void link_dlg_profile(struct dlg_profile_link *linker, struct dlg_cell *dlg)
+static int link_dlg_profile(struct dlg_profile_link *linker, struct dlg_cell *dlg)
 {
 	struct dlg_entry *d_entry;
 
+	/* add to the profile first, so a linker that cannot be counted is not
+	 * added to the dialog */
+	linker->hash_linker.dlg = dlg;
+	if (link_profile(linker, &dlg->callid)<0)
+		return -1;
+
 	/* add the linker to the dialog */
 	/* FIXME zero h_id is not 100% for testing if the dialog is inserted
 	 * into the hash table -> we need circular lists  -bogdan */
@@ -505,16 +644,14 @@ static void link_dlg_profile(struct dlg_profile_link *linker, struct dlg_cell *d
 		dlg_lock( d_table, d_entry);
 		linker->next = dlg->profile_links;
 		dlg->profile_links =linker;
-		linker->hash_linker.dlg = dlg;
 		dlg_unlock( d_table, d_entry);
 	} else {
 		linker->next = dlg->profile_links;
 		dlg->profile_links =linker;
-		linker->hash_linker.dlg = dlg;
 	}
 
 	atomic_or_int((volatile int*)&dlg->dflags, DLG_FLAG_CHANGED_PROF);
-	link_profile(linker, &dlg->callid);
+	return 0;
 }
 
 
@@ -542,7 +679,12 @@ void set_current_dialog(sip_msg_t *msg, dlg_cell_t *dlg)
 			linker = linker->next;
 			/* process tlinker */
 			tlinker->next = NULL;
-			link_dlg_profile( tlinker, dlg);
+			if (link_dlg_profile( tlinker, dlg)<0) {
+				LM_ERR("failed to add dialog [%u:%u] to profile <%.*s>\n",
+						dlg->h_entry, dlg->h_id, tlinker->profile->name.len,
+						tlinker->profile->name.s);
+				shm_free(tlinker);
+			}
 		}
 	}
 	current_pending_linkers = NULL;
@@ -595,7 +737,10 @@ int set_dlg_profile(struct sip_msg *msg, str *value, struct dlg_profile_table *p
 
 	if (dlg!=NULL) {
 		/* add linker directly to the dialog and profile */
-		link_dlg_profile( linker, dlg);
+		if (link_dlg_profile( linker, dlg)<0) {
+			shm_free(linker);
+			goto error;
+		}
 	} else {
 		/* if existing linkers are not from current request, just discard them */
 		if (msg->id!=current_dlg_msg_id || msg->pid!=current_dlg_msg_pid) {
@@ -668,12 +813,18 @@ int dlg_add_profile(dlg_cell_t *dlg, str *value, struct dlg_profile_table *profi
 
 	/* add linker directly to the dialog and profile */
 	if(dlg!=NULL) {
-		link_dlg_profile(linker, dlg);
+		if(link_dlg_profile(linker, dlg)<0) {
+			shm_free(linker);
+			goto error;
+		}
 	} else {
 		vkey.s = linker->hash_linker.puid;
 		vkey.len = linker->hash_linker.puid_len;
 		profile->flags |= FLAG_PROFILE_REMOTE;
-		link_profile(linker, &vkey);
+		if(link_profile(linker, &vkey)<0) {
+			shm_free(linker);
+			goto error;
+		}
 	}
 	return 0;
 error:
@@ -807,36 +958,36 @@ done:
 unsigned int get_profile_size(struct dlg_profile_table *profile, str *value)
 {
 	unsigned int n,i;
-	struct dlg_profile_hash *ph;
+	struct dlg_profile_vcount *vc;
+	int epoch;
 
 	if (profile->has_value==0 || value==NULL) {
-		/* iterate through the hash and count all records */
-		lock_get( &profile->lock );
-		for( i=0,n=0 ; i<profile->size ; i++ )
-			n += profile->entries[i].content;
-		lock_release( &profile->lock );
-		return n;
+		/* total kept updated on link/unlink */
+		n = atomic_get(&profile->count);
+		return ((int)n<0)?0:n;
 	} else {
-		/* iterate through the hash entry and count only matching */
-		/* calculate the hash position */
+		/* look up the counter of the value in its hash entry - only
+		 * the distinct values of the entry are compared, not the items,
+		 * and without the profile lock if the process can be an epoch
+		 * reader (the removed counters are freed after it is done) */
 		i = calc_hash_profile( value, NULL, profile);
 		n = 0;
-		lock_get( &profile->lock );
-		ph = profile->entries[i].first;
-		if(ph) {
-			do {
-				/* compare */
-				if ( value->len==ph->value.len &&
-				memcmp(value->s,ph->value.s,value->len)==0 ) {
-					/* found */
-					n++;
-				}
-				/* next */
-				ph=ph->next;
-			}while( ph!=profile->entries[i].first );
+		epoch = (epoch_enter(dlg_profiles_epoch)==0);
+		if (!epoch)
+			lock_get( &profile->lock );
+		for (vc=profile->entries[i].vcounts ; vc ; vc=vc->next) {
+			membar_depends();
+			if (value->len==vc->value.len
+					&& memcmp(value->s, vc->value.s, value->len)==0) {
+				n = atomic_get(&vc->count);
+				break;
+			}
 		}
-		lock_release( &profile->lock );
-		return n;
+		if (epoch)
+			epoch_exit(dlg_profiles_epoch);
+		else
+			lock_release( &profile->lock );
+		return ((int)n<0)?0:n;
 	}
 }
 
@@ -37,6 +37,7 @@
 #include "../../lib/srutils/srjson.h"
 #include "../../lib/srutils/sruid.h"
 #include "../../core/locking.h"
+#include "../../core/atomic_ops.h"
 #include "../../core/str.h"
 #include "../../modules/tm/h_table.h"
 
@@ -73,10 +74,20 @@ typedef struct dlg_profile_link {
 } dlg_profile_link_t;
 
 
+/*! number of profile items with the same value, changed with the profile
+ * lock held and read without it (see get_profile_size()) */
+typedef struct dlg_profile_vcount {
+	str value; /*!< profile value */
+	atomic_t count; /*!< items with this value */
+	struct dlg_profile_vcount *next;
+} dlg_profile_vcount_t;
+
+
 /*! dialog profile entry */
 typedef struct dlg_profile_entry {
 	struct dlg_profile_hash *first;
 	unsigned int content; /*!< content of the entry */
+	struct dlg_profile_vcount *vcounts; /*!< per value counters (profiles with value) */
 } dlg_profile_entry_t;
 
 #define FLAG_PROFILE_REMOTE	1
@@ -88,6 +99,7 @@ typedef struct dlg_profile_table {
 	unsigned int has_value; /*!< 0 for profiles without value, otherwise it has a value */
 	int flags; /*!< flags related to the profile */
 	gen_lock_t lock; /*! lock for concurrent access */
+	atomic_t count; /*!< number of items in the profile */
 	struct dlg_profile_entry *entries;
 	struct dlg_profile_table *next;
 } dlg_profile_table_t;
@@ -103,6 +115,20 @@ typedef struct dlg_profile_table {
 int add_profile_definitions( char* profiles, unsigned int has_value);
 
 
+/*!
+ * \brief Init the deferred free of the value counters read without lock
+ * \note to be called in child_init with PROC_INIT
+ * \return 0 on success, -1 on failure
+ */
+int dlg_profiles_epoch_init(void);
+
+
+/*!
+ * \brief Free the value counters no reader can access anymore
+ */
+void dlg_profiles_epoch_reclaim(void);
+
+
 /*!
  * \brief Destroy the global dialog profile list
  */
@@ -0,0 +1,301 @@
+/**
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+/*!
+ * \file
+ * \brief Binary snapshots of the dialogs
+ * \ingroup dialog
+ * Module: \ref dialog
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../../core/dprint.h"
+#include "../../core/timer.h"
+#include "../../core/timer_proc.h"
+#include "../../core/counters.h"
+#include "../../lib/srdb1/db_snap.h"
+#include "dlg_hash.h"
+#include "dlg_var.h"
+#include "dlg_profile.h"
+#include "dlg_db_handler.h"
+#include "dlg_snap.h"
+
+#define DLG_SNAP_FNAME_SIZE 256
+
+str dlg_snapshot_dir = {0, 0};
+int dlg_snapshot_interval = 0;
+int dlg_snapshot_max_age = 600;
+
+extern int dlg_db_mode_param;
+
+/* set once the dialogs are loaded, so an aborted startup does not replace
+ * the snapshots with an empty table */
+static int _dlg_snap_ready = 0;
+
+
+static void dlg_snap_timer(unsigned int ticks, void *param)
+{
+	dlg_snap_save(0);
+}
+
+
+int dlg_snap_init(void)
+{
+	if (dlg_snapshot_dir.s==NULL || dlg_snapshot_dir.len<=0) {
+		dlg_snapshot_dir.s = NULL;
+		dlg_snapshot_dir.len = 0;
+		return 0;
+	}
+	/* with a db, only the snapshot written on shutdown is loaded */
+	if (dlg_snapshot_interval>0 && dlg_db_mode_param==DB_MODE_NONE
+			&& sr_wtimer_add(dlg_snap_timer, 0, dlg_snapshot_interval)<0) {
+		LM_ERR("failed to add the snapshot timer\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+void dlg_snap_set_ready(void)
+{
+	_dlg_snap_ready = 1;
+}
+
+
+/* file and content names, the content name includes the hash size so the
+ * h_entry values of the rows are valid */
+static int dlg_snap_names(char *vars, char *fname, char *name, int nsize)
+{
+	int n;
+
+	n = snprintf(fname, DLG_SNAP_FNAME_SIZE, "%.*s/dialog%s.snap",
+			dlg_snapshot_dir.len, dlg_snapshot_dir.s, (vars)?"_vars":"");
+	if (n<0 || n>=DLG_SNAP_FNAME_SIZE) {
+		LM_ERR("snapshot file name too long\n");
+		return -1;
+	}
+	snprintf(name, nsize, "dialog%s:%u", (vars)?"_vars":"", d_table->size);
+	return 0;
+}
+
+
+#define DLG_SNAP_STR(_v, _s) do { \
+		(_v)->type = DB1_STR; \
+		(_v)->nul = ((_s).s==NULL || (_s).len<=0); \
+		(_v)->val.str_val = (_s); \
+	} while(0)
+
+#define DLG_SNAP_INT(_v, _n) do { \
+		(_v)->type = DB1_INT; \
+		(_v)->nul = 0; \
+		(_v)->val.int_val = (int)(_n); \
+	} while(0)
+
+/* same columns and order as select_entire_dialog_table() */
+static void dlg_snap_dialog_vals(dlg_cell_t *dlg, srjson_doc_t *jdoc,
+		db_val_t *values)
+{
+	DLG_SNAP_INT(values, dlg->h_entry);
+	DLG_SNAP_INT(values+1, dlg->h_id);
+	DLG_SNAP_STR(values+2, dlg->callid);
+	DLG_SNAP_STR(values+3, dlg->from_uri);
+	DLG_SNAP_STR(values+4, dlg->tag[DLG_CALLER_LEG]);
+	DLG_SNAP_STR(values+5, dlg->to_uri);
+	DLG_SNAP_STR(values+6, dlg->tag[DLG_CALLEE_LEG]);
+	DLG_SNAP_INT(values+7, dlg->start_ts);
+	DLG_SNAP_INT(values+8, dlg->state);
+	DLG_SNAP_INT(values+9, (unsigned int)time(0) + dlg->tl.timeout
+			- get_ticks());
+	DLG_SNAP_STR(values+10, dlg->cseq[DLG_CALLER_LEG]);
+	DLG_SNAP_STR(values+11, dlg->cseq[DLG_CALLEE_LEG]);
+	DLG_SNAP_STR(values+12, dlg->route_set[DLG_CALLER_LEG]);
+	DLG_SNAP_STR(values+13, dlg->route_set[DLG_CALLEE_LEG]);
+	DLG_SNAP_STR(values+14, dlg->contact[DLG_CALLER_LEG]);
+	DLG_SNAP_STR(values+15, dlg->contact[DLG_CALLEE_LEG]);
+	if (dlg->bind_addr[DLG_CALLER_LEG]) {
+		DLG_SNAP_STR(values+16, dlg->bind_addr[DLG_CALLER_LEG]->sock_str);
+	} else {
+		values[16].type = DB1_STR;
+		values[16].nul = 1;
+	}
+	if (dlg->bind_addr[DLG_CALLEE_LEG]) {
+		DLG_SNAP_STR(values+17, dlg->bind_addr[DLG_CALLEE_LEG]->sock_str);
+	} else {
+		values[17].type = DB1_STR;
+		values[17].nul = 1;
+	}
+	DLG_SNAP_INT(values+18, dlg->sflags);
+	DLG_SNAP_STR(values+19, dlg->toroute_name);
+	DLG_SNAP_STR(values+20, dlg->req_uri);
+	DLG_SNAP_STR(values+21, jdoc->buf);
+	DLG_SNAP_INT(values+22, dlg->iflags);
+}
+
+
+void dlg_snap_save(int final)
+{
+	char fname[DLG_SNAP_FNAME_SIZE];
+	char vfname[DLG_SNAP_FNAME_SIZE];
+	char name[64];
+	char vname[64];
+	db_val_t values[DIALOG_TABLE_COL_NO];
+	db_val_t vvalues[DIALOG_VARS_TABLE_COL_NO];
+	db_snap_w_t w;
+	db_snap_w_t vw;
+	srjson_doc_t jdoc;
+	dlg_entry_t *entry;
+	dlg_cell_t *dlg;
+	dlg_var_t *var;
+	unsigned int i;
+	unsigned int flags;
+	int n;
+
+	if (dlg_snapshot_dir.s==NULL || _dlg_snap_ready==0)
+		return;
+	if (dlg_snap_names(0, fname, name, sizeof(name))<0
+			|| dlg_snap_names("v", vfname, vname, sizeof(vname))<0)
+		return;
+	if (db_snap_create(&w, fname, name, DIALOG_TABLE_COL_NO)<0)
+		return;
+	if (db_snap_create(&vw, vfname, vname, DIALOG_VARS_TABLE_COL_NO)<0) {
+		db_snap_abort(&w);
+		return;
+	}
+
+	n = 0;
+	for (i=0; i<d_table->size; i++) {
+		entry = &d_table->entries[i];
+		dlg_lock(d_table, entry);
+		for (dlg=entry->first; dlg; dlg=dlg->next) {
+			/* same as the db, not stored in initial or deleted states */
+			if (dlg->state<DLG_STATE_EARLY || dlg->state==DLG_STATE_DELETED)
+				continue;
+			srjson_InitDoc(&jdoc, NULL);
+			dlg_profiles_to_json(dlg, &jdoc);
+			dlg_snap_dialog_vals(dlg, &jdoc, values);
+			if (db_snap_add(&w, values)<0) {
+				if (jdoc.buf.s!=NULL)
+					jdoc.free_fn(jdoc.buf.s);
+				srjson_DestroyDoc(&jdoc);
+				dlg_unlock(d_table, entry);
+				goto error;
+			}
+			if (jdoc.buf.s!=NULL) {
+				jdoc.free_fn(jdoc.buf.s);
+				jdoc.buf.s = NULL;
+			}
+			srjson_DestroyDoc(&jdoc);
+			for (var=dlg->vars; var; var=var->next) {
+				if (var->vflags & DLG_FLAG_DEL)
+					continue;
+				DLG_SNAP_INT(vvalues, dlg->h_entry);
+				DLG_SNAP_INT(vvalues+1, dlg->h_id);
+				DLG_SNAP_STR(vvalues+2, var->key);
+				DLG_SNAP_STR(vvalues+3, var->value);
+				if (db_snap_add(&vw, vvalues)<0) {
+					dlg_unlock(d_table, entry);
+					goto error;
+				}
+			}
+			n++;
+		}
+		dlg_unlock(d_table, entry);
+	}
+
+	flags = (final)?DB_SNAP_F_FINAL:0;
+	/* the vars first, they are loaded only with the dialogs */
+	if (db_snap_commit(&vw, flags)<0) {
+		db_snap_abort(&w);
+		return;
+	}
+	if (db_snap_commit(&w, flags)<0)
+		return;
+	LM_DBG("%d dialogs written to %s\n", n, fname);
+	return;
+
+error:
+	LM_ERR("failed to write the dialog snapshots\n");
+	db_snap_abort(&vw);
+	db_snap_abort(&w);
+}
+
+
+int dlg_snap_load(void)
+{
+	char fname[DLG_SNAP_FNAME_SIZE];
+	char name[64];
+	db_val_t values[DIALOG_TABLE_COL_NO];
+	db_snap_t s;
+	unsigned int flags;
+	int ret;
+	int n;
+
+	if (dlg_snapshot_dir.s==NULL)
+		return 1;
+	if (dlg_snap_names(0, fname, name, sizeof(name))<0)
+		return 1;
+	/* with a database, only a snapshot of the updated table can be used */
+	flags = (dlg_db_mode_param==DB_MODE_NONE)?0:DB_SNAP_F_FINAL;
+	if (db_snap_open(&s, fname, name, DIALOG_TABLE_COL_NO,
+				dlg_snapshot_max_age, flags)<0)
+		return 1;
+
+	n = 0;
+	while ((ret=db_snap_next(&s, values))>0) {
+		if (dlg_load_dialog_row(values)<0) {
+			ret = -1;
+			break;
+		}
+		n++;
+	}
+	db_snap_close(&s);
+	if (ret<0) {
+		LM_ERR("failed to load the dialogs from snapshot %s\n", fname);
+		return -1;
+	}
+	LM_INFO("%d dialogs loaded from snapshot %s\n", n, fname);
+	if (dlg_db_mode_param!=DB_MODE_NONE && unlink(fname)<0)
+		LM_WARN("failed to remove snapshot %s: %s\n", fname, strerror(errno));
+
+	if (dlg_snap_names("v", fname, name, sizeof(name))<0)
+		return 0;
+	if (db_snap_open(&s, fname, name, DIALOG_VARS_TABLE_COL_NO,
+				dlg_snapshot_max_age, flags)<0) {
+		LM_WARN("dialog variables snapshot %s not loaded\n", fname);
+		return 0;
+	}
+	while ((ret=db_snap_next(&s, values))>0)
+		dlg_load_vars_row(values);
+	db_snap_close(&s);
+	if (ret<0)
+		LM_ERR("failed to load the dialog variables from snapshot %s\n",
+				fname);
+	if (dlg_db_mode_param!=DB_MODE_NONE && unlink(fname)<0)
+		LM_WARN("failed to remove snapshot %s: %s\n", fname, strerror(errno));
+	return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+/*!
+ * \file
+ * \brief Binary snapshots of the dialogs
+ *
+ * When snapshot_dir is set, the dialogs and their variables are written
+ * to dialog.snap and dialog_vars.snap (rows with the dialog and
+ * dialog_vars table columns, see lib/srdb1/db_snap.h) every
+ * snapshot_interval seconds and on shutdown. At startup they are loaded
+ * from the snapshots instead of the database. With a database, only the
+ * snapshots written on shutdown (after the final db update) are used and
+ * they are removed once loaded.
+ * \ingroup dialog
+ * Module: \ref dialog
+ */
+
+#ifndef _DLG_SNAP_H_
+#define _DLG_SNAP_H_
+
+#include "../../core/str.h"
+
+extern str dlg_snapshot_dir;
+extern int dlg_snapshot_interval;
+extern int dlg_snapshot_max_age;
+
+int dlg_snap_init(void);
+
+/*! \return 0 if the dialogs were loaded, 1 if there is no usable
+ * snapshot, -1 on error */
+int dlg_snap_load(void);
+
+/*! \brief enable the writes, once the dialogs are loaded */
+void dlg_snap_set_ready(void);
+
+void dlg_snap_save(int final);
+
+#endif
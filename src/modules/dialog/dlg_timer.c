@@ -38,13 +38,15 @@ dlg_timer_handler timer_hdl = 0;
 
 /*!
  * \brief Initialize the dialog timer handler
- * Initialize the dialog timer handler, allocate the lock and a global
- * timer in shared memory. The global timer handler will be set on success.
+ * Initialize the dialog timer handler, allocate the global timer wheel
+ * and its locks in shared memory. The global timer handler will be set on success.
  * \param hdl dialog timer handler
  * \return 0 on success, -1 on failure
  */
 int init_dlg_timer(dlg_timer_handler hdl)
 {
+	int i;
+
 	d_timer = (struct dlg_timer*)shm_malloc(sizeof(struct dlg_timer));
 	if (d_timer==0) {
 		LM_ERR("no more shm mem\n");
@@ -52,24 +54,21 @@ int init_dlg_timer(dlg_timer_handler hdl)
 	}
 	memset( d_timer, 0, sizeof(struct dlg_timer) );
 
-	d_timer->first.next = d_timer->first.prev = &(d_timer->first);
-
-	d_timer->lock = lock_alloc();
-	if (d_timer->lock==0) {
-		LM_ERR("failed to alloc lock\n");
-		goto error0;
-	}
-
-	if (lock_init(d_timer->lock)==0) {
-		LM_ERR("failed to init lock\n");
-		goto error1;
+	for (i=0; i<DLG_TIMER_SLOTS; i++) {
+		d_timer->slots[i].first.next = d_timer->slots[i].first.prev =
+			&(d_timer->slots[i].first);
+		if (lock_init(&d_timer->slots[i].lock)==0) {
+			LM_ERR("failed to init lock\n");
+			goto error;
+		}
 	}
+	d_timer->last = get_ticks();
 
 	timer_hdl = hdl;
 	return 0;
-error1:
-	lock_dealloc(d_timer->lock);
-error0:
+error:
+	while (--i >= 0)
+		lock_destroy(&d_timer->slots[i].lock);
 	shm_free(d_timer);
 	d_timer = 0;
 	return -1;
@@ -81,35 +80,66 @@ error0:
  */
 void destroy_dlg_timer(void)
 {
+	int i;
+
 	if (d_timer==0)
 		return;
 
-	lock_destroy(d_timer->lock);
-	lock_dealloc(d_timer->lock);
+	for (i=0; i<DLG_TIMER_SLOTS; i++)
+		lock_destroy(&d_timer->slots[i].lock);
 
 	shm_free(d_timer);
 	d_timer = 0;
 }
 
 
+/*!
+ * \brief Second of the wheel slot for a timeout
+ * A timeout that is not after the last second handled by the timer routine
+ * goes in the slot of the next second, to not wait a full wheel turn.
+ * \param timeout timeout in seconds
+ * \return slot second, the slot index is second & DLG_TIMER_MASK
+ */
+static inline unsigned int dlg_timer_second(unsigned int timeout)
+{
+	unsigned int last;
+
+	last = d_timer->last;
+	if ((int)(timeout - last) <= 0)
+		return last + 1;
+	return timeout;
+}
+
+
+/*!
+ * \brief Check if the timer routine handled the slot second since it was
+ * selected (must be called with the slot lock held, the routine updates
+ * the last second with it)
+ * \param sec slot second
+ * \return 1 if the slot must be selected again, 0 if not
+ */
+static inline int dlg_timer_second_passed(unsigned int sec)
+{
+	return ((int)(sec - d_timer->last) <= 0);
+}
+
+
 /*!
  * \brief Helper function for insert_dialog_timer
  * \see insert_dialog_timer
  * \param tl dialog timer list
+ * \param slot slot index, with the lock held
  */
-static inline void insert_dialog_timer_unsafe(struct dlg_tl *tl)
+static inline void insert_dialog_timer_unsafe(struct dlg_tl *tl,
+		unsigned int slot)
 {
-	struct dlg_tl* ptr;
-
-	/* insert in sorted order */
-	for(ptr = d_timer->first.prev; ptr != &d_timer->first ; ptr = ptr->prev) {
-		if ( ptr->timeout <= tl->timeout )
-			break;
-	}
+	struct dlg_tl *first;
 
 	LM_DBG("inserting %p for %d\n", tl,tl->timeout);
-	tl->prev = ptr;
-	tl->next = ptr->next;
+	first = &d_timer->slots[slot].first;
+	tl->slot = slot;
+	tl->prev = first->prev;
+	tl->next = first;
 	tl->prev->next = tl;
 	tl->next->prev = tl;
 }
@@ -123,18 +153,30 @@ static inline void insert_dialog_timer_unsafe(struct dlg_tl *tl)
  */
 int insert_dlg_timer(struct dlg_tl *tl, int interval)
 {
-	lock_get( d_timer->lock);
+	unsigned int timeout;
+	unsigned int sec;
+	unsigned int slot;
+
+	timeout = get_ticks()+interval;
+again:
+	sec = dlg_timer_second(timeout);
+	slot = sec & DLG_TIMER_MASK;
+	lock_get( &d_timer->slots[slot].lock);
 
 	if (tl->next!=0 || tl->prev!=0) {
 		LM_CRIT("Trying to insert a bogus dlg tl=%p tl->next=%p tl->prev=%p\n",
 			tl, tl->next, tl->prev);
-		lock_release( d_timer->lock);
+		lock_release( &d_timer->slots[slot].lock);
 		return -1;
 	}
-	tl->timeout = get_ticks()+interval;
-	insert_dialog_timer_unsafe( tl );
+	if (dlg_timer_second_passed(sec)) {
+		lock_release( &d_timer->slots[slot].lock);
+		goto again;
+	}
+	tl->timeout = timeout;
+	insert_dialog_timer_unsafe( tl, slot );
 
-	lock_release( d_timer->lock);
+	lock_release( &d_timer->slots[slot].lock);
 
 	return 0;
 }
@@ -160,26 +202,36 @@ static inline void remove_dialog_timer_unsafe(struct dlg_tl *tl)
  */
 int remove_dialog_timer(struct dlg_tl *tl)
 {
-	lock_get( d_timer->lock);
+	unsigned int slot;
+
+again:
+	slot = tl->slot;
+	lock_get( &d_timer->slots[slot].lock);
 
 	if (tl->prev==NULL && tl->timeout==0) {
-		lock_release( d_timer->lock);
+		lock_release( &d_timer->slots[slot].lock);
 		return 1;
 	}
 
 	if (tl->prev==NULL || tl->next==NULL) {
 		LM_CRIT("bogus tl=%p tl->prev=%p tl->next=%p\n",
 			tl, tl->prev, tl->next);
-		lock_release( d_timer->lock);
+		lock_release( &d_timer->slots[slot].lock);
 		return -1;
 	}
 
+	/* moved to another slot meanwhile */
+	if (tl->slot!=slot) {
+		lock_release( &d_timer->slots[slot].lock);
+		goto again;
+	}
+
 	remove_dialog_timer_unsafe(tl);
 	tl->next = NULL;
 	tl->prev = NULL;
 	tl->timeout = 0;
 
-	lock_release( d_timer->lock);
+	lock_release( &d_timer->slots[slot].lock);
 	return 0;
 }
 
@@ -189,72 +241,92 @@ int remove_dialog_timer(struct dlg_tl *tl)
  * \param tl dialog timer
  * \param timeout new timeout value in seconds
  * \return 0 on success, -1 when the input list is invalid
- * \note the update is implemented as a remove, insert
+ * \note the update is implemented as a remove, insert (with both slots
+ * locked)
  */
 int update_dlg_timer(struct dlg_tl *tl, int timeout)
 {
-	lock_get( d_timer->lock);
+	unsigned int old_slot;
+	unsigned int sec;
+	unsigned int slot;
+	unsigned int ntimeout;
+
+	ntimeout = get_ticks()+timeout;
+again:
+	old_slot = tl->slot;
+	sec = dlg_timer_second(ntimeout);
+	slot = sec & DLG_TIMER_MASK;
+	/* lock the slots in index order */
+	if (old_slot<=slot) {
+		lock_get( &d_timer->slots[old_slot].lock);
+		if (slot!=old_slot)
+			lock_get( &d_timer->slots[slot].lock);
+	} else {
+		lock_get( &d_timer->slots[slot].lock);
+		lock_get( &d_timer->slots[old_slot].lock);
+	}
 
 	if (tl->next==0 || tl->prev==0) {
 		LM_CRIT("Trying to update a bogus dlg tl=%p tl->next=%p tl->prev=%p\n",
 			tl, tl->next, tl->prev);
-		lock_release( d_timer->lock);
-		return -1;
+		goto error;
+	}
+	if (tl->slot!=old_slot || dlg_timer_second_passed(sec)) {
+		if (slot!=old_slot)
+			lock_release( &d_timer->slots[slot].lock);
+		lock_release( &d_timer->slots[old_slot].lock);
+		goto again;
 	}
 	remove_dialog_timer_unsafe( tl );
-	tl->timeout = get_ticks()+timeout;
-	insert_dialog_timer_unsafe( tl );
+	tl->timeout = ntimeout;
+	insert_dialog_timer_unsafe( tl, slot );
 
-	lock_release( d_timer->lock);
+	if (slot!=old_slot)
+		lock_release( &d_timer->slots[slot].lock);
+	lock_release( &d_timer->slots[old_slot].lock);
 	return 0;
+error:
+	if (slot!=old_slot)
+		lock_release( &d_timer->slots[slot].lock);
+	lock_release( &d_timer->slots[old_slot].lock);
+	return -1;
 }
 
 
 /*!
  * \brief Helper function for dlg_timer_routine
+ * Detach the expired timers of the slot of a second, the timers that
+ * expire in a later turn of the wheel are left in the slot.
+ * \param sec slot second
  * \param time time for expiration check
- * \return list of expired dialogs on success, 0 on failure
+ * \param ret list of expired dialogs, the detached ones are added to it
  */
-static inline struct dlg_tl* get_expired_dlgs(unsigned int time)
+static inline void get_expired_dlgs(unsigned int sec, unsigned int time,
+		struct dlg_tl **ret)
 {
-	struct dlg_tl *tl , *end, *ret;
-
-	lock_get( d_timer->lock);
-
-	if (d_timer->first.next==&(d_timer->first)
-	|| d_timer->first.next->timeout > time ) {
-		lock_release( d_timer->lock);
-		return 0;
-	}
-
-	end = &d_timer->first;
-	tl = d_timer->first.next;
-	LM_DBG("start with tl=%p tl->prev=%p tl->next=%p (%d) at %d "
-		"and end with end=%p end->prev=%p end->next=%p\n",
-		tl,tl->prev,tl->next,tl->timeout,time,
-		end,end->prev,end->next);
-	while( tl!=end && tl->timeout <= time) {
+	struct dlg_tl *tl, *end, *next;
+	unsigned int slot;
+
+	slot = sec & DLG_TIMER_MASK;
+	lock_get( &d_timer->slots[slot].lock);
+	/* the inserts done from now on go in a later slot */
+	d_timer->last = sec;
+
+	end = &d_timer->slots[slot].first;
+	for (tl=end->next; tl!=end; tl=next) {
+		next = tl->next;
+		if ((int)(tl->timeout - time) > 0)
+			continue;
 		LM_DBG("getting tl=%p tl->prev=%p tl->next=%p with %d\n",
 			tl,tl->prev,tl->next,tl->timeout);
+		remove_dialog_timer_unsafe(tl);
 		tl->prev = 0;
 		tl->timeout = 0;
-		tl=tl->next;
-	}
-	LM_DBG("end with tl=%p tl->prev=%p tl->next=%p and d_timer->first.next->prev=%p\n",
-		tl,tl->prev,tl->next,d_timer->first.next->prev);
-
-	if (tl==end && d_timer->first.next->prev) {
-		ret = 0;
-	} else {
-		ret = d_timer->first.next;
-		tl->prev->next = 0;
-		d_timer->first.next = tl;
-		tl->prev = &d_timer->first;
+		tl->next = *ret;
+		*ret = tl;
 	}
 
-	lock_release( d_timer->lock);
-
-	return ret;
+	lock_release( &d_timer->slots[slot].lock);
 }
 
 
@@ -267,8 +339,16 @@ static inline struct dlg_tl* get_expired_dlgs(unsigned int time)
 void dlg_timer_routine(unsigned int ticks , void * attr)
 {
 	struct dlg_tl *tl, *ctl;
-
-	tl = get_expired_dlgs( ticks );
+	unsigned int t;
+	unsigned int n;
+
+	/* walk the slots of the seconds since the last run (at most a wheel
+	 * turn at once, the next runs catch up if the routine was late) */
+	tl = 0;
+	for (t=d_timer->last+1, n=0; (int)(t - ticks) <= 0 && n<DLG_TIMER_SLOTS;
+			t++, n++) {
+		get_expired_dlgs(t, ticks, &tl);
+	}
 
 	while (tl) {
 		ctl = tl;
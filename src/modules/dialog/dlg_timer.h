@@ -39,14 +39,32 @@ typedef struct dlg_tl
 	struct dlg_tl     *next;
 	struct dlg_tl     *prev;
 	volatile unsigned int  timeout; /*!< timeout in seconds */
+	volatile unsigned int  slot;    /*!< timer wheel slot */
 } dlg_tl_t;
 
 
-/*! dialog timer */
-typedef struct dlg_timer
+/*! number of timer wheel slots (power of 2), one per second */
+#define DLG_TIMER_SLOTS		4096
+#define DLG_TIMER_MASK		(DLG_TIMER_SLOTS-1)
+
+/*! timer wheel slot, the timers that expire at the same second modulo
+ * DLG_TIMER_SLOTS (not sorted) */
+typedef struct dlg_timer_slot
 {
 	struct dlg_tl   first; /*!< dialog timeout list */
-	gen_lock_t      *lock; /*!< lock for the list */
+	gen_lock_t      lock;  /*!< lock for the list */
+} dlg_timer_slot_t;
+
+
+/*! dialog timer
+ * The timers are kept in a wheel of DLG_TIMER_SLOTS slots, each with its
+ * own lock, so an insert, update or remove is O(1) and locks only the
+ * slot(s) of the timer. The timer routine walks every second only the
+ * slot of that second. */
+typedef struct dlg_timer
+{
+	dlg_timer_slot_t slots[DLG_TIMER_SLOTS];
+	volatile unsigned int last; /*!< last second handled by the routine */
 } dlg_timer_t;
 
 
@@ -56,8 +74,8 @@ typedef void (*dlg_timer_handler)(struct dlg_tl *);
 
 /*!
  * \brief Initialize the dialog timer handler
- * Initialize the dialog timer handler, allocate the lock and a global
- * timer in shared memory. The global timer handler will be set on success.
+ * Initialize the dialog timer handler, allocate the global timer wheel
+ * and its locks in shared memory. The global timer handler will be set on success.
  * \param hdl dialog timer handler
  * \return 0 on success, -1 on failure
  */
@@ -93,7 +111,8 @@ int remove_dialog_timer(struct dlg_tl *tl);
  * \param tl dialog timer
  * \param timeout new timeout value in seconds
  * \return 0 on success, -1 when the input list is invalid
- * \note the update is implemented as a remove, insert
+ * \note the update is implemented as a remove, insert (with both slots
+ * locked)
  */
 int update_dlg_timer(struct dlg_tl *tl, int timeout);
 
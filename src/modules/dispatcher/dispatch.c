@@ -31,6 +31,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <limits.h>
+#include <sys/time.h>
 
 #include "../../core/ut.h"
 #include "../../core/trim.h"
@@ -64,6 +66,8 @@
 
 #define DS_ALG_RROBIN 4
 #define DS_ALG_LOAD 10
+#define DS_ALG_LATENCY 12
+#define DS_ALG_LEASTOUT 13
 
 static int _ds_table_version = DS_TABLE_VERSION;
 
@@ -88,6 +92,7 @@ int *next_idx = NULL;
 static void ds_run_route(struct sip_msg *msg, str *uri, char *route);
 
 void shuffle_uint100array(unsigned int *arr);
+unsigned int ds_get_hash(str *x, str *y);
 int ds_reinit_rweight_on_state_change(
 		int old_state, int new_state, ds_set_t *dset);
 
@@ -261,6 +266,9 @@ int ds_set_attrs(ds_dest_t *dest, str *attrs)
 		} else if(pit->name.len == 6
 				  && strncasecmp(pit->name.s, "socket", 6) == 0) {
 			dest->attrs.socket = pit->body;
+		} else if(pit->name.len == 13
+				  && strncasecmp(pit->name.s, "ping_interval", 13) == 0) {
+			str2sint(&pit->body, &dest->attrs.ping_interval);
 		} else if(pit->name.len == 7
 				  && strncasecmp(pit->name.s, "rweight", 7) == 0) {
 			tmp_rweight = 0;
@@ -569,6 +577,152 @@ randomize:
 	return 0;
 }
 
+/**
+ * mix the bits of a hash value, for placing it on the hashing ring
+ */
+static inline unsigned int ds_hash_mix(unsigned int h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/**
+ * number of items that can be selected by hashing - the last one is kept
+ * as the final option if use_default is set
+ */
+static inline int ds_select_range(ds_set_t *dset)
+{
+	if(ds_use_default != 0 && dset->nr != 1)
+		return dset->nr - 1;
+	return dset->nr;
+}
+
+static int ds_hpoint_cmp(const void *a, const void *b)
+{
+	if(((ds_hpoint_t *)a)->pos < ((ds_hpoint_t *)b)->pos)
+		return -1;
+	if(((ds_hpoint_t *)a)->pos > ((ds_hpoint_t *)b)->pos)
+		return 1;
+	return 0;
+}
+
+/**
+ * Initialize the consistent hashing ring for a destination set
+ * - each destination gets ds_hash_ring points, placed by the hash of its
+ *   address, and the ring is split in a power of two number of slots, so
+ *   the lookup is an index in the array of slots (see ds_init_select())
+ */
+int ds_init_hash_ring(ds_set_t *dset)
+{
+	int n;
+	int j;
+	int k;
+	int t;
+	unsigned int rsize;
+	char buf[INT2STR_MAX_LEN];
+	str vs;
+
+	if(ds_hash_ring <= 0 || dset == NULL || dset->dlist == NULL)
+		return 0;
+
+	n = ds_select_range(dset);
+	dset->hpoints =
+			(ds_hpoint_t *)shm_malloc(n * ds_hash_ring * sizeof(ds_hpoint_t));
+	if(dset->hpoints == NULL) {
+		LM_ERR("no more shm\n");
+		return -1;
+	}
+	t = 0;
+	for(j = 0; j < n; j++) {
+		for(k = 0; k < ds_hash_ring; k++) {
+			vs.s = int2strbuf(k, buf, INT2STR_MAX_LEN, &vs.len);
+			dset->hpoints[t].pos =
+					ds_hash_mix(ds_get_hash(&dset->dlist[j].uri, &vs));
+			dset->hpoints[t].dst = j;
+			t++;
+		}
+	}
+	qsort(dset->hpoints, t, sizeof(ds_hpoint_t), ds_hpoint_cmp);
+	dset->hpnr = t;
+
+	/* at least two slots per point, for an even split of the ring */
+	for(dset->hrbits = 10, rsize = 1 << 10;
+			rsize < 2 * t && dset->hrbits < 24; dset->hrbits++, rsize <<= 1)
+		;
+	dset->hring = (int *)shm_malloc(rsize * sizeof(int));
+	if(dset->hring == NULL) {
+		LM_ERR("no more shm\n");
+		shm_free(dset->hpoints);
+		dset->hpoints = NULL;
+		dset->hpnr = 0;
+		return -1;
+	}
+	for(j = 0; j < rsize; j++)
+		dset->hring[j] = -1;
+	return 0;
+}
+
+/**
+ * Fill the selection arrays of a destination set with the active items
+ * - anext[i] is the item to use when the selection (e.g., by hash modulo
+ *   or round robin) gives the index i, the next active one at or after it
+ * - hring[s] is the active item owning the ring slot s: the one of the
+ *   first active point at or after the start of the slot
+ * - to be called on load and when an item becomes active or inactive;
+ *   the arrays are updated in place, the selection checks the state of
+ *   the item found in them and falls back to walking the list
+ */
+int ds_init_select(ds_set_t *dset)
+{
+	int n;
+	int i;
+	int k;
+	int cur;
+	unsigned int s;
+	unsigned int pos;
+	unsigned int shift;
+
+	if(dset == NULL || dset->dlist == NULL)
+		return -1;
+
+	n = ds_select_range(dset);
+	if(dset->anext != NULL) {
+		/* first active item, for wrapping */
+		for(cur = 0; cur < n && ds_skip_dst(dset->dlist[cur].flags); cur++)
+			;
+		if(cur == n)
+			cur = -1;
+		for(i = n - 1; i >= 0; i--) {
+			if(!ds_skip_dst(dset->dlist[i].flags))
+				cur = i;
+			dset->anext[i] = cur;
+		}
+	}
+
+	if(dset->hring != NULL) {
+		for(k = 0; k < dset->hpnr
+					&& ds_skip_dst(dset->dlist[dset->hpoints[k].dst].flags);
+				k++)
+			;
+		cur = (k < dset->hpnr) ? dset->hpoints[k].dst : -1;
+		shift = 32 - dset->hrbits;
+		k = dset->hpnr - 1;
+		for(s = 1U << dset->hrbits; s > 0; s--) {
+			pos = (s - 1) << shift;
+			for(; k >= 0 && dset->hpoints[k].pos >= pos; k--) {
+				if(!ds_skip_dst(dset->dlist[dset->hpoints[k].dst].flags))
+					cur = dset->hpoints[k].dst;
+			}
+			dset->hring[s - 1] = cur;
+		}
+	}
+	return 0;
+}
+
 /*! \brief  compact destinations from sets for fast access */
 int reindex_dests(ds_set_t *node)
 {
@@ -612,6 +766,15 @@ int reindex_dests(ds_set_t *node)
 	dp_init_weights(node);
 	dp_init_relative_weights(node);
 
+	node->anext = (int *)shm_malloc(node->nr * sizeof(int));
+	if(node->anext == NULL) {
+		LM_ERR("no more memory!\n");
+		goto err1;
+	}
+	if(ds_init_hash_ring(node) != 0)
+		goto err1;
+	ds_init_select(node);
+
 	return 0;
 
 err1:
@@ -1349,6 +1512,83 @@ int ds_get_leastloaded(ds_set_t *dset)
 	return k;
 }
 
+/**
+ * Get the destination with the lowest response time, weighted by the
+ * number of outstanding requests. The destinations without samples are
+ * taken as slow as the slowest sampled one and the ties are taken in turn
+ */
+int ds_get_leastlatency(ds_set_t *dset)
+{
+	int i;
+	int j;
+	int k;
+	int n;
+	int avg;
+	int seed;
+	unsigned long long t;
+	unsigned long long v;
+
+	n = ds_select_range(dset);
+	seed = 0;
+	for(j = 0; j < n; j++) {
+		if(!ds_skip_dst(dset->dlist[j].flags)
+				&& dset->dlist[j].latency_stats.count > 0
+				&& dset->dlist[j].latency_stats.avg > seed)
+			seed = dset->dlist[j].latency_stats.avg;
+	}
+
+	k = -1;
+	t = 0;
+	for(i = 0; i < n; i++) {
+		j = (dset->last + i) % n;
+		if(ds_skip_dst(dset->dlist[j].flags))
+			continue;
+		avg = (dset->dlist[j].latency_stats.count > 0)
+					  ? dset->dlist[j].latency_stats.avg
+					  : seed;
+		v = (unsigned long long)avg
+			* (atomic_get(&dset->dlist[j].outstanding) + 1);
+		if(k < 0 || v < t) {
+			k = j;
+			t = v;
+		}
+	}
+	if(k >= 0)
+		dset->last = (k + 1) % n;
+	return k;
+}
+
+/**
+ * Get the destination with the least outstanding requests, starting
+ * after the last selected one so the ties are taken in turn
+ */
+int ds_get_leastoutstanding(ds_set_t *dset)
+{
+	int i;
+	int j;
+	int k;
+	int n;
+	int t;
+	int v;
+
+	k = -1;
+	t = 0;
+	n = ds_select_range(dset);
+	for(i = 0; i < n; i++) {
+		j = (dset->last + i) % n;
+		if(ds_skip_dst(dset->dlist[j].flags))
+			continue;
+		v = atomic_get(&dset->dlist[j].outstanding);
+		if(k < 0 || v < t) {
+			k = j;
+			t = v;
+		}
+	}
+	if(k >= 0)
+		dset->last = (k + 1) % n;
+	return k;
+}
+
 /**
  *
  */
@@ -1646,6 +1886,255 @@ static inline int ds_update_dst(
 	return 0;
 }
 
+/**
+ * current time in microseconds, for the response times
+ */
+static inline unsigned long long ds_get_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (unsigned long long)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+/**
+ * Get destination by group and address from the active list
+ */
+static ds_dest_t *ds_find_dst(int group, str *address)
+{
+	int i;
+	ds_set_t *idx = NULL;
+
+	if(_ds_list == NULL || _ds_list_nr <= 0)
+		return NULL;
+
+	if(ds_get_index(group, *crt_idx, &idx) != 0)
+		return NULL;
+
+	for(i = 0; i < idx->nr; i++) {
+		if(idx->dlist[i].uri.len == address->len
+				&& strncasecmp(idx->dlist[i].uri.s, address->s, address->len)
+						   == 0)
+			return &idx->dlist[i];
+	}
+	return NULL;
+}
+
+/**
+ * Add a response time sample to the destination stats. The updates are
+ * not locked, a lost sample only delays the average.
+ */
+static void ds_latency_add(ds_dest_t *dst, unsigned long long sent)
+{
+	long long rtt;
+
+	rtt = (long long)(ds_get_time_us() - sent);
+	if(rtt < 0 || rtt > INT_MAX)
+		return;
+	dst->latency_stats.last = (int)rtt;
+	if(dst->latency_stats.count == 0) {
+		dst->latency_stats.avg = (int)rtt;
+	} else {
+		/* exponential moving average, 1/8 of the new sample */
+		dst->latency_stats.avg += ((int)rtt - dst->latency_stats.avg) / 8;
+	}
+	dst->latency_stats.count++;
+}
+
+/**
+ * Update the response time of a destination on a keepalive reply
+ */
+static void ds_update_latency(int group, str *address)
+{
+	ds_dest_t *dst;
+	unsigned long long sent;
+
+	dst = ds_find_dst(group, address);
+	if(dst == NULL)
+		return;
+	sent = dst->ping_sent;
+	if(sent == 0)
+		return;
+	dst->ping_sent = 0;
+	ds_latency_add(dst, sent);
+}
+
+/*! branch of a tracked request, for the latency and least outstanding
+ * requests algorithms */
+typedef struct _ds_track_branch {
+	unsigned long long start;
+	int sent;
+	int replied;
+	int done;
+	str uri;
+} ds_track_branch_t;
+
+/*! request routed to the destinations of a group, tracked per branch */
+typedef struct _ds_track {
+	int group;
+	int nr;
+	ds_track_branch_t *br;
+} ds_track_t;
+
+/**
+ * Release the outstanding request of the branch destination, only once
+ * per branch and only if the branch was forwarded to the group
+ */
+static void ds_track_branch_done(ds_track_t *tp, ds_track_branch_t *bp)
+{
+	ds_dest_t *dst;
+
+	if(atomic_get_int(&bp->sent) == 0 || atomic_add_int(&bp->done, 1) != 1)
+		return;
+	dst = ds_find_dst(tp->group, &bp->uri);
+	/* the counter is reset if the list was reloaded meanwhile */
+	if(dst != NULL && atomic_get(&dst->outstanding) > 0)
+		atomic_dec(&dst->outstanding);
+}
+
+/**
+ * Release the outstanding requests of all the branches
+ */
+static void ds_track_done(ds_track_t *tp)
+{
+	int i;
+
+	for(i = 0; i < tp->nr; i++)
+		ds_track_branch_done(tp, &tp->br[i]);
+}
+
+/**
+ * tm callback - a branch is outstanding once forwarded to a destination
+ * of the group (the first one or a failover one), its first reply other
+ * than 100 gives the response time and its final reply ends it. The
+ * failure of the transaction ends all its branches.
+ */
+static void ds_track_callback(
+		struct cell *t, int type, struct tmcb_params *ps)
+{
+	ds_track_t *tp;
+	ds_track_branch_t *bp;
+	ds_dest_t *dst;
+	str *uri;
+	int b;
+
+	if(ps->param == NULL || *ps->param == NULL)
+		return;
+	tp = (ds_track_t *)(*ps->param);
+
+	if(type & TMCB_ON_FAILURE) {
+		ds_track_done(tp);
+		return;
+	}
+	if(type & TMCB_REQUEST_FWDED) {
+		/* called when the branch is created, before adding it, so
+		 * the slot is set again if the branch is not added */
+		b = t->nr_of_outgoings;
+		if(b >= tp->nr || ps->req == NULL)
+			return;
+		bp = &tp->br[b];
+		if(atomic_get_int(&bp->sent) != 0) {
+			/* the previous branch with this index was not added (e.g.,
+			 * dns or send buffer failure) - release and reuse the slot */
+			ds_track_branch_done(tp, bp);
+			atomic_set_int(&bp->sent, 0);
+			membar_write();
+			if(bp->uri.s != NULL)
+				shm_free(bp->uri.s);
+			memset(bp, 0, sizeof(ds_track_branch_t));
+		}
+		if(ps->req->dst_uri.len > 0)
+			uri = &ps->req->dst_uri;
+		else if(ps->req->new_uri.len > 0)
+			uri = &ps->req->new_uri;
+		else
+			uri = &ps->req->first_line.u.request.uri;
+		dst = ds_find_dst(tp->group, uri);
+		if(dst == NULL)
+			return; /* not sent to the group */
+		bp->uri.s = (char *)shm_malloc(uri->len + 1);
+		if(bp->uri.s == NULL) {
+			LM_ERR("no more shm\n");
+			return;
+		}
+		memcpy(bp->uri.s, uri->s, uri->len);
+		bp->uri.s[uri->len] = '\0';
+		bp->uri.len = uri->len;
+		atomic_inc(&dst->outstanding);
+		bp->start = ds_get_time_us();
+		membar_write(); /* uri and start set before sent */
+		atomic_set_int(&bp->sent, 1);
+		return;
+	}
+	/* TMCB_RESPONSE_IN - the reply branch is set before running it */
+	b = tmb.t_gett_branch();
+	if(b < 0 || b >= tp->nr)
+		return;
+	bp = &tp->br[b];
+	if(atomic_get_int(&bp->sent) == 0)
+		return;
+	if(ps->code > 100 && atomic_add_int(&bp->replied, 1) == 1) {
+		dst = ds_find_dst(tp->group, &bp->uri);
+		if(dst != NULL)
+			ds_latency_add(dst, bp->start);
+	}
+	if(ps->code >= 200)
+		ds_track_branch_done(tp, bp);
+}
+
+/**
+ * tm callback param release - the transaction was not completed or was
+ * never created (e.g., stateless forwarding)
+ */
+static void ds_track_release(void *param)
+{
+	ds_track_t *tp;
+	int i;
+
+	tp = (ds_track_t *)param;
+	ds_track_done(tp);
+	for(i = 0; i < tp->nr; i++) {
+		if(tp->br[i].uri.s != NULL)
+			shm_free(tp->br[i].uri.s);
+	}
+	shm_free(tp);
+}
+
+/**
+ * Track the request routed to the group with tm callbacks, each branch
+ * forwarded by the transaction to a destination of the group is counted
+ * as outstanding
+ */
+static int ds_track_add(sip_msg_t *msg, int group)
+{
+	ds_track_t *tp;
+
+	if(tmb.register_tmcb == NULL)
+		return 0;
+
+	tp = (ds_track_t *)shm_malloc(sizeof(ds_track_t)
+			+ sr_dst_max_branches * sizeof(ds_track_branch_t));
+	if(tp == NULL) {
+		LM_ERR("no more shm\n");
+		return -1;
+	}
+	memset(tp, 0, sizeof(ds_track_t)
+			+ sr_dst_max_branches * sizeof(ds_track_branch_t));
+	tp->group = group;
+	tp->nr = sr_dst_max_branches;
+	tp->br = (ds_track_branch_t *)((char *)tp + sizeof(ds_track_t));
+
+	if(tmb.register_tmcb(msg, 0,
+			   TMCB_REQUEST_FWDED | TMCB_RESPONSE_IN | TMCB_ON_FAILURE,
+			   ds_track_callback, (void *)tp, ds_track_release)
+			< 0) {
+		LM_ERR("cannot register tm callbacks\n");
+		shm_free(tp);
+		return -1;
+	}
+	return 0;
+}
+
 /**
  *
  */
@@ -1664,7 +2153,7 @@ int ds_select_dst(struct sip_msg *msg, int set, int alg, int mode)
 int ds_select_dst_limit(
 		sip_msg_t *msg, int set, int alg, unsigned int limit, int mode)
 {
-	int i, cnt;
+	int i, cnt, hashed;
 	unsigned int hash, lhash;
 	int_str avp_val;
 	ds_set_t *idx = NULL;
@@ -1703,6 +2192,7 @@ int ds_select_dst_limit(
 	LM_DBG("set [%d]\n", set);
 
 	hash = 0;
+	hashed = 1;
 	switch(alg) {
 		case 0: /* hash call-id */
 			if(ds_hash_callid(msg, &hash) != 0) {
@@ -1731,6 +2221,7 @@ int ds_select_dst_limit(
 		case DS_ALG_RROBIN: /* round robin */
 			hash = idx->last;
 			idx->last = (idx->last + 1) % idx->nr;
+			hashed = 0;
 			break;
 		case 5: /* hash auth username */
 			i = ds_hash_authusername(msg, &hash);
@@ -1742,6 +2233,7 @@ int ds_select_dst_limit(
 					/* No Authorization found: Use round robin */
 					hash = idx->last;
 					idx->last = (idx->last + 1) % idx->nr;
+					hashed = 0;
 					break;
 				default:
 					LM_ERR("can't get authorization hash\n");
@@ -1750,6 +2242,7 @@ int ds_select_dst_limit(
 			break;
 		case 6: /* random selection */
 			hash = kam_rand() % idx->nr;
+			hashed = 0;
 			break;
 		case 7: /* hash on PV value */
 			if(ds_hash_pvar(msg, &hash) != 0) {
@@ -1759,12 +2252,15 @@ int ds_select_dst_limit(
 			break;
 		case 8: /* use always first entry */
 			hash = 0;
+			hashed = 0;
 			break;
 		case 9: /* weight based distribution */
 			hash = idx->wlist[idx->wlast];
 			idx->wlast = (idx->wlast + 1) % 100;
+			hashed = 0;
 			break;
 		case DS_ALG_LOAD: /* call load based distribution */
+			hashed = 0;
 			/* only INVITE can start a call */
 			if(msg->first_line.u.request.method_value != METHOD_INVITE) {
 				/* use first entry */
@@ -1794,20 +2290,39 @@ int ds_select_dst_limit(
 		case 11: /* relative weight based distribution */
 			hash = idx->rwlist[idx->rwlast];
 			idx->rwlast = (idx->rwlast + 1) % 100;
+			hashed = 0;
+			break;
+		case DS_ALG_LATENCY: /* response time based distribution */
+		case DS_ALG_LEASTOUT: /* least outstanding requests */
+			hashed = 0;
+			if(alg == DS_ALG_LATENCY)
+				i = ds_get_leastlatency(idx);
+			else
+				i = ds_get_leastoutstanding(idx);
+			/* no active address - let the search below handle it */
+			hash = (i < 0) ? 0 : i;
 			break;
 		default:
 			LM_WARN("algo %d not implemented - using first entry...\n", alg);
 			hash = 0;
+			hashed = 0;
 	}
 
 	LM_DBG("alg hash [%u]\n", hash);
 	cnt = 0;
 
-	if(ds_use_default != 0 && idx->nr != 1)
-		hash = hash % (idx->nr - 1);
-	else
-		hash = hash % idx->nr;
-	i = hash;
+	i = -1;
+	if(hashed && idx->hring != NULL) {
+		/* consistent hashing - owner of the ring slot */
+		i = idx->hring[ds_hash_mix(hash) >> (32 - idx->hrbits)];
+	}
+	hash = hash % ds_select_range(idx);
+	if((i < 0 || ds_skip_dst(idx->dlist[i].flags)) && idx->anext != NULL) {
+		/* precomputed next active destination */
+		i = idx->anext[hash];
+	}
+	if(i < 0 || ds_skip_dst(idx->dlist[i].flags))
+		i = hash;
 
 	/* if selected address is inactive, find next active */
 	while(ds_skip_dst(idx->dlist[i].flags)) {
@@ -1838,6 +2353,13 @@ int ds_select_dst_limit(
 	/* if alg is round-robin then update the shortcut to next to be used */
 	if(alg == DS_ALG_RROBIN)
 		idx->last = (hash + 1) % idx->nr;
+	if((alg == DS_ALG_LATENCY || alg == DS_ALG_LEASTOUT)
+			&& msg->first_line.type == SIP_REQUEST
+			&& msg->first_line.u.request.method_value != METHOD_ACK) {
+		if(ds_track_add(msg, set) < 0)
+			LM_WARN("request to [%.*s] not tracked\n",
+					idx->dlist[hash].uri.len, idx->dlist[hash].uri.s);
+	}
 
 	LM_DBG("selected [%d-%d/%d] <%.*s>\n", alg, set, hash,
 			idx->dlist[hash].uri.len, idx->dlist[hash].uri.s);
@@ -2249,6 +2771,8 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, int state)
 			if(idx->dlist[i].attrs.rweight > 0)
 				ds_reinit_rweight_on_state_change(
 						old_state, idx->dlist[i].flags, idx);
+			if(!ds_skip_dst(old_state) != !ds_skip_dst(idx->dlist[i].flags))
+				ds_init_select(idx);
 
 			return 0;
 		}
@@ -2348,6 +2872,8 @@ int ds_reinit_state(int group, str *address, int state)
 				ds_reinit_rweight_on_state_change(
 						old_state, idx->dlist[i].flags, idx);
 			}
+			if(!ds_skip_dst(old_state) != !ds_skip_dst(idx->dlist[i].flags))
+				ds_init_select(idx);
 
 			return 0;
 		}
@@ -2577,6 +3103,7 @@ static void ds_options_callback(
 	 * We accept both a "200 OK" or the configured reply as a valid response */
 	if((ps->code >= 200 && ps->code <= 299)
 			|| ds_ping_check_rplcode(ps->code)) {
+		ds_update_latency(group, &uri);
 		/* Set the according entry back to "Active" */
 		state = 0;
 		if(ds_probing_mode == DS_PROBE_ALL
@@ -2605,12 +3132,41 @@ static void ds_options_callback(
 	return;
 }
 
+/**
+ * Send a keepalive request to a destination
+ */
+static void ds_ping_dst(ds_set_t *node, ds_dest_t *dst)
+{
+	uac_req_t uac_r;
+
+	LM_DBG("probing set #%d, URI %.*s\n", node->id, dst->uri.len,
+			dst->uri.s);
+
+	/* Send ping using TM-Module.
+	 * int request(str* m, str* ruri, str* to, str* from, str* h,
+	 *		str* b, str *oburi,
+	 *		transaction_cb cb, void* cbp); */
+	set_uac_req(&uac_r, &ds_ping_method, 0, 0, 0, TMCB_LOCAL_COMPLETED,
+			ds_options_callback, (void *)(long)node->id);
+	if(dst->attrs.socket.s != NULL && dst->attrs.socket.len > 0) {
+		uac_r.ssock = &dst->attrs.socket;
+	} else if(ds_default_socket.s != NULL && ds_default_socket.len > 0) {
+		uac_r.ssock = &ds_default_socket;
+	}
+	dst->ping_sent = ds_get_time_us();
+	if(tmb.t_request(&uac_r, &dst->uri, &dst->uri, &ds_ping_from,
+			   &ds_outbound_proxy)
+			< 0) {
+		LM_ERR("unable to ping [%.*s]\n", dst->uri.len, dst->uri.s);
+		dst->ping_sent = 0;
+	}
+}
+
 /**
  *
  */
 void ds_ping_set(ds_set_t *node)
 {
-	uac_req_t uac_r;
 	int i, j;
 
 	if(!node)
@@ -2626,28 +3182,48 @@ void ds_ping_set(ds_set_t *node)
 		/* If the Flag of the entry has "Probing set, send a probe:	*/
 		if(ds_probing_mode == DS_PROBE_ALL
 				|| (node->dlist[j].flags & DS_PROBING_DST) != 0) {
-			LM_DBG("probing set #%d, URI %.*s\n", node->id,
-					node->dlist[j].uri.len, node->dlist[j].uri.s);
-
-			/* Send ping using TM-Module.
-			 * int request(str* m, str* ruri, str* to, str* from, str* h,
-			 *		str* b, str *oburi,
-			 *		transaction_cb cb, void* cbp); */
-			set_uac_req(&uac_r, &ds_ping_method, 0, 0, 0, TMCB_LOCAL_COMPLETED,
-					ds_options_callback, (void *)(long)node->id);
-			if(node->dlist[j].attrs.socket.s != NULL
-					&& node->dlist[j].attrs.socket.len > 0) {
-				uac_r.ssock = &node->dlist[j].attrs.socket;
-			} else if(ds_default_socket.s != NULL
-					  && ds_default_socket.len > 0) {
-				uac_r.ssock = &ds_default_socket;
-			}
-			if(tmb.t_request(&uac_r, &node->dlist[j].uri, &node->dlist[j].uri,
-					   &ds_ping_from, &ds_outbound_proxy)
-					< 0) {
-				LM_ERR("unable to ping [%.*s]\n", node->dlist[j].uri.len,
-						node->dlist[j].uri.s);
-			}
+			ds_ping_dst(node, &node->dlist[j]);
+		}
+	}
+}
+
+/**
+ * Send the keepalives that are due, each destination being pinged every
+ * ping_interval (attribute) or ds_ping_interval seconds. The first
+ * keepalive is delayed by a hash of the address modulo the interval, so
+ * the requests are spread over the interval instead of sent in one burst.
+ */
+static void ds_ping_spread_set(ds_set_t *node, time_t now)
+{
+	int i, j;
+	int interval;
+	ds_dest_t *dst;
+
+	if(!node)
+		return;
+
+	for(i = 0; i < 2; ++i)
+		ds_ping_spread_set(node->next[i], now);
+
+	for(j = 0; j < node->nr; j++) {
+		dst = &node->dlist[j];
+		interval = (dst->attrs.ping_interval > 0) ? dst->attrs.ping_interval
+												  : ds_ping_interval;
+		if(interval <= 0)
+			continue;
+		if(dst->ping_next == 0) {
+			dst->ping_next = now + ds_get_hash(&dst->uri, NULL) % interval;
+		}
+		if(dst->ping_next > now)
+			continue;
+		dst->ping_next = now + interval;
+		/* skip addresses set in disabled state by admin */
+		if((dst->flags & DS_DISABLED_DST) != 0)
+			continue;
+		/* If the Flag of the entry has "Probing set, send a probe:	*/
+		if(ds_probing_mode == DS_PROBE_ALL
+				|| (dst->flags & DS_PROBING_DST) != 0) {
+			ds_ping_dst(node, dst);
 		}
 	}
 }
@@ -2675,6 +3251,27 @@ void ds_check_timer(unsigned int ticks, void *param)
 	ds_ping_set(_ds_list);
 }
 
+/*! \brief
+ * Timer for spread probing (ds_ping_spread)
+ *
+ * This timer is fired every second.
+ */
+void ds_ping_spread_timer(unsigned int ticks, void *param)
+{
+	/* Check for the list. */
+	if(_ds_list == NULL || _ds_list_nr <= 0) {
+		LM_DBG("no destination sets\n");
+		return;
+	}
+
+	if(_ds_ping_active != NULL && *_ds_ping_active == 0) {
+		LM_DBG("pinging destinations is inactive by admin\n");
+		return;
+	}
+
+	ds_ping_spread_set(_ds_list, time(NULL));
+}
+
 /*! \brief
  * Timer for checking expired items in call load dispatching
  *
@@ -2782,6 +3379,12 @@ void ds_avl_destroy(ds_set_t **node_ptr)
 	}
 	if(node->dlist != NULL)
 		shm_free(node->dlist);
+	if(node->anext != NULL)
+		shm_free(node->anext);
+	if(node->hpoints != NULL)
+		shm_free(node->hpoints);
+	if(node->hring != NULL)
+		shm_free(node->hring);
 	shm_free(node);
 
 	*node_ptr = NULL;
@@ -32,6 +32,7 @@
 #include "../../core/pvar.h"
 #include "../../core/parser/msg_parser.h"
 #include "../../core/rand/kam_rand.h"
+#include "../../core/atomic_ops.h"
 #include "../../modules/tm/tm_load.h"
 
 
@@ -67,6 +68,7 @@ extern str ds_dest_attrs_col;
 
 extern int ds_flags;
 extern int ds_use_default;
+extern int ds_hash_ring;
 
 extern int_str dst_avp_name;
 extern unsigned short dst_avp_type;
@@ -97,6 +99,8 @@ extern int probing_threshold;  /*!< number of failed requests,
 extern int inactive_threshold; /*!< number of successful requests,
 								before a destination is taken into active */
 extern int ds_probing_mode;
+extern int ds_ping_interval;
+extern int ds_ping_spread;
 extern str ds_outbound_proxy;
 extern str ds_default_socket;
 extern struct socket_info *ds_default_sockinfo;
@@ -134,6 +138,7 @@ int ds_is_addr_from_list(sip_msg_t *_m, int group, str *uri, int mode);
  * Timer for checking inactive destinations
  */
 void ds_check_timer(unsigned int ticks, void *param);
+void ds_ping_spread_timer(unsigned int ticks, void *param);
 
 
 /*! \brief
@@ -154,8 +159,16 @@ typedef struct _ds_attrs {
 	int maxload;
 	int weight;
 	int rweight;
+	int ping_interval; /*!< keepalive interval, 0 for ds_ping_interval */
 } ds_attrs_t;
 
+/*! round trip time of the keepalive requests, in microseconds */
+typedef struct _ds_latency_stats {
+	int avg;		/*!< moving average (1/8 of the new sample) */
+	int last;		/*!< last sample */
+	unsigned int count;	/*!< number of samples */
+} ds_latency_stats_t;
+
 typedef struct _ds_dest {
 	str uri;
 	int flags;
@@ -167,9 +180,19 @@ typedef struct _ds_dest {
 	unsigned short int port; 	/*!< Port of the URI */
 	unsigned short int proto; 	/*!< Protocol of the URI */
 	int message_count;
+	time_t ping_next;	/*!< time of the next keepalive (ds_ping_spread) */
+	unsigned long long ping_sent;	/*!< time of the last keepalive (usec) */
+	ds_latency_stats_t latency_stats;
+	atomic_t outstanding;	/*!< requests without final reply (algs 12, 13) */
 	struct _ds_dest *next;
 } ds_dest_t;
 
+/*! point of a destination on the consistent hashing ring */
+typedef struct _ds_hpoint {
+	unsigned int pos;
+	int dst;
+} ds_hpoint_t;
+
 typedef struct _ds_set {
 	int id;				/*!< id of dst set */
 	int nr;				/*!< number of items in dst set */
@@ -179,6 +202,11 @@ typedef struct _ds_set {
 	ds_dest_t *dlist;
 	unsigned int wlist[100];
 	unsigned int rwlist[100];
+	int *anext;			/*!< first active item at or after each index */
+	ds_hpoint_t *hpoints;	/*!< hashing ring points, sorted by pos */
+	int hpnr;			/*!< number of hashing ring points */
+	int *hring;			/*!< active item owning each ring slot */
+	unsigned int hrbits;	/*!< log2 of the number of ring slots */
 	struct _ds_set *next[2];
 	int longer;
 } ds_set_t;
@@ -72,6 +72,7 @@ char *dslistfile = CFG_DIR"dispatcher.list";
 int  ds_force_dst   = 1;
 int  ds_flags       = 0;
 int  ds_use_default = 0;
+int  ds_hash_ring   = 0;
 static str dst_avp_param = STR_NULL;
 static str grp_avp_param = STR_NULL;
 static str cnt_avp_param = STR_NULL;
@@ -101,7 +102,8 @@ int inactive_threshold = 1; /* number of replied requests, before a destination
 							 * is taken into back in active state */
 str ds_ping_method = str_init("OPTIONS");
 str ds_ping_from   = str_init("sip:dispatcher@localhost");
-static int ds_ping_interval = 0;
+int ds_ping_interval = 0;
+int ds_ping_spread = 0;
 int ds_probing_mode  = DS_PROBE_NONE;
 
 static str ds_ping_reply_codes_str= STR_NULL;
@@ -225,6 +227,7 @@ static param_export_t params[]={
 	{"force_dst",       INT_PARAM, &ds_force_dst},
 	{"flags",           INT_PARAM, &ds_flags},
 	{"use_default",     INT_PARAM, &ds_use_default},
+	{"ds_hash_ring",    INT_PARAM, &ds_hash_ring},
 	{"dst_avp",         PARAM_STR, &dst_avp_param},
 	{"grp_avp",         PARAM_STR, &grp_avp_param},
 	{"cnt_avp",         PARAM_STR, &cnt_avp_param},
@@ -239,6 +242,7 @@ static param_export_t params[]={
 	{"ds_ping_method",     PARAM_STR, &ds_ping_method},
 	{"ds_ping_from",       PARAM_STR, &ds_ping_from},
 	{"ds_ping_interval",   INT_PARAM, &ds_ping_interval},
+	{"ds_ping_spread",     INT_PARAM, &ds_ping_spread},
 	{"ds_ping_reply_codes", PARAM_STR, &ds_ping_reply_codes_str},
 	{"ds_probing_mode",    INT_PARAM, &ds_probing_mode},
 	{"ds_hash_size",       INT_PARAM, &ds_hash_size},
@@ -503,8 +507,10 @@ static int mod_init(void)
 			return -1;
 		}
 	}
-	/* Only, if the Probing-Timer is enabled the TM-API needs to be loaded: */
-	if(ds_ping_interval > 0) {
+	/* Only, if the Probing-Timer is enabled the TM-API needs to be loaded
+	 * (with ds_ping_spread the interval can be set only per destination,
+	 * by the ping_interval attribute): */
+	if(ds_ping_interval > 0 || ds_ping_spread != 0) {
 		/*****************************************************
 		 * TM-Bindings
 		 *****************************************************/
@@ -515,13 +521,28 @@ static int mod_init(void)
 		/*****************************************************
 		 * Register the PING-Timer
 		 *****************************************************/
-		if(ds_timer_mode == 1) {
+		if(ds_ping_spread != 0) {
+			/* every second, for the destinations that are due */
+			if(ds_timer_mode == 1) {
+				if(sr_wtimer_add(ds_ping_spread_timer, NULL, 1) < 0)
+					return -1;
+			} else {
+				if(register_timer(ds_ping_spread_timer, NULL, 1) < 0)
+					return -1;
+			}
+		} else if(ds_timer_mode == 1) {
 			if(sr_wtimer_add(ds_check_timer, NULL, ds_ping_interval) < 0)
 				return -1;
 		} else {
 			if(register_timer(ds_check_timer, NULL, ds_ping_interval) < 0)
 				return -1;
 		}
+	} else if(module_loaded("tm")) {
+		/* TM-Bindings for tracking the requests (algorithms 12 and 13) */
+		if(load_tm_api(&tmb) == -1) {
+			LM_ERR("could not load the TM-functions\n");
+			return -1;
+		}
 	}
 
 	return 0;
@@ -1113,6 +1134,21 @@ int ds_rpc_print_set(ds_set_t *node, rpc_t *rpc, void *ctx, void *rpc_handle)
 				return -1;
 			}
 		}
+		if(node->dlist[j].latency_stats.count > 0) {
+			if(rpc->struct_add(vh, "{", "LATENCY", &wh) < 0) {
+				rpc->fault(ctx, 500, "Internal error creating dest struct");
+				return -1;
+			}
+			/* microseconds */
+			if(rpc->struct_add(wh, "ddd", "AVG",
+					   node->dlist[j].latency_stats.avg, "LAST",
+					   node->dlist[j].latency_stats.last, "COUNT",
+					   (int)node->dlist[j].latency_stats.count)
+					< 0) {
+				rpc->fault(ctx, 500, "Internal error creating latency struct");
+				return -1;
+			}
+		}
 	}
 
 	return 0;
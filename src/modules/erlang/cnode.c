@@ -309,6 +309,16 @@ void cnode_main_loop(int cnode_id)
 				}
 				break;
 #endif
+#ifdef HAVE_IO_URING
+			case POLL_IOURING:
+				while(1){
+					r = io_wait_loop_uring(&io_h, IO_LISTEN_TIMEOUT, 0);
+					if(!r && enode_connect()) {
+						LM_ERR("failed reconnect to %.*s\n",STR_FMT(enode_name));
+					}
+				}
+				break;
+#endif
 #ifdef HAVE_KQUEUE
 			case POLL_KQUEUE:
 				while(1){
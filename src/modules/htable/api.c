@@ -127,6 +127,19 @@ int ht_api_count_cells_re(str *hname, str *sre, int mode)
 	return 0;
 }
 
+/**
+ * get the values of n integer items with one call
+ * - return the number of items found, -1 on error
+ */
+int ht_api_get_cell_ints(str *hname, str *names, int *vals, int n)
+{
+	ht_t* ht;
+	ht = ht_get_table(hname);
+	if(ht==NULL)
+		return -1;
+	return ht_get_cell_ints(ht, names, vals, n);
+}
+
 /**
  *
  */
@@ -142,6 +155,7 @@ int bind_htable(htable_api_t* api)
 	api->get_expire = ht_api_get_cell_expire;
 	api->rm_re    = ht_api_rm_cell_re;
 	api->count_re = ht_api_count_cells_re;
+	api->get_ints = ht_api_get_cell_ints;
 	return 0;
 }
 
@@ -36,6 +36,8 @@ typedef int (*ht_api_get_cell_expire_f)(str *hname, str *name,
 
 typedef int (*ht_api_rm_cell_re_f)(str *hname, str *sre, int mode);
 typedef int (*ht_api_count_cells_re_f)(str *hname, str *sre, int mode);
+typedef int (*ht_api_get_cell_ints_f)(str *hname, str *names, int *vals,
+		int n);
 
 typedef struct htable_api {
 	ht_api_set_cell_f set;
@@ -44,6 +46,7 @@ typedef struct htable_api {
 	ht_api_get_cell_expire_f get_expire;
 	ht_api_rm_cell_re_f rm_re;
 	ht_api_count_cells_re_f count_re;
+	ht_api_get_cell_ints_f get_ints;
 } htable_api_t;
 
 typedef int (*bind_htable_f)(htable_api_t* api);
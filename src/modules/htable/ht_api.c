@@ -37,6 +37,7 @@
 
 #include "ht_api.h"
 #include "ht_db.h"
+#include "../../core/mem/epoch.h"
 
 
 extern str ht_event_callback;
@@ -226,6 +227,109 @@ int ht_cell_pkg_free(ht_cell_t *cell)
 	return 0;
 }
 
+/* epoch domain of the counters tables, which are read without taking the
+ * slot lock */
+static epoch_t *_ht_epoch = NULL;
+
+/**
+ * init the epoch domain if there are counters tables, to be called in
+ * PROC_INIT, when the number of processes is known
+ */
+int ht_epoch_init(void)
+{
+	ht_t *ht;
+
+	for(ht=_ht_root; ht!=NULL; ht=ht->next)
+		if(ht->counters)
+			break;
+	if(ht==NULL)
+		return 0;
+	_ht_epoch = epoch_new();
+	return (_ht_epoch==NULL)?-1:0;
+}
+
+void ht_epoch_destroy(void)
+{
+	epoch_destroy(_ht_epoch);
+	_ht_epoch = NULL;
+}
+
+/**
+ * free a cell unlinked from a table
+ * - in a counters table the cell can still be walked by lock-free
+ *   readers, it is retired and freed after they are done
+ */
+void ht_cell_release(ht_t *ht, ht_cell_t *cell)
+{
+	if(ht->counters)
+		epoch_retire_shm(_ht_epoch, cell);
+	else
+		ht_cell_free(cell);
+}
+
+
+/**
+ * expiry list of a slot
+ * - the cells of an auto-expire table are kept ordered by etime, the
+ *   expire time they were queued with, so the timer only has to look at
+ *   the head of the list
+ * - an expire time extended later (e.g., updateexpire) does not move the
+ *   cell, the timer re-queues it when it reaches the head
+ * - must be called with the slot lock held
+ */
+static void ht_elist_add(ht_entry_t *e, ht_cell_t *cell)
+{
+	ht_cell_t *p;
+
+	cell->etime = cell->expire;
+	/* the new expire is usually the latest one */
+	for(p=e->elast; p!=NULL && p->etime>cell->etime; p=p->eprev);
+	cell->eprev = p;
+	if(p==NULL) {
+		cell->enext = e->efirst;
+		e->efirst = cell;
+	} else {
+		cell->enext = p->enext;
+		p->enext = cell;
+	}
+	if(cell->enext)
+		cell->enext->eprev = cell;
+	else
+		e->elast = cell;
+}
+
+static void ht_elist_rm(ht_entry_t *e, ht_cell_t *cell)
+{
+	if(cell->etime==0)
+		return;
+	if(cell->eprev)
+		cell->eprev->enext = cell->enext;
+	else
+		e->efirst = cell->enext;
+	if(cell->enext)
+		cell->enext->eprev = cell->eprev;
+	else
+		e->elast = cell->eprev;
+	cell->enext = cell->eprev = NULL;
+	cell->etime = 0;
+}
+
+/**
+ * set the expire time of a cell, must be called with the slot lock held
+ */
+static void ht_cell_expire_update(ht_entry_t *e, ht_cell_t *cell,
+		time_t expire)
+{
+	cell->expire = expire;
+	if(expire==0) {
+		ht_elist_rm(e, cell);
+	} else if(cell->etime==0) {
+		ht_elist_add(e, cell);
+	} else if(expire<cell->etime) {
+		ht_elist_rm(e, cell);
+		ht_elist_add(e, cell);
+	}
+}
 
 ht_t *ht_get_root(void)
 {
@@ -256,7 +360,7 @@ ht_t* ht_get_table(str *name)
 
 int ht_add_table(str *name, int autoexp, str *dbtable, str *dbcols, int size,
 		int dbmode, int itype, int_str *ival, int updateexpire,
-		int dmqreplicate)
+		int dmqreplicate, int snapshot, int counters)
 {
 	unsigned int htid;
 	ht_t *ht;
@@ -302,6 +406,8 @@ int ht_add_table(str *name, int autoexp, str *dbtable, str *dbcols, int size,
 	if(ival!=NULL)
 		ht->initval = *ival;
 	ht->dmqreplicate = dmqreplicate;
+	ht->snapshot = snapshot;
+	ht->counters = counters;
 
 	if(dbcols!=NULL && dbcols->s!=NULL && dbcols->len>0) {
 		ht->scols[0].s = (char*)shm_malloc((1+dbcols->len)*sizeof(char));
@@ -465,6 +571,13 @@ int ht_set_cell(ht_t *ht, str *name, int type, int_str *val, int mode)
 	if(ht==NULL || ht->entries==NULL)
 		return -1;
 
+	if(ht->counters && (type&AVP_VAL_STR))
+	{
+		LM_ERR("string value for [%.*s] in counters table [%.*s]\n",
+				name->len, name->s, ht->name.len, ht->name.s);
+		return -1;
+	}
+
 	hid = ht_compute_hash(name);
 
 	idx = ht_get_entry(hid, ht->htsize);
@@ -498,7 +611,7 @@ int ht_set_cell(ht_t *ht, str *name, int type, int_str *val, int mode)
 						it->value.s.s[it->value.s.len] = '\0';
 
 						if(ht->updateexpire)
-							it->expire = now + ht->htexpire;
+							ht_cell_expire_update(&ht->entries[idx], it, now + ht->htexpire);
 					} else {
 						/* new */
 						cell = ht_cell_new(name, type, val, hid);
@@ -520,14 +633,17 @@ int ht_set_cell(ht_t *ht, str *name, int type, int_str *val, int mode)
 							ht->entries[idx].first = cell;
 						if(it->next)
 							it->next->prev = cell;
-						ht_cell_free(it);
+						ht_elist_rm(&ht->entries[idx], it);
+						if(cell->expire)
+							ht_elist_add(&ht->entries[idx], cell);
+						ht_cell_release(ht, it);
 					}
 				} else {
 					it->flags &= ~AVP_VAL_STR;
 					it->value.n = val->n;
 
 					if(ht->updateexpire)
-						it->expire = now + ht->htexpire;
+						ht_cell_expire_update(&ht->entries[idx], it, now + ht->htexpire);
 				}
 				if(mode) ht_slot_unlock(ht, idx);
 				return 0;
@@ -554,12 +670,15 @@ int ht_set_cell(ht_t *ht, str *name, int type, int_str *val, int mode)
 						ht->entries[idx].first = cell;
 					if(it->next)
 						it->next->prev = cell;
-					ht_cell_free(it);
+					ht_elist_rm(&ht->entries[idx], it);
+					if(cell->expire)
+						ht_elist_add(&ht->entries[idx], cell);
+					ht_cell_release(ht, it);
 				} else {
 					it->value.n = val->n;
 
 					if(ht->updateexpire)
-						it->expire = now + ht->htexpire;
+						ht_cell_expire_update(&ht->entries[idx], it, now + ht->htexpire);
 				}
 				if(mode) ht_slot_unlock(ht, idx);
 				return 0;
@@ -584,15 +703,20 @@ int ht_set_cell(ht_t *ht, str *name, int type, int_str *val, int mode)
 			cell->next = ht->entries[idx].first;
 			ht->entries[idx].first->prev = cell;
 		}
+		/* lock-free readers must see the cell content before the link */
+		membar_write();
 		ht->entries[idx].first = cell;
 	} else {
 		cell->next = prev->next;
 		cell->prev = prev;
 		if(prev->next)
 			prev->next->prev = cell;
+		membar_write();
 		prev->next = cell;
 	}
 	ht->entries[idx].esize++;
+	if(cell->expire)
+		ht_elist_add(&ht->entries[idx], cell);
 	if(mode) ht_slot_unlock(ht, idx);
 	return 0;
 }
@@ -631,8 +755,9 @@ int ht_del_cell(ht_t *ht, str *name)
 			if(it->next)
 				it->next->prev = it->prev;
 			ht->entries[idx].esize--;
+			ht_elist_rm(&ht->entries[idx], it);
 			ht_slot_unlock(ht, idx);
-			ht_cell_free(it);
+			ht_cell_release(ht, it);
 			return 0;
 		}
 		it = it->next;
@@ -692,8 +817,9 @@ ht_cell_t* ht_cell_value_add(ht_t *ht, str *name, int val, int mode,
 					if(it->next)
 						it->next->prev = it->prev;
 					ht->entries[idx].esize--;
+					ht_elist_rm(&ht->entries[idx], it);
 					if(mode) ht_slot_unlock(ht, idx);
-					ht_cell_free(it);
+					ht_cell_release(ht, it);
 					return NULL;
 				}
 			}
@@ -704,9 +830,12 @@ ht_cell_t* ht_cell_value_add(ht_t *ht, str *name, int val, int mode,
 				if(mode) ht_slot_unlock(ht, idx);
 				return NULL;
 			} else {
-				it->value.n += val;
+				if(ht->counters)
+					atomic_add_int(&it->value.n, val);
+				else
+					it->value.n += val;
 				if(ht->updateexpire)
-					it->expire = now + ht->htexpire;
+					ht_cell_expire_update(&ht->entries[idx], it, now + ht->htexpire);
 				if(old!=NULL)
 				{
 					if(old->msize>=it->msize)
@@ -749,15 +878,19 @@ ht_cell_t* ht_cell_value_add(ht_t *ht, str *name, int val, int mode,
 			it->next = ht->entries[idx].first;
 			ht->entries[idx].first->prev = it;
 		}
+		membar_write();
 		ht->entries[idx].first = it;
 	} else {
 		it->next = prev->next;
 		it->prev = prev;
 		if(prev->next)
 			prev->next->prev = it;
+		membar_write();
 		prev->next = it;
 	}
 	ht->entries[idx].esize++;
+	if(it->expire)
+		ht_elist_add(&ht->entries[idx], it);
 	if(old!=NULL)
 	{
 		if(old->msize>=it->msize)
@@ -814,8 +947,9 @@ ht_cell_t* ht_cell_pkg_copy(ht_t *ht, str *name, ht_cell_t *old)
 				if(it->next)
 					it->next->prev = it->prev;
 				ht->entries[idx].esize--;
+				ht_elist_rm(&ht->entries[idx], it);
 				ht_slot_unlock(ht, idx);
-				ht_cell_free(it);
+				ht_cell_release(ht, it);
 				return NULL;
 			}
 			if(old!=NULL)
@@ -839,6 +973,161 @@ ht_cell_t* ht_cell_pkg_copy(ht_t *ht, str *name, ht_cell_t *old)
 	return NULL;
 }
 
+/**
+ * find an integer cell, without lock for the counters tables
+ * - the caller must hold the slot lock or be in an epoch read section
+ * - return the cell or NULL if not found or expired
+ */
+static ht_cell_t* ht_cell_int_find(ht_t *ht, str *name, unsigned int hid,
+		time_t now)
+{
+	ht_cell_t *it;
+
+	it = ht->entries[ht_get_entry(hid, ht->htsize)].first;
+	while(it!=NULL && it->cellid < hid)
+		it = it->next;
+	while(it!=NULL && it->cellid == hid)
+	{
+		if(name->len==it->name.len
+				&& strncmp(name->s, it->name.s, name->len)==0)
+		{
+			if(it->flags&AVP_VAL_STR)
+				return NULL;
+			if(now>0 && it->expire!=0 && it->expire<now)
+				return NULL;
+			return it;
+		}
+		it = it->next;
+	}
+	return NULL;
+}
+
+/**
+ * get the value of an integer cell without a pkg copy
+ * - no lock is taken for the counters tables
+ * - expired items are not removed here, it is left to the timer
+ * - return 0 if found, 1 if not found, -1 on error
+ */
+int ht_get_cell_int(ht_t *ht, str *name, int *val)
+{
+	unsigned int idx;
+	unsigned int hid;
+	ht_cell_t *it;
+	time_t now;
+	int ret;
+
+	if(ht==NULL || ht->entries==NULL)
+		return -1;
+
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+	now = (ht->htexpire>0)?time(NULL):0;
+
+	ret = 1;
+	if(ht->counters && epoch_enter(_ht_epoch)==0)
+	{
+		it = ht_cell_int_find(ht, name, hid, now);
+		if(it!=NULL)
+		{
+			*val = atomic_get_int(&it->value.n);
+			ret = 0;
+		}
+		epoch_exit(_ht_epoch);
+		return ret;
+	}
+
+	/* head test and return */
+	if(ht->entries[idx].first==NULL)
+		return 1;
+	ht_slot_lock(ht, idx);
+	it = ht_cell_int_find(ht, name, hid, now);
+	if(it!=NULL)
+	{
+		*val = it->value.n;
+		ret = 0;
+	}
+	ht_slot_unlock(ht, idx);
+	return ret;
+}
+
+/**
+ * get the values of n integer cells
+ * - missing items get the initval of the table, or 0 if it has none
+ * - return the number of items found, -1 on error
+ */
+int ht_get_cell_ints(ht_t *ht, str *names, int *vals, int n)
+{
+	int i;
+	int found;
+	int epoch;
+	int ret;
+
+	if(ht==NULL || ht->entries==NULL || names==NULL || vals==NULL)
+		return -1;
+
+	/* one read section for all the items */
+	epoch = (ht->counters && epoch_enter(_ht_epoch)==0);
+	found = 0;
+	for(i=0; i<n; i++)
+	{
+		ret = ht_get_cell_int(ht, &names[i], &vals[i]);
+		if(ret==0) {
+			found++;
+		} else {
+			vals[i] = (ht->flags==PV_VAL_INT)?ht->initval.n:0;
+		}
+	}
+	if(epoch)
+		epoch_exit(_ht_epoch);
+	return found;
+}
+
+/**
+ * add val to an integer cell, creating it if the table has an initval
+ * - the update of an existing item in a counters table is lock-free
+ * - return 0 and the new value in res, 1 if the item was not found or
+ *   has a string value, -1 on error
+ */
+int ht_cell_int_add(ht_t *ht, str *name, int val, int *res)
+{
+	unsigned int hid;
+	ht_cell_t *it;
+	time_t now;
+
+	if(ht==NULL || ht->entries==NULL)
+		return -1;
+
+	if(ht->counters && epoch_enter(_ht_epoch)==0)
+	{
+		hid = ht_compute_hash(name);
+		now = (ht->htexpire>0)?time(NULL):0;
+		it = ht_cell_int_find(ht, name, hid, now);
+		/* a later expire of a queued cell is picked up by the timer, a
+		 * cell that is not in the expiry list has to be queued under lock */
+		if(it!=NULL && (now==0 || ht->updateexpire==0 || it->etime!=0))
+		{
+			*res = atomic_add_int(&it->value.n, val);
+			if(now>0 && ht->updateexpire)
+				it->expire = now + ht->htexpire;
+			epoch_exit(_ht_epoch);
+			return 0;
+		}
+		epoch_exit(_ht_epoch);
+	}
+
+	/* new or expired item - done under slot lock */
+	it = ht_cell_value_add(ht, name, val, 1, NULL);
+	if(it==NULL)
+		return 1;
+	if(it->flags&AVP_VAL_STR) {
+		ht_cell_pkg_free(it);
+		return 1;
+	}
+	*res = it->value.n;
+	ht_cell_pkg_free(it);
+	return 0;
+}
+
 int ht_dbg(void)
 {
 	int i;
@@ -884,6 +1173,8 @@ int ht_table_spec(char *spec)
 	unsigned int dbmode = 0;
 	unsigned int updateexpire = 1;
 	unsigned int dmqreplicate = 0;
+	unsigned int snapshot = 0;
+	unsigned int counters = 0;
 	str in;
 	str tok;
 	param_t *pit=NULL;
@@ -949,11 +1240,21 @@ int ht_table_spec(char *spec)
 				goto error;
 
 			LM_DBG("htable [%.*s] - dmqreplicate [%u]\n", name.len, name.s, dmqreplicate);
+		} else if(pit->name.len==8 && strncmp(pit->name.s, "snapshot", 8)==0) {
+			if(str2int(&tok, &snapshot)!=0)
+				goto error;
+			LM_DBG("htable [%.*s] - snapshot [%u]\n", name.len, name.s,
+					snapshot);
+		} else if(pit->name.len==8 && strncmp(pit->name.s, "counters", 8)==0) {
+			if(str2int(&tok, &counters)!=0)
+				goto error;
+			LM_DBG("htable [%.*s] - counters [%u]\n", name.len, name.s,
+					counters);
 		} else { goto error; }
 	}
 
 	return ht_add_table(&name, autoexpire, &dbtable, &dbcols, size, dbmode,
-			itype, &ival, updateexpire, dmqreplicate);
+			itype, &ival, updateexpire, dmqreplicate, snapshot, counters);
 
 error:
 	LM_ERR("invalid htable parameter [%.*s]\n", in.len, in.s);
@@ -967,7 +1268,7 @@ int ht_db_load_tables(void)
 	ht = _ht_root;
 	while(ht)
 	{
-		if(ht->dbtable.len>0)
+		if(ht->dbtable.len>0 && ht->snap_loaded==0)
 		{
 			LM_DBG("loading db table [%.*s] in ht [%.*s]\n",
 					ht->dbtable.len, ht->dbtable.s,
@@ -1025,7 +1326,7 @@ void ht_timer(unsigned int ticks, void *param)
 {
 	ht_t *ht;
 	ht_cell_t *it;
-	ht_cell_t *it0;
+	ht_entry_t *e;
 	time_t now;
 	int i;
 	int istart;
@@ -1047,32 +1348,41 @@ void ht_timer(unsigned int ticks, void *param)
 		{
 			for(i=istart; i<ht->htsize; i+=istep)
 			{
-				/* free entries */
+				e = &ht->entries[i];
+				/* head test - nothing to expire in the slot */
+				if(e->efirst==NULL)
+					continue;
+				/* free entries - only the head of the expiry list is
+				 * checked, the rest of it expires later */
 				ht_slot_lock(ht, i);
-				it = ht->entries[i].first;
-				while(it)
+				while((it=e->efirst)!=NULL && it->etime<now)
 				{
-					it0 = it->next;
-					if(it->expire!=0 && it->expire<now)
+					ht_elist_rm(e, it);
+					if(it->expire==0)
+						continue;
+					if(it->expire>=now)
 					{
-						/* expired */
-						ht_handle_expired_record(ht, it);
-						if(it->prev==NULL)
-							ht->entries[i].first = it->next;
-						else
-							it->prev->next = it->next;
-						if(it->next)
-							it->next->prev = it->prev;
-						ht->entries[i].esize--;
-						ht_cell_free(it);
+						/* expire extended since it was queued */
+						ht_elist_add(e, it);
+						continue;
 					}
-					it = it0;
+					/* expired */
+					ht_handle_expired_record(ht, it);
+					if(it->prev==NULL)
+						e->first = it->next;
+					else
+						it->prev->next = it->next;
+					if(it->next)
+						it->next->prev = it->prev;
+					e->esize--;
+					ht_cell_release(ht, it);
 				}
 				ht_slot_unlock(ht, i);
 			}
 		}
 		ht = ht->next;
 	}
+	epoch_reclaim(_ht_epoch);
 	return;
 }
 
@@ -1165,7 +1475,7 @@ int ht_set_cell_expire(ht_t *ht, str *name, int type, int_str *val)
 				&& strncmp(name->s, it->name.s, name->len)==0)
 		{
 			/* update value */
-			it->expire = now;
+			ht_cell_expire_update(&ht->entries[idx], it, now);
 			ht_slot_unlock(ht, idx);
 			return 0;
 		}
@@ -1260,7 +1570,8 @@ int ht_rm_cell_re(str *sre, ht_t *ht, int mode)
 				if(it->next)
 					it->next->prev = it->prev;
 				ht->entries[i].esize--;
-				ht_cell_free(it);
+				ht_elist_rm(&ht->entries[i], it);
+				ht_cell_release(ht, it);
 			}
 			it = it0;
 		}
@@ -1294,7 +1605,8 @@ int ht_reset_content(ht_t *ht)
 			if(it->next)
 				it->next->prev = it->prev;
 			ht->entries[i].esize--;
-			ht_cell_free(it);
+			ht_elist_rm(&ht->entries[i], it);
+			ht_cell_release(ht, it);
 			it = it0;
 		}
 		ht_slot_unlock(ht, i);
@@ -40,14 +40,19 @@ typedef struct _ht_cell
 	str name;
 	int_str value;
 	time_t  expire;
+	time_t  etime;       /* expire time in the expiry list, 0 if not in it */
     struct _ht_cell *prev;
     struct _ht_cell *next;
+    struct _ht_cell *eprev; /* expiry list of the slot */
+    struct _ht_cell *enext;
 } ht_cell_t;
 
 typedef struct _ht_entry
 {
 	unsigned int esize;  /* number of items in the slot */
 	ht_cell_t *first;    /* first item in the slot */
+	ht_cell_t *efirst;   /* expiry list, ordered by etime */
+	ht_cell_t *elast;
 	gen_lock_t lock;     /* mutex to access items in the slot */
 	atomic_t locker_pid; /* pid of the process that holds the lock */
 	int rec_lock_level;  /* recursive lock count */
@@ -71,6 +76,9 @@ typedef struct _ht
 	int updateexpire;
 	unsigned int htsize;
 	int dmqreplicate;
+	int snapshot;
+	int snap_loaded;
+	int counters;
 	int evex_index;
 	char evex_name_buf[HT_EVEX_NAME_SIZE];
 	str evex_name;
@@ -86,7 +94,7 @@ typedef struct _ht_pv {
 
 int ht_add_table(str *name, int autoexp, str *dbtable, str *dbcols, int size,
 		int dbmode, int itype, int_str *ival, int updateexpire,
-		int dmqreplicate);
+		int dmqreplicate, int snapshot, int counters);
 int ht_init_tables(void);
 int ht_destroy(void);
 int ht_set_cell(ht_t *ht, str *name, int type, int_str *val, int mode);
@@ -98,6 +106,13 @@ int ht_dbg(void);
 ht_cell_t* ht_cell_pkg_copy(ht_t *ht, str *name, ht_cell_t *old);
 int ht_cell_pkg_free(ht_cell_t *cell);
 int ht_cell_free(ht_cell_t *cell);
+void ht_cell_release(ht_t *ht, ht_cell_t *cell);
+int ht_epoch_init(void);
+void ht_epoch_destroy(void);
+
+int ht_get_cell_int(ht_t *ht, str *name, int *val);
+int ht_get_cell_ints(ht_t *ht, str *names, int *vals, int n);
+int ht_cell_int_add(ht_t *ht, str *name, int val, int *res);
 
 int ht_table_spec(char *spec);
 ht_t* ht_get_table(str *name);
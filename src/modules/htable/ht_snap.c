@@ -0,0 +1,246 @@
+/**
+ *
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../../core/dprint.h"
+#include "../../core/usr_avp.h"
+#include "../../core/timer_proc.h"
+#include "../../lib/srdb1/db_snap.h"
+
+#include "ht_snap.h"
+
+/* name, value type, value, absolute expire time */
+#define HT_SNAP_COLS 4
+#define HT_SNAP_FNAME_SIZE 256
+
+str ht_snapshot_dir = {0, 0};
+int ht_snapshot_interval = 0;
+int ht_snapshot_max_age = 600;
+
+/* set once the tables are loaded, so an aborted startup does not replace
+ * the snapshots with empty tables */
+static int _ht_snap_ready = 0;
+
+static void ht_snap_timer(unsigned int ticks, void *param)
+{
+	ht_snap_save_tables(0);
+}
+
+void ht_snap_set_ready(void)
+{
+	_ht_snap_ready = 1;
+}
+
+int ht_snap_init(void)
+{
+	ht_t *ht;
+
+	if(ht_snapshot_dir.s==NULL || ht_snapshot_dir.len<=0) {
+		ht_snapshot_dir.s = NULL;
+		ht_snapshot_dir.len = 0;
+		return 0;
+	}
+	/* the periodic snapshots are used only for the tables without db */
+	for(ht=ht_get_root(); ht; ht=ht->next) {
+		if(ht->snapshot!=0 && ht->dbtable.len<=0)
+			break;
+	}
+	if(ht!=NULL && ht_snapshot_interval>0
+			&& sr_wtimer_add(ht_snap_timer, 0, ht_snapshot_interval)<0) {
+		LM_ERR("failed to add the snapshot timer\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int ht_snap_fname(ht_t *ht, char *fname)
+{
+	int n;
+
+	n = snprintf(fname, HT_SNAP_FNAME_SIZE, "%.*s/htable_%.*s.snap",
+			ht_snapshot_dir.len, ht_snapshot_dir.s, ht->name.len, ht->name.s);
+	if(n<0 || n>=HT_SNAP_FNAME_SIZE) {
+		LM_ERR("snapshot file name too long for htable [%.*s]\n",
+				ht->name.len, ht->name.s);
+		return -1;
+	}
+	return 0;
+}
+
+static int ht_snap_save_table(ht_t *ht, unsigned int flags)
+{
+	char fname[HT_SNAP_FNAME_SIZE];
+	db_val_t vals[HT_SNAP_COLS];
+	db_snap_w_t w;
+	ht_cell_t *it;
+	time_t now;
+	unsigned int i;
+	int n;
+
+	if(ht_snap_fname(ht, fname)<0)
+		return -1;
+	if(db_snap_create(&w, fname, "htable", HT_SNAP_COLS)<0)
+		return -1;
+
+	now = time(NULL);
+	n = 0;
+	memset(vals, 0, sizeof(vals));
+	vals[0].type = DB1_STR;
+	vals[1].type = DB1_INT;
+	vals[3].type = DB1_BIGINT;
+	for(i=0; i<ht->htsize; i++) {
+		ht_slot_lock(ht, i);
+		for(it=ht->entries[i].first; it; it=it->next) {
+			if(it->expire!=0 && it->expire<now)
+				continue;
+			vals[0].val.str_val = it->name;
+			vals[1].val.int_val = it->flags&AVP_VAL_STR;
+			if(it->flags&AVP_VAL_STR) {
+				vals[2].type = DB1_STR;
+				vals[2].val.str_val = it->value.s;
+			} else {
+				vals[2].type = DB1_INT;
+				vals[2].val.int_val = it->value.n;
+			}
+			vals[3].val.ll_val = (long long)it->expire;
+			if(db_snap_add(&w, vals)<0) {
+				ht_slot_unlock(ht, i);
+				db_snap_abort(&w);
+				return -1;
+			}
+			n++;
+		}
+		ht_slot_unlock(ht, i);
+	}
+	if(db_snap_commit(&w, flags)<0)
+		return -1;
+	LM_DBG("htable [%.*s]: %d items written to %s\n", ht->name.len,
+			ht->name.s, n, fname);
+	return 0;
+}
+
+void ht_snap_save_tables(int final)
+{
+	ht_t *ht;
+
+	if(ht_snapshot_dir.s==NULL || _ht_snap_ready==0)
+		return;
+	for(ht=ht_get_root(); ht; ht=ht->next) {
+		if(ht->snapshot==0)
+			continue;
+		/* with a db table, only the snapshot written on shutdown is
+		 * loaded */
+		if(final==0 && ht->dbtable.len>0)
+			continue;
+		if(ht_snap_save_table(ht, (final)?DB_SNAP_F_FINAL:0)<0) {
+			LM_ERR("failed to write the snapshot of htable [%.*s]\n",
+					ht->name.len, ht->name.s);
+		}
+	}
+}
+
+/* returns 0 if loaded, 1 if there is no usable snapshot, -1 on error */
+static int ht_snap_load_table(ht_t *ht)
+{
+	char fname[HT_SNAP_FNAME_SIZE];
+	db_val_t vals[HT_SNAP_COLS];
+	db_snap_t s;
+	str name;
+	int_str val;
+	int_str expires;
+	int type;
+	time_t now;
+	int n;
+	int ret;
+
+	if(ht_snap_fname(ht, fname)<0)
+		return 1;
+	/* with a db table, only a snapshot of the synced table can be used */
+	if(db_snap_open(&s, fname, "htable", HT_SNAP_COLS, ht_snapshot_max_age,
+				(ht->dbtable.len>0)?DB_SNAP_F_FINAL:0)<0)
+		return 1;
+
+	now = time(NULL);
+	n = 0;
+	while((ret=db_snap_next(&s, vals))>0) {
+		if(VAL_NULL(&vals[0]) || VAL_NULL(&vals[2]))
+			continue;
+		if(VAL_BIGINT(&vals[3])!=0 && VAL_BIGINT(&vals[3])<=now)
+			continue;
+		name = VAL_STR(&vals[0]);
+		type = VAL_INT(&vals[1])&AVP_VAL_STR;
+		if(type&AVP_VAL_STR) {
+			if(VAL_TYPE(&vals[2])!=DB1_STR)
+				continue;
+			val.s = VAL_STR(&vals[2]);
+		} else {
+			val.n = VAL_INT(&vals[2]);
+		}
+		if(ht_set_cell(ht, &name, type, &val, 1)!=0) {
+			LM_ERR("error adding item [%.*s] to htable [%.*s]\n",
+					name.len, name.s, ht->name.len, ht->name.s);
+			ret = -1;
+			break;
+		}
+		/* keep the expire time of the saved item */
+		if(ht->htexpire>0 && VAL_BIGINT(&vals[3])>0) {
+			expires.n = (int)(VAL_BIGINT(&vals[3]) - now);
+			ht_set_cell_expire(ht, &name, 0, &expires);
+		}
+		n++;
+	}
+	db_snap_close(&s);
+	if(ret<0) {
+		LM_ERR("failed to load htable [%.*s] from snapshot %s\n",
+				ht->name.len, ht->name.s, fname);
+		return -1;
+	}
+	LM_INFO("htable [%.*s]: %d items loaded from snapshot %s\n",
+			ht->name.len, ht->name.s, n, fname);
+	/* the db table is changed from now on, don't load it again */
+	if(ht->dbtable.len>0 && unlink(fname)<0) {
+		LM_WARN("failed to remove snapshot %s: %s\n", fname, strerror(errno));
+	}
+	return 0;
+}
+
+int ht_snap_load_tables(void)
+{
+	ht_t *ht;
+	int ret;
+
+	if(ht_snapshot_dir.s==NULL)
+		return 0;
+	for(ht=ht_get_root(); ht; ht=ht->next) {
+		if(ht->snapshot==0)
+			continue;
+		ret = ht_snap_load_table(ht);
+		if(ret<0)
+			return -1;
+		ht->snap_loaded = (ret==0);
+	}
+	return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ *
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Binary snapshots of the hash tables that have the snapshot=1 attribute,
+ * written in <snapshot_dir>/htable_<name>.snap every snapshot_interval
+ * seconds and on shutdown, and loaded at startup (see lib/srdb1/db_snap.h).
+ * A table with a dbtable is loaded only from the snapshot written on
+ * shutdown (after the db sync) and the snapshot is removed once loaded.
+ */
+
+#ifndef _HT_SNAP_H_
+#define _HT_SNAP_H_
+
+#include "ht_api.h"
+
+extern str ht_snapshot_dir;
+extern int ht_snapshot_interval;
+extern int ht_snapshot_max_age;
+
+int ht_snap_init(void);
+int ht_snap_load_tables(void);
+void ht_snap_set_ready(void);
+void ht_snap_save_tables(int final);
+
+#endif
@@ -33,6 +33,7 @@ int pv_get_ht_cell(struct sip_msg *msg,  pv_param_t *param,
 	str htname;
 	ht_cell_t *htc=NULL;
 	ht_pv_t *hpv;
+	int ival;
 
 	hpv = (ht_pv_t*)param->pvn.u.dname;
 
@@ -47,6 +48,15 @@ int pv_get_ht_cell(struct sip_msg *msg,  pv_param_t *param,
 		LM_ERR("cannot get $sht name\n");
 		return -1;
 	}
+	if(hpv->ht->counters)
+	{
+		/* integer only table - no lock and no pkg copy */
+		if(ht_get_cell_int(hpv->ht, &htname, &ival)==0)
+			return pv_get_sintval(msg, param, res, ival);
+		if(hpv->ht->flags==PV_VAL_INT)
+			return pv_get_sintval(msg, param, res, hpv->ht->initval.n);
+		return pv_get_null(msg, param, res);
+	}
 	htc = ht_cell_pkg_copy(hpv->ht, &htname, _htc_local);
 	if(htc==NULL)
 	{
@@ -311,6 +321,7 @@ int pv_get_ht_add(struct sip_msg *msg,  pv_param_t *param,
 	str htname;
 	ht_cell_t *htc=NULL;
 	ht_pv_t *hpv;
+	int_str isval;
 
 	hpv = (ht_pv_t*)param->pvn.u.dname;
 
@@ -325,6 +336,18 @@ int pv_get_ht_add(struct sip_msg *msg,  pv_param_t *param,
 		LM_ERR("cannot get $sht name\n");
 		return -1;
 	}
+	if(hpv->ht->counters)
+	{
+		/* atomic update, without lock and pkg copy */
+		if(ht_cell_int_add(hpv->ht, &htname, val, &isval.n)!=0)
+			return pv_get_null(msg, param, res);
+		if (hpv->ht->dmqreplicate>0) {
+			if (ht_dmq_replicate_action(HT_DMQ_SET_CELL, &hpv->htname, &htname, 0, &isval, 1)!=0) {
+				LM_ERR("dmq relication failed\n");
+			}
+		}
+		return pv_get_sintval(msg, param, res, isval.n);
+	}
 	htc = ht_cell_value_add(hpv->ht, &htname, val, 1, _htc_local);
 	if(htc==NULL)
 	{
@@ -45,6 +45,7 @@
 #include "ht_var.h"
 #include "api.h"
 #include "ht_dmq.h"
+#include "ht_snap.h"
 
 
 MODULE_VERSION
@@ -139,6 +140,9 @@ static param_export_t params[]={
 	{"enable_dmq",         INT_PARAM, &ht_enable_dmq},
 	{"timer_procs",        PARAM_INT, &ht_timer_procs},
 	{"event_callback",     PARAM_STR, &ht_event_callback},
+	{"snapshot_dir",       PARAM_STR, &ht_snapshot_dir},
+	{"snapshot_interval",  PARAM_INT, &ht_snapshot_interval},
+	{"snapshot_max_age",   PARAM_INT, &ht_snapshot_max_age},
 	{0,0,0}
 };
 
@@ -174,6 +178,11 @@ static int mod_init(void)
 		return -1;
 	ht_db_init_params();
 
+	if(ht_snap_init()!=0)
+		return -1;
+	if(ht_snap_load_tables()!=0)
+		return -1;
+
 	if(ht_db_url.len>0)
 	{
 		if(ht_db_init_con()!=0)
@@ -210,6 +219,8 @@ static int mod_init(void)
 
 	ht_iterator_init();
 
+	ht_snap_set_ready();
+
 	return 0;
 }
 
@@ -240,6 +251,8 @@ static int child_init(int rank)
 	if (rank!=PROC_INIT)
 		return 0;
 
+	if(ht_epoch_init()!=0)
+		return -1;
 
 	rt = -1;
 	if(ht_event_callback.s==NULL || ht_event_callback.len<=0) {
@@ -302,6 +315,9 @@ static void destroy(void)
 			}
 		}
 	}
+	/* after the db sync, it can replace the load from db */
+	ht_snap_save_tables(1);
+	ht_epoch_destroy();
 	ht_destroy();
 }
 
@@ -1071,6 +1087,8 @@ static void htable_rpc_reload(rpc_t* rpc, void* c)
 		return;
 	}
 
+	/* the new cells must be complete for the lock-free readers */
+	membar_write();
 	/* replace old entries */
 	for(i=0; i<nht.htsize; i++)
 	{
@@ -1078,6 +1096,8 @@ static void htable_rpc_reload(rpc_t* rpc, void* c)
 		first = ht->entries[i].first;
 		ht->entries[i].first = nht.entries[i].first;
 		ht->entries[i].esize = nht.entries[i].esize;
+		ht->entries[i].efirst = nht.entries[i].efirst;
+		ht->entries[i].elast = nht.entries[i].elast;
 		ht_slot_unlock(ht, i);
 		nht.entries[i].first = first;
 	}
@@ -1089,7 +1109,7 @@ static void htable_rpc_reload(rpc_t* rpc, void* c)
 		{
 			it = first;
 			first = first->next;
-			ht_cell_free(it);
+			ht_cell_release(ht, it);
 		}
 	}
 	free(nht.entries);
@@ -163,6 +163,7 @@ int lookup_helper(struct sip_msg* _m, udomain_t* _d, str* _uri, int _mode)
 	sr_xavp_t *xavp=NULL;
 	sip_uri_t path_uri;
 	str path_str;
+	int snapshot = 0;
 
 	ret = -1;
 
@@ -210,14 +211,18 @@ int lookup_helper(struct sip_msg* _m, udomain_t* _d, str* _uri, int _mode)
 
 	if(puri.gr.s==NULL || puri.gr_val.len>0)
 	{
-		/* aor or pub-gruu lookup */
-		ul.lock_udomain(_d, &aor);
-		res = ul.get_urecord(_d, &aor, &r);
+		/* aor or pub-gruu lookup - on a private copy of the record, so
+		 * the slot is not kept locked while building the branches */
+		res = ul.get_urecord_snapshot(_d, &aor, &r);
+		if (res < 0) {
+			LM_ERR("failed to get '%.*s' from usrloc\n", aor.len, ZSW(aor.s));
+			return -3;
+		}
 		if (res > 0) {
 			LM_DBG("'%.*s' Not found in usrloc\n", aor.len, ZSW(aor.s));
-			ul.unlock_udomain(_d, &aor);
 			return -1;
 		}
+		snapshot = 1;
 
 		ptr = r->contacts;
 		ret = -1;
@@ -449,8 +454,12 @@ int lookup_helper(struct sip_msg* _m, udomain_t* _d, str* _uri, int _mode)
 	}
 
 done:
-	ul.release_urecord(r);
-	ul.unlock_udomain(_d, &aor);
+	if (snapshot) {
+		ul.release_urecord_snapshot(r);
+	} else {
+		ul.release_urecord(r);
+		ul.unlock_udomain(_d, &aor);
+	}
 	return ret;
 }
 
@@ -86,13 +86,14 @@ int tcpops_acquire_fd_from_tcpmain(int conid, int *fd)
 	msg[0] = (long)s_con;
 	msg[1] = CONN_GET_FD;
 
-	n = send_all(unix_tcp_sock, msg, sizeof(msg));
+	n = send_all(tcpconn_main_sock(s_con), msg, sizeof(msg));
 	if (unlikely(n <= 0)){
 		LM_ERR("failed to send fd request: %s (%d)\n", strerror(errno), errno);
 		goto error_release;
 	}
 
-	n = receive_fd(unix_tcp_sock, &tmp, sizeof(tmp), fd, MSG_WAITALL);
+	n = receive_fd(tcpconn_main_sock(s_con), &tmp, sizeof(tmp), fd,
+			MSG_WAITALL);
 	if (unlikely(n <= 0)){
 		LM_ERR("failed to get fd (receive_fd): %s (%d)\n", strerror(errno), errno);
 		goto error_release;
@@ -70,7 +70,11 @@ struct cfg_group_tls default_tls_cfg = {
 	10*1024*1024, /* ct_wq_max: 10 Mb by default */
 	64*1024, /* con_ct_wq_max: 64Kb by default */
 	4096, /* ct_wq_blk_size */
-	0 /* send_close_notify (off by default)*/
+	0, /* send_close_notify (off by default)*/
+	0, /* send_batch (off by default) */
+	16384, /* session_cache_size */
+	0, /* session_ticket (off by default) */
+	3600 /* session_ticket_rotate (s) */
 };
 
 volatile void* tls_cfg = &default_tls_cfg;
@@ -217,6 +221,18 @@ cfg_def_t	tls_cfg_def[] = {
 		"enable/disable sending a close notify TLS shutdown alert"
 			" before closing the corresponding TCP connection."
 			"Note that having it enabled has a performance impact."},
+	{"send_batch", CFG_VAR_INT | CFG_ATOMIC, 0, 16384, 0, 0,
+		"maximum clear text bytes encoded in one TLS record for the messages"
+		" sent while the TCP write queue of the connection is not empty"
+		" (0 disables the batching)"},
+	{"session_cache_size", CFG_VAR_INT | CFG_READONLY, 1, 1<<24, 0, 0,
+		"maximum number of sessions kept in the shared session cache" },
+	{"session_ticket", CFG_VAR_INT | CFG_READONLY, 0, 1, 0, 0,
+		"enables or disables the session tickets (the ticket keys are"
+		" shared by all the processes)" },
+	{"session_ticket_rotate", CFG_VAR_INT | CFG_ATOMIC, 0, 7*86400, 0, 0,
+		"session ticket key rotation interval in seconds (0 disables the"
+		" rotation)" },
 	{0, 0, 0, 0, 0, 0}
 };
 
@@ -94,6 +94,11 @@ struct cfg_group_tls {
 	int ct_wq_blk_size; /* minimum block size for the clear text write queue */
 	int send_close_notify; /* if set try to be nice and send a shutdown alert
 						    before closing the tcp connection */
+	int send_batch; /* maximum clear text bytes batched in one record while
+					   the tcp write queue is not empty (0 = off) */
+	int session_cache_size; /* maximum sessions in the shared cache */
+	int session_ticket; /* enable session tickets, keys shared by all procs */
+	int session_ticket_rotate; /* ticket key rotation interval (s) */
 };
 
 
@@ -185,6 +185,37 @@ int tls_ct_wq_add(tls_ct_q** ct_q, const void* data, unsigned int size)
 
 
 
+/**
+ * @brief Add data to a clear text batch queue
+ *
+ * Same as tls_ct_wq_add(), but the queue blocks have the batch size, so
+ * that each block is encoded in one tls record.
+ * @param ct_q clear text batch queue
+ * @param data data
+ * @param size data size
+ * @param blk_size batch size
+ * @return 0 on success, < 0 on error (-1 memory allocation, -2 queue size
+ *         too big).
+ */
+int tls_ct_bq_add(tls_ct_q** ct_q, const void* data, unsigned int size,
+					unsigned int blk_size)
+{
+	int ret;
+	
+	if (unlikely( (*ct_q && (((*ct_q)->queued + size) >
+						cfg_get(tls, tls_cfg, con_ct_wq_max))) ||
+				(atomic_get(tls_total_ct_wq) + size) >
+						cfg_get(tls, tls_cfg, ct_wq_max))) {
+		return -2;
+	}
+	ret = tls_ct_q_add(ct_q, data, size, blk_size);
+	if (likely(ret >= 0))
+		atomic_add(tls_total_ct_wq, size);
+	return ret;
+}
+
+
+
 /**
  * @brief Wrapper over tls_ct_q_destroy()
  * Wrapper over tls_ct_q_destroy(), besides doing a tls_ct_q_destroy it
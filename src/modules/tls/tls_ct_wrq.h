@@ -84,6 +84,21 @@ int tls_ct_wq_flush(struct tcp_connection* c, tls_ct_q** tc_q,
  */
 int tls_ct_wq_add(tls_ct_q** ct_q, const void* data, unsigned int size);
 
+/**
+ * @brief Add data to a clear text batch queue
+ *
+ * Same as tls_ct_wq_add(), but the queue blocks have the batch size, so
+ * that each block is encoded in one tls record.
+ * @param ct_q clear text batch queue
+ * @param data data
+ * @param size data size
+ * @param blk_size batch size
+ * @return 0 on success, < 0 on error (-1 memory allocation, -2 queue size
+ *         too big).
+ */
+int tls_ct_bq_add(tls_ct_q** ct_q, const void* data, unsigned int size,
+					unsigned int blk_size);
+
 /**
  * @brief Wrapper over tls_ct_q_destroy()
  * Wrapper over tls_ct_q_destroy(), besides doing a tls_ct_q_destroy it
@@ -25,8 +25,14 @@
  */
 
 #include <stdlib.h>
+#include <time.h>
 #include <openssl/ssl.h>
 #include <openssl/opensslv.h>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x030000000L
+# include <openssl/core_names.h>
+#endif
 #if OPENSSL_VERSION_NUMBER >= 0x00907000L
 # include <openssl/ui.h>
 #endif
@@ -35,6 +41,7 @@
 #include "../../core/pt.h"
 #include "../../core/cfg/cfg.h"
 #include "../../core/dprint.h"
+#include "../../core/locking.h"
 #include "tls_config.h"
 #include "tls_server.h"
 #include "tls_util.h"
@@ -42,6 +49,7 @@
 #include "tls_init.h"
 #include "tls_domain.h"
 #include "tls_cfg.h"
+#include "tls_sess_cache.h"
 
 /*
  * ECDHE is enabled only on OpenSSL 1.0.0e and later.
@@ -787,10 +795,182 @@ static int set_ssl_options(tls_domain_t* d)
 }
 
 
+#if OPENSSL_VERSION_NUMBER >= 0x01000000L
+/* session ticket keys, shared by all the processes (openssl would generate
+ * random keys for each SSL_CTX and there is one SSL_CTX per process, so
+ * a ticket could be used only on the process that issued it) */
+typedef struct tls_ticket_key {
+	unsigned char name[16];
+	unsigned char aes_key[32];
+	unsigned char hmac_key[32];
+} tls_ticket_key_t;
+
+typedef struct tls_ticket_keys {
+	gen_lock_t lock;
+	time_t rotated; /* last rotation time */
+	tls_ticket_key_t key[2]; /* current and previous key */
+} tls_ticket_keys_t;
+
+static tls_ticket_keys_t* tls_ticket_keys = 0;
+
+
+static int tls_ticket_key_new(tls_ticket_key_t* k)
+{
+	if (RAND_bytes(k->name, sizeof(k->name)) != 1 ||
+			RAND_bytes(k->aes_key, sizeof(k->aes_key)) != 1 ||
+			RAND_bytes(k->hmac_key, sizeof(k->hmac_key)) != 1)
+		return -1;
+	return 0;
+}
+
+
+/* copies the current and the previous ticket key, rotating them first if
+ * the session_ticket_rotate interval elapsed */
+static void tls_ticket_keys_get(tls_ticket_key_t* keys)
+{
+	tls_ticket_key_t k;
+	int rotate;
+	time_t now;
+
+	rotate = cfg_get(tls, tls_cfg, session_ticket_rotate);
+	now = time(0);
+	lock_get(&tls_ticket_keys->lock);
+	if (rotate > 0 && now - tls_ticket_keys->rotated >= rotate) {
+		if (tls_ticket_key_new(&k) == 0) {
+			tls_ticket_keys->key[1] = tls_ticket_keys->key[0];
+			tls_ticket_keys->key[0] = k;
+			tls_ticket_keys->rotated = now;
+		} else {
+			ERR("failed to generate a new session ticket key\n");
+		}
+	}
+	keys[0] = tls_ticket_keys->key[0];
+	keys[1] = tls_ticket_keys->key[1];
+	lock_release(&tls_ticket_keys->lock);
+}
+
+
+#if OPENSSL_VERSION_NUMBER >= 0x030000000L
+static int tls_ticket_hmac_init(EVP_MAC_CTX* hctx, tls_ticket_key_t* k)
+{
+	OSSL_PARAM params[2];
+
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+					"SHA256", 0);
+	params[1] = OSSL_PARAM_construct_end();
+	return EVP_MAC_init(hctx, k->hmac_key, sizeof(k->hmac_key), params);
+}
+#else
+static int tls_ticket_hmac_init(HMAC_CTX* hctx, tls_ticket_key_t* k)
+{
+	return HMAC_Init_ex(hctx, k->hmac_key, sizeof(k->hmac_key),
+					EVP_sha256(), 0);
+}
+#endif
+
+
+/* openssl session ticket key callback
+ * returns -1 on error, 0 if the key was not found (full handshake), 1 on
+ * success and 2 if the ticket was decrypted with the previous key (openssl
+ * will issue a new ticket with the current key) */
+#if OPENSSL_VERSION_NUMBER >= 0x030000000L
+static int tls_ticket_key_cb(SSL* ssl, unsigned char* key_name,
+							unsigned char* iv, EVP_CIPHER_CTX* ectx,
+							EVP_MAC_CTX* hctx, int enc)
+#else
+static int tls_ticket_key_cb(SSL* ssl, unsigned char* key_name,
+							unsigned char* iv, EVP_CIPHER_CTX* ectx,
+							HMAC_CTX* hctx, int enc)
+#endif
+{
+	tls_ticket_key_t keys[2];
+	int i;
+
+	tls_ticket_keys_get(keys);
+	if (enc) {
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+			return -1;
+		memcpy(key_name, keys[0].name, sizeof(keys[0].name));
+		if (EVP_EncryptInit_ex(ectx, EVP_aes_256_cbc(), 0, keys[0].aes_key,
+					iv) != 1 || tls_ticket_hmac_init(hctx, &keys[0]) != 1)
+			return -1;
+		return 1;
+	}
+	for (i = 0; i < 2; i++) {
+		if (memcmp(key_name, keys[i].name, sizeof(keys[i].name)) == 0)
+			break;
+	}
+	if (i == 2)
+		return 0; /* unknown or expired key */
+	if (tls_ticket_hmac_init(hctx, &keys[i]) != 1 ||
+			EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), 0, keys[i].aes_key,
+					iv) != 1)
+		return -1;
+	return (i == 0) ? 1 : 2;
+}
+#endif /* openssl >= 1.0.0 */
+
+
+/**
+ * @brief Init the session ticket keys shared by all the processes
+ * @return 0 on success, -1 on error
+ */
+int tls_ticket_keys_init(void)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x01000000L
+	tls_ticket_keys = shm_malloc(sizeof(*tls_ticket_keys));
+	if (tls_ticket_keys == 0) {
+		ERR("not enough shared memory for the session ticket keys\n");
+		return -1;
+	}
+	memset(tls_ticket_keys, 0, sizeof(*tls_ticket_keys));
+	/* the previous key is random too, it won't match any ticket */
+	if (tls_ticket_key_new(&tls_ticket_keys->key[0]) < 0 ||
+			tls_ticket_key_new(&tls_ticket_keys->key[1]) < 0) {
+		ERR("failed to generate the session ticket keys\n");
+		goto error;
+	}
+	tls_ticket_keys->rotated = time(0);
+	if (lock_init(&tls_ticket_keys->lock) == 0) {
+		ERR("failed to init the session ticket keys lock\n");
+		goto error;
+	}
+	return 0;
+error:
+	shm_free(tls_ticket_keys);
+	tls_ticket_keys = 0;
+	return -1;
+#else
+	WARN("session tickets with shared keys require openssl >= 1.0.0\n");
+	return 0;
+#endif
+}
+
+
+/**
+ * @brief Destroy the session ticket keys
+ */
+void tls_ticket_keys_destroy(void)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x01000000L
+	if (tls_ticket_keys == 0)
+		return;
+	lock_destroy(&tls_ticket_keys->lock);
+	memset(tls_ticket_keys, 0, sizeof(*tls_ticket_keys));
+	shm_free(tls_ticket_keys);
+	tls_ticket_keys = 0;
+#endif
+}
+
+
 /**
  * @brief Configure TLS session cache parameters 
+ *
+ * With session_cache the server sessions are kept in the shared memory
+ * cache and with session_ticket the tickets are encrypted with the shared
+ * keys, so that a session can be resumed by any process.
  * @param d domain
- * @return 0
+ * @return 0 on success, -1 on error
  */
 static int set_session_cache(tls_domain_t* d)
 {
@@ -801,13 +981,29 @@ static int set_session_cache(tls_domain_t* d)
 	procs_no=get_max_procs();
 	tls_session_id=cfg_get(tls, tls_cfg, session_id);
 	for(i = 0; i < procs_no; i++) {
-		/* janakj: I am not sure if session cache makes sense in ser, session
-		 * cache is stored in SSL_CTX and we have one SSL_CTX per process,
-		 * thus sessions among processes will not be reused
-		 */
-		SSL_CTX_set_session_cache_mode(d->ctx[i],
-				cfg_get(tls, tls_cfg, session_cache) ? SSL_SESS_CACHE_SERVER :
-				SSL_SESS_CACHE_OFF);
+		if (cfg_get(tls, tls_cfg, session_cache) &&
+				(d->type & TLS_DOMAIN_SRV)) {
+			if (tls_sess_cache_set(d->ctx[i], d) < 0) {
+				ERR("%s: Failed to set the session cache\n",
+						tls_domain_str(d));
+				return -1;
+			}
+		} else {
+			SSL_CTX_set_session_cache_mode(d->ctx[i], SSL_SESS_CACHE_OFF);
+		}
+#if OPENSSL_VERSION_NUMBER >= 0x01000000L
+		if (tls_ticket_keys) {
+# if OPENSSL_VERSION_NUMBER >= 0x030000000L
+			SSL_CTX_set_tlsext_ticket_key_evp_cb(d->ctx[i], tls_ticket_key_cb);
+# else
+			SSL_CTX_set_tlsext_ticket_key_cb(d->ctx[i], tls_ticket_key_cb);
+# endif
+		} else if (cfg_get(tls, tls_cfg, session_cache)) {
+			/* resume through the shared cache and not with tickets
+			 * encrypted with per process keys */
+			SSL_CTX_set_options(d->ctx[i], SSL_OP_NO_TICKET);
+		}
+#endif
 		/* not really needed is SSL_SESS_CACHE_OFF */
 		SSL_CTX_set_session_id_context(d->ctx[i],
 					(unsigned char*)tls_session_id.s, tls_session_id.len);
@@ -210,4 +210,17 @@ void tls_free_cfg(tls_domains_cfg_t* cfg);
  */
 void tls_destroy_cfg(void);
 
+
+/**
+ * @brief Init the session ticket keys shared by all the processes
+ * @return 0 on success, -1 on error
+ */
+int tls_ticket_keys_init(void);
+
+
+/**
+ * @brief Destroy the session ticket keys
+ */
+void tls_ticket_keys_destroy(void);
+
 #endif /* _TLS_DOMAIN_H */
@@ -58,6 +58,7 @@
 #include "tls_init.h"
 #include "tls_locking.h"
 #include "tls_ct_wrq.h"
+#include "tls_sess_cache.h"
 #include "tls_cfg.h"
 
 /* will be set to 1 when the TLS env is initialized to make destroy safe */
@@ -769,4 +770,6 @@ void destroy_tls_h(void)
 	tls_destroy_cfg();
 	tls_destroy_locks();
 	tls_ct_wq_destroy();
+	tls_sess_cache_destroy();
+	tls_ticket_keys_destroy();
 }
@@ -49,6 +49,7 @@
 #include "tls_util.h"
 #include "tls_mod.h"
 #include "tls_cfg.h"
+#include "tls_sess_cache.h"
 
 #ifndef TLS_HOOKS
 	#error "TLS_HOOKS must be defined, or the tls module won't work"
@@ -191,6 +192,10 @@ static param_export_t params[] = {
 	{"tls_debug",           PARAM_INT,    &default_tls_cfg.debug        },
 	{"session_cache",       PARAM_INT,    &default_tls_cfg.session_cache},
 	{"session_id",          PARAM_STR,    &default_tls_cfg.session_id   },
+	{"session_cache_size",  PARAM_INT,  &default_tls_cfg.session_cache_size},
+	{"session_ticket",      PARAM_INT,    &default_tls_cfg.session_ticket},
+	{"session_ticket_rotate", PARAM_INT,
+										&default_tls_cfg.session_ticket_rotate},
 	{"config",              PARAM_STR,    &default_tls_cfg.config_file  },
 	{"tls_disable_compression", PARAM_INT,
 										&default_tls_cfg.disable_compression},
@@ -203,6 +208,7 @@ static param_export_t params[] = {
 	{"con_ct_wq_max",      PARAM_INT,    &default_tls_cfg.con_ct_wq_max},
 	{"ct_wq_max",          PARAM_INT,    &default_tls_cfg.ct_wq_max},
 	{"ct_wq_blk_size",     PARAM_INT,    &default_tls_cfg.ct_wq_blk_size},
+	{"send_batch",         PARAM_INT,    &default_tls_cfg.send_batch},
 	{"tls_force_run",       PARAM_INT,    &default_tls_cfg.force_run},
 	{"low_mem_threshold1",  PARAM_INT,    &default_tls_cfg.low_mem_threshold1},
 	{"low_mem_threshold2",  PARAM_INT,    &default_tls_cfg.low_mem_threshold2},
@@ -242,6 +248,7 @@ static struct tls_hooks tls_h = {
 	init_tls_h,
 	destroy_tls_h,
 	tls_mod_pre_init_h,
+	tls_h_flush,
 };
 
 
@@ -349,6 +356,15 @@ static int mod_init(void)
 		ERR("Unable to initialize TLS buffering\n");
 		goto error;
 	}
+	if (cfg_get(tls, tls_cfg, session_cache) &&
+			tls_sess_cache_init(cfg_get(tls, tls_cfg, session_cache_size)) < 0){
+		ERR("Unable to initialize TLS session cache\n");
+		goto error;
+	}
+	if (cfg_get(tls, tls_cfg, session_ticket) && tls_ticket_keys_init() < 0) {
+		ERR("Unable to initialize TLS session ticket keys\n");
+		goto error;
+	}
 	if (cfg_get(tls, tls_cfg, config_file).s) {
 		*tls_domains_cfg =
 			tls_load_config(&cfg_get(tls, tls_cfg, config_file));
@@ -38,6 +38,7 @@
 #include "tls_util.h"
 #include "tls_server.h"
 #include "tls_ct_wrq.h"
+#include "tls_sess_cache.h"
 #include "tls_rpc.h"
 #include "tls_cfg.h"
 
@@ -87,6 +88,8 @@ static void tls_reload(rpc_t* rpc, void* ctx)
 	*tls_domains_cfg = cfg;
 
 	lock_release(tls_domains_cfg_lock);
+	/* the cached sessions belong to the old domains */
+	tls_sess_cache_flush();
 
 	return;
 
@@ -101,7 +104,6 @@ static const char* tls_list_doc[2] = {
 	0
 };
 
-extern gen_lock_t* tcpconn_lock;
 extern struct tcp_connection** tcpconn_id_hash;
 
 static void tls_list(rpc_t* rpc, void* c)
@@ -116,8 +118,8 @@ static void tls_list(rpc_t* rpc, void* c)
 	struct tcp_connection* con;
 	int i, len, timeout;
 
-	TCPCONN_LOCK;
 	for(i = 0; i < TCP_ID_HASH_SIZE; i++) {
+		TCPCONN_LOCK(tcp_id_part(i));
 		for (con = tcpconn_id_hash[i]; con; con = con->id_next) {
 			if (con->rcv.proto != PROTO_TLS) continue;
 			tls_d = con->extra_data;
@@ -186,8 +188,8 @@ static void tls_list(rpc_t* rpc, void* c)
 						);
 			}
 		}
+		TCPCONN_UNLOCK(tcp_id_part(i));
 	}
-	TCPCONN_UNLOCK;
 }
 
 
@@ -638,6 +638,8 @@ void tls_h_tcpconn_clean(struct tcp_connection *c)
 		atomic_dec(&extra->cfg->ref_count);
 		if (extra->ct_wq)
 			tls_ct_wq_free(&extra->ct_wq);
+		if (extra->ct_bq)
+			tls_ct_wq_free(&extra->ct_bq);
 		if (extra->enc_rd_buf) {
 			shm_free(extra->enc_rd_buf);
 			extra->enc_rd_buf = 0;
@@ -689,6 +691,36 @@ void tls_h_close(struct tcp_connection *c, int fd)
 
 
 
+/** moves the batched clear text to the WANTS_READ queue.
+ * The batched data is older than anything in the WANTS_READ queue, so this
+ * must be done when the write starts waiting for a read.
+ * WARNING: must be called with c->write_lock held.
+ * @return 0 on success, -1 on error.
+ */
+static int tls_ct_bq_move(struct tls_extra_data* tls_c)
+{
+	tls_ct_q* q;
+	struct sbuf_elem* b;
+	unsigned int start;
+	unsigned int end;
+
+	q = tls_c->ct_bq;
+	if (tls_ct_q_empty(q))
+		return 0;
+	for (b = q->first; b; b = b->next) {
+		start = (b == q->first) ? q->offset : 0;
+		end = (b == q->last) ? q->last_used : b->b_size;
+		/* the bytes are already accounted in the total queued */
+		if (unlikely(tls_ct_q_add(&tls_c->ct_wq, b->buf + start, end - start,
+						cfg_get(tls, tls_cfg, ct_wq_blk_size)) < 0))
+			return -1;
+	}
+	tls_ct_q_destroy(&tls_c->ct_bq);
+	return 0;
+}
+
+
+
 /* generic tcpconn_{do,1st}_send() function pointer type */
 typedef int (*tcp_low_level_send_t)(int fd, struct tcp_connection *c,
 									char* buf, unsigned len,
@@ -737,6 +769,8 @@ int tls_encode_f(struct tcp_connection *c,
 	const char* buf;
 	unsigned int len;
 	int x;
+	int flush_flags;
+	int batch;
 	
 	buf = *pbuf;
 	len = *plen;
@@ -775,7 +809,64 @@ int tls_encode_f(struct tcp_connection *c,
 		send_flags->f &= ~SND_F_CON_CLOSE;
 		goto end;
 	}
-	if (unlikely(tls_set_mbufs(c, &rd, &wr) < 0)) {
+	/* tcp write queue not empty => nothing can be sent right now, batch the
+	   clear text and encode it in as few records as possible once the queue
+	   is emptied (tls_h_flush()) */
+	batch = cfg_get(tls, tls_cfg, send_batch);
+	if (unlikely(tls_ct_q_non_empty(tls_c->ct_bq)
+#ifdef TCP_ASYNC
+				|| (batch && tls_c->state == S_TLS_ESTABLISHED &&
+					c->wbuf_q.first)
+#endif /* TCP_ASYNC */
+				)) {
+		if (likely(tls_ct_bq_add(&tls_c->ct_bq, buf, len,
+						(batch > 0) ? batch : len) >= 0)) {
+			TLS_WR_TRACE("(%p) tcp write queue present => batching"
+							" (%d bytes, %p)\n", c, len, buf);
+			send_flags->f &= ~SND_F_CON_CLOSE;
+			goto end;
+		}
+		/* batch queue full => encode the batched data first */
+		if (unlikely(tls_set_mbufs(c, &rd, &wr) < 0)) {
+			ERR("tls_set_mbufs failed\n");
+			goto error;
+		}
+		flush_flags = 0;
+		n = tls_ct_wq_flush(c, &tls_c->ct_bq, &flush_flags, &ssl_error);
+		if (unlikely(n < 0))
+			goto error;
+		if (unlikely(!(flush_flags & F_BUFQ_EMPTY))) {
+			switch(ssl_error) {
+				case SSL_ERROR_NONE:
+				case SSL_ERROR_WANT_WRITE:
+					/* wr buffer full, retry after it's sent */
+					if (unlikely(wr.used == 0)) {
+						BUG("write buffer too small (%d/%d bytes)\n",
+								wr.used, wr.size);
+						goto bug;
+					}
+					*rest_buf = buf;
+					*rest_len = len;
+					break;
+				case SSL_ERROR_WANT_READ:
+					if (unlikely(tls_ct_bq_move(tls_c) < 0 ||
+								tls_ct_wq_add(&tls_c->ct_wq, buf, len) < 0)) {
+						ERR("ct write buffer full (%d bytes)\n",
+								tls_c->ct_wq?tls_c->ct_wq->queued:0);
+						goto error_wq_full;
+					}
+					tls_c->flags |= F_TLS_CON_WR_WANTS_RD;
+					break;
+				default:
+					TLS_ERR(err_src);
+					goto error;
+			}
+			send_flags->f &= ~SND_F_CON_CLOSE;
+			tls_set_mbufs(c, 0, 0);
+			goto end;
+		}
+		ssl_error = SSL_ERROR_NONE;
+	} else if (unlikely(tls_set_mbufs(c, &rd, &wr) < 0)) {
 		ERR("tls_set_mbufs failed\n");
 		goto error;
 	}
@@ -841,10 +932,11 @@ redo_wr:
 				send_flags->f &= ~SND_F_CON_CLOSE;
 				break; /* or goto end */
 			case SSL_ERROR_WANT_WRITE:
-				if (unlikely(offs == 0)) {
+				if (unlikely(offs == 0 && wr.used == 0)) {
 					/*  error, no record fits in the buffer or
 					  no partial write enabled and buffer to small to fit
-					  all the records */
+					  all the records (wr.used != 0 if batched data was
+					  encoded first) */
 					BUG("write buffer too small (%d/%d bytes)\n",
 							wr.used, wr.size);
 					goto bug;
@@ -937,6 +1029,79 @@ ssl_eof:
 
 
 
+/** tls flush batched data.
+ * Called by the tcp code when the tcp write queue of the connection has been
+ * emptied, it encodes the clear text batched by tls_encode_f() directly in
+ * the given buffer (normally a new tcp write queue block).
+ * WARNING: it must always be called with c->write_lock held!
+ * @param c - tcp connection
+ * @param buf - buffer for the tls records.
+ * @param size - buffer size.
+ * @param more - (result) set to 1 if the batched data did not fit in buf
+ *               (it should be called again with a new buffer), 0 otherwise.
+ * @return bytes written in buf on success (>=0), < 0 on error.
+ */
+int tls_h_flush(struct tcp_connection *c, char* buf, unsigned int size,
+					int* more)
+{
+	struct tls_extra_data* tls_c;
+	struct tls_mbuf rd, wr;
+	int n;
+	int flush_flags;
+	int ssl_error;
+
+	*more = 0;
+	tls_c = (struct tls_extra_data*)c->extra_data;
+	if (likely(tls_c == 0 || tls_ct_q_empty(tls_c->ct_bq)))
+		return 0;
+	tls_mbuf_init(&rd, 0, 0); /* no read */
+	tls_mbuf_init(&wr, (unsigned char*)buf, size);
+	if (unlikely(tls_set_mbufs(c, &rd, &wr) < 0)) {
+		ERR("tls_set_mbufs failed\n");
+		return -1;
+	}
+	flush_flags = 0;
+	ssl_error = SSL_ERROR_NONE;
+	n = tls_ct_wq_flush(c, &tls_c->ct_bq, &flush_flags, &ssl_error);
+	TLS_WR_TRACE("(%p) ct_bq_flush()=> %d (ff=%d ssl_error=%d used=%d)\n",
+					c, n, flush_flags, ssl_error, wr.used);
+	if (unlikely(n < 0))
+		goto error;
+	if (unlikely(!(flush_flags & F_BUFQ_EMPTY))) {
+		switch(ssl_error) {
+			case SSL_ERROR_NONE:
+			case SSL_ERROR_WANT_WRITE:
+				/* buf full */
+				if (unlikely(wr.used == 0)) {
+					BUG("write buffer too small (%d/%d bytes)\n",
+							wr.used, wr.size);
+					goto error;
+				}
+				*more = 1;
+				break;
+			case SSL_ERROR_WANT_READ:
+				/* renegotiation: wait for a read, like tls_encode_f() */
+				if (unlikely(tls_ct_bq_move(tls_c) < 0)) {
+					ERR("ct write buffer full (%d bytes)\n",
+							tls_c->ct_wq?tls_c->ct_wq->queued:0);
+					goto error;
+				}
+				tls_c->flags |= F_TLS_CON_WR_WANTS_RD;
+				break;
+			default:
+				TLS_ERR("TLS write:");
+				goto error;
+		}
+	}
+	tls_set_mbufs(c, 0, 0);
+	return wr.used;
+error:
+	tls_set_mbufs(c, 0, 0);
+	return -1;
+}
+
+
+
 /** tls read.
  * Each modification of ssl data structures has to be protected, another process * might ask for the same connection and attempt write to it which would
  * result in updating the ssl structures.
@@ -58,6 +58,8 @@ struct tls_extra_data {
 							   (openssl code might add buffering BIOs so
 							    it's better to remember our original BIO) */
 	tls_ct_q* ct_wq;
+	tls_ct_q* ct_bq;        /* clear text batched while the tcp write queue
+							   is not empty (send_batch) */
 	struct tls_rd_buf* enc_rd_buf;
 	unsigned int flags;
 	enum  tls_conn_states state;
@@ -90,6 +92,9 @@ int tls_encode_f(struct tcp_connection *c,
 
 int tls_read_f(struct tcp_connection *c, int* flags);
 
+int tls_h_flush(struct tcp_connection *c, char* buf, unsigned int size,
+					int* more);
+
 int tls_h_fix_read_conn(struct tcp_connection *c);
 
 int tls_connect(struct tcp_connection *c, int* error);
@@ -0,0 +1,314 @@
+/*
+ * TLS module
+ *
+ * Copyright (C) 2016 kamailio.org
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * tls session cache kept in shared memory.
+ * (openssl keeps the session cache in the SSL_CTX and there is one SSL_CTX
+ * per process, so a session could be resumed only if the new connection
+ * ended up in the same process. The sessions are stored here DER encoded,
+ * hashed by the session id, and the openssl internal cache is disabled).
+ * @file
+ * @ingroup tls
+ * Module: @ref tls
+ */
+
+#include <string.h>
+#include <time.h>
+#include "tls_sess_cache.h"
+#include "../../core/atomic_ops.h"
+#include "../../core/hashes.h"
+#include "../../core/locking.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/dprint.h"
+
+
+typedef struct tls_sess_entry {
+	struct tls_sess_entry* next;
+	tls_domain_t* dom; /* domain on which the session was established */
+	time_t expire;
+	unsigned int id_len;
+	unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+	int der_len;
+	unsigned char der[1]; /* DER encoded session */
+} tls_sess_entry_t;
+
+typedef struct tls_sess_slot {
+	gen_lock_t lock;
+	tls_sess_entry_t* first; /* newest first */
+} tls_sess_slot_t;
+
+typedef struct tls_sess_cache {
+	atomic_t entries; /* cached sessions */
+	int max_entries;
+	unsigned int size; /* number of slots, power of 2 */
+	tls_sess_slot_t slots[1];
+} tls_sess_cache_t;
+
+static tls_sess_cache_t* tls_sess_cache = 0;
+/* SSL_CTX ex_data index, for the domain owning the context */
+static int tls_sess_ctx_idx = -1;
+
+
+
+static inline tls_sess_slot_t* tls_sess_get_slot(const unsigned char* id,
+												unsigned int id_len)
+{
+	return &tls_sess_cache->slots[get_hash1_raw((const char*)id, id_len) &
+									(tls_sess_cache->size - 1)];
+}
+
+
+
+/* unlinks and frees *e, must be called with the slot lock held */
+static inline void tls_sess_entry_free(tls_sess_entry_t** e)
+{
+	tls_sess_entry_t* t;
+
+	t = *e;
+	*e = t->next;
+	shm_free(t);
+	atomic_dec(&tls_sess_cache->entries);
+}
+
+
+
+static inline tls_domain_t* tls_sess_get_dom(SSL_CTX* ctx)
+{
+	return (tls_domain_t*)SSL_CTX_get_ex_data(ctx, tls_sess_ctx_idx);
+}
+
+
+
+/* openssl new session callback */
+static int tls_sess_new_cb(SSL* ssl, SSL_SESSION* sess)
+{
+	tls_sess_entry_t* e;
+	tls_sess_entry_t** p;
+	tls_sess_slot_t* s;
+	const unsigned char* id;
+	unsigned int id_len;
+	unsigned char* der;
+	int der_len;
+	time_t now;
+
+	id = SSL_SESSION_get_id(sess, &id_len);
+	if (id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+		return 0;
+	der_len = i2d_SSL_SESSION(sess, 0);
+	if (der_len <= 0)
+		return 0;
+	e = shm_malloc(sizeof(*e) + der_len - 1);
+	if (e == 0) {
+		ERR("not enough shared memory for caching a tls session\n");
+		return 0;
+	}
+	e->next = 0;
+	e->dom = tls_sess_get_dom(SSL_get_SSL_CTX(ssl));
+	e->expire = SSL_SESSION_get_time(sess) + SSL_SESSION_get_timeout(sess);
+	e->id_len = id_len;
+	memcpy(e->id, id, id_len);
+	der = e->der;
+	e->der_len = i2d_SSL_SESSION(sess, &der);
+
+	now = time(0);
+	s = tls_sess_get_slot(id, id_len);
+	lock_get(&s->lock);
+	/* drop the expired sessions and any older copy of this one */
+	p = &s->first;
+	while (*p) {
+		if ((*p)->expire <= now || ((*p)->id_len == id_len &&
+					memcmp((*p)->id, id, id_len) == 0))
+			tls_sess_entry_free(p);
+		else
+			p = &(*p)->next;
+	}
+	/* the limit is not exact (the slots are not locked together) */
+	if (atomic_get(&tls_sess_cache->entries) >= tls_sess_cache->max_entries) {
+		if (s->first == 0) {
+			lock_release(&s->lock);
+			shm_free(e);
+			DBG("tls session cache full\n");
+			return 0;
+		}
+		/* make room by dropping the oldest session in the slot */
+		for (p = &s->first; (*p)->next; p = &(*p)->next);
+		tls_sess_entry_free(p);
+	}
+	e->next = s->first;
+	s->first = e;
+	atomic_inc(&tls_sess_cache->entries);
+	lock_release(&s->lock);
+	return 0; /* no reference to sess kept */
+}
+
+
+
+/* openssl get session callback */
+#if OPENSSL_VERSION_NUMBER >= 0x010100000L
+static SSL_SESSION* tls_sess_get_cb(SSL* ssl, const unsigned char* id,
+									int id_len, int* copy)
+#else
+static SSL_SESSION* tls_sess_get_cb(SSL* ssl, unsigned char* id,
+									int id_len, int* copy)
+#endif
+{
+	tls_sess_entry_t** p;
+	tls_sess_slot_t* s;
+	tls_domain_t* dom;
+	const unsigned char* der;
+	SSL_SESSION* sess;
+	time_t now;
+
+	*copy = 0; /* a new session is returned, openssl owns it */
+	if (id_len <= 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+		return 0;
+	sess = 0;
+	dom = tls_sess_get_dom(SSL_get_SSL_CTX(ssl));
+	now = time(0);
+	s = tls_sess_get_slot(id, id_len);
+	lock_get(&s->lock);
+	for (p = &s->first; *p; p = &(*p)->next) {
+		if ((*p)->id_len != id_len || (*p)->dom != dom ||
+				memcmp((*p)->id, id, id_len) != 0)
+			continue;
+		if ((*p)->expire <= now) {
+			tls_sess_entry_free(p);
+			break;
+		}
+		der = (*p)->der;
+		sess = d2i_SSL_SESSION(0, &der, (*p)->der_len);
+		break;
+	}
+	lock_release(&s->lock);
+	return sess;
+}
+
+
+
+/* openssl remove session callback */
+static void tls_sess_remove_cb(SSL_CTX* ctx, SSL_SESSION* sess)
+{
+	tls_sess_entry_t** p;
+	tls_sess_slot_t* s;
+	tls_domain_t* dom;
+	const unsigned char* id;
+	unsigned int id_len;
+
+	id = SSL_SESSION_get_id(sess, &id_len);
+	if (id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+		return;
+	dom = tls_sess_get_dom(ctx);
+	s = tls_sess_get_slot(id, id_len);
+	lock_get(&s->lock);
+	for (p = &s->first; *p; p = &(*p)->next) {
+		if ((*p)->id_len == id_len && (*p)->dom == dom &&
+				memcmp((*p)->id, id, id_len) == 0) {
+			tls_sess_entry_free(p);
+			break;
+		}
+	}
+	lock_release(&s->lock);
+}
+
+
+
+int tls_sess_cache_init(int max_entries)
+{
+	unsigned int size;
+	unsigned int i;
+
+	for (size = 16; size * 4 < max_entries && size < 65536; size <<= 1);
+	tls_sess_cache = shm_malloc(sizeof(*tls_sess_cache) +
+								(size - 1) * sizeof(tls_sess_slot_t));
+	if (tls_sess_cache == 0) {
+		ERR("not enough shared memory for the tls session cache\n");
+		return -1;
+	}
+	memset(tls_sess_cache, 0, sizeof(*tls_sess_cache) +
+								(size - 1) * sizeof(tls_sess_slot_t));
+	atomic_set(&tls_sess_cache->entries, 0);
+	tls_sess_cache->max_entries = max_entries;
+	tls_sess_cache->size = size;
+	for (i = 0; i < size; i++) {
+		if (lock_init(&tls_sess_cache->slots[i].lock) == 0) {
+			ERR("failed to init the tls session cache locks\n");
+			goto error;
+		}
+	}
+	/* before forking, the index must be the same in all the processes */
+	tls_sess_ctx_idx = SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+	if (tls_sess_ctx_idx < 0) {
+		ERR("failed to get a SSL_CTX ex_data index\n");
+		i = size;
+		goto error;
+	}
+	return 0;
+error:
+	while (i > 0)
+		lock_destroy(&tls_sess_cache->slots[--i].lock);
+	shm_free(tls_sess_cache);
+	tls_sess_cache = 0;
+	return -1;
+}
+
+
+
+void tls_sess_cache_flush(void)
+{
+	unsigned int i;
+
+	if (tls_sess_cache == 0)
+		return;
+	for (i = 0; i < tls_sess_cache->size; i++) {
+		lock_get(&tls_sess_cache->slots[i].lock);
+		while (tls_sess_cache->slots[i].first)
+			tls_sess_entry_free(&tls_sess_cache->slots[i].first);
+		lock_release(&tls_sess_cache->slots[i].lock);
+	}
+}
+
+
+
+void tls_sess_cache_destroy(void)
+{
+	unsigned int i;
+
+	if (tls_sess_cache == 0)
+		return;
+	tls_sess_cache_flush();
+	for (i = 0; i < tls_sess_cache->size; i++)
+		lock_destroy(&tls_sess_cache->slots[i].lock);
+	shm_free(tls_sess_cache);
+	tls_sess_cache = 0;
+}
+
+
+
+int tls_sess_cache_set(SSL_CTX* ctx, tls_domain_t* d)
+{
+	if (tls_sess_cache == 0)
+		return -1;
+	if (SSL_CTX_set_ex_data(ctx, tls_sess_ctx_idx, d) == 0)
+		return -1;
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER |
+										SSL_SESS_CACHE_NO_INTERNAL);
+	SSL_CTX_sess_set_new_cb(ctx, tls_sess_new_cb);
+	SSL_CTX_sess_set_get_cb(ctx, tls_sess_get_cb);
+	SSL_CTX_sess_set_remove_cb(ctx, tls_sess_remove_cb);
+	return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * TLS module
+ *
+ * Copyright (C) 2016 kamailio.org
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * tls session cache kept in shared memory (sessions established by one
+ * process can be resumed by any other process).
+ * @file
+ * @ingroup tls
+ * Module: @ref tls
+ */
+
+#ifndef __tls_sess_cache_h
+#define __tls_sess_cache_h
+
+#include <openssl/ssl.h>
+#include "tls_domain.h"
+
+
+/**
+ * @brief Init the shared memory session cache
+ * @param max_entries maximum number of cached sessions
+ * @return 0 on success, < 0 on error.
+ */
+int tls_sess_cache_init(int max_entries);
+
+/**
+ * @brief Destroy the shared memory session cache
+ */
+void tls_sess_cache_destroy(void);
+
+/**
+ * @brief Remove all the cached sessions (e.g. on config reload)
+ */
+void tls_sess_cache_flush(void);
+
+/**
+ * @brief Use the shared memory session cache for a SSL context
+ * @param ctx SSL context
+ * @param d domain owning the context (sessions are not shared between
+ *          domains)
+ * @return 0 on success, < 0 on error.
+ */
+int tls_sess_cache_set(SSL_CTX* ctx, tls_domain_t* d);
+
+#endif /* __tls_sess_cache_h */
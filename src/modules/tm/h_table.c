@@ -26,6 +26,7 @@
  */
 
 #include <stdlib.h>
+#include <sched.h>
 
 
 #include "../../core/mem/shm_mem.h"
@@ -36,6 +37,7 @@
 #include "../../core/globals.h"
 #include "../../core/error.h"
 #include "../../core/char_msg_val.h"
+#include "../../core/sip_msg_clone.h"
 #include "../../core/rand/kam_rand.h"
 #include "defs.h"
 #include "t_reply.h"
@@ -75,15 +77,28 @@ enum kill_reason get_kr()
 }
 
 
+int tm_hash_size = TABLE_ENTRIES;
+
+/* spins before yielding the cpu while waiting for the readers to leave */
+#define TM_HASH_RD_SPINS 128
+
 void lock_hash(int i)
 {
 
 	int mypid;
+	int n;
 
 	mypid = my_pid();
 	if(likely(atomic_get(&_tm_table->entries[i].locker_pid) != mypid)) {
 		lock(&_tm_table->entries[i].mutex);
 		atomic_set(&_tm_table->entries[i].locker_pid, mypid);
+		/* no new reader can come in while the mutex is held, wait for the
+		 * ones still walking the list */
+		for(n = 0; unlikely(atomic_get(&_tm_table->entries[i].readers)); n++) {
+			if(n >= TM_HASH_RD_SPINS)
+				sched_yield();
+		}
+		membar_read();
 	} else {
 		/* locked within the same process that called us*/
 		_tm_table->entries[i].rec_lock_level++;
@@ -103,6 +118,31 @@ void unlock_hash(int i)
 }
 
 
+/* the mutex is held only while registering as reader, so the readers
+ * don't wait for each other while walking the list, only for the
+ * processes changing it (lock_hash()) */
+void lock_hash_read(int i)
+{
+	if(unlikely(atomic_get(&_tm_table->entries[i].locker_pid) == my_pid())) {
+		/* already owned exclusively by this process */
+		return;
+	}
+	lock(&_tm_table->entries[i].mutex);
+	atomic_inc(&_tm_table->entries[i].readers);
+	unlock(&_tm_table->entries[i].mutex);
+}
+
+
+void unlock_hash_read(int i)
+{
+	if(unlikely(atomic_get(&_tm_table->entries[i].locker_pid) == my_pid())) {
+		return;
+	}
+	membar_read_atomic_op();
+	atomic_dec(&_tm_table->entries[i].readers);
+}
+
+
 #ifdef TM_HASH_STATS
 unsigned int transaction_count(void)
 {
@@ -110,7 +150,7 @@ unsigned int transaction_count(void)
 	unsigned int count;
 
 	count = 0;
-	for(i = 0; i < TABLE_ENTRIES; i++)
+	for(i = 0; i < _tm_table->size; i++)
 		count += _tm_table->entries[i].cur_entries;
 	return count;
 }
@@ -149,8 +189,12 @@ void free_cell_helper(
 
 	shm_lock();
 	/* UA Server */
-	if(dead_cell->uas.request)
-		sip_msg_free_unsafe(dead_cell->uas.request);
+	if(dead_cell->uas.request) {
+		if(tm_arena_has(dead_cell, dead_cell->uas.request))
+			_sip_msg_free_lumps(shm_free_unsafe, dead_cell->uas.request);
+		else
+			sip_msg_free_unsafe(dead_cell->uas.request);
+	}
 	if(dead_cell->uas.response.buffer)
 		shm_free_unsafe(dead_cell->uas.response.buffer);
 #ifdef CANCEL_REASON_SUPPORT
@@ -178,10 +222,10 @@ void free_cell_helper(
 	for(i = 0; i < dead_cell->nr_of_outgoings; i++) {
 		/* retransmission buffer */
 		if((b = dead_cell->uac[i].request.buffer))
-			shm_free_unsafe(b);
+			tm_arena_shm_free_unsafe(dead_cell, b);
 		b = dead_cell->uac[i].local_cancel.buffer;
 		if(b != 0 && b != BUSY_BUFFER)
-			shm_free_unsafe(b);
+			tm_arena_shm_free_unsafe(dead_cell, b);
 		rpl = dead_cell->uac[i].reply;
 		if(rpl && rpl != FAKED_REPLY && rpl->msg_flags & FL_SHM_CLONE) {
 			sip_msg_free_unsafe(rpl);
@@ -206,16 +250,16 @@ void free_cell_helper(
 		dns_srv_handle_put_shm_unsafe(&dead_cell->uac[i].dns_h);
 #endif
 		if(unlikely(dead_cell->uac[i].path.s)) {
-			shm_free_unsafe(dead_cell->uac[i].path.s);
+			tm_arena_shm_free_unsafe(dead_cell, dead_cell->uac[i].path.s);
 		}
 		if(unlikely(dead_cell->uac[i].instance.s)) {
-			shm_free_unsafe(dead_cell->uac[i].instance.s);
+			tm_arena_shm_free_unsafe(dead_cell, dead_cell->uac[i].instance.s);
 		}
 		if(unlikely(dead_cell->uac[i].ruid.s)) {
-			shm_free_unsafe(dead_cell->uac[i].ruid.s);
+			tm_arena_shm_free_unsafe(dead_cell, dead_cell->uac[i].ruid.s);
 		}
 		if(unlikely(dead_cell->uac[i].location_ua.s)) {
-			shm_free_unsafe(dead_cell->uac[i].location_ua.s);
+			tm_arena_shm_free_unsafe(dead_cell, dead_cell->uac[i].location_ua.s);
 		}
 	}
 
@@ -247,7 +291,7 @@ void free_cell_helper(
 		xavp_destroy_list_unsafe(&dead_cell->xavps_list);
 #endif
 
-	/* the cell's body */
+	/* the cell's body, together with the arena */
 	shm_free_unsafe(dead_cell);
 
 	shm_unlock();
@@ -300,6 +344,62 @@ static void inline init_branches(struct cell *t)
 }
 
 
+/**
+ * @brief Allocate size bytes from the arena of a transaction
+ * @return pointer inside the cell chunk, or 0 if there is not enough space
+ * left in the arena (nothing is released until the cell is freed)
+ */
+char *tm_arena_alloc(struct cell *t, unsigned int size)
+{
+	int used;
+	int n;
+
+	size = ROUND_POINTER(size);
+	do {
+		used = atomic_get(&t->arena_used);
+		n = used + size;
+		if(n > (int)t->arena_size || n < used)
+			return 0;
+	} while(atomic_cmpxchg(&t->arena_used, used, n) != used);
+	return (char *)t + used;
+}
+
+
+/**
+ * @brief Allocate size bytes from the arena of a transaction, falling back
+ * to shm_malloc() if the arena is exhausted
+ * @note free with tm_arena_shm_free()
+ */
+char *tm_arena_shm_malloc(struct cell *t, unsigned int size)
+{
+	char *p;
+
+	p = tm_arena_alloc(t, size);
+	if(p == 0)
+		p = (char *)shm_malloc(size);
+	return p;
+}
+
+
+/* clones the request inside the arena of t, if it fits there */
+static struct sip_msg *tm_arena_msg_clone(
+		struct cell *t, struct sip_msg *p_msg, int *sip_msg_len)
+{
+	unsigned int len;
+	char *p;
+
+	if(atomic_get(&t->arena_used) >= (int)t->arena_size)
+		return sip_msg_cloner(p_msg, sip_msg_len);
+	/* requests are cloned without lumps, see sip_msg_cloner() */
+	len = sip_msg_shm_clone_len(p_msg, 0);
+	p = tm_arena_alloc(t, len);
+	if(p == 0)
+		return sip_msg_cloner(p_msg, sip_msg_len);
+	*sip_msg_len = len;
+	return sip_msg_shm_clone_buf(p_msg, p, 0);
+}
+
+
 struct cell *build_cell(struct sip_msg *p_msg)
 {
 	struct cell *new_cell;
@@ -316,15 +416,19 @@ struct cell *build_cell(struct sip_msg *p_msg)
 	 * uac (sr_dst_max_banches * sizeof(struct ua_client) ) */
 	cell_size = sizeof(struct cell) + MD5_LEN - sizeof(((struct cell *)0)->md5)
 				+ (sr_dst_max_branches * sizeof(struct ua_client));
+	cell_size = ROUND_POINTER(cell_size);
 
-	new_cell = (struct cell *)shm_malloc(cell_size);
+	/* the arena follows the cell in the same chunk */
+	new_cell = (struct cell *)shm_malloc(cell_size + tm_arena_size);
 	if(!new_cell) {
 		ser_error = E_OUT_OF_MEM;
 		return NULL;
 	}
 
-	/* filling with 0 */
+	/* filling with 0 (only the cell, the arena is filled when used) */
 	memset(new_cell, 0, cell_size);
+	new_cell->arena_size = cell_size + tm_arena_size;
+	atomic_set(&new_cell->arena_used, cell_size);
 
 	/* UAS */
 	new_cell->uas.response.my_T = new_cell;
@@ -375,7 +479,8 @@ struct cell *build_cell(struct sip_msg *p_msg)
 	}
 
 	if(p_msg) {
-		new_cell->uas.request = sip_msg_cloner(p_msg, &sip_msg_len);
+		new_cell->uas.request =
+				tm_arena_msg_clone(new_cell, p_msg, &sip_msg_len);
 		if(!new_cell->uas.request)
 			goto error;
 		new_cell->uas.end_request =
@@ -440,7 +545,7 @@ void free_hash_table()
 
 	if(_tm_table) {
 		/* remove the data contained by each entry */
-		for(i = 0; i < TABLE_ENTRIES; i++) {
+		for(i = 0; i < _tm_table->size; i++) {
 			release_entry_lock((_tm_table->entries) + i);
 			/* delete all synonyms at hash-collision-slot i */
 			clist_foreach_safe(&_tm_table->entries[i], p_cell, tmp_cell, next_c)
@@ -461,20 +566,24 @@ struct s_table *init_hash_table()
 	int i;
 
 	/*allocs the table*/
-	_tm_table = (struct s_table *)shm_malloc(sizeof(struct s_table));
+	_tm_table = (struct s_table *)shm_malloc(
+			sizeof(struct s_table) + tm_hash_size * sizeof(struct entry));
 	if(!_tm_table) {
 		LOG(L_ERR, "ERROR: init_hash_table: no shmem for TM table\n");
 		goto error0;
 	}
 
-	memset(_tm_table, 0, sizeof(struct s_table));
+	memset(_tm_table, 0,
+			sizeof(struct s_table) + tm_hash_size * sizeof(struct entry));
+	_tm_table->size = tm_hash_size;
+	_tm_table->entries = (struct entry *)(_tm_table + 1);
 
 	/* try first allocating all the structures needed for syncing */
 	if(lock_initialize() == -1)
 		goto error1;
 
 	/* inits the entriess */
-	for(i = 0; i < TABLE_ENTRIES; i++) {
+	for(i = 0; i < _tm_table->size; i++) {
 		init_entry_lock(_tm_table, (_tm_table->entries) + i);
 		_tm_table->entries[i].next_label = kam_rand();
 		/* init cell list */
@@ -83,9 +83,15 @@ struct async_state;
 
 #define LOCK_HASH(_h) lock_hash((_h))
 #define UNLOCK_HASH(_h) unlock_hash((_h))
+/* shared lock, only for walking the list (no changes); a process holding
+ * it must not try LOCK_HASH() on the same entry */
+#define LOCK_HASH_READ(_h) lock_hash_read((_h))
+#define UNLOCK_HASH_READ(_h) unlock_hash_read((_h))
 
 void lock_hash(int i);
 void unlock_hash(int i);
+void lock_hash_read(int i);
+void unlock_hash_read(int i);
 
 
 #define NO_CANCEL ((char *)0)
@@ -468,6 +474,12 @@ typedef struct cell
 	/* branch route backup for late branch add (t_append_branch) */
 	unsigned short on_branch_delayed;
 
+	/* transaction arena: the cell is allocated together with tm_arena_size
+	 * extra bytes, from which the cloned request and the branch buffers
+	 * are taken (bump allocation, released only with the cell) */
+	unsigned int arena_size; /* total size of the cell chunk */
+	atomic_t arena_used;	 /* bytes already used, from the cell start */
+
 	/* place holder for MD5checksum, MD5_LEN bytes are extra alloc'ed */
 	char md5[0];
 
@@ -496,6 +508,7 @@ typedef struct entry
 	ser_lock_t mutex;
 	atomic_t locker_pid; /* pid of the process that holds the lock */
 	int rec_lock_level;  /* recursive lock count */
+	atomic_t readers;    /* processes holding the shared (read) lock */
 	/* currently highest sequence number in a synonym list */
 	unsigned int next_label;
 #ifdef TM_HASH_STATS
@@ -509,14 +522,30 @@ typedef struct entry
 /* transaction table */
 typedef struct s_table
 {
+	unsigned int size; /* number of entries, power of 2 */
 	/* table of hash entries; each of them is a list of synonyms  */
-	struct entry entries[TABLE_ENTRIES];
+	struct entry *entries;
 } s_table_t;
 
+/* number of hash table entries (hash_size modparam) */
+extern int tm_hash_size;
+
+/* hash table entry for a callid and cseq number */
+#define tm_hash(callid, cseq_nr) \
+	(hash((callid), (cseq_nr)) & (_tm_table->size - 1))
+
 /* pointer to the big table where all the transaction data lives */
 extern struct s_table *_tm_table; /* private internal stuff, don't touch
 								 * directly */
 
+/* extra bytes allocated with each cell for the transaction arena */
+extern int tm_arena_size;
+
+/* true if p points inside the cell chunk of t (arena included) */
+#define tm_arena_has(t, p) \
+	((char *)(p) >= (char *)(t) \
+			&& (char *)(p) < (char *)(t) + (t)->arena_size)
+
 #define list_entry(ptr, type, member) \
 	((type *)((char *)(ptr) - (unsigned long)(&((type *)0)->member)))
 
@@ -561,6 +590,22 @@ void free_cell_helper(tm_cell_t *dead_cell, int silent, const char *fname,
 
 struct cell *build_cell(struct sip_msg *p_msg);
 
+char *tm_arena_alloc(struct cell *t, unsigned int size);
+char *tm_arena_shm_malloc(struct cell *t, unsigned int size);
+
+/* frees p, unless it was allocated from the arena of t */
+#define tm_arena_shm_free(t, p)     \
+	do {                            \
+		if(!tm_arena_has((t), (p))) \
+			shm_free(p);            \
+	} while(0)
+
+#define tm_arena_shm_free_unsafe(t, p) \
+	do {                               \
+		if(!tm_arena_has((t), (p)))    \
+			shm_free_unsafe(p);        \
+	} while(0)
+
 #ifdef TM_HASH_STATS
 unsigned int transaction_count(void);
 #endif
@@ -52,6 +52,23 @@
 
 #include "../../core/atomic_ops.h" /* membar_depends() */
 
+/**
+ * @brief Helper function to free the lumps block of a cloned request
+ *
+ * The lumps are cloned later than the request (see save_msg_lumps()),
+ * into a separate memory block linked to add_rm, body_lumps or reply_lump
+ */
+#define _sip_msg_free_lumps(_free_func, _p_msg)   \
+	do {                                          \
+		membar_depends();                         \
+		if((_p_msg)->add_rm)                      \
+			_free_func((_p_msg)->add_rm);         \
+		else if((_p_msg)->body_lumps)             \
+			_free_func((_p_msg)->body_lumps);     \
+		else if((_p_msg)->reply_lump)             \
+			_free_func((_p_msg)->reply_lump);     \
+	} while(0)
+
 /**
  * @brief Helper function to free a SIP message
  *
@@ -67,13 +84,7 @@
 		if(_p_msg->first_line.type == SIP_REPLY) { \
 			_free_func((_p_msg));                  \
 		} else {                                   \
-			membar_depends();                      \
-			if((_p_msg)->add_rm)                   \
-				_free_func((_p_msg)->add_rm);      \
-			else if((_p_msg)->body_lumps)          \
-				_free_func((_p_msg)->body_lumps);  \
-			else if((_p_msg)->reply_lump)          \
-				_free_func((_p_msg)->reply_lump);  \
+			_sip_msg_free_lumps(_free_func, _p_msg); \
 			_free_func((_p_msg));                  \
 		}                                          \
 	} while(0)
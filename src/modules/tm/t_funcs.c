@@ -88,6 +88,7 @@ void tm_shutdown()
 	/* destroy the hash table */
 	DBG("DEBUG: tm_shutdown : emptying hash table\n");
 	free_hash_table( );
+	tm_tshards_destroy();
 	DBG("DEBUG: tm_shutdown : removing semaphores\n");
 	lock_cleanup();
 	DBG("DEBUG: tm_shutdown : destroying tmcb lists\n");
@@ -93,6 +93,34 @@ void set_branch_route( unsigned int on_branch)
 
 
 
+/** builds the branch request buffer.
+ * If there is space left in the transaction arena, the request is printed
+ * in pkg memory and then copied into the arena, otherwise it is built
+ * directly in shm.
+ * @return buffer (free with tm_arena_shm_free()) or 0 on error
+ */
+static char *tm_build_req_buf(struct cell *t, struct sip_msg *i_req,
+		unsigned int *len, struct dest_info *dst)
+{
+	char *buf;
+	char *shbuf;
+
+	if (atomic_get(&t->arena_used) >= (int)t->arena_size)
+		return build_req_buf_from_sip_req(i_req, len, dst, BUILD_IN_SHM);
+
+	buf=build_req_buf_from_sip_req(i_req, len, dst, 0);
+	if (!buf)
+		return 0;
+	/* keep the trailing 0, like the BUILD_IN_SHM buffers */
+	shbuf=tm_arena_shm_malloc(t, *len+1);
+	if (shbuf)
+		memcpy(shbuf, buf, *len+1);
+	else
+		*len=0;
+	pkg_free(buf);
+	return shbuf;
+}
+
 /** prepares a new branch "buffer".
  * Creates the buffer used in the branch rb, fills everything needed (
  * the sending information: t->uac[branch].request.dst, branch buffer, uri
@@ -471,7 +499,7 @@ static int prepare_new_uac( struct cell *t, struct sip_msg *i_req,
 		goto error01;
 	}
 	/* ... and build it now */
-	shbuf=build_req_buf_from_sip_req( i_req, &len, dst, BUILD_IN_SHM);
+	shbuf=tm_build_req_buf(t, i_req, &len, dst);
 	if (!shbuf) {
 		LM_ERR("could not build request\n");
 		ret=E_OUT_OF_MEM;
@@ -490,9 +518,9 @@ static int prepare_new_uac( struct cell *t, struct sip_msg *i_req,
 		i_req->first_line.u.request.method.len+1;
 	t->uac[branch].uri.len=GET_RURI(i_req)->len;
 	if (unlikely(i_req->path_vec.s && i_req->path_vec.len)){
-		t->uac[branch].path.s=shm_malloc(i_req->path_vec.len+1);
+		t->uac[branch].path.s=tm_arena_shm_malloc(t, i_req->path_vec.len+1);
 		if (unlikely(t->uac[branch].path.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
@@ -505,9 +533,9 @@ static int prepare_new_uac( struct cell *t, struct sip_msg *i_req,
 		memcpy( t->uac[branch].path.s, i_req->path_vec.s, i_req->path_vec.len);
 	}
 	if (unlikely(i_req->instance.s && i_req->instance.len)){
-		t->uac[branch].instance.s=shm_malloc(i_req->instance.len+1);
+		t->uac[branch].instance.s=tm_arena_shm_malloc(t, i_req->instance.len+1);
 		if (unlikely(t->uac[branch].instance.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
@@ -520,9 +548,9 @@ static int prepare_new_uac( struct cell *t, struct sip_msg *i_req,
 		memcpy( t->uac[branch].instance.s, i_req->instance.s, i_req->instance.len);
 	}
 	if (unlikely(i_req->ruid.s && i_req->ruid.len)){
-		t->uac[branch].ruid.s=shm_malloc(i_req->ruid.len+1);
+		t->uac[branch].ruid.s=tm_arena_shm_malloc(t, i_req->ruid.len+1);
 		if (unlikely(t->uac[branch].ruid.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
@@ -535,9 +563,9 @@ static int prepare_new_uac( struct cell *t, struct sip_msg *i_req,
 		memcpy( t->uac[branch].ruid.s, i_req->ruid.s, i_req->ruid.len);
 	}
 	if (unlikely(i_req->location_ua.s && i_req->location_ua.len)){
-		t->uac[branch].location_ua.s=shm_malloc(i_req->location_ua.len+1);
+		t->uac[branch].location_ua.s=tm_arena_shm_malloc(t, i_req->location_ua.len+1);
 		if (unlikely(t->uac[branch].location_ua.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
@@ -658,7 +686,7 @@ static char *print_uac_request_from_buf( struct cell *t, struct sip_msg *i_req,
 
 	/* allocate memory for the new buffer */
 	*len = buf_len + via_len - (old_via_end - old_via_begin);
-	shbuf=(char *)shm_malloc(*len);
+	shbuf=tm_arena_shm_malloc(t, *len);
 	if (!shbuf) {
 		ser_error=E_OUT_OF_MEM;
 		LM_ERR("no shmem\n");
@@ -891,9 +919,9 @@ static int add_uac_from_buf( struct cell *t, struct sip_msg *request,
 	t->uac[branch].uri.len=uri->len;
 	/* copy the path */
 	if (unlikely(path && path->s)){
-		t->uac[branch].path.s=shm_malloc(path->len+1);
+		t->uac[branch].path.s=tm_arena_shm_malloc(t, path->len+1);
 		if (unlikely(t->uac[branch].path.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
@@ -907,9 +935,9 @@ static int add_uac_from_buf( struct cell *t, struct sip_msg *request,
 	}
 	/* copy the instance */
 	if (unlikely(instance && instance->s)){
-		t->uac[branch].instance.s=shm_malloc(instance->len+1);
+		t->uac[branch].instance.s=tm_arena_shm_malloc(t, instance->len+1);
 		if (unlikely(t->uac[branch].instance.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
@@ -923,9 +951,9 @@ static int add_uac_from_buf( struct cell *t, struct sip_msg *request,
 	}
 	/* copy the ruid */
 	if (unlikely(ruid && ruid->s)){
-		t->uac[branch].ruid.s=shm_malloc(ruid->len+1);
+		t->uac[branch].ruid.s=tm_arena_shm_malloc(t, ruid->len+1);
 		if (unlikely(t->uac[branch].ruid.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
@@ -939,9 +967,9 @@ static int add_uac_from_buf( struct cell *t, struct sip_msg *request,
 	}
 	/* copy the location_ua */
 	if (unlikely(location_ua && location_ua->s)){
-		t->uac[branch].location_ua.s=shm_malloc(location_ua->len+1);
+		t->uac[branch].location_ua.s=tm_arena_shm_malloc(t, location_ua->len+1);
 		if (unlikely(t->uac[branch].location_ua.s==0)) {
-			shm_free(shbuf);
+			tm_arena_shm_free(t, shbuf);
 			t->uac[branch].request.buffer=0;
 			t->uac[branch].request.buffer_len=0;
 			t->uac[branch].uri.s=0;
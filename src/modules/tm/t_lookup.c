@@ -429,6 +429,24 @@ e2eack_found:
  * (T_branch is always set to T_BR_UNDEFINED).
  */
 
+/* the lookups that don't keep the entry locked for adding a new
+ * transaction need only the shared lock */
+static inline void t_lookup_lock(unsigned int hash_index, int excl)
+{
+	if (excl)
+		LOCK_HASH(hash_index);
+	else
+		LOCK_HASH_READ(hash_index);
+}
+
+static inline void t_lookup_unlock(unsigned int hash_index, int excl)
+{
+	if (excl)
+		UNLOCK_HASH(hash_index);
+	else
+		UNLOCK_HASH_READ(hash_index);
+}
+
 int t_lookup_request( struct sip_msg* p_msg , int leave_new_locked,
 		int* cancel)
 {
@@ -451,7 +469,7 @@ int t_lookup_request( struct sip_msg* p_msg , int leave_new_locked,
 
 	/* start searching into the table */
 	if (!(p_msg->msg_flags & FL_HASH_INDEX)){
-		p_msg->hash_index=hash( p_msg->callid->body , get_cseq(p_msg)->number);
+		p_msg->hash_index=tm_hash( p_msg->callid->body , get_cseq(p_msg)->number);
 		p_msg->msg_flags|=FL_HASH_INDEX;
 	}
 	isACK = p_msg->REQ_METHOD==METHOD_ACK;
@@ -475,7 +493,7 @@ int t_lookup_request( struct sip_msg* p_msg , int leave_new_locked,
 	if (branch && branch->value.s && branch->value.len>MCOOKIE_LEN
 			&& memcmp(branch->value.s,MCOOKIE,MCOOKIE_LEN)==0) {
 		/* huhuhu! the cookie is there -- let's proceed fast */
-		LOCK_HASH(p_msg->hash_index);
+		t_lookup_lock(p_msg->hash_index, leave_new_locked);
 		match_status=matching_3261(p_msg,&p_cell,
 				/* skip transactions with different method; otherwise CANCEL
 				 * would  match the previous INVITE trans.  */
@@ -494,7 +512,7 @@ int t_lookup_request( struct sip_msg* p_msg , int leave_new_locked,
 	LM_DBG("proceeding to pre-RFC3261 transaction matching\n");
 	*cancel=0;
 	/* lock the whole entry*/
-	LOCK_HASH(p_msg->hash_index);
+	t_lookup_lock(p_msg->hash_index, leave_new_locked);
 
 	hash_bucket=&(get_tm_table()->entries[p_msg->hash_index]);
 
@@ -636,7 +654,7 @@ notfound:
 	/* no transaction found */
 	set_t(0, T_BR_UNDEFINED);
 	if (!leave_new_locked) {
-		UNLOCK_HASH(p_msg->hash_index);
+		UNLOCK_HASH_READ(p_msg->hash_index);
 	}
 	LM_DBG("no transaction found\n");
 	return -1;
@@ -645,7 +663,7 @@ e2e_ack:
 	t_ack=p_cell;	/* e2e proxied ACK */
 	set_t(0, T_BR_UNDEFINED);
 	if (!leave_new_locked) {
-		UNLOCK_HASH(p_msg->hash_index);
+		UNLOCK_HASH_READ(p_msg->hash_index);
 	}
 	LM_DBG("e2e proxy ACK found\n");
 	return -2;
@@ -654,7 +672,7 @@ found:
 	set_t(p_cell, T_BR_UNDEFINED);
 	REF_UNSAFE( T );
 	set_kr(REQ_EXIST);
-	UNLOCK_HASH( p_msg->hash_index );
+	t_lookup_unlock(p_msg->hash_index, leave_new_locked);
 	LM_DBG("transaction found (T=%p)\n",T);
 	return 1;
 }
@@ -686,7 +704,7 @@ struct cell* t_lookupOriginalT(  struct sip_msg* p_msg )
 			/* stop processing */
 			return 0;
 		}
-		p_msg->hash_index=hash( p_msg->callid->body , get_cseq(p_msg)->number);
+		p_msg->hash_index=tm_hash( p_msg->callid->body , get_cseq(p_msg)->number);
 		p_msg->msg_flags|=FL_HASH_INDEX;
 	}
 	hash_index = p_msg->hash_index;
@@ -705,7 +723,7 @@ struct cell* t_lookupOriginalT(  struct sip_msg* p_msg )
 	if (branch && branch->value.s && branch->value.len>MCOOKIE_LEN
 			&& memcmp(branch->value.s,MCOOKIE,MCOOKIE_LEN)==0) {
 		/* huhuhu! the cookie is there -- let's proceed fast */
-		LOCK_HASH(hash_index);
+		LOCK_HASH_READ(hash_index);
 		ret=matching_3261(p_msg, &p_cell,
 				/* we are seeking the original transaction --
 				 * skip CANCEL transactions during search
@@ -716,7 +734,7 @@ struct cell* t_lookupOriginalT(  struct sip_msg* p_msg )
 
 	/* no cookies --proceed to old-fashioned pre-3261 t-matching */
 
-	LOCK_HASH(hash_index);
+	LOCK_HASH_READ(hash_index);
 
 	hash_bucket=&(get_tm_table()->entries[hash_index]);
 	/* all the transactions from the entry are compared */
@@ -781,14 +799,14 @@ struct cell* t_lookupOriginalT(  struct sip_msg* p_msg )
 notfound:
 	/* no transaction found */
 	LM_DBG(" no CANCEL matching found! \n" );
-	UNLOCK_HASH(hash_index);
+	UNLOCK_HASH_READ(hash_index);
 	LM_DBG("lookup completed\n");
 	return 0;
 
 found:
 	LM_DBG("canceled transaction found (%p)! \n",p_cell );
 	REF_UNSAFE( p_cell );
-	UNLOCK_HASH(hash_index);
+	UNLOCK_HASH_READ(hash_index);
 	LM_DBG("found - lookup completed\n");
 	return p_cell;
 }
@@ -864,7 +882,7 @@ int t_reply_matching( struct sip_msg *p_msg , int *p_branch )
 
 	/* sanity check */
 	if (unlikely(reverse_hex2int(hashi, hashl, &hash_index)<0
-				||hash_index>=TABLE_ENTRIES
+				||hash_index>=get_tm_table()->size
 				|| reverse_hex2int(branchi, branchl, &branch_id)<0
 				|| branch_id>=sr_dst_max_branches
 				|| loopl!=MD5_LEN)
@@ -883,7 +901,7 @@ int t_reply_matching( struct sip_msg *p_msg , int *p_branch )
 	cseq_method=get_cseq(p_msg)->method;
 	is_cancel=cseq_method.len==CANCEL_LEN
 		&& memcmp(cseq_method.s, CANCEL, CANCEL_LEN)==0;
-	LOCK_HASH(hash_index);
+	LOCK_HASH_READ(hash_index);
 	hash_bucket=&(get_tm_table()->entries[hash_index]);
 	/* all the transactions from the entry are compared */
 	clist_foreach(hash_bucket, p_cell, next_c){
@@ -929,7 +947,7 @@ int t_reply_matching( struct sip_msg *p_msg , int *p_branch )
 		set_t(p_cell, (int)branch_id);
 		*p_branch =(int) branch_id;
 		REF_UNSAFE( T );
-		UNLOCK_HASH(hash_index);
+		UNLOCK_HASH_READ(hash_index);
 		LM_DBG("reply matched (T=%p)!\n",T);
 		if(likely(!(p_msg->msg_flags&FL_TM_RPL_MATCHED))) {
 			/* if this is a 200 for INVITE, we will wish to store to-tags to be
@@ -968,7 +986,7 @@ int t_reply_matching( struct sip_msg *p_msg , int *p_branch )
 	} /* for cycle */
 
 	/* nothing found */
-	UNLOCK_HASH(hash_index);
+	UNLOCK_HASH_READ(hash_index);
 	LM_DBG("no matching transaction exists\n");
 
 nomatch2:
@@ -1540,12 +1558,12 @@ int t_lookup_ident(struct cell ** trans, unsigned int hash_index,
 	struct cell* p_cell;
 	struct entry* hash_bucket;
 
-	if(unlikely(hash_index >= TABLE_ENTRIES)){
+	if(unlikely(hash_index >= get_tm_table()->size)){
 		LM_ERR("invalid hash_index=%u\n",hash_index);
 		return -1;
 	}
 
-	LOCK_HASH(hash_index);
+	LOCK_HASH_READ(hash_index);
 
 #ifndef E2E_CANCEL_HOP_BY_HOP
 #warning "t_lookup_ident() can only reliably match INVITE transactions in " \
@@ -1557,7 +1575,7 @@ int t_lookup_ident(struct cell ** trans, unsigned int hash_index,
 		prefetch_loc_r(p_cell->next_c, 1);
 		if(p_cell->label == label){
 			REF_UNSAFE(p_cell);
-			UNLOCK_HASH(hash_index);
+			UNLOCK_HASH_READ(hash_index);
 			set_t(p_cell, T_BR_UNDEFINED);
 			*trans=p_cell;
 			LM_DBG("transaction found\n");
@@ -1565,7 +1583,7 @@ int t_lookup_ident(struct cell ** trans, unsigned int hash_index,
 		}
 	}
 
-	UNLOCK_HASH(hash_index);
+	UNLOCK_HASH_READ(hash_index);
 	set_t(0, T_BR_UNDEFINED);
 	*trans=p_cell;
 
@@ -1630,9 +1648,9 @@ int t_lookup_callid(struct cell ** trans, str callid, str cseq) {
 	invite_method.len = INVITE_LEN;
 
 	/* lookup the hash index where the transaction is stored */
-	hash_index=hash(callid, cseq);
+	hash_index=tm_hash(callid, cseq);
 
-	if(unlikely(hash_index >= TABLE_ENTRIES)){
+	if(unlikely(hash_index >= get_tm_table()->size)){
 		LM_ERR("invalid hash_index=%u\n",hash_index);
 		return -1;
 	}
@@ -1646,7 +1664,7 @@ int t_lookup_callid(struct cell ** trans, str callid, str cseq) {
 	LM_DBG("created comparable cseq header field: >%.*s<\n",
 			(int)(endpos - cseq_header), cseq_header);
 
-	LOCK_HASH(hash_index);
+	LOCK_HASH_READ(hash_index);
 	LM_DBG("just locked hash index %u, looking for transactions there:\n",
 			hash_index);
 
@@ -1663,7 +1681,7 @@ int t_lookup_callid(struct cell ** trans, str callid, str cseq) {
 					p_cell->callid.len, p_cell->callid.s, p_cell->cseq_n.len,
 					p_cell->cseq_n.s);
 			REF_UNSAFE(p_cell);
-			UNLOCK_HASH(hash_index);
+			UNLOCK_HASH_READ(hash_index);
 			set_t(p_cell, T_BR_UNDEFINED);
 			*trans=p_cell;
 			LM_DBG("t_lookup_callid: transaction found.\n");
@@ -1674,7 +1692,7 @@ int t_lookup_callid(struct cell ** trans, str callid, str cseq) {
 
 	}
 
-	UNLOCK_HASH(hash_index);
+	UNLOCK_HASH_READ(hash_index);
 	LM_DBG("transaction not found.\n");
 
 	return -1;
@@ -1478,6 +1478,7 @@ branches_failed:
 int t_retransmit_reply( struct cell *t )
 {
 	static char b[BUF_SIZE];
+	struct retr_buf rb;
 	int len;
 
 	/* first check if we managed to resolve topmost Via
@@ -1513,8 +1514,16 @@ int t_retransmit_reply( struct cell *t )
 		goto error;
 	}
 	memcpy( b, t->uas.response.buffer, len );
+	/* the result of a retransmission is not used, so an udp
+	 * retransmission can be queued in the current udp send batch */
+	rb.dst = t->uas.response.dst;
 	UNLOCK_REPLIES( t );
-	SEND_PR_BUFFER( & t->uas.response, b, len );
+	if (rb.dst.proto == PROTO_UDP) {
+		rb.dst.send_flags.f |= SND_F_UDP_BATCH;
+		SEND_PR_BUFFER( &rb, b, len );
+	} else {
+		SEND_PR_BUFFER( & t->uas.response, b, len );
+	}
 	if (unlikely(has_tran_tmcbs(t, TMCB_RESPONSE_SENT))){
 		/* we don't know if it's a retransmission of a local reply or a
 		 * forwarded reply */
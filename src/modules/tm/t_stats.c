@@ -195,7 +195,7 @@ void tm_rpc_hash_stats(rpc_t* rpc, void* c)
 	crt_zeroes=0;
 	crt_dev_no=0;
 	crt_dev=0;
-	for (r=0; r<TABLE_ENTRIES; r++){
+	for (r=0; r<_tm_table->size; r++){
 		acc=_tm_table->entries[r].acc_entries;
 		crt=_tm_table->entries[r].cur_entries;
 		
@@ -209,10 +209,10 @@ void tm_rpc_hash_stats(rpc_t* rpc, void* c)
 		if (crt>crt_max) crt_max=crt;
 		if (crt==0) crt_zeroes++;
 	}
-	acc_average=acc_count/(double)TABLE_ENTRIES;
-	crt_average=crt_count/(double)TABLE_ENTRIES;
+	acc_average=acc_count/(double)_tm_table->size;
+	crt_average=crt_count/(double)_tm_table->size;
 	
-	for (r=0; r<TABLE_ENTRIES; r++){
+	for (r=0; r<_tm_table->size; r++){
 		acc=_tm_table->entries[r].acc_entries;
 		crt=_tm_table->entries[r].cur_entries;
 		
@@ -229,7 +229,7 @@ void tm_rpc_hash_stats(rpc_t* rpc, void* c)
 	}
 	
 	if (rpc->add(c, "{", &st) < 0) return;
-	rpc->struct_add(st, "d", "hash_size", (unsigned) TABLE_ENTRIES);
+	rpc->struct_add(st, "d", "hash_size", (unsigned) _tm_table->size);
 	rpc->struct_add(st, "d", "crt_transactions", (unsigned)crt_count);
 	rpc->struct_add(st, "f", "crt_target_per_cell", crt_average);
 	rpc->struct_add(st, "dd", "crt_min", (unsigned)crt_min,
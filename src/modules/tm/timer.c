@@ -557,8 +557,8 @@ ticks_t retr_buf_handler(ticks_t ticks, struct timer_ln *tl, void *p)
 		/* WARNING:  the next line depends on taking care not to start the
 		 *           wait timer before finishing with t (if this is not
 		 *           guaranteed then comment the timer_allow_del() line) */
-		timer_allow_del(); /* [optional] allow timer_dels, since we're done
-							  and there is no race risk */
+		tm_tshard_allow_del(); /* [optional] allow timer_dels, since we're
+								  done and there is no race risk */
 		final_response_handler(rbuf, t);
 		return 0;
 	} else {
@@ -99,6 +99,7 @@
 #include "../../core/timer.h"
 #include "h_table.h"
 #include "config.h"
+#include "timer_shard.h"
 
 /**
  * \brief try to do fast retransmissions (but fall back to slow timer for FR
@@ -214,13 +215,19 @@ inline static int _set_fr_retr(struct retr_buf *rb, unsigned retr_ms)
 		LM_DBG("too late, timer already marked for deletion\n");
 		return 0;
 	}
+	if(tm_timer_procs > 0) {
+		ret = tm_tshard_add(tm_tshard_get(rb->my_T->hash_index), &(rb)->timer,
+				(timeout < retr_ticks) ? timeout : retr_ticks);
+	} else {
 #ifdef TIMER_DEBUG
-	ret = timer_add_safe(&(rb)->timer,
-			(timeout < retr_ticks) ? timeout : retr_ticks, file, func, line);
+		ret = timer_add_safe(&(rb)->timer,
+				(timeout < retr_ticks) ? timeout : retr_ticks, file, func,
+				line);
 #else
-	ret = timer_add(
-			&(rb)->timer, (timeout < retr_ticks) ? timeout : retr_ticks);
+		ret = timer_add(
+				&(rb)->timer, (timeout < retr_ticks) ? timeout : retr_ticks);
 #endif
+	}
 	if(ret == 0)
 		rb->t_active = 1;
 	membar_write_atomic_op(); /* make sure t_active will be commited to mem.
@@ -237,7 +244,11 @@ inline static int _set_fr_retr(struct retr_buf *rb, unsigned retr_ms)
 		(rb)->flags |= F_RB_DEL_TIMER; /* timer should be deleted */ \
 		if((rb)->t_active) {                                         \
 			(rb)->t_active = 0;                                      \
-			timer_del(&(rb)->timer);                                 \
+			if(tm_timer_procs > 0)                                   \
+				tm_tshard_del(tm_tshard_get((rb)->my_T->hash_index), \
+						&(rb)->timer);                               \
+			else                                                     \
+				timer_del(&(rb)->timer);                             \
 		}                                                            \
 	} while(0)
 
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \file
+ * \brief TM :: retransmission timer shards
+ * \ingroup tm
+ */
+
+#include <sched.h>
+
+#include "../../core/mem/shm_mem.h"
+#include "../../core/dprint.h"
+#include "../../core/cfg/cfg_struct.h"
+#include "../../core/pt.h"
+#include "../../core/sr_module.h"
+#include "../../core/timer_proc.h"
+#include "../../core/udp_server.h"
+#include "timer_shard.h"
+
+int tm_timer_procs = 0;
+struct tm_tshard* tm_tshards = 0;
+
+/* shard run by the current process, 0 if not a shard timer process */
+static struct tm_tshard* in_tshard = 0;
+
+
+static void tm_tshard_init_lists(struct timer_lists* lst)
+{
+	int r;
+
+	for (r=0; r<H0_ENTRIES; r++)
+		_timer_init_list(&lst->h0[r]);
+	for (r=0; r<H1_ENTRIES; r++)
+		_timer_init_list(&lst->h1[r]);
+	for (r=0; r<H2_ENTRIES; r++)
+		_timer_init_list(&lst->h2[r]);
+	_timer_init_list(&lst->expired);
+}
+
+
+/** allocates the shards, called from mod_init
+ * returns 0 on success, -1 on error */
+int tm_tshards_init(void)
+{
+	int i;
+
+	if (tm_timer_procs <= 0)
+		return 0;
+	tm_tshards = shm_malloc(tm_timer_procs * sizeof(struct tm_tshard));
+	if (tm_tshards == 0) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(tm_tshards, 0, tm_timer_procs * sizeof(struct tm_tshard));
+	for (i=0; i<tm_timer_procs; i++) {
+		if (lock_init(&tm_tshards[i].lock) == 0) {
+			LM_ERR("failed to init the lock of timer shard %d\n", i);
+			goto error;
+		}
+		tm_tshard_init_lists(&tm_tshards[i].lst);
+		tm_tshards[i].prev_ticks = get_ticks_raw();
+	}
+	return 0;
+error:
+	while (--i >= 0)
+		lock_destroy(&tm_tshards[i].lock);
+	shm_free(tm_tshards);
+	tm_tshards = 0;
+	return -1;
+}
+
+
+void tm_tshards_destroy(void)
+{
+	int i;
+
+	if (tm_tshards == 0)
+		return;
+	for (i=0; i<tm_timer_procs; i++)
+		lock_destroy(&tm_tshards[i].lock);
+	shm_free(tm_tshards);
+	tm_tshards = 0;
+}
+
+
+/* same as _timer_dist_tl(), but for a shard (must be called with the
+ * shard lock held) */
+static inline void tm_tshard_dist_tl(struct tm_tshard* s,
+		struct timer_ln* tl, ticks_t delta)
+{
+	if (likely(delta<H0_ENTRIES)) {
+		if (unlikely(delta==0)) {
+			_timer_add_list(&s->lst.expired, tl);
+		} else {
+			_timer_add_list(&s->lst.h0[tl->expire & H0_MASK], tl);
+		}
+	} else if (likely(delta<(H0_ENTRIES*H1_ENTRIES))) {
+		_timer_add_list(&s->lst.h1[(tl->expire & H1_H0_MASK)>>H0_BITS], tl);
+	} else {
+		_timer_add_list(&s->lst.h2[tl->expire>>(H1_BITS+H0_BITS)], tl);
+	}
+}
+
+
+static inline void tm_tshard_redist(struct tm_tshard* s, ticks_t t,
+		struct timer_head* h)
+{
+	struct timer_ln* tl;
+	struct timer_ln* tmp;
+
+	timer_foreach_safe(tl, tmp, h) {
+		tm_tshard_dist_tl(s, tl, tl->expire-t);
+	}
+	_timer_init_list(h);
+}
+
+
+/* the expire time is relative to the shard time and not to the global
+ * ticks: the timer proc. might be a tick behind and adding relative to the
+ * global time could place the timer on an already processed h0 slot */
+static inline void _tm_tshard_add(struct tm_tshard* s, struct timer_ln* tl)
+{
+	tl->expire = s->prev_ticks + tl->initial_timeout;
+	tm_tshard_dist_tl(s, tl, tl->initial_timeout);
+}
+
+
+/** adds a timer to a shard, delta ticks from now
+ * same semantics as timer_add()
+ * returns -1 on error, 0 on success */
+int tm_tshard_add(struct tm_tshard* s, struct timer_ln* tl, ticks_t delta)
+{
+	int ret;
+
+	ret = -1;
+	lock_get(&s->lock);
+	if (unlikely(tl->flags & F_TIMER_ACTIVE)) {
+		LM_DBG("called on an active timer %p (%p, %p), flags %x\n",
+				tl, tl->next, tl->prev, tl->flags);
+		goto end;
+	}
+	if (unlikely((tl->next!=0) || (tl->prev!=0))) {
+		LM_CRIT("called with linked timer: %p (%p, %p)\n",
+				tl, tl->next, tl->prev);
+		goto end;
+	}
+	tl->initial_timeout = delta;
+	tl->flags |= F_TIMER_ACTIVE;
+	_tm_tshard_add(s, tl);
+	ret = 0;
+end:
+	lock_release(&s->lock);
+	return ret;
+}
+
+
+/** deletes a timer from a shard, waiting for its handler if running
+ * same semantics as timer_del()
+ * returns <0 on error (-1 if the timer is not active or already deleted and
+ * -2 if the delete is attempted from the timer handler) and 0 on success */
+int tm_tshard_del(struct tm_tshard* s, struct timer_ln* tl)
+{
+	int ret;
+
+again:
+	if (!(tl->flags & F_TIMER_ACTIVE))
+		return -1;
+	lock_get(&s->lock);
+	if (s->running == tl) {
+		lock_release(&s->lock);
+		if (in_tshard == s) {
+			LM_CRIT("timer handle %p tried to delete itself\n", tl);
+			return -2;
+		}
+		sched_yield(); /* wait for it to complete */
+		goto again;
+	}
+	if ((tl->next!=0) && (tl->prev!=0)) {
+		_timer_rm_list(tl);
+		tl->next = tl->prev = 0;
+		ret = 0;
+	} else {
+		ret = -1;
+	}
+	lock_release(&s->lock);
+	return ret;
+}
+
+
+/** same as timer_allow_del(), for handlers that can run both from the
+ * core timer and from a shard */
+void tm_tshard_allow_del(void)
+{
+	if (in_tshard) {
+		in_tshard->running = 0;
+	} else {
+		timer_allow_del();
+	}
+}
+
+
+/* must be called with the shard lock held, it releases it while running
+ * the handlers */
+static void tm_tshard_list_expire(struct tm_tshard* s, ticks_t t,
+		struct timer_head* h)
+{
+	struct timer_ln* tl;
+	ticks_t ret;
+
+	while (h->next != (struct timer_ln*)h) {
+		tl = h->next;
+		_timer_rm_list(tl);
+		tl->next = tl->prev = 0;
+		s->running = tl;
+		lock_release(&s->lock); /* acts also as write barrier */
+		ret = tl->f(t, tl, tl->data);
+		cfg_reset_all();
+		lock_get(&s->lock);
+		if (ret != 0) {
+			/* not one-shot, re-add it */
+			if (ret != (ticks_t)-1)
+				tl->initial_timeout = ret;
+			_tm_tshard_add(s, tl);
+		}
+		s->running = 0;
+	}
+}
+
+
+static void tm_tshard_timer(unsigned int uticks, void* param)
+{
+	struct tm_tshard* s;
+	ticks_t now;
+	struct timer_head* h;
+
+	s = in_tshard;
+	now = get_ticks_raw();
+	/* the reply retransmissions of this tick go out with sendmmsg() */
+	udp_send_batch_start();
+	lock_get(&s->lock);
+	while ((s_ticks_t)(now - s->prev_ticks) > 0) {
+		s->prev_ticks++;
+		if (unlikely((s->prev_ticks & H0_MASK) == 0)) {
+			if (unlikely((s->prev_ticks & H1_H0_MASK) == 0))
+				tm_tshard_redist(s, s->prev_ticks,
+						&s->lst.h2[s->prev_ticks >> (H0_BITS+H1_BITS)]);
+			tm_tshard_redist(s, s->prev_ticks,
+					&s->lst.h1[(s->prev_ticks & H1_H0_MASK) >> H0_BITS]);
+		}
+		h = &s->lst.h0[s->prev_ticks & H0_MASK];
+		if (h->next != (struct timer_ln*)h) {
+			clist_append_sublist(&s->lst.expired, h->next, h->prev,
+					next, prev);
+			_timer_init_list(h);
+		}
+		/* the handlers run with the shard time set to the tick they
+		 * expired on, so re-added timers are relative to it */
+		tm_tshard_list_expire(s, s->prev_ticks, &s->lst.expired);
+	}
+	lock_release(&s->lock);
+	udp_send_batch_end();
+}
+
+
+/** forks the shard timer processes, called from child_init(PROC_MAIN)
+ * returns 0 on success, -1 on error */
+int tm_tshards_fork(void)
+{
+	int i;
+	int pid;
+
+	for (i=0; i<tm_timer_procs; i++) {
+		/* set before fork, the child inherits it */
+		in_tshard = &tm_tshards[i];
+		pid = fork_sync_utimer(PROC_TIMER, "TM Retr Timer", 1 /*socks flag*/,
+				tm_tshard_timer, 0, 1000000U / TIMER_TICKS_HZ);
+		in_tshard = 0;
+		if (pid < 0) {
+			LM_ERR("failed to start timer shard %d process\n", i);
+			return -1;
+		}
+	}
+	return 0;
+}
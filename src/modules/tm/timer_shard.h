@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \file
+ * \brief TM :: retransmission timer shards
+ *
+ * When the timer_procs parameter is set, the retransmission and final
+ * response timers of the transactions are not added to the core timer,
+ * but to one of timer_procs timer wheels (shards) kept in shared memory.
+ * The shard is selected by the transaction hash index and each shard has
+ * its own lock and is run by its own timer process, so the retransmissions
+ * are handled by several processes in parallel instead of by the single
+ * core timer process.
+ *
+ * The add/del semantics are the same as for the core timer_add()/
+ * timer_del() (a delete waits for a running handler to finish).
+ * \ingroup tm
+ */
+
+#ifndef _TM_TIMER_SHARD_H
+#define _TM_TIMER_SHARD_H
+
+#include "../../core/timer.h"
+#include "../../core/timer_funcs.h"
+#include "../../core/locking.h"
+
+struct tm_tshard {
+	gen_lock_t lock;
+	struct timer_ln* volatile running; /* handler running now */
+	ticks_t prev_ticks; /* last tick the shard ran for */
+	struct timer_lists lst;
+};
+
+extern int tm_timer_procs;
+extern struct tm_tshard* tm_tshards;
+
+/** shard of a transaction hash index */
+#define tm_tshard_get(hash_index) \
+	(&tm_tshards[(hash_index) % (unsigned int)tm_timer_procs])
+
+int tm_tshards_init(void);
+void tm_tshards_destroy(void);
+int tm_tshards_fork(void);
+
+int tm_tshard_add(struct tm_tshard* s, struct timer_ln* tl, ticks_t delta);
+int tm_tshard_del(struct tm_tshard* s, struct timer_ln* tl);
+void tm_tshard_allow_del(void);
+
+#endif /* _TM_TIMER_SHARD_H */
@@ -65,6 +65,7 @@
 #include "../../core/cfg/cfg.h"
 #include "../../core/globals.h"
 #include "../../core/timer_ticks.h"
+#include "../../core/timer_proc.h"
 #include "../../core/mod_fix.h"
 #include "../../core/kemi.h"
 
@@ -231,6 +232,9 @@ int tm_failure_exec_mode = 0;
 
 int tm_dns_reuse_rcv_socket = 0;
 
+/* extra bytes allocated with each transaction for its arena */
+int tm_arena_size = 0;
+
 static rpc_export_t tm_rpc[];
 
 str tm_event_callback = STR_NULL;
@@ -470,6 +474,9 @@ static param_export_t params[]={
 	{"remap_503_500",       PARAM_INT, &tm_remap_503_500                     },
 	{"failure_exec_mode",   PARAM_INT, &tm_failure_exec_mode                 },
 	{"dns_reuse_rcv_socket",PARAM_INT, &tm_dns_reuse_rcv_socket              },
+	{"arena_size",          PARAM_INT, &tm_arena_size                        },
+	{"hash_size",           PARAM_INT, &tm_hash_size                         },
+	{"timer_procs",         PARAM_INT, &tm_timer_procs                       },
 #ifdef CANCEL_REASON_SUPPORT
 	{"local_cancel_reason", PARAM_INT, &default_tm_cfg.local_cancel_reason   },
 	{"e2e_cancel_reason",   PARAM_INT, &default_tm_cfg.e2e_cancel_reason     },
@@ -710,6 +717,8 @@ static int script_init( struct sip_msg *foo, unsigned int flags, void *bar)
 
 static int mod_init(void)
 {
+	int i;
+
 	DBG( "TM - (sizeof cell=%ld, sip_msg=%ld) initializing...\n",
 			(long)sizeof(struct cell), (long)sizeof(struct sip_msg));
 
@@ -721,6 +730,29 @@ static int mod_init(void)
 		return -1;
 	}
 
+	if (tm_arena_size < 0) {
+		LM_WARN("invalid arena_size %d, arena disabled\n", tm_arena_size);
+		tm_arena_size = 0;
+	}
+	tm_arena_size = ROUND_POINTER(tm_arena_size);
+
+	/* the hash table size must be a power of 2, not bigger than the range
+	 * of the hash function */
+	if (tm_hash_size < 16) {
+		LM_WARN("hash_size %d too small, using 16\n", tm_hash_size);
+		tm_hash_size = 16;
+	} else if (tm_hash_size > TABLE_ENTRIES) {
+		LM_WARN("hash_size %d too big, using %d\n", tm_hash_size,
+				TABLE_ENTRIES);
+		tm_hash_size = TABLE_ENTRIES;
+	}
+	for (i = 16; i < tm_hash_size; i <<= 1);
+	if (i != tm_hash_size) {
+		LM_WARN("hash_size %d is not a power of 2, using %d\n",
+				tm_hash_size, i);
+		tm_hash_size = i;
+	}
+
 	if (init_callid() < 0) {
 		LM_CRIT("Error while initializing Call-ID generator\n");
 		return -1;
@@ -732,6 +764,14 @@ static int mod_init(void)
 		return -1;
 	}
 
+	if (tm_timer_procs > 0) {
+		if (tm_tshards_init() < 0) {
+			LM_ERR("initializing the timer shards failed\n");
+			return -1;
+		}
+		register_sync_timers(tm_timer_procs);
+	}
+
 	/* init static hidden values */
 	init_t();
 
@@ -848,6 +888,10 @@ static int child_init(int rank)
 		LM_ERR("Error while initializing Call-ID generator\n");
 		return -2;
 	}
+	if (rank == PROC_MAIN && tm_timer_procs > 0) {
+		if (tm_tshards_fork() < 0)
+			return -1;
+	}
 	return 0;
 }
 
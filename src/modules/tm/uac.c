@@ -78,7 +78,7 @@ int uac_init(void)
 	str src[3];
 	struct socket_info *si;
 
-	if (KAM_RAND_MAX < TABLE_ENTRIES) {
+	if (KAM_RAND_MAX < tm_hash_size) {
 		LM_WARN("uac does not spread across the whole hash table\n");
 	}
 	/* on tcp/tls bind_address is 0 so try to get the first address we listen
@@ -148,7 +148,7 @@ static inline unsigned int dlg2hash( dlg_t* dlg )
 	unsigned int hashid;
 
 	cseq_nr.s=int2str(dlg->loc_seq.value, &cseq_nr.len);
-	hashid=hash(dlg->id.call_id, cseq_nr);
+	hashid=tm_hash(dlg->id.call_id, cseq_nr);
 	LM_DBG("hashid %d\n", hashid);
 	return hashid;
 }
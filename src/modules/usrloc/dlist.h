@@ -39,6 +39,7 @@
 typedef struct dlist {
 	str name;            /*!< Name of the domain (null terminated) */
 	udomain_t* d;        /*!< Payload */
+	int snap_loaded;     /*!< Loaded from a snapshot at startup */
 	struct dlist* next;  /*!< Next element in the list */
 } dlist_t;
 
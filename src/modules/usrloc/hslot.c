@@ -27,8 +27,20 @@
 
 
 
+#include <sys/time.h>
+
 #include "hslot.h"
 
+/* upper limits (usec) of the lock wait histogram buckets, the first
+ * bucket counts the locks taken without waiting */
+static long long ul_lwait_limits[UL_LWAIT_BUCKETS-1] = {
+	0, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+char* ul_lwait_names[UL_LWAIT_BUCKETS] = {
+	"none", "10us", "100us", "1ms", "10ms", "100ms", "1s", "inf"
+};
+
 /*!
  * \brief Initialize cache slot structure
  * \param _d domain for the hash slot
@@ -41,6 +53,9 @@ int init_slot(struct udomain* _d, hslot_t* _s, int n)
 	_s->first = 0;
 	_s->last = 0;
 	_s->d = _d;
+	_s->seq = 0;
+	memset(_s->lwait, 0, sizeof(_s->lwait));
+	_s->lwait_us = 0;
 	if(rec_lock_init(&_s->rlock)==NULL) {
 		LM_ERR("failed to initialize the slock (%d)\n", n);
 		return -1;
@@ -71,6 +86,46 @@ void deinit_slot(hslot_t* _s)
 }
 
 
+/*!
+ * \brief Lock the slot
+ *
+ * The wait time is measured only if the lock is already taken by another
+ * process and is added to the slot histogram (with the lock held).
+ * \param _s hash slot
+ */
+void slot_lock(hslot_t* _s)
+{
+	struct timeval t0, t1;
+	long long us;
+	int b;
+
+	if (rec_lock_tryget(&_s->rlock)==0) {
+		if (_s->rlock.rec_lock_level==0)
+			_s->lwait[0]++;
+		return;
+	}
+	gettimeofday(&t0, 0);
+	rec_lock_get(&_s->rlock);
+	gettimeofday(&t1, 0);
+	us = (long long)(t1.tv_sec - t0.tv_sec) * 1000000
+			+ (t1.tv_usec - t0.tv_usec);
+	if (us < 0) us = 0; /* time changed */
+	for (b=1; b<UL_LWAIT_BUCKETS-1 && us>=ul_lwait_limits[b]; b++);
+	_s->lwait[b]++;
+	_s->lwait_us += us;
+}
+
+
+/*!
+ * \brief Unlock the slot
+ * \param _s hash slot
+ */
+void slot_unlock(hslot_t* _s)
+{
+	rec_lock_release(&_s->rlock);
+}
+
+
 /*!
  * \brief Add an element to an slot's linked list
  * \param _s hash slot
@@ -78,6 +133,7 @@ void deinit_slot(hslot_t* _s)
  */
 void slot_add(hslot_t* _s, struct urecord* _r)
 {
+	slot_write_begin(_s);
 	if (_s->n == 0) {
 		_s->first = _s->last = _r;
 	} else {
@@ -87,6 +143,7 @@ void slot_add(hslot_t* _s, struct urecord* _r)
 	}
 	_s->n++;
 	_r->slot = _s;
+	slot_write_end(_s);
 }
 
 
@@ -97,6 +154,7 @@ void slot_add(hslot_t* _s, struct urecord* _r)
  */
 void slot_rem(hslot_t* _s, struct urecord* _r)
 {
+	slot_write_begin(_s);
 	if (_r->prev) {
 		_r->prev->next = _r->next;
 	} else {
@@ -112,4 +170,5 @@ void slot_rem(hslot_t* _s, struct urecord* _r)
 	_r->prev = _r->next = 0;
 	_r->slot = 0;
 	_s->n--;
+	slot_write_end(_s);
 }
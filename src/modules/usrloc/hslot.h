@@ -37,6 +37,9 @@
 struct udomain;
 struct urecord;
 
+/*! \brief Number of buckets of the slot lock wait time histogram:
+ * not waited, < 10us, < 100us, < 1ms, < 10ms, < 100ms, < 1s, >= 1s */
+#define UL_LWAIT_BUCKETS 8
 
 typedef struct hslot {
 	int n;                  /*!< Number of elements in the collision slot */
@@ -44,8 +47,63 @@ typedef struct hslot {
 	struct urecord* last;   /*!< Last element in the list */
 	struct udomain* d;      /*!< Domain we belong to */
 	rec_lock_t rlock;       /*!< Recursive lock for hash entry */
+	volatile unsigned int seq; /*!< Changes counter, odd while the records
+								 of the slot are changed in memory */
+	unsigned int lwait[UL_LWAIT_BUCKETS]; /*!< Lock wait time histogram */
+	unsigned long long lwait_us; /*!< Total lock wait time (usec) */
 } hslot_t;
 
+/*! \brief Names of the lock wait histogram buckets */
+extern char* ul_lwait_names[UL_LWAIT_BUCKETS];
+
+
+/*! \brief
+ * Start changing the records of the slot (with the slot lock held)
+ *
+ * Only the memory changes are enclosed (not the db operations), so
+ * the lock-free readers wait at most for a few memory updates.
+ */
+static inline void slot_write_begin(hslot_t* _s)
+{
+	if (_s) {
+		_s->seq++;
+		membar_write();
+	}
+}
+
+/*! \brief
+ * Done changing the records of the slot
+ */
+static inline void slot_write_end(hslot_t* _s)
+{
+	if (_s) {
+		membar_write();
+		_s->seq++;
+	}
+}
+
+/*! \brief
+ * Start reading the slot without lock, returns the changes counter
+ * (odd if a change is in progress)
+ */
+static inline unsigned int slot_read_begin(hslot_t* _s)
+{
+	unsigned int seq;
+
+	seq = _s->seq;
+	membar_read();
+	return seq;
+}
+
+/*! \brief
+ * Check if the slot was changed since slot_read_begin()
+ */
+static inline int slot_read_retry(hslot_t* _s, unsigned int _seq)
+{
+	membar_read();
+	return _s->seq != _seq;
+}
+
 /*! \brief
  * Initialize slot structure
  */
@@ -58,6 +116,18 @@ int init_slot(struct udomain* _d, hslot_t* _s, int n);
 void deinit_slot(hslot_t* _s);
 
 
+/*! \brief
+ * Lock the slot, updating the lock wait histogram
+ */
+void slot_lock(hslot_t* _s);
+
+
+/*! \brief
+ * Unlock the slot
+ */
+void slot_unlock(hslot_t* _s);
+
+
 /*! \brief
  * Add an element to slot linked list
  */
@@ -34,6 +34,8 @@
 #include "../../core/socket_info.h"
 #include "../../core/dprint.h"
 #include "../../lib/srdb1/db.h"
+#include "../../core/mem/epoch.h"
+#include "ul_dbq.h"
 #include "usrloc_mod.h"
 #include "ul_callback.h"
 #include "usrloc.h"
@@ -51,6 +53,18 @@ void ul_set_xavp_contact_clone(int v)
 }
 
 #ifdef WITH_XAVP
+/*!
+ * \brief xavp_destroy_list() for epoch_retire()
+ * \param _x freed xavp list
+ */
+static void ul_free_xavp(void* _x)
+{
+	sr_xavp_t *xavp;
+
+	xavp = (sr_xavp_t*)_x;
+	xavp_destroy_list(&xavp);
+}
+
 /*!
  * \brief Store xavp list per contact
  * \param _c contact structure
@@ -64,8 +78,12 @@ void ucontact_xavp_store(ucontact_t *_c)
 		return;
 	if(ul_xavp_contact_name.s==NULL)
 		return;
-	/* remove old list if it is set -- update case */
-	if (_c->xavp) xavp_destroy_list(&_c->xavp);
+	/* remove old list if it is set -- update case (lookups might still
+	 * read it without lock) */
+	if (_c->xavp) {
+		epoch_retire(ul_epoch, _c->xavp, ul_free_xavp);
+		_c->xavp = 0;
+	}
 	xavp = xavp_get(&ul_xavp_contact_name, NULL);
 	if(xavp==NULL)
 		return;
@@ -180,6 +198,16 @@ void free_ucontact(ucontact_t* _c)
 }
 
 
+/*!
+ * \brief free_ucontact() for epoch_retire()
+ * \param _c freed contact
+ */
+void ul_free_ucontact(void* _c)
+{
+	free_ucontact((ucontact_t*)_c);
+}
+
+
 /*!
  * \brief Print contact, for debugging purposes only
  * \param _f output file
@@ -257,8 +285,9 @@ int mem_update_ucontact(ucontact_t* _c, ucontact_info_t* _ci)
 				return -1; \
 			}\
 			memcpy(ptr, (_new)->s, (_new)->len);\
-			if ((_old)->s) shm_free((_old)->s);\
+			old = (_old)->s;\
 			(_old)->s = ptr;\
+			if (old) epoch_retire_shm(ul_epoch, old);\
 		} else {\
 			memcpy((_old)->s, (_new)->s, (_new)->len);\
 		}\
@@ -266,6 +295,7 @@ int mem_update_ucontact(ucontact_t* _c, ucontact_info_t* _ci)
 	} while(0)
 
 	char* ptr;
+	char* old;
 
 	if(_ci->instance.s!=NULL && _ci->instance.len>0)
 	{
@@ -282,17 +312,19 @@ int mem_update_ucontact(ucontact_t* _c, ucontact_info_t* _ci)
 	if (_ci->received.s && _ci->received.len) {
 		update_str( &_c->received, &_ci->received);
 	} else {
-		if (_c->received.s) shm_free(_c->received.s);
+		old = _c->received.s;
 		_c->received.s = 0;
 		_c->received.len = 0;
+		if (old) epoch_retire_shm(ul_epoch, old);
 	}
 	
 	if (_ci->path) {
 		update_str( &_c->path, _ci->path);
 	} else {
-		if (_c->path.s) shm_free(_c->path.s);
+		old = _c->path.s;
 		_c->path.s = 0;
 		_c->path.len = 0;
+		if (old) epoch_retire_shm(ul_epoch, old);
 	}
 
 #ifdef WITH_XAVP
@@ -482,6 +514,8 @@ int db_insert_ucontact(ucontact_t* _c)
 		return -1;
 	}
 
+	if (ul_dbq_active() && ul_dbq_add(UL_DBQ_INSERT, _c)==0)
+		return 0;
 
 	keys[0] = &user_col;
 	vals[0].type = DB1_STR;
@@ -679,7 +713,16 @@ int db_insert_ucontact(ucontact_t* _c)
 		return -1;
 	}
 
-	if (ul_dbf.insert(ul_dbh, keys, vals, nr_cols) < 0) {
+	/* the queued inserts are written with insert-update (if supported),
+	 * so the row of an already written contact is just updated */
+	if (ul_dbq_writer() && DB_CAPABILITY(ul_dbf, DB_CAP_INSERT_UPDATE)) {
+		if (ul_dbf.insert_update(ul_dbh, keys, vals, nr_cols) < 0) {
+			LM_ERR("inserting contact in db failed %.*s (%.*s)\n",
+					_c->aor->len, ZSW(_c->aor->s),
+					_c->ruid.len, ZSW(_c->ruid.s));
+			return -1;
+		}
+	} else if (ul_dbf.insert(ul_dbh, keys, vals, nr_cols) < 0) {
 		LM_ERR("inserting contact in db failed %.*s (%.*s)\n",
 				_c->aor->len, ZSW(_c->aor->s), _c->ruid.len, ZSW(_c->ruid.s));
 		return -1;
@@ -1414,6 +1457,10 @@ int db_update_ucontact_instance(ucontact_t* _c)
  */
 int db_update_ucontact(ucontact_t* _c)
 {
+	if (ul_dbq_active() && !(_c->flags & FL_MEM)
+			&& ul_dbq_add(UL_DBQ_UPDATE, _c)==0)
+		return 0;
+
 	if(ul_db_ops_ruid==0)
 		if (_c->instance.len<=0) {
 			return db_update_ucontact_addr(_c);
@@ -1565,6 +1612,10 @@ int db_delete_ucontact_ruid(ucontact_t* _c)
  */
 int db_delete_ucontact(ucontact_t* _c)
 {
+	if (ul_dbq_active() && !(_c->flags & FL_MEM)
+			&& ul_dbq_add(UL_DBQ_DELETE, _c)==0)
+		return 0;
+
 	if(ul_db_ops_ruid==0)
 		return db_delete_ucontact_addr(_c);
 	else
@@ -1674,10 +1725,13 @@ int update_ucontact(struct urecord* _r, ucontact_t* _c, ucontact_info_t* _ci)
 {
 	/* we have to update memory in any case, but database directly
 	 * only in db_mode 1 */
+	slot_write_begin(_r ? _r->slot : 0);
 	if (mem_update_ucontact( _c, _ci) < 0) {
+		slot_write_end(_r ? _r->slot : 0);
 		LM_ERR("failed to update memory\n");
 		return -1;
 	}
+	slot_write_end(_r ? _r->slot : 0);
 
 	if (db_mode==DB_ONLY) {
 		if (update_contact_db(_c) < 0) return -1;
@@ -1690,8 +1744,11 @@ int update_ucontact(struct urecord* _r, ucontact_t* _c, ucontact_info_t* _ci)
 		run_ul_callbacks( UL_CONTACT_UPDATE, _c);
 	}
 
-	if (_r && db_mode!=DB_ONLY)
+	if (_r && db_mode!=DB_ONLY) {
+		slot_write_begin(_r->slot);
 		update_contact_pos( _r, _c);
+		slot_write_end(_r->slot);
+	}
 
 	st_update_ucontact(_c);
 
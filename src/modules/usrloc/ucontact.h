@@ -57,6 +57,13 @@ ucontact_t* new_ucontact(str* _dom, str* _aor, str* _contact,
 void free_ucontact(ucontact_t* _c);
 
 
+/*!
+ * \brief free_ucontact() for epoch_retire()
+ * \param _c freed contact
+ */
+void ul_free_ucontact(void* _c);
+
+
 /*!
  * \brief Print contact, for debugging purposes only
  * \param _f output file
@@ -36,6 +36,7 @@
 #include "../../core/ut.h"
 #include "../../core/hashes.h"
 #include "../../core/sr_module.h"
+#include "../../core/mem/epoch.h"
 #include "usrloc_mod.h"            /* usrloc module parameters */
 #include "usrloc.h"
 #include "utime.h"
@@ -368,6 +369,67 @@ static inline ucontact_info_t* dbrow2info(db_val_t *vals, str *contact, int rcon
 }
 
 
+/*!
+ * \brief Inserts in memory a contact loaded from the database or from
+ * a snapshot, the contact is marked as already stored in the database
+ * \param _d domain
+ * \param _aor address of record
+ * \param _contact contact address
+ * \param _ci contact information
+ * \return 0 on success, -1 on failure
+ */
+int mem_load_ucontact(udomain_t* _d, str* _aor, str* _contact,
+		ucontact_info_t* _ci)
+{
+	urecord_t* r;
+	ucontact_t* c;
+
+	lock_udomain(_d, _aor);
+	if (get_urecord(_d, _aor, &r) > 0) {
+		if (mem_insert_urecord(_d, _aor, &r) < 0) {
+			LM_ERR("failed to create a record\n");
+			unlock_udomain(_d, _aor);
+			return -1;
+		}
+	}
+
+	if ( (c=mem_insert_ucontact(r, _contact, _ci)) == 0) {
+		LM_ERR("inserting contact failed\n");
+		unlock_udomain(_d, _aor);
+		return -1;
+	}
+
+	/* We have to do this, because insert_ucontact sets state to CS_NEW
+	 * and we have the contact in the database already */
+	c->state = CS_SYNC;
+	unlock_udomain(_d, _aor);
+	return 0;
+}
+
+
+/*!
+ * \brief Inserts in memory a contact stored as a row of values with the
+ * same layout as the location table columns (without the username)
+ * \param _d domain
+ * \param _aor address of record
+ * \param _vals contact, expires, q, callid, ... keepalive values
+ * \return 0 on success, 1 if the row was skipped, -1 on failure
+ */
+int mem_load_ucontact_row(udomain_t* _d, str* _aor, db_val_t* _vals)
+{
+	ucontact_info_t *ci;
+	str contact;
+
+	ci = dbrow2info(_vals, &contact, 0);
+	if (ci==0) {
+		LM_ERR("skipping record for %.*s in table %s\n",
+				_aor->len, _aor->s, _d->name->s);
+		return 1;
+	}
+	return mem_load_ucontact(_d, _aor, &contact, ci);
+}
+
+
 /*!
  * \brief Load all records from a udomain
  *
@@ -392,9 +454,6 @@ int preload_udomain(db1_con_t* _c, udomain_t* _d)
 	int i;
 	int n;
 
-	urecord_t* r;
-	ucontact_t* c;
-
 	columns[0] = &user_col;
 	columns[1] = &contact_col;
 	columns[2] = &expires_col;
@@ -505,26 +564,8 @@ int preload_udomain(db1_con_t* _c, udomain_t* _d)
 				}
 			}
 
-		
-			lock_udomain(_d, &user);
-			if (get_urecord(_d, &user, &r) > 0) {
-				if (mem_insert_urecord(_d, &user, &r) < 0) {
-					LM_ERR("failed to create a record\n");
-					unlock_udomain(_d, &user);
-					goto error;
-				}
-			}
-
-			if ( (c=mem_insert_ucontact(r, &contact, ci)) == 0) {
-				LM_ERR("inserting contact failed\n");
-				unlock_udomain(_d, &user);
-				goto error1;
-			}
-
-			/* We have to do this, because insert_ucontact sets state to CS_NEW
-			 * and we have the contact in the database already */
-			c->state = CS_SYNC;
-			unlock_udomain(_d, &user);
+			if (mem_load_ucontact(_d, &user, &contact, ci) < 0)
+				goto error;
 		}
 
 		if (DB_CAPABILITY(ul_dbf, DB_CAP_FETCH)) {
@@ -545,8 +586,6 @@ int preload_udomain(db1_con_t* _c, udomain_t* _d)
 #endif
 
 	return 0;
-error1:
-	free_ucontact(c);
 error:
 	ul_dbf.free_result(_c, res);
 	return -1;
@@ -991,7 +1030,8 @@ int mem_insert_urecord(udomain_t* _d, str* _aor, struct urecord** _r)
 void mem_delete_urecord(udomain_t* _d, struct urecord* _r)
 {
 	slot_rem(_r->slot, _r);
-	free_urecord(_r);
+	/* lookups might still read it without lock */
+	epoch_retire(ul_epoch, _r, ul_free_urecord);
 	update_stat( _d->users, -1);
 }
 
@@ -1039,7 +1079,7 @@ void lock_udomain(udomain_t* _d, str* _aor)
 	{
 		sl = ul_get_aorhash(_aor) & (_d->size - 1);
 
-		rec_lock_get(&_d->table[sl].rlock);
+		slot_lock(&_d->table[sl]);
 	}
 }
 
@@ -1055,7 +1095,7 @@ void unlock_udomain(udomain_t* _d, str* _aor)
 	if (db_mode!=DB_ONLY)
 	{
 		sl = ul_get_aorhash(_aor) & (_d->size - 1);
-		rec_lock_release(&_d->table[sl].rlock);
+		slot_unlock(&_d->table[sl]);
 	}
 }
 
@@ -1067,7 +1107,7 @@ void unlock_udomain(udomain_t* _d, str* _aor)
 void lock_ulslot(udomain_t* _d, int i)
 {
 	if (db_mode!=DB_ONLY)
-		rec_lock_get(&_d->table[i].rlock);
+		slot_lock(&_d->table[i]);
 }
 
 
@@ -1079,7 +1119,7 @@ void lock_ulslot(udomain_t* _d, int i)
 void unlock_ulslot(udomain_t* _d, int i)
 {
 	if (db_mode!=DB_ONLY)
-		rec_lock_release(&_d->table[i].rlock);
+		slot_unlock(&_d->table[i]);
 }
 
 
@@ -1144,6 +1184,221 @@ int get_urecord(udomain_t* _d, str* _aor, struct urecord** _r)
 	return 1;   /* Nothing found */
 }
 
+
+/*! \brief lock-free snapshot attempts before taking the slot lock */
+#define UL_SNAPSHOT_RETRIES 16
+/*! \brief sanity limits for the values read without lock (a bigger value
+ * can only be read while the record is changed) */
+#define UL_SNAPSHOT_MAX_CONTACTS 4096
+#define UL_SNAPSHOT_MAX_STR 65536
+
+#define ul_snapshot_str_len(_s) \
+	(((_s).s && (_s).len > 0) ? (_s).len : 0)
+
+#define ul_snapshot_str_cpy(_dst, _p) \
+	do { \
+		if ((_dst).s && (_dst).len > 0) { \
+			memcpy((_p), (_dst).s, (_dst).len); \
+			(_dst).s = (_p); \
+			(_p) += (_dst).len; \
+		} else { \
+			(_dst).s = 0; \
+			(_dst).len = 0; \
+		} \
+	} while(0)
+
+/*!
+ * \brief Copy a record and its contacts in one pkg block
+ * \param _r copied record
+ * \param _s slot of the record if it is not locked, 0 if locked
+ * \param _seq slot changes counter when the read started
+ * \param _snap copy
+ * \return 0 on success, -1 on error, -2 if the record was changed while
+ * copying it
+ */
+static int ul_snapshot_copy(urecord_t* _r, hslot_t* _s, unsigned int _seq,
+		urecord_t** _snap)
+{
+	ucontact_t* c;
+	ucontact_t* tmp;
+	ucontact_t* sc;
+	urecord_t* snap;
+	char* p;
+	int n, i, len, slen;
+
+	n = 0;
+	for (c = _r->contacts; c; c = c->next) {
+		if (++n > UL_SNAPSHOT_MAX_CONTACTS && _s)
+			return -2;
+	}
+	tmp = 0;
+	if (n > 0) {
+		tmp = (ucontact_t*)pkg_malloc(n * sizeof(ucontact_t));
+		if (tmp == 0) {
+			LM_ERR("no more pkg memory\n");
+			return -1;
+		}
+	}
+	/* copy the contact structures first, the strings are sized from
+	 * the copy */
+	for (c = _r->contacts, i = 0; c && i < n; c = c->next, i++)
+		memcpy(&tmp[i], c, sizeof(ucontact_t));
+	if ((_s && slot_read_retry(_s, _seq)) || i != n)
+		goto retry;
+
+	len = sizeof(urecord_t) + n * sizeof(ucontact_t) + _r->aor.len;
+	for (i = 0; i < n; i++) {
+		slen = ul_snapshot_str_len(tmp[i].c)
+			+ ul_snapshot_str_len(tmp[i].received)
+			+ ul_snapshot_str_len(tmp[i].path)
+			+ ul_snapshot_str_len(tmp[i].user_agent)
+			+ ul_snapshot_str_len(tmp[i].callid)
+			+ ul_snapshot_str_len(tmp[i].ruid)
+			+ ul_snapshot_str_len(tmp[i].instance);
+		if (slen > UL_SNAPSHOT_MAX_STR)
+			goto retry;
+		len += slen;
+	}
+	snap = (urecord_t*)pkg_malloc(len);
+	if (snap == 0) {
+		LM_ERR("no more pkg memory\n");
+		if (tmp) pkg_free(tmp);
+		return -1;
+	}
+	memcpy(snap, _r, sizeof(urecord_t));
+	snap->slot = 0;
+	snap->prev = snap->next = 0;
+	snap->contacts = 0;
+	sc = (ucontact_t*)(snap + 1);
+	p = (char*)(sc + n);
+	memcpy(p, _r->aor.s, _r->aor.len);
+	snap->aor.s = p;
+	p += _r->aor.len;
+	for (i = 0; i < n; i++) {
+		memcpy(&sc[i], &tmp[i], sizeof(ucontact_t));
+		sc[i].aor = &snap->aor;
+		sc[i].prev = (i > 0) ? &sc[i-1] : 0;
+		sc[i].next = (i < n - 1) ? &sc[i+1] : 0;
+		ul_snapshot_str_cpy(sc[i].c, p);
+		ul_snapshot_str_cpy(sc[i].received, p);
+		ul_snapshot_str_cpy(sc[i].path, p);
+		ul_snapshot_str_cpy(sc[i].user_agent, p);
+		ul_snapshot_str_cpy(sc[i].callid, p);
+		ul_snapshot_str_cpy(sc[i].ruid, p);
+		ul_snapshot_str_cpy(sc[i].instance, p);
+#ifdef WITH_XAVP
+		/* the xavps are not copied, they stay readable until the
+		 * snapshot is released (freed only after the current readers) */
+		if (db_mode == DB_ONLY)
+			sc[i].xavp = 0;
+#endif
+	}
+	if (n > 0)
+		snap->contacts = sc;
+	if (tmp) pkg_free(tmp);
+	if (_s && slot_read_retry(_s, _seq)) {
+		pkg_free(snap);
+		return -2;
+	}
+	*_snap = snap;
+	return 0;
+
+retry:
+	if (tmp) pkg_free(tmp);
+	return -2;
+}
+
+
+/*!
+ * \brief Get a private copy of a record, without locking the slot
+ *
+ * The record is searched and copied without the slot lock, the copy is
+ * validated against the slot changes counter and redone if the slot was
+ * changed meanwhile. Only if the slot keeps changing, the copy is done
+ * with the slot locked. So a lookup does not wait for the slot lock held
+ * by a save while it writes to the database. A process that cannot enter
+ * the usrloc epoch always copies with the slot locked and without the
+ * contacts xavps (they are not protected from being freed).
+ * \param _d domain to search the record
+ * \param _aor address of record
+ * \param _r copy of the record, must be released with
+ * release_urecord_snapshot()
+ * \return 0 if a record was found, 1 if nothing could be found, -1 on error
+ */
+int get_urecord_snapshot(udomain_t* _d, str* _aor, urecord_t** _r)
+{
+	unsigned int sl, i, n, aorhash, seq;
+	int retry, ret, epoch;
+	hslot_t* s;
+	urecord_t* r;
+#ifdef WITH_XAVP
+	ucontact_t* c;
+#endif
+
+	epoch = (epoch_enter(ul_epoch)==0);
+	if (epoch && db_mode!=DB_ONLY) {
+		aorhash = ul_get_aorhash(_aor);
+		sl = aorhash&(_d->size-1);
+		s = &_d->table[sl];
+		for (retry = 0; retry < UL_SNAPSHOT_RETRIES; retry++) {
+			seq = slot_read_begin(s);
+			if (seq & 1)
+				continue; /* a change is in progress */
+			n = s->n;
+			r = s->first;
+			for(i = 0; r!=NULL && i < n; i++) {
+				if((r->aorhash==aorhash) && (r->aor.len==_aor->len)
+							&& !memcmp(r->aor.s,_aor->s,_aor->len))
+					break;
+				r = r->next;
+			}
+			if (r==NULL || i==n) {
+				if (slot_read_retry(s, seq))
+					continue;
+				ret = 1;
+				goto done;
+			}
+			ret = ul_snapshot_copy(r, s, seq, _r);
+			if (ret != -2)
+				goto done;
+		}
+	}
+	/* too many changes (or db only mode or no epoch), copy it with the
+	 * slot locked */
+	lock_udomain(_d, _aor);
+	ret = get_urecord(_d, _aor, &r);
+	if (ret == 0) {
+		ret = ul_snapshot_copy(r, 0, 0, _r);
+#ifdef WITH_XAVP
+		if (ret == 0 && !epoch) {
+			for (c = (*_r)->contacts; c; c = c->next)
+				c->xavp = 0;
+		}
+#endif
+		release_urecord(r);
+	}
+	unlock_udomain(_d, _aor);
+done:
+	/* on success the epoch is left by release_urecord_snapshot() */
+	if (ret != 0 && epoch)
+		epoch_exit(ul_epoch);
+	return ret;
+}
+
+
+/*!
+ * \brief Release a record copy returned by get_urecord_snapshot()
+ * \param _r copy of the record
+ */
+void release_urecord_snapshot(urecord_t* _r)
+{
+	if (_r == 0)
+		return;
+	pkg_free(_r);
+	/* a no-op in the processes that could not enter the epoch */
+	epoch_exit(ul_epoch);
+}
+
 /*!
  * \brief Obtain a urecord pointer if the urecord exists in domain (lock slot)
  * \param _d domain to search the record
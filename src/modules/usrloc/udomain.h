@@ -79,6 +79,30 @@ void free_udomain(udomain_t* _d);
 void print_udomain(FILE* _f, udomain_t* _d);
 
 
+/*!
+ * \brief Inserts in memory a contact loaded from the database or from
+ * a snapshot, the contact is marked as already stored in the database
+ * \param _d domain
+ * \param _aor address of record
+ * \param _contact contact address
+ * \param _ci contact information
+ * \return 0 on success, -1 on failure
+ */
+int mem_load_ucontact(udomain_t* _d, str* _aor, str* _contact,
+		ucontact_info_t* _ci);
+
+
+/*!
+ * \brief Inserts in memory a contact stored as a row of values with the
+ * same layout as the location table columns (without the username)
+ * \param _d domain
+ * \param _aor address of record
+ * \param _vals contact, expires, q, callid, ... keepalive values
+ * \return 0 on success, 1 if the row was skipped, -1 on failure
+ */
+int mem_load_ucontact_row(udomain_t* _d, str* _aor, db_val_t* _vals);
+
+
 /*!
  * \brief Load all records from a udomain
  *
@@ -184,6 +208,22 @@ int insert_urecord(udomain_t* _d, str* _aor, struct urecord** _r);
  */
 int get_urecord(udomain_t* _d, str* _aor, struct urecord** _r);
 
+/*!
+ * \brief Get a private copy of a record, without locking the slot
+ * \param _d domain to search the record
+ * \param _aor address of record
+ * \param _r copy of the record, must be released with
+ * release_urecord_snapshot()
+ * \return 0 if a record was found, 1 if nothing could be found, -1 on error
+ */
+int get_urecord_snapshot(udomain_t* _d, str* _aor, struct urecord** _r);
+
+/*!
+ * \brief Release a record copy returned by get_urecord_snapshot()
+ * \param _r copy of the record
+ */
+void release_urecord_snapshot(struct urecord* _r);
+
 /*!
  * \brief Obtain a urecord pointer if the urecord exists in domain (lock slot)
  * \param _d domain to search the record
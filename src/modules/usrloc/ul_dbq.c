@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - Asynchronous database writer
+ *  \ingroup usrloc
+ */
+
+#include <string.h>
+
+#include "../../core/mem/shm_mem.h"
+#include "../../core/dprint.h"
+#include "../../core/locking.h"
+#include "../../core/hashes.h"
+#include "../../core/sr_module.h"
+#include "../../core/timer_proc.h"
+#include "../../lib/srdb1/db.h"
+#include "usrloc_mod.h"
+#include "ucontact.h"
+#include "ul_dbq.h"
+
+#define UL_DBQ_HASH_SIZE 1024
+/* times a failed operation is queued again before being dropped (the db
+ * api does not tell a transient error from a bad row) */
+#define UL_DBQ_MAX_RETRIES 5
+
+/*! \brief contact copy of a queued operation */
+typedef struct ul_dbq_data {
+	ucontact_t c;
+	str aor;
+} ul_dbq_data_t;
+
+/*! \brief queued operation */
+typedef struct ul_dbq_item {
+	int op;                     /*!< UL_DBQ_* */
+	int failed;                 /*!< the db write failed, queue again */
+	int retries;                /*!< times it was queued again */
+	unsigned int hid;           /*!< hash of the ruid */
+	ul_dbq_data_t* d;           /*!< last state of the contact */
+	struct ul_dbq_item* next;   /*!< next in the queue */
+	struct ul_dbq_item* hnext;  /*!< next in the ruid hash slot */
+} ul_dbq_item_t;
+
+typedef struct ul_dbq {
+	gen_lock_t lock;
+	ul_dbq_item_t* first;
+	ul_dbq_item_t* last;
+	ul_dbq_item_t* htable[UL_DBQ_HASH_SIZE];
+} ul_dbq_t;
+
+int ul_db_writer = 0;            /*!< use the writer process */
+int ul_db_writer_interval = 100; /*!< queue flush interval (ms) */
+int ul_db_writer_batch = 100;    /*!< operations per transaction */
+
+static ul_dbq_t* _ul_dbq = 0;
+/* set in the writer process (before fork, inherited by it) */
+static int _ul_dbq_writer = 0;
+
+
+int ul_dbq_init(void)
+{
+	if (ul_db_writer==0)
+		return 0;
+	if (db_mode!=WRITE_THROUGH && db_mode!=WRITE_BACK) {
+		LM_INFO("db writer is used only in db_mode 1 and 2 - disabled\n");
+		ul_db_writer = 0;
+		return 0;
+	}
+	if (ul_xavp_contact_name.s) {
+		/* the contact xavps are not copied in the queue */
+		LM_WARN("db writer cannot be used with xavp_contact - disabled\n");
+		ul_db_writer = 0;
+		return 0;
+	}
+	if (ul_db_writer_interval<=0)
+		ul_db_writer_interval = 100;
+	_ul_dbq = (ul_dbq_t*)shm_malloc(sizeof(ul_dbq_t));
+	if (_ul_dbq==0) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_ul_dbq, 0, sizeof(ul_dbq_t));
+	if (lock_init(&_ul_dbq->lock)==0) {
+		LM_ERR("failed to init the db queue lock\n");
+		shm_free(_ul_dbq);
+		_ul_dbq = 0;
+		return -1;
+	}
+	/* the writer process is forked from child_init(PROC_MAIN) */
+	register_sync_timers(1);
+	return 0;
+}
+
+
+void ul_dbq_destroy(void)
+{
+	db1_con_t* dbh;
+	ul_dbq_item_t* it;
+	int n;
+
+	if (_ul_dbq==0)
+		return;
+	/* write what is left directly from this process, connecting to db
+	 * only for it if this process has no connection */
+	_ul_dbq_writer = 1;
+	dbh = 0;
+	if (ul_dbh==0 && _ul_dbq->first) {
+		dbh = ul_dbf.init(&db_url);
+		if (dbh==0)
+			LM_ERR("failed to connect to database for the final flush\n");
+		ul_dbh = dbh;
+	}
+	ul_dbq_flush();
+	if (dbh) {
+		ul_dbf.close(dbh);
+		ul_dbh = 0;
+	}
+	/* still queued if there was no db connection or the write failed */
+	n = 0;
+	while (_ul_dbq->first) {
+		it = _ul_dbq->first;
+		_ul_dbq->first = it->next;
+		shm_free(it->d);
+		shm_free(it);
+		n++;
+	}
+	if (n>0)
+		LM_ERR("%d queued db operations lost (not written to db)\n", n);
+	lock_destroy(&_ul_dbq->lock);
+	shm_free(_ul_dbq);
+	_ul_dbq = 0;
+}
+
+
+int ul_dbq_active(void)
+{
+	return _ul_dbq!=0 && _ul_dbq_writer==0;
+}
+
+
+int ul_dbq_writer(void)
+{
+	return _ul_dbq_writer;
+}
+
+
+#define ul_dbq_str_len(_s) (((_s).s) ? (_s).len : 0)
+
+#define ul_dbq_str_cpy(_dst, _src, _p) \
+	do { \
+		if ((_src).s) { \
+			memcpy((_p), (_src).s, (_src).len); \
+			(_dst).s = (_p); \
+			(_dst).len = (_src).len; \
+			(_p) += (_src).len; \
+		} else { \
+			(_dst).s = 0; \
+			(_dst).len = 0; \
+		} \
+	} while(0)
+
+/*! \brief copy of the contact fields written in db, in one shm block */
+static ul_dbq_data_t* ul_dbq_data_new(ucontact_t* _c)
+{
+	ul_dbq_data_t* d;
+	char* p;
+	int len;
+
+	len = sizeof(ul_dbq_data_t) + _c->aor->len
+		+ ul_dbq_str_len(_c->c) + ul_dbq_str_len(_c->received)
+		+ ul_dbq_str_len(_c->path) + ul_dbq_str_len(_c->callid)
+		+ ul_dbq_str_len(_c->user_agent) + ul_dbq_str_len(_c->ruid)
+		+ ul_dbq_str_len(_c->instance);
+	d = (ul_dbq_data_t*)shm_malloc(len);
+	if (d==0) {
+		SHM_MEM_ERROR;
+		return 0;
+	}
+	memcpy(&d->c, _c, sizeof(ucontact_t));
+	d->c.next = d->c.prev = 0;
+#ifdef WITH_XAVP
+	d->c.xavp = 0;
+#endif
+	p = (char*)(d + 1);
+	memcpy(p, _c->aor->s, _c->aor->len);
+	d->aor.s = p;
+	d->aor.len = _c->aor->len;
+	p += _c->aor->len;
+	d->c.aor = &d->aor;
+	ul_dbq_str_cpy(d->c.c, _c->c, p);
+	ul_dbq_str_cpy(d->c.received, _c->received, p);
+	ul_dbq_str_cpy(d->c.path, _c->path, p);
+	ul_dbq_str_cpy(d->c.callid, _c->callid, p);
+	ul_dbq_str_cpy(d->c.user_agent, _c->user_agent, p);
+	ul_dbq_str_cpy(d->c.ruid, _c->ruid, p);
+	ul_dbq_str_cpy(d->c.instance, _c->instance, p);
+	return d;
+}
+
+
+int ul_dbq_add(int _op, ucontact_t* _c)
+{
+	ul_dbq_item_t* it;
+	ul_dbq_data_t* d;
+	ul_dbq_data_t* old;
+	unsigned int hid;
+
+	if (_c->flags & FL_MEM)
+		return 0;
+	d = ul_dbq_data_new(_c);
+	if (d==0)
+		return -1;
+	hid = (_c->ruid.len>0) ? core_hash(&_c->ruid, 0, UL_DBQ_HASH_SIZE) : 0;
+
+	lock_get(&_ul_dbq->lock);
+	if (_c->ruid.len>0) {
+		for (it=_ul_dbq->htable[hid]; it; it=it->hnext) {
+			if (it->d->c.domain==_c->domain
+					&& it->d->c.ruid.len==_c->ruid.len
+					&& memcmp(it->d->c.ruid.s, _c->ruid.s, _c->ruid.len)==0)
+				break;
+		}
+		if (it) {
+			/* coalesce - an insert followed by updates stays an insert,
+			 * otherwise the last operation wins */
+			if (!(it->op==UL_DBQ_INSERT && _op==UL_DBQ_UPDATE))
+				it->op = _op;
+			old = it->d;
+			it->d = d;
+			lock_release(&_ul_dbq->lock);
+			shm_free(old);
+			return 0;
+		}
+	}
+	lock_release(&_ul_dbq->lock);
+
+	it = (ul_dbq_item_t*)shm_malloc(sizeof(ul_dbq_item_t));
+	if (it==0) {
+		SHM_MEM_ERROR;
+		shm_free(d);
+		return -1;
+	}
+	memset(it, 0, sizeof(ul_dbq_item_t));
+	it->op = _op;
+	it->hid = hid;
+	it->d = d;
+
+	lock_get(&_ul_dbq->lock);
+	/* not searched again for the ruid - the record is locked by the
+	 * caller, so the same contact is not queued in parallel */
+	if (_c->ruid.len>0) {
+		it->hnext = _ul_dbq->htable[hid];
+		_ul_dbq->htable[hid] = it;
+	}
+	if (_ul_dbq->last)
+		_ul_dbq->last->next = it;
+	else
+		_ul_dbq->first = it;
+	_ul_dbq->last = it;
+	lock_release(&_ul_dbq->lock);
+	return 0;
+}
+
+
+static int ul_dbq_exec(ul_dbq_item_t* _it)
+{
+	switch (_it->op) {
+		case UL_DBQ_INSERT:
+			return db_insert_ucontact(&_it->d->c);
+		case UL_DBQ_UPDATE:
+			return db_update_ucontact(&_it->d->c);
+		case UL_DBQ_DELETE:
+			return db_delete_ucontact(&_it->d->c);
+	}
+	return -1;
+}
+
+
+static void ul_dbq_exec_list(ul_dbq_item_t* _first, ul_dbq_item_t* _end)
+{
+	ul_dbq_item_t* it;
+
+	for (it=_first; it!=_end; it=it->next) {
+		if (ul_dbq_exec(it)<0) {
+			LM_ERR("failed to write contact to db (aor: %.*s)\n",
+					it->d->aor.len, ZSW(it->d->aor.s));
+			it->failed = 1;
+		}
+	}
+}
+
+
+/*! \brief write a list of operations, in transactions of up to
+ * db_writer_batch operations if the db module supports them */
+static void ul_dbq_write(ul_dbq_item_t* _list)
+{
+	ul_dbq_item_t* first;
+	ul_dbq_item_t* it;
+	int i, err;
+
+	if (ul_db_writer_batch<=1 || ul_dbf.start_transaction==0
+			|| ul_dbf.end_transaction==0 || ul_dbf.abort_transaction==0) {
+		ul_dbq_exec_list(_list, 0);
+		return;
+	}
+	while (_list) {
+		first = _list;
+		for (i=0; _list && i<ul_db_writer_batch; i++)
+			_list = _list->next;
+		if (ul_dbf.start_transaction(ul_dbh, DB_LOCKING_NONE)<0) {
+			ul_dbq_exec_list(first, _list);
+			continue;
+		}
+		err = 0;
+		for (it=first; it!=_list; it=it->next) {
+			if (ul_dbq_exec(it)<0) {
+				err = 1;
+				break;
+			}
+		}
+		if (err==0 && ul_dbf.end_transaction(ul_dbh)==0)
+			continue;
+		/* redo the operations one by one, so only the failed ones
+		 * are queued again */
+		LM_DBG("db transaction failed - writing the operations one by one\n");
+		ul_dbf.abort_transaction(ul_dbh);
+		ul_dbq_exec_list(first, _list);
+	}
+}
+
+
+/*! \brief put back in the queue the operations that failed to be written
+ * (_first.._last, in order).
+ * The contacts are not dirty anymore once queued, so the operations must
+ * be retried by the next flush, before the ones queued meanwhile, unless
+ * a newer one was queued meanwhile for the same contact */
+static void ul_dbq_requeue(ul_dbq_item_t* _first)
+{
+	ul_dbq_item_t* it;
+	ul_dbq_item_t* f;
+	ul_dbq_item_t* first;
+	ul_dbq_item_t* last;
+	ucontact_t* c;
+
+	first = last = 0;
+	lock_get(&_ul_dbq->lock);
+	while (_first) {
+		f = _first;
+		_first = _first->next;
+		f->failed = 0;
+		f->next = f->hnext = 0;
+		c = &f->d->c;
+		if (c->ruid.len>0) {
+			for (it=_ul_dbq->htable[f->hid]; it; it=it->hnext) {
+				if (it->d->c.domain==c->domain
+						&& it->d->c.ruid.len==c->ruid.len
+						&& memcmp(it->d->c.ruid.s, c->ruid.s, c->ruid.len)==0)
+					break;
+			}
+			if (it) {
+				/* the newer state wins, but it is still not in db if the
+				 * failed operation was the insert */
+				if (f->op==UL_DBQ_INSERT && it->op==UL_DBQ_UPDATE)
+					it->op = UL_DBQ_INSERT;
+				shm_free(f->d);
+				shm_free(f);
+				continue;
+			}
+			f->hnext = _ul_dbq->htable[f->hid];
+			_ul_dbq->htable[f->hid] = f;
+		}
+		if (last)
+			last->next = f;
+		else
+			first = f;
+		last = f;
+	}
+	if (first) {
+		last->next = _ul_dbq->first;
+		_ul_dbq->first = first;
+		if (_ul_dbq->last==0)
+			_ul_dbq->last = last;
+	}
+	lock_release(&_ul_dbq->lock);
+}
+
+
+void ul_dbq_flush(void)
+{
+	ul_dbq_item_t* list;
+	ul_dbq_item_t* it;
+	ul_dbq_item_t* failed;
+	ul_dbq_item_t* failed_last;
+
+	if (_ul_dbq==0 || ul_dbh==0)
+		return;
+	lock_get(&_ul_dbq->lock);
+	list = _ul_dbq->first;
+	if (list) {
+		_ul_dbq->first = _ul_dbq->last = 0;
+		memset(_ul_dbq->htable, 0, sizeof(_ul_dbq->htable));
+	}
+	lock_release(&_ul_dbq->lock);
+	if (list==0)
+		return;
+
+	/* the operations queued meanwhile are written by the next flush,
+	 * after these ones */
+	ul_dbq_write(list);
+
+	failed = failed_last = 0;
+	while (list) {
+		it = list;
+		list = list->next;
+		if (it->failed && it->retries<UL_DBQ_MAX_RETRIES) {
+			it->retries++;
+			it->next = 0;
+			if (failed_last)
+				failed_last->next = it;
+			else
+				failed = it;
+			failed_last = it;
+			continue;
+		}
+		if (it->failed) {
+			LM_ERR("dropping db operation %d for contact (aor: %.*s)"
+					" - still failing after %d retries\n", it->op,
+					it->d->aor.len, ZSW(it->d->aor.s), it->retries);
+		}
+		shm_free(it->d);
+		shm_free(it);
+	}
+	if (failed)
+		ul_dbq_requeue(failed);
+}
+
+
+static void ul_dbq_timer(unsigned int ticks, void* param)
+{
+	ul_dbq_flush();
+}
+
+
+int ul_dbq_fork(void)
+{
+	int pid;
+
+	if (_ul_dbq==0)
+		return 0;
+	_ul_dbq_writer = 1;
+	pid = fork_sync_utimer(PROC_TIMER, "USRLOC DB Writer", 1 /*socks flag*/,
+			ul_dbq_timer, 0, ul_db_writer_interval * 1000U);
+	_ul_dbq_writer = 0;
+	if (pid<0) {
+		LM_ERR("failed to start the db writer process\n");
+		return -1;
+	}
+	return 0;
+}
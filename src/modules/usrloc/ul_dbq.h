@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - Asynchronous database writer
+ *  \ingroup usrloc
+ *
+ * When the db_writer parameter is set (db_mode 1 and 2), the contact
+ * inserts, updates and deletes are not done by the process changing the
+ * contact, but are queued in shared memory and done by a dedicated
+ * writer process every db_writer_interval milliseconds. The queued
+ * operations are coalesced by contact ruid (only the last state of a
+ * contact is written) and written in transactions of up to
+ * db_writer_batch operations, if supported by the database module.
+ * The contacts are marked as synced when queued, so the operations that
+ * fail to be written are queued again and retried by the next flush, up
+ * to a few times before they are dropped.
+ *
+ * If the queue cannot be used (no more shm), the operation is done
+ * directly by the calling process.
+ */
+
+#ifndef UL_DBQ_H
+#define UL_DBQ_H
+
+#include "usrloc.h"
+
+#define UL_DBQ_INSERT 1
+#define UL_DBQ_UPDATE 2
+#define UL_DBQ_DELETE 3
+
+extern int ul_db_writer;
+extern int ul_db_writer_interval;
+extern int ul_db_writer_batch;
+
+/*! \brief allocate the queue, called from mod_init */
+int ul_dbq_init(void);
+
+/*! \brief write the queued operations and free the queue, called from
+ * destroy (before the final sync of the cache) */
+void ul_dbq_destroy(void);
+
+/*! \brief fork the writer process, called from child_init(PROC_MAIN) */
+int ul_dbq_fork(void);
+
+/*! \brief true if the db operations of this process must be queued */
+int ul_dbq_active(void);
+
+/*! \brief true if running in the writer process */
+int ul_dbq_writer(void);
+
+/*! \brief queue a db operation (UL_DBQ_*) for a contact
+ * \return 0 on success, -1 on error (the operation must be done directly) */
+int ul_dbq_add(int _op, ucontact_t* _c);
+
+/*! \brief write all the queued operations, called by the writer process
+ * and on shutdown */
+void ul_dbq_flush(void);
+
+#endif /* UL_DBQ_H */
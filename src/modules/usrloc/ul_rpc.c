@@ -816,6 +816,65 @@ static const char* ul_rpc_db_expired_contacts_doc[2] = {
 	0
 };
 
+static const char* ul_rpc_lock_stats_doc[2] = {
+	"Histogram of the wait times for the location table slot locks",
+	0
+};
+
+static void ul_rpc_lock_stats(rpc_t* rpc, void* ctx)
+{
+	dlist_t* dl;
+	udomain_t* dom;
+	unsigned int lwait[UL_LWAIT_BUCKETS];
+	unsigned long long wait_us;
+	char wbuf[24];
+	void* th;
+	void* ah;
+	void* vh;
+	int i, b;
+
+	for( dl=root ; dl ; dl=dl->next ) {
+		dom = dl->d;
+		/* the counters are read without locking, only for statistics */
+		memset(lwait, 0, sizeof(lwait));
+		wait_us = 0;
+		for(i=0; i<dom->size; i++) {
+			for(b=0; b<UL_LWAIT_BUCKETS; b++)
+				lwait[b] += dom->table[i].lwait[b];
+			wait_us += dom->table[i].lwait_us;
+		}
+		snprintf(wbuf, sizeof(wbuf), "%llu", wait_us);
+		if (rpc->add(ctx, "{", &th) < 0)
+		{
+			rpc->fault(ctx, 500, "Internal error creating top rpc");
+			return;
+		}
+		if(rpc->struct_add(th, "Sds[",
+					"Domain",  &dl->name,
+					"Size",    (int)dom->size,
+					"WaitUsec", wbuf,
+					"Wait",    &ah)<0)
+		{
+			rpc->fault(ctx, 500, "Internal error creating inner struct");
+			return;
+		}
+		for(b=0; b<UL_LWAIT_BUCKETS; b++) {
+			if(rpc->array_add(ah, "{", &vh)<0)
+			{
+				rpc->fault(ctx, 500, "Internal error creating bucket struct");
+				return;
+			}
+			if(rpc->struct_add(vh, "sd",
+						"Bucket", ul_lwait_names[b],
+						"Count",  (int)lwait[b])<0)
+			{
+				rpc->fault(ctx, 500, "Internal error adding bucket");
+				return;
+			}
+		}
+	}
+}
+
 rpc_export_t ul_rpc[] = {
 	{"ul.dump",   ul_rpc_dump,   ul_rpc_dump_doc,   0},
 	{"ul.lookup",   ul_rpc_lookup,   ul_rpc_lookup_doc,   0},
@@ -826,6 +885,7 @@ rpc_export_t ul_rpc[] = {
 	{"ul.db_users", ul_rpc_db_users, ul_rpc_db_users_doc, 0},
 	{"ul.db_contacts", ul_rpc_db_contacts, ul_rpc_db_contacts_doc, 0},
 	{"ul.db_expired_contacts", ul_rpc_db_expired_contacts, ul_rpc_db_expired_contacts_doc, 0},
+	{"ul.lock_stats", ul_rpc_lock_stats, ul_rpc_lock_stats_doc, 0},
 	{0, 0, 0, 0}
 };
 
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - Binary snapshots of the location tables
+ *  \ingroup usrloc
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/timer_proc.h"
+#include "../../lib/srdb1/db_snap.h"
+#include "usrloc_mod.h"
+#include "dlist.h"
+#include "utime.h"
+#include "ul_snap.h"
+
+/*! \brief aor + the contact columns loaded by preload_udomain() */
+#define UL_SNAP_COLS 20
+#define UL_SNAP_FNAME_SIZE 256
+
+str ul_snapshot_dir = STR_NULL;
+int ul_snapshot_interval = 0;
+int ul_snapshot_max_age = 600;
+
+/* set once the domains are loaded, so an aborted startup does not replace
+ * the snapshots with empty tables */
+static int* ul_snap_ready = 0;
+
+
+static void ul_snap_timer(unsigned int ticks, void* param)
+{
+	ul_snap_save_all(0);
+}
+
+
+int ul_snap_init(void)
+{
+	if (ul_snapshot_dir.s == 0 || ul_snapshot_dir.len <= 0) {
+		ul_snapshot_dir.s = 0;
+		ul_snapshot_dir.len = 0;
+		return 0;
+	}
+	if (db_mode == DB_ONLY) {
+		LM_WARN("snapshots are not used in DB_ONLY mode\n");
+		ul_snapshot_dir.s = 0;
+		ul_snapshot_dir.len = 0;
+		return 0;
+	}
+	ul_snap_ready = (int*)shm_malloc(sizeof(int));
+	if (ul_snap_ready == 0) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	*ul_snap_ready = 0;
+	/* with a db, only the snapshot written on shutdown is loaded */
+	if (ul_snapshot_interval > 0 && db_mode == NO_DB
+			&& sr_wtimer_add(ul_snap_timer, 0, ul_snapshot_interval) < 0) {
+		LM_ERR("failed to add the snapshot timer\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+/* snapshot file and content names of a domain, the content name includes
+ * the expires type (the type of the expires and last_modified values) */
+static int ul_snap_names(udomain_t* _d, char* _fname, char* _name,
+		int _nsize)
+{
+	int n;
+
+	n = snprintf(_fname, UL_SNAP_FNAME_SIZE, "%.*s/usrloc_%.*s.snap",
+			ul_snapshot_dir.len, ul_snapshot_dir.s,
+			_d->name->len, _d->name->s);
+	if (n < 0 || n >= UL_SNAP_FNAME_SIZE) {
+		LM_ERR("snapshot file name too long for table %.*s\n",
+				_d->name->len, _d->name->s);
+		return -1;
+	}
+	snprintf(_name, _nsize, "usrloc:%.*s:%d", _d->name->len, _d->name->s,
+			ul_expires_type);
+	return 0;
+}
+
+
+#define UL_SNAP_STR(v, _s) do { \
+		(v)->type = DB1_STR; \
+		(v)->nul = ((_s).s == 0 || (_s).len <= 0); \
+		(v)->val.str_val = (_s); \
+	} while(0)
+
+/* same columns and types as db_insert_ucontact() */
+static void ul_snap_contact_vals(ucontact_t* _c, db_val_t* _vals)
+{
+	memset(_vals, 0, UL_SNAP_COLS * sizeof(db_val_t));
+
+	UL_SNAP_STR(&_vals[0], *_c->aor);
+	UL_SNAP_STR(&_vals[1], _c->c);
+	UL_DB_EXPIRES_SET(&_vals[2], _c->expires);
+	_vals[3].type = DB1_DOUBLE;
+	_vals[3].val.double_val = q2double(_c->q);
+	UL_SNAP_STR(&_vals[4], _c->callid);
+	_vals[5].type = DB1_INT;
+	_vals[5].val.int_val = _c->cseq;
+	_vals[6].type = DB1_BITMAP;
+	_vals[6].val.bitmap_val = _c->flags;
+	_vals[7].type = DB1_BITMAP;
+	_vals[7].val.bitmap_val = _c->cflags;
+	UL_SNAP_STR(&_vals[8], _c->user_agent);
+	UL_SNAP_STR(&_vals[9], _c->received);
+	UL_SNAP_STR(&_vals[10], _c->path);
+	if (_c->sock) {
+		UL_SNAP_STR(&_vals[11], _c->sock->sock_str);
+	} else {
+		_vals[11].type = DB1_STR;
+		_vals[11].nul = 1;
+	}
+	_vals[12].type = DB1_BITMAP;
+	_vals[12].nul = (_c->methods == 0xFFFFFFFF);
+	_vals[12].val.bitmap_val = _c->methods;
+	UL_DB_EXPIRES_SET(&_vals[13], _c->last_modified);
+	UL_SNAP_STR(&_vals[14], _c->ruid);
+	UL_SNAP_STR(&_vals[15], _c->instance);
+	_vals[16].type = DB1_INT;
+	_vals[16].val.int_val = (int)_c->reg_id;
+	_vals[17].type = DB1_INT;
+	_vals[17].val.int_val = _c->server_id;
+	_vals[18].type = DB1_INT;
+	_vals[18].val.int_val = _c->tcpconn_id;
+	_vals[19].type = DB1_INT;
+	_vals[19].val.int_val = _c->keepalive;
+}
+
+
+static int ul_snap_save_udomain(udomain_t* _d, unsigned int _flags)
+{
+	char fname[UL_SNAP_FNAME_SIZE];
+	char name[64];
+	db_val_t vals[UL_SNAP_COLS];
+	db_snap_w_t w;
+	urecord_t* r;
+	ucontact_t* c;
+	int i;
+	int n;
+
+	if (ul_snap_names(_d, fname, name, sizeof(name)) < 0)
+		return -1;
+	if (db_snap_create(&w, fname, name, UL_SNAP_COLS) < 0)
+		return -1;
+
+	get_act_time();
+	n = 0;
+	for (i = 0; i < _d->size; i++) {
+		lock_ulslot(_d, i);
+		for (r = _d->table[i].first; r; r = r->next) {
+			for (c = r->contacts; c; c = c->next) {
+				if (!VALID_CONTACT(c, act_time))
+					continue;
+				ul_snap_contact_vals(c, vals);
+				if (db_snap_add(&w, vals) < 0) {
+					unlock_ulslot(_d, i);
+					db_snap_abort(&w);
+					return -1;
+				}
+				n++;
+			}
+		}
+		unlock_ulslot(_d, i);
+	}
+	if (db_snap_commit(&w, _flags) < 0)
+		return -1;
+	LM_DBG("%d contacts written to %s\n", n, fname);
+	return 0;
+}
+
+
+void ul_snap_set_ready(void)
+{
+	if (ul_snap_ready)
+		*ul_snap_ready = 1;
+}
+
+
+void ul_snap_save_all(int _final)
+{
+	dlist_t* ptr;
+
+	if (ul_snap_ready == 0 || *ul_snap_ready == 0)
+		return;
+	for (ptr = root; ptr; ptr = ptr->next) {
+		if (ul_snap_save_udomain(ptr->d, (_final)?DB_SNAP_F_FINAL:0) < 0) {
+			LM_ERR("failed to write the snapshot of table %.*s\n",
+					ptr->name.len, ZSW(ptr->name.s));
+		}
+	}
+}
+
+
+int ul_snap_load_udomain(udomain_t* _d)
+{
+	char fname[UL_SNAP_FNAME_SIZE];
+	char name[64];
+	db_val_t vals[UL_SNAP_COLS];
+	db_snap_t s;
+	str aor;
+	int n;
+	int ret;
+
+	if (ul_snapshot_dir.s == 0)
+		return 1;
+	if (ul_snap_names(_d, fname, name, sizeof(name)) < 0)
+		return 1;
+	/* with a database, only a snapshot of the synced cache can be used */
+	if (db_snap_open(&s, fname, name, UL_SNAP_COLS, ul_snapshot_max_age,
+				(db_mode==NO_DB)?0:DB_SNAP_F_FINAL) < 0)
+		return 1;
+
+	n = 0;
+	while ((ret = db_snap_next(&s, vals)) > 0) {
+		aor.s = (char*)VAL_STRING(&vals[0]);
+		if (VAL_NULL(&vals[0]) || aor.s == 0 || aor.s[0] == 0) {
+			LM_CRIT("empty aor in snapshot %s...skipping\n", fname);
+			continue;
+		}
+		aor.len = strlen(aor.s);
+		ret = mem_load_ucontact_row(_d, &aor, &vals[1]);
+		if (ret < 0)
+			break;
+		if (ret == 0)
+			n++;
+	}
+	db_snap_close(&s);
+	if (ret < 0) {
+		LM_ERR("failed to load table %.*s from snapshot %s\n",
+				_d->name->len, _d->name->s, fname);
+		return -1;
+	}
+	LM_INFO("table %.*s: %d contacts loaded from snapshot %s\n",
+			_d->name->len, _d->name->s, n, fname);
+	/* the database is changed from now on, don't load it again */
+	if (db_mode != NO_DB && unlink(fname) < 0) {
+		LM_WARN("failed to remove snapshot %s: %s\n", fname, strerror(errno));
+	}
+	return 0;
+}
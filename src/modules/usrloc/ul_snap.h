@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2016 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ *  \brief USRLOC - Binary snapshots of the location tables
+ *  \ingroup usrloc
+ *
+ * When the snapshot_dir parameter is set, the contacts of each location
+ * table are written to <snapshot_dir>/usrloc_<table>.snap every
+ * snapshot_interval seconds and on shutdown (see lib/srdb1/db_snap.h).
+ * At startup a table is loaded from its snapshot instead of the database
+ * if the snapshot is not older than snapshot_max_age. With a database
+ * (db_mode 1, 2 and 4) only the snapshot written on shutdown, after the
+ * final database sync, is used and it is removed once loaded. Without a
+ * database any recent enough snapshot is used.
+ */
+
+#ifndef UL_SNAP_H
+#define UL_SNAP_H
+
+#include "../../core/str.h"
+#include "udomain.h"
+
+extern str ul_snapshot_dir;
+extern int ul_snapshot_interval;
+extern int ul_snapshot_max_age;
+
+/*! \brief add the snapshot timer, called from mod_init */
+int ul_snap_init(void);
+
+/*! \brief load a domain from its snapshot
+ * \return 0 if loaded, 1 if there is no usable snapshot, -1 on error */
+int ul_snap_load_udomain(udomain_t* _d);
+
+/*! \brief mark the domains as loaded, the snapshots are written only
+ * after it, called from child_init(PROC_SIPINIT) */
+void ul_snap_set_ready(void);
+
+/*! \brief write the snapshots of all domains
+ * \param _final set on shutdown, after the final database sync */
+void ul_snap_save_all(int _final);
+
+#endif /* UL_SNAP_H */
@@ -35,6 +35,7 @@
 #include "../../core/hashes.h"
 #include "../../core/tcp_conn.h"
 #include "../../core/pass_fd.h"
+#include "../../core/mem/epoch.h"
 #include "usrloc_mod.h"
 #include "usrloc.h"
 #include "utime.h"
@@ -103,6 +104,16 @@ void free_urecord(urecord_t* _r)
 }
 
 
+/*!
+ * \brief free_urecord() for epoch_retire()
+ * \param _r freed record
+ */
+void ul_free_urecord(void* _r)
+{
+	free_urecord((urecord_t*)_r);
+}
+
+
 /*!
  * \brief Print a record, useful for debugging
  * \param _f print output
@@ -151,6 +162,7 @@ ucontact_t* mem_insert_ucontact(urecord_t* _r, str* _c, ucontact_info_t* _ci)
 	}
 	if_update_stat( _r->slot, _r->slot->d->contacts, 1);
 
+	slot_write_begin(_r->slot);
 	ptr = _r->contacts;
 
 	if (!desc_time_order) {
@@ -178,6 +190,7 @@ ucontact_t* mem_insert_ucontact(urecord_t* _r, str* _c, ucontact_info_t* _ci)
 	} else {
 		_r->contacts = c;
 	}
+	slot_write_end(_r->slot);
 
 	return c;
 }
@@ -190,6 +203,7 @@ ucontact_t* mem_insert_ucontact(urecord_t* _r, str* _c, ucontact_info_t* _ci)
  */
 void mem_remove_ucontact(urecord_t* _r, ucontact_t* _c)
 {
+	slot_write_begin(_r->slot);
 	if (_c->prev) {
 		_c->prev->next = _c->next;
 		if (_c->next) {
@@ -201,6 +215,7 @@ void mem_remove_ucontact(urecord_t* _r, ucontact_t* _c)
 			_c->next->prev = 0;
 		}
 	}
+	slot_write_end(_r->slot);
 }	
 
 
@@ -213,7 +228,8 @@ void mem_delete_ucontact(urecord_t* _r, ucontact_t* _c)
 {
 	mem_remove_ucontact(_r, _c);
 	if_update_stat( _r->slot, _r->slot->d->contacts, -1);
-	free_ucontact(_c);
+	/* lookups might still read it without lock */
+	epoch_retire(ul_epoch, _c, ul_free_ucontact);
 }
 
 static inline int is_valid_tcpconn(ucontact_t *c)
@@ -254,7 +270,7 @@ static inline int close_connection(int conid) {
 		con->send_flags.f |= SND_F_CON_CLOSE;
 		con->flags |= F_CONN_FORCE_EOF;
 
-		n = send_all(unix_tcp_sock, msg, sizeof(msg));
+		n = send_all(tcpconn_main_sock(con), msg, sizeof(msg));
 		if (unlikely(n <= 0)){
 			LM_ERR("failed to send close request: %s (%d)\n", strerror(errno), errno);
 			return 0;
@@ -62,6 +62,13 @@ int new_urecord(str* _dom, str* _aor, urecord_t** _r);
 void free_urecord(urecord_t* _r);
 
 
+/*!
+ * \brief free_urecord() for epoch_retire()
+ * \param _r freed record
+ */
+void ul_free_urecord(void* _r);
+
+
 /*!
  * \brief Print a record, useful for debugging
  * \param _f print output
@@ -72,6 +72,9 @@ int bind_usrloc(usrloc_api_t* api)
 	api->get_urecord_by_ruid      = get_urecord_by_ruid;
 	api->get_ucontact_by_instance = get_ucontact_by_instance;
 
+	api->get_urecord_snapshot     = get_urecord_snapshot;
+	api->release_urecord_snapshot = release_urecord_snapshot;
+
 	api->set_keepalive_timeout    = ul_set_keepalive_timeout;
 	api->refresh_keepalive        = ul_refresh_keepalive;
 	api->set_max_partition        = ul_set_max_partition;
@@ -153,6 +153,11 @@ typedef int (*insert_urecord_t)(struct udomain* _d, str* _aor, struct urecord**
 
 typedef int (*get_urecord_t)(struct udomain* _d, str* _aor, struct urecord** _r);
 
+typedef int (*get_urecord_snapshot_t)(struct udomain* _d, str* _aor,
+		struct urecord** _r);
+
+typedef void (*release_urecord_snapshot_t)(struct urecord* _r);
+
 typedef int (*get_urecord_by_ruid_t)(udomain_t* _d, unsigned int _aorhash,
 		str *_ruid, struct urecord** _r, struct ucontact** _c);
 
@@ -224,6 +229,9 @@ typedef struct usrloc_api {
 	get_urecord_by_ruid_t       get_urecord_by_ruid;
 	get_ucontact_by_instance_t  get_ucontact_by_instance;
 
+	get_urecord_snapshot_t      get_urecord_snapshot;
+	release_urecord_snapshot_t  release_urecord_snapshot;
+
 	update_ucontact_t    update_ucontact;
 
 	register_ulcb_t      register_ulcb;
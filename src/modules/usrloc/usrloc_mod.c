@@ -55,6 +55,9 @@
 #include "ucontact.h"        /* update_ucontact */
 #include "ul_rpc.h"
 #include "ul_callback.h"
+#include "../../core/mem/epoch.h"
+#include "ul_dbq.h"
+#include "ul_snap.h"
 #include "usrloc.h"
 
 MODULE_VERSION
@@ -171,6 +174,7 @@ unsigned int nat_bflag = (unsigned int)-1;
 unsigned int init_flag = 0;
 
 db1_con_t* ul_dbh = 0; /* Database connection handle */
+epoch_t* ul_epoch = NULL; /* deferred free for the lock-free readers */
 db_func_t ul_dbf;
 
 /* filter on load by server id */
@@ -233,6 +237,12 @@ static param_export_t params[] = {
 	{"db_insert_null",      PARAM_INT, &ul_db_insert_null},
 	{"server_id_filter",    PARAM_INT, &ul_db_srvid},
 	{"db_timer_clean",      PARAM_INT, &ul_db_timer_clean},
+	{"db_writer",           PARAM_INT, &ul_db_writer},
+	{"db_writer_interval",  PARAM_INT, &ul_db_writer_interval},
+	{"db_writer_batch",     PARAM_INT, &ul_db_writer_batch},
+	{"snapshot_dir",        PARAM_STR, &ul_snapshot_dir},
+	{"snapshot_interval",   PARAM_INT, &ul_snapshot_interval},
+	{"snapshot_max_age",    PARAM_INT, &ul_snapshot_max_age},
 	{0, 0, 0}
 };
 
@@ -356,6 +366,16 @@ static int mod_init(void)
 		}
 	}
 
+	if (ul_dbq_init() < 0) {
+		LM_ERR("failed to init the db writer queue\n");
+		return -1;
+	}
+
+	if (ul_snap_init() < 0) {
+		LM_ERR("failed to init the snapshots\n");
+		return -1;
+	}
+
 	if (handle_lost_tcp && db_mode == DB_ONLY)
 		LM_WARN("handle_lost_tcp option makes nothing in DB_ONLY mode\n");
 
@@ -369,10 +389,18 @@ static int child_init(int _rank)
 {
 	dlist_t* ptr;
 	int i;
+	int ret;
 
 	if(sruid_init(&_ul_sruid, '-', "ulcx", SRUID_INC)<0)
 		return -1;
 
+	/* the number of processes is known now, before forking */
+	if(_rank==PROC_INIT && db_mode!=DB_ONLY) {
+		ul_epoch = epoch_new();
+		if(ul_epoch==NULL)
+			return -1;
+	}
+
 	if(_rank==PROC_MAIN && ul_timer_procs>0)
 	{
 		for(i=0; i<ul_timer_procs; i++)
@@ -385,6 +413,22 @@ static int child_init(int _rank)
 		}
 	}
 
+	if(_rank==PROC_MAIN && ul_dbq_fork()<0)
+		return -1;
+
+	/* load the domains that have a snapshot, the others are preloaded
+	 * from DB */
+	if (_rank==PROC_SIPINIT && db_mode!=DB_ONLY) {
+		for( ptr=root ; ptr ; ptr=ptr->next) {
+			ret = ul_snap_load_udomain(ptr->d);
+			if (ret < 0)
+				return -1;
+			ptr->snap_loaded = (ret==0);
+		}
+		if (db_mode==NO_DB)
+			ul_snap_set_ready();
+	}
+
 	/* connecting to DB ? */
 	switch (db_mode) {
 		case NO_DB:
@@ -419,13 +463,14 @@ static int child_init(int _rank)
 	if (_rank==PROC_SIPINIT && db_mode!=DB_ONLY) {
 		/* if cache is used, populate domains from DB */
 		for( ptr=root ; ptr ; ptr=ptr->next) {
-			if (preload_udomain(ul_dbh, ptr->d) < 0) {
+			if (!ptr->snap_loaded && preload_udomain(ul_dbh, ptr->d) < 0) {
 				LM_ERR("child(%d): failed to preload domain '%.*s'\n",
 						_rank, ptr->name.len, ZSW(ptr->name.s));
 				return -1;
 			}
 			uldb_preload_attrs(ptr->d);
 		}
+		ul_snap_set_ready();
 	}
 
 	return 0;
@@ -437,6 +482,9 @@ static int child_init(int _rank)
  */
 static void destroy(void)
 {
+	/* write the queued db operations, the final sync is done directly */
+	ul_dbq_destroy();
+
 	/* we need to sync DB in order to flush the cache */
 	if (ul_dbh) {
 		if (synchronize_all_udomains(0, 1) != 0) {
@@ -445,8 +493,14 @@ static void destroy(void)
 		ul_dbf.close(ul_dbh);
 	}
 
+	/* after the sync, so it can replace the preload from DB */
+	ul_snap_save_all(1);
+
 	free_all_udomains();
 
+	epoch_destroy(ul_epoch);
+	ul_epoch = NULL;
+
 	/* free callbacks list */
 	destroy_ulcb_list();
 }
@@ -460,6 +514,7 @@ static void ul_core_timer(unsigned int ticks, void* param)
 	if (synchronize_all_udomains(0, 1) != 0) {
 		LM_ERR("synchronizing cache failed\n");
 	}
+	epoch_reclaim(ul_epoch);
 }
 
 /*! \brief
@@ -470,6 +525,7 @@ static void ul_local_timer(unsigned int ticks, void* param)
 	if (synchronize_all_udomains((int)(long)param, ul_timer_procs) != 0) {
 		LM_ERR("synchronizing cache failed\n");
 	}
+	epoch_reclaim(ul_epoch);
 }
 
 /*! \brief
@@ -32,6 +32,7 @@
 
 #include "../../lib/srdb1/db.h"
 #include "../../core/str.h"
+#include "../../core/mem/epoch.h"
 
 
 /*
@@ -97,6 +98,10 @@ extern unsigned int init_flag;
 extern str ul_xavp_contact_name;
 
 extern db1_con_t* ul_dbh;   /* Database connection handle */
+
+/* deferred free of the records and contacts read without the slot lock,
+ * NULL if there are no lock-free readers (db only mode, before fork) */
+extern epoch_t* ul_epoch;
 extern db_func_t ul_dbf;
 
 /* filter on load by server id */
@@ -0,0 +1,225 @@
+/*
+ * Header parsing throughput test for parser/hf_scan.h and parse_hname2()
+ *  (compares the scalar, sse4.2 and avx2 scanners on a corpus of sip
+ *   messages and checks that all of them find the same headers)
+ *
+ * Copyright (C) 2016 kamailio.org
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+/*
+ * Example gcc command line (from test/misc/code):
+ *  gcc -O2 -Wall -D__CPU_x86_64 -D__OS_linux -DCC_GCC_LIKE_ASM -DFAST_LOCK
+ *      -DPKG_MALLOC -DSHM_MEM -DF_MALLOC -I../../../src hf_scan_test.c
+ *      ../../../src/core/parser/hf_scan.c
+ *      ../../../src/core/parser/parse_hname2.c -o hf_scan_test
+ *
+ * Usage:
+ *  ./hf_scan_test [-n iterations] ../sip/<name>.sip ...
+ */
+
+#include "core/parser/hf.h"
+#include "core/parser/hf_scan.h"
+#include "core/parser/parse_hname2.h"
+#include "core/dprint.h"
+#include "core/str.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+
+/* the parser is linked without the rest of the core, provide what the
+ * logging macros need */
+int log_stderr = 1;
+int log_color = 0;
+volatile int dprint_crit = 0;
+km_log_f _km_log_func = 0;
+str* log_prefix_val = 0;
+struct log_level_info log_level_info[16];
+int process_no = 0;
+int get_debug_level(char *mname, int mnlen) { return L_ALERT; }
+int get_debug_facility(char *mname, int mnlen) { return 0; }
+void dprint_color(int level) {}
+void dprint_color_reset(void) {}
+int my_pid(void) { return getpid(); }
+
+
+/* zeroed bytes after each message, like the receive buffers */
+#define MSG_PAD 64
+#define MAX_MSGS 1024
+
+struct test_msg {
+	char* buf;
+	int len;
+	char* name;
+};
+
+struct scan_res {
+	unsigned long headers;
+	unsigned long known;
+	unsigned long type_sum;
+};
+
+
+static int load_msg(struct test_msg* m, char* fname)
+{
+	FILE* f;
+	long len;
+
+	f = fopen(fname, "r");
+	if (f == 0) {
+		perror(fname);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	m->buf = malloc(len + MSG_PAD);
+	if (m->buf == 0 || fread(m->buf, 1, len, f) != len) {
+		fprintf(stderr, "ERROR: cannot read %s\n", fname);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	memset(m->buf + len, 0, MSG_PAD);
+	m->len = len;
+	m->name = fname;
+	return 0;
+}
+
+
+/* walks the headers the same way get_hdr_field() does for the headers
+ * that are not parsed further (requests and replies; the corpus also has
+ * truncated messages, e.g. no_eom_reply.sip, their last header ends at
+ * the end of the buffer) */
+static int scan_msg(struct test_msg* m, struct scan_res* res)
+{
+	struct hdr_field hf;
+	char* p;
+	char* end;
+	char* match;
+
+	end = m->buf + m->len;
+	/* skip the first line */
+	p = hf_scan_lf(m->buf, end);
+	if (p == 0)
+		return -1;
+	p++;
+	while (p < end && *p != '\r' && *p != '\n') {
+		memset(&hf, 0, sizeof(hf));
+		p = parse_hname2(p, end, &hf);
+		if (hf.type == HDR_ERROR_T)
+			return -1;
+		res->headers++;
+		if (hf.type != HDR_OTHER_T)
+			res->known++;
+		res->type_sum += hf.type;
+		/* find the end of the header, including folded lines */
+		do {
+			match = hf_scan_lf(p, end);
+			if (match == 0) {
+				p = end; /* truncated message */
+				break;
+			}
+			p = match + 1;
+		} while (p < end && (*p == ' ' || *p == '\t'));
+	}
+	return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	struct test_msg msgs[MAX_MSGS];
+	struct scan_res res[3];
+	struct scan_res tmp;
+	struct timespec ts1, ts2;
+	unsigned long long bytes;
+	double secs;
+	int n, iterations;
+	int i, j, mode, c;
+
+	iterations = 100000;
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+			case 'n':
+				iterations = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-n iterations] msg.sip ...\n",
+						argv[0]);
+				exit(-1);
+		}
+	}
+	n = 0;
+	bytes = 0;
+	for (i = optind; i < argc && n < MAX_MSGS; i++) {
+		if (load_msg(&msgs[n], argv[i]) < 0)
+			exit(-1);
+		bytes += msgs[n].len;
+		n++;
+	}
+	if (n == 0) {
+		fprintf(stderr, "ERROR: no messages given\n");
+		exit(-1);
+	}
+
+	memset(res, 0, sizeof(res));
+	for (mode = HF_SCAN_SCALAR; mode <= HF_SCAN_AVX2; mode++) {
+		if (hf_scan_set_mode(mode) < 0) {
+			printf("%-8s: not supported\n", hf_scan_mode_name(mode));
+			continue;
+		}
+		/* one checked pass over the corpus */
+		for (j = 0; j < n; j++) {
+			if (scan_msg(&msgs[j], &res[mode]) < 0) {
+				fprintf(stderr, "ERROR: %s: bad message %s\n",
+						hf_scan_mode_name(mode), msgs[j].name);
+				exit(-1);
+			}
+		}
+		if (mode != HF_SCAN_SCALAR
+				&& memcmp(&res[mode], &res[HF_SCAN_SCALAR],
+						sizeof(struct scan_res)) != 0) {
+			fprintf(stderr, "ERROR: %s: results differ from scalar"
+					" (%lu/%lu headers, %lu/%lu known)\n",
+					hf_scan_mode_name(mode), res[mode].headers,
+					res[HF_SCAN_SCALAR].headers, res[mode].known,
+					res[HF_SCAN_SCALAR].known);
+			exit(-1);
+		}
+
+		memset(&tmp, 0, sizeof(tmp));
+		clock_gettime(CLOCK_MONOTONIC, &ts1);
+		for (i = 0; i < iterations; i++) {
+			for (j = 0; j < n; j++) {
+				scan_msg(&msgs[j], &tmp);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &ts2);
+		secs = (ts2.tv_sec - ts1.tv_sec)
+				+ (ts2.tv_nsec - ts1.tv_nsec) / 1000000000.0;
+		printf("%-8s: %d msgs x %d: %.3f s, %.1f MB/s, %.0f msgs/s,"
+				" %.0f headers/s\n",
+				hf_scan_mode_name(mode), n, iterations, secs,
+				(double)bytes * iterations / secs / (1024 * 1024),
+				(double)n * iterations / secs,
+				(double)res[HF_SCAN_SCALAR].headers * iterations / secs);
+	}
+	printf("%lu headers per corpus pass, %lu well known\n",
+			res[HF_SCAN_SCALAR].headers, res[HF_SCAN_SCALAR].known);
+	return 0;
+}